@@ -0,0 +1,115 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Compares the queue storage of ActionContainer (papilio::RingBuffer) 
+// with the std::deque based storage it replaced, for the access pattern
+// of queued report and cycle actions: push a batch of actions, then pop 
+// them one by one.
+//
+// Build and run with 
+//
+//    make benchmark
+
+#include "papilio/aux/RingBuffer.h"
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <memory>
+
+namespace {
+   
+struct Payload { int value_; };
+
+// The former ActionContainer::popFront() copied the front element
+// before popping it.
+//
+template<typename _Container>
+std::shared_ptr<Payload> popFrontCopy(_Container &container) {
+   auto front_element = container.front();
+   container.pop_front();
+   return front_element;
+}
+
+template<typename _Container>
+std::shared_ptr<Payload> popFrontMove(_Container &container) {
+   auto front_element = std::move(container.front());
+   container.pop_front();
+   return front_element;
+}
+
+template<typename _Container, typename _PopFunction>
+double run(_PopFunction pop, int n_rounds, int batch_size) {
+   
+   std::shared_ptr<Payload> action = std::make_shared<Payload>(Payload{1});
+   _Container container;
+   long sum = 0;
+   
+   auto start = std::chrono::steady_clock::now();
+   
+   for(int round = 0; round < n_rounds; ++round) {
+      for(int i = 0; i < batch_size; ++i) {
+         container.push_back(action);
+      }
+      while(!container.empty()) {
+         sum += pop(container)->value_;
+      }
+   }
+   
+   auto end = std::chrono::steady_clock::now();
+   
+   if(sum != long(n_rounds)*batch_size) {
+      std::cerr << "Unexpected checksum " << sum << std::endl;
+   }
+   
+   double seconds = std::chrono::duration<double>(end - start).count();
+   
+   // Push/pop pairs per second
+   //
+   return double(n_rounds)*batch_size/seconds;
+}
+
+void report(const char *name, double rate, double reference) {
+   std::cout << "   " << name << ": " << rate/1e6 << " M push/pop per s ("
+      << rate/reference << "x)" << std::endl;
+}
+
+} // namespace
+
+int main() {
+   
+   typedef std::deque<std::shared_ptr<Payload>> Deque;
+   typedef papilio::RingBuffer<std::shared_ptr<Payload>> Ring;
+   
+   const int n_actions = 1 << 24;
+   
+   for(int batch_size: { 1, 8, 64, 1024 }) {
+      
+      int n_rounds = n_actions/batch_size;
+      
+      double deque_copy = run<Deque>(popFrontCopy<Deque>, n_rounds, batch_size);
+      double deque_move = run<Deque>(popFrontMove<Deque>, n_rounds, batch_size);
+      double ring_move = run<Ring>(popFrontMove<Ring>, n_rounds, batch_size);
+      
+      std::cout << "batch size " << batch_size << std::endl;
+      report("std::deque, copy pop    ", deque_copy, deque_copy);
+      report("std::deque, move pop    ", deque_move, deque_copy);
+      report("RingBuffer, move pop    ", ring_move, deque_copy);
+   }
+   
+   return 0;
+}
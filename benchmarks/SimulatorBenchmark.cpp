@@ -0,0 +1,619 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Measures the throughput of the simulator's hot paths against a mock
+// simulator core whose loop() does nothing but emit a configurable
+// number of keyboard reports.
+//
+// Build and run with 
+//
+//    make benchmark
+
+#include "Papilio.h"
+#include "papilio/ActionContainer_Impl.h"
+#include "papilio/SimulatorCore_.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+using namespace papilio;
+using namespace papilio::actions;
+
+namespace {
+   
+// A stream buffer that discards everything but still lets
+// the simulator format its output.
+//
+class NullBuffer : public std::streambuf
+{
+   protected:
+      
+      virtual int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+      virtual std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+class BenchmarkKeyboardReport : public KeyboardReport_
+{
+   public:
+      
+      virtual std::shared_ptr<Report_> clone() const override {
+         return std::make_shared<BenchmarkKeyboardReport>(*this);
+      }
+      
+      virtual bool equals(const Report_ &other) const override {
+         auto other_report = dynamic_cast<const BenchmarkKeyboardReport*>(&other);
+         return other_report && (other_report->keycodes_ == keycodes_);
+      }
+      
+      virtual bool isEmpty() const override { return keycodes_.none(); }
+      
+      virtual void dump(const Simulator &simulator, const char *add_indent = "") const override {
+         simulator.log() << add_indent << "benchmark keyboard report";
+      }
+      
+      virtual bool isKeycodeActive(uint8_t keycode) const override { return keycodes_.test(keycode); }
+      virtual std::vector<uint8_t> getActiveKeycodes() const override { return keycodes_.toKeycodes(); }
+      virtual bool isModifierKeycodeActive(uint8_t /*modifier*/) const override { return false; }
+      virtual bool isAssertAnyModifierActive() const override { return false; }
+      virtual bool isAnyKeyActive() const override { return !keycodes_.none(); }
+      virtual std::vector<uint8_t> getActiveModifiers() const override { return std::vector<uint8_t>{}; }
+      
+      virtual KeycodeBitmap getKeycodeBitmap() const override { return keycodes_; }
+      virtual uint8_t getModifierBitmap() const override { return modifiers_; }
+      
+      KeycodeBitmap keycodes_;
+      uint8_t modifiers_ = 0;
+};
+
+class BenchmarkCore : public SimulatorCore_
+{
+   public:
+      
+      BenchmarkCore(uint8_t rows, uint8_t cols)
+         :  rows_(rows), cols_(cols), pressed_(rows*cols), reported_pressed_(rows*cols)
+      {}
+      
+      virtual void init() override {}
+      
+      virtual void getKeyMatrixDimensions(uint8_t &rows, uint8_t &cols) const override {
+         rows = rows_; cols = cols_;
+      }
+      
+      virtual void pressKey(uint8_t row, uint8_t col) override { pressed_[row*cols_ + col] = true; }
+      virtual void releaseKey(uint8_t row, uint8_t col) override { pressed_[row*cols_ + col] = false; }
+      virtual void tapKey(uint8_t row, uint8_t col) override { pressed_[row*cols_ + col] = true; }
+      virtual bool isKeyPressed(uint8_t row, uint8_t col) const override { return pressed_[row*cols_ + col]; }
+      
+      virtual KeyOffset getNumLEDs() const override { return KeyOffset(rows_*cols_); }
+      
+      virtual void getCurrentKeyLEDColor(KeyOffset key_offset, uint8_t &red, 
+                                         uint8_t &green, uint8_t &blue) const override {
+         red = key_offset; green = uint8_t(2*key_offset); blue = uint8_t(3*key_offset);
+      }
+      
+      virtual void getCurrentKeyLabel(uint8_t /*row*/, uint8_t /*col*/,
+                                      std::string &label_string) const override {
+         label_string = " A  ";
+      }
+      
+      virtual void setTime(uint32_t /*time*/) override {}
+      
+      virtual const char *keycodeToName(uint8_t /*keycode*/) const override { return "A"; }
+      
+      virtual void loop() override {
+         for(int i = 0; i < n_reports_per_cycle_; ++i) {
+            report_callback_();
+         }
+      }
+      
+      // Nothing but the key state changes.
+      //
+      virtual bool takeChanges(CoreChanges &changes) override {
+         if(!track_changes_) { return false; }
+         for(KeyOffset key_offset = 0; key_offset < rows_*cols_; ++key_offset) {
+            if(pressed_[key_offset] != reported_pressed_[key_offset]) {
+               changes.mark(CoreChanges::KeyStateChange, key_offset);
+            }
+         }
+         reported_pressed_ = pressed_;
+         return true;
+      }
+      
+      virtual bool saveState(std::vector<uint8_t> &image) const override {
+         image.assign(pressed_.begin(), pressed_.end());
+         return true;
+      }
+      
+      virtual bool restoreState(const std::vector<uint8_t> &image) override {
+         if(image.size() != pressed_.size()) { return false; }
+         pressed_.assign(image.begin(), image.end());
+         return true;
+      }
+      
+      int n_reports_per_cycle_ = 0;
+      bool track_changes_ = false;
+      std::function<void()> report_callback_;
+      
+   private:
+      
+      uint8_t rows_, cols_;
+      std::vector<bool> pressed_;
+      std::vector<bool> reported_pressed_;
+};
+
+class BenchmarkSimulator : public Simulator
+{
+   public:
+      
+      BenchmarkSimulator(std::ostream &out) : Simulator(out) {
+         terminate_on_failure_ = false;
+      }
+      
+      void report(const BenchmarkKeyboardReport &report) {
+         this->processReport(report);
+      }
+};
+
+struct Setup
+{
+   Setup(uint8_t rows = 4, uint8_t cols = 16)
+      :  out_(&null_buffer_),
+         simulator_(out_),
+         core_(std::make_shared<BenchmarkCore>(rows, cols))
+   {
+      simulator_.setCore(core_);
+      report_.keycodes_.set(4);
+      core_->report_callback_ = [this]() { simulator_.report(report_); };
+   }
+   
+   NullBuffer null_buffer_;
+   std::ostream out_;
+   BenchmarkSimulator simulator_;
+   std::shared_ptr<BenchmarkCore> core_;
+   BenchmarkKeyboardReport report_;
+};
+
+template<typename _Function>
+void measure(const char *name, const char *unit, long n, _Function function) {
+   
+   auto start = std::chrono::steady_clock::now();
+   function();
+   auto end = std::chrono::steady_clock::now();
+   
+   double seconds = std::chrono::duration<double>(end - start).count();
+   
+   printf("%-56s %12.0f %s/s\n", name, n/seconds, unit);
+}
+
+std::string generateKeyboardTemplate(int rows, int cols) {
+   std::string result;
+   for(int row = 0; row < rows; ++row) {
+      for(int col = 0; col < cols; ++col) {
+         result += "|{" + std::to_string(row*cols + col) + "}";
+      }
+      result += "|\n";
+   }
+   return result;
+}
+
+} // namespace
+
+int main() {
+   
+   {
+      Setup setup;
+      const int n = 1000000;
+      measure("cycle()", "cycles", n, [&]() {
+         for(int i = 0; i < n; ++i) { setup.simulator_.cycle(true); }
+      });
+   }
+   
+   {
+      Setup setup;
+      const int n = 10000000;
+      measure("cycles(n), fast forward", "cycles", n, [&]() {
+         setup.simulator_.cycles(n);
+      });
+   }
+   
+   {
+      Setup setup;
+      setup.simulator_.setFastForward(false);
+      const int n = 1000000;
+      measure("cycles(n), no fast forward", "cycles", n, [&]() {
+         setup.simulator_.cycles(n);
+      });
+   }
+   
+   {
+      Setup setup;
+      const int n = 1000000;
+      for(int i = 1; i <= n; i += 10) {
+         setup.simulator_.scheduleTapKey(ScheduleTime::atCycle(i), 0, 0);
+      }
+      measure("cycles(n), scheduled key tap every 10 cycles", "cycles", n, [&]() {
+         setup.simulator_.cycles(n);
+      });
+   }
+   
+   {
+      // Scheduled taps and direct presses between cycles must be 
+      // replayed in the cycles they were applied in.
+      //
+      const char *journal_filename = "SimulatorBenchmark.journal";
+      const int n = 200000;
+      {
+         Setup setup;
+         for(int i = 1; i <= n; i += 10) {
+            setup.simulator_.scheduleTapKey(ScheduleTime::atCycle(i), 0, 0);
+         }
+         setup.simulator_.startInputJournal(journal_filename);
+         for(int i = 0; i < n; i += 1000) {
+            setup.simulator_.pressKey(1, 1);
+            setup.simulator_.cycles(500);
+            setup.simulator_.releaseKey(1, 1);
+            setup.simulator_.cycles(500);
+         }
+         setup.simulator_.stopInputJournal();
+      }
+      
+      Setup setup;
+      bool replayed = false;
+      measure("replayInputJournal(), scheduled key tap every 10 cycles", "cycles", n, [&]() {
+         replayed = setup.simulator_.replayInputJournal(journal_filename);
+      });
+      std::remove(journal_filename);
+      
+      if(!replayed || (setup.simulator_.getErrorCount() != 0) 
+            || (setup.simulator_.getCycleId() != n)) {
+         printf("   input journal replay diverged from the recording\n");
+      }
+   }
+   
+   for(bool parallel: { false, true }) {
+      
+      Setup setup;
+      
+      auto candidate = std::make_shared<BenchmarkCore>(4, 16);
+      candidate->n_reports_per_cycle_ = 10;
+      candidate->report_callback_ = setup.core_->report_callback_;
+      setup.core_->n_reports_per_cycle_ = 10;
+      
+      auto core = std::make_shared<DifferentialCore>(setup.core_, candidate);
+      core->setParallel(parallel);
+      setup.simulator_.setCore(core);
+      
+      const int n_cycles = 200000;
+      
+      const char *name = parallel ? "DifferentialCore, 10 reports per cycle, parallel"
+                                  : "DifferentialCore, 10 reports per cycle, serial";
+      measure(name, "cycles", n_cycles, [&]() {
+         setup.simulator_.cycles(n_cycles);
+      });
+   }
+   
+   {
+      Setup setup;
+      
+      // The candidate reports a different keycode while key (0, 0) is
+      // pressed. Every replay restores a snapshot taken before the key
+      // is pressed and must detect the mismatch again in the same cycle.
+      //
+      auto candidate = std::make_shared<BenchmarkCore>(4, 16);
+      BenchmarkCore *candidate_core = candidate.get();
+      candidate->n_reports_per_cycle_ = 1;
+      setup.core_->n_reports_per_cycle_ = 1;
+      BenchmarkKeyboardReport diverging_report;
+      diverging_report.keycodes_.set(5);
+      candidate->report_callback_ = [&setup, candidate_core, &diverging_report]() {
+         setup.simulator_.report(candidate_core->isKeyPressed(0, 0) ? diverging_report
+                                                                    : setup.report_);
+      };
+      
+      auto core = std::make_shared<DifferentialCore>(setup.core_, candidate);
+      core->setParallel(false);
+      setup.simulator_.setCore(core);
+      setup.simulator_.cycles(10);
+      
+      auto snapshot = setup.simulator_.snapshot();
+      
+      const int n_replays = 20000;
+      int n_failed = 0;
+      
+      measure("DifferentialCore, replaying a mismatch", "replays", n_replays, [&]() {
+         for(int i = 0; i < n_replays; ++i) {
+            setup.simulator_.restore(snapshot);
+            if(core->hasMismatch()) { ++n_failed; }
+            setup.simulator_.cycles(5);
+            core->pressKey(0, 0);
+            setup.simulator_.cycles(5);
+            if(!core->hasMismatch() || (core->getMismatch().n_cycles_before_ != 15)) { 
+               ++n_failed; 
+            }
+         }
+      });
+      
+      if(n_failed > 0) {
+         printf("   %d replays did not reproduce the mismatch\n", n_failed);
+      }
+   }
+   
+   {
+      Setup setup;
+      setup.simulator_.setLogLevel(StandardLogLevel);
+      
+      // Every pressed key generates keycode 4 + key offset, except for 
+      // the last key which is left shift.
+      //
+      setup.core_->n_reports_per_cycle_ = 1;
+      setup.core_->report_callback_ = [&setup]() {
+         BenchmarkKeyboardReport report;
+         for(uint8_t key = 0; key < 63; ++key) {
+            if(setup.core_->isKeyPressed(key/16, key % 16)) {
+               report.keycodes_.set(4 + key);
+            }
+         }
+         if(setup.core_->isKeyPressed(3, 15)) {
+            report.modifiers_ = 0x02;
+         }
+         setup.simulator_.report(report);
+      };
+      
+      TypingLoadGenerator typing;
+      typing.addModifier(0xE1, 3, 15);
+      for(uint8_t i = 0; i < 26; ++i) {
+         typing.addCharacter(char('a' + i), i/16, i % 16, 4 + i);
+         typing.addCharacter(char('A' + i), i/16, i % 16, 4 + i, 0x02);
+      }
+      typing.addCharacter(' ', 26/16, 26 % 16, 4 + 26);
+      
+      std::string text;
+      for(int i = 0; i < 2000; ++i) {
+         text += "The quick brown fox jumps over the lazy dog. ";
+      }
+      
+      measure("TypingLoadGenerator::run(), 120 WPM", "keystrokes", long(text.size()), [&]() {
+         typing.run(setup.simulator_, text);
+      });
+      
+      if(typing.getReconstructedText() != typing.getTypedText()) {
+         printf("   reconstructed text differs from typed text\n");
+      }
+   }
+   
+   for(bool failure: { false, true }) {
+      
+      Setup setup;
+      setup.core_->n_reports_per_cycle_ = 1;
+      
+      // A key that gets stuck at cycle 123457 is detected by an
+      // invariant that only checks every 1000 cycles.
+      //
+      const int n_cycles = 200000;
+      if(failure) {
+         setup.simulator_.schedulePressKey(ScheduleTime::atCycle(123457), 0, 0);
+      }
+      setup.simulator_.permanentCycleActions().add(CustomAction{[&setup]() {
+         return    (setup.simulator_.getCycleId() % 1000 != 0)
+                || !setup.core_->isKeyPressed(0, 0);
+      }});
+      
+      FailureBisector bisector;
+      bisector.addProbe("key released", [](Simulator &simulator) {
+         return !simulator.getCore().isKeyPressed(0, 0);
+      });
+      
+      const char *name = failure ? "FailureBisector::run(), bisecting a failure"
+                                 : "FailureBisector::run(), passing";
+      measure(name, "cycles", n_cycles, [&]() {
+         bisector.run(setup.simulator_, n_cycles);
+      });
+      
+      if(failure && (bisector.getFirstFailingCycle() != 123457)) {
+         printf("   first failing cycle %d instead of 123457\n", bisector.getFirstFailingCycle());
+      }
+   }
+   
+   for(int n_actions: { 0, 10, 100 }) {
+      
+      Setup setup;
+      setup.core_->n_reports_per_cycle_ = 10;
+      
+      for(int i = 0; i < n_actions; ++i) {
+         setup.simulator_.permanentKeyboardReportActions().add(AssertKeycodesActive{4});
+      }
+      
+      const int n_cycles = 2000000/(n_actions + 1);
+      
+      std::string name = "processReport(), " + std::to_string(n_actions) + " permanent actions";
+      measure(name.c_str(), "reports", long(n_cycles)*10, [&]() {
+         setup.simulator_.cycles(n_cycles);
+      });
+   }
+   
+   for(size_t capacity: { size_t(0), size_t(1024) }) {
+      
+      Setup setup;
+      setup.simulator_.setLogLevel(StandardLogLevel);
+      setup.simulator_.flightRecorder().setCapacity(capacity);
+      setup.core_->n_reports_per_cycle_ = 10;
+      
+      const int n_cycles = 200000;
+      
+      const char *name = capacity ? "processReport(), flight recorder" 
+                                  : "processReport(), no flight recorder";
+      measure(name, "reports", long(n_cycles)*10, [&]() {
+         setup.simulator_.cycles(n_cycles);
+      });
+   }
+   
+   for(auto policy: { HostPollingModel::DropNewest, HostPollingModel::Coalesce }) {
+      
+      Setup setup;
+      setup.simulator_.setLogLevel(StandardLogLevel);
+      setup.simulator_.hostPolling().setEnabled(true);
+      setup.simulator_.hostPolling().setPolicy(policy);
+      setup.core_->n_reports_per_cycle_ = 10;
+      
+      const int n_cycles = 200000;
+      
+      const char *name = (policy == HostPollingModel::Coalesce) 
+                                 ? "processReport(), host polling, coalesce"
+                                 : "processReport(), host polling, drop newest";
+      measure(name, "reports", long(n_cycles)*10, [&]() {
+         setup.simulator_.cycles(n_cycles);
+      });
+      
+      // One report per poll reaches the host.
+      //
+      const auto &endpoint = setup.simulator_.getHostPolling().getEndpoint(KeyboardReportTypeId);
+      if(endpoint.getNumDelivered() + endpoint.getNumDropped() + endpoint.getNumMerged() 
+            + endpoint.getQueueDepth() != uint64_t(n_cycles)*10) {
+         printf("   reports lost by the host polling model\n");
+      }
+   }
+   
+   for(bool static_group: { false, true }) {
+      
+      Setup setup;
+      setup.core_->n_reports_per_cycle_ = 10;
+      
+      if(static_group) {
+         setup.simulator_.permanentReportActions().add(
+            staticGroup(AssertKeycodesActive{4}, AssertAnyKeycodeActive{}, 
+                        AssertKeycodesActive{4}, AssertAnyKeycodeActive{}));
+      }
+      else {
+         setup.simulator_.permanentReportActions().add(
+            group(AssertKeycodesActive{4}, AssertAnyKeycodeActive{}, 
+                  AssertKeycodesActive{4}, AssertAnyKeycodeActive{}));
+      }
+      
+      const int n_cycles = 200000;
+      
+      const char *name = static_group ? "processReport(), staticGroup(...) of 4 actions"
+                                      : "processReport(), group(...) of 4 actions";
+      measure(name, "reports", long(n_cycles)*10, [&]() {
+         setup.simulator_.cycles(n_cycles);
+      });
+   }
+   
+   // Trace output is enabled by default. The hot paths are measured 
+   // with and without it.
+   //
+   for(int log_level: { TraceLogLevel, StandardLogLevel }) {
+      
+      const char *suffix = (log_level == TraceLogLevel) ? ", trace log level" : ", standard log level";
+      
+      {
+         Setup setup;
+         setup.simulator_.setLogLevel(log_level);
+         setup.core_->n_reports_per_cycle_ = 10;
+         const int n_cycles = 200000;
+         std::string name = std::string{"processReport(), 10 permanent actions"} + suffix;
+         
+         for(int i = 0; i < 10; ++i) {
+            setup.simulator_.permanentKeyboardReportActions().add(AssertKeycodesActive{4});
+         }
+         
+         measure(name.c_str(), "reports", long(n_cycles)*10, [&]() {
+            setup.simulator_.cycles(n_cycles);
+         });
+      }
+   
+      {
+         Setup setup;
+         setup.simulator_.setLogLevel(log_level);
+         ActionContainer<ReportAction_> container{setup.simulator_};
+         std::shared_ptr<ReportAction_> action = AssertKeycodesActive{4}.ptr();
+         const int n = 1000000;
+         std::string name = std::string{"ActionContainer add()/popFront()"} + suffix;
+         measure(name.c_str(), "actions", n, [&]() {
+            for(int i = 0; i < n; ++i) {
+               container.add(action);
+               container.popFront();
+            }
+         });
+      }
+   }
+   
+   {
+      Setup setup;
+      setup.core_->n_reports_per_cycle_ = 1;
+      const int n = 1000000;
+      measure("cycleExpectReports(), queued action per report", "reports", n, [&]() {
+         for(int i = 0; i < n; ++i) {
+            setup.simulator_.cycleExpectReports(AssertKeycodesActive{4});
+         }
+      });
+   }
+   
+   {
+      Setup setup(16, 16);
+      std::string keyboard = generateKeyboardTemplate(16, 16);
+      const int n = 1000;
+      measure("renderKeyboard(), 16x16 matrix", "frames", n, [&]() {
+         for(int i = 0; i < n; ++i) {
+            renderKeyboard(setup.simulator_, keyboard.c_str());
+         }
+      });
+   }
+   
+   for(bool track_changes: { false, true }) {
+      Setup setup(16, 16);
+      setup.core_->track_changes_ = track_changes;
+      std::string keyboard = generateKeyboardTemplate(16, 16);
+      KeyboardRenderer renderer{keyboard.c_str()};
+      renderer.update(setup.simulator_);
+      const int n = 100000;
+      const char *name = track_changes 
+            ? "KeyboardRenderer::update(), unchanged, change tracking"
+            : "KeyboardRenderer::update(), 16x16 matrix, unchanged";
+      measure(name, "frames", n, [&]() {
+         for(int i = 0; i < n; ++i) {
+            renderer.update(setup.simulator_);
+         }
+      });
+   }
+   
+   {
+      Setup setup(16, 16);
+      uint8_t key_led_colors[256][3];
+      for(int i = 0; i < 256; ++i) {
+         key_led_colors[i][0] = uint8_t(i);
+         key_led_colors[i][1] = uint8_t(2*i);
+         key_led_colors[i][2] = uint8_t(3*i);
+      }
+      const int n = 100000;
+      measure("assertKeyLEDState(), 16x16 matrix", "checks", n, [&]() {
+         for(int i = 0; i < n; ++i) {
+            assertKeyLEDState(setup.simulator_, key_led_colors);
+         }
+      });
+      if(setup.simulator_.getErrorCount() != 0) {
+         std::cerr << "Unexpected LED state mismatch" << std::endl;
+      }
+   }
+   
+   return 0;
+}
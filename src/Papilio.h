@@ -20,18 +20,46 @@
 #include "papilio/Simulator.h"
 #include "papilio/Visualization.h"
 #include "papilio/LED_Checks.h"
+#include "papilio/TestRunner.h"
+#include "papilio/Fuzzer.h"
+#include "papilio/ReportTrace.h"
+#include "papilio/InputJournal.h"
+#include "papilio/LEDRecording.h"
+#include "papilio/CoreChanges.h"
+#include "papilio/CompositeCore.h"
+#include "papilio/DifferentialCore.h"
+#include "papilio/TypingLoadGenerator.h"
+#include "papilio/FailureBisector.h"
+#include "papilio/HostPollingModel.h"
+#include "papilio/HostInputBridge.h"
+#include "papilio/CoreLibrary.h"
+#include "papilio/StaticSimulatorCore.h"
+#include "papilio/KeymapSweep.h"
+#include "papilio/aux/AsyncOStream.h"
 
 #include "papilio/reports/BootKeyboardReport_.h"
 #include "papilio/reports/KeyboardReport_.h"
 #include "papilio/reports/MouseReport_.h"
 #include "papilio/reports/AbsoluteMouseReport_.h"
+#include "papilio/reports/ConsumerControlReport_.h"
+#include "papilio/reports/SystemControlReport_.h"
+#include "papilio/reports/RawHIDReport_.h"
+#include "papilio/reports/ReportTypes.h"
 
 #include "papilio/actions/Grouped.h"
+#include "papilio/actions/StaticGrouped.h"
 #include "papilio/actions/CustomAction.h"
 #include "papilio/actions/AssertNumOverallReportsEquals.h"
 #include "papilio/actions/Action_.h"
 #include "papilio/actions/AssertCycleIsNth.h"
 #include "papilio/actions/AssertElapsedTimeGreater.h"
+#include "papilio/actions/RecordLEDAnimation.h"
+#include "papilio/actions/AssertLEDsMatchRecording.h"
+#include "papilio/actions/AssertLatencyBelow.h"
+#include "papilio/actions/AssertCycleWallTimeBelow.h"
+#include "papilio/actions/AssertPeakHeapBelow.h"
+#include "papilio/actions/AssertCoresAgree.h"
+#include "papilio/actions/AssertHostNotSaturated.h"
 
 #include "papilio/actions/generic_report/AssertReportEmpty.h"
 #include "papilio/actions/generic_report/AssertReportEquals.h"
@@ -39,6 +67,8 @@
 #include "papilio/actions/generic_report/AssertReportIsNthInCycle.h"
 #include "papilio/actions/generic_report/CustomReportAction.h"
 #include "papilio/actions/generic_report/AssertCycleGeneratesNReports.h"
+#include "papilio/actions/generic_report/RecordReportTrace.h"
+#include "papilio/actions/generic_report/AssertReportsMatchTrace.h"
 
 #include "papilio/actions/keyboard_report/AssertModifiersActive.h"
 #include "papilio/actions/keyboard_report/AssertAnyKeycodeActive.h"
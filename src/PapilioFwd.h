@@ -0,0 +1,67 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Forward declarations of Papilio's main classes. Include this file
+// instead of Papilio.h in headers of test code that only pass
+// simulators, cores and reports by reference.
+
+#include <stdint.h>
+
+namespace papilio {
+   
+typedef uint16_t KeyOffset;
+
+class Simulator;
+class SimulatorCore_;
+class KeyMatrixState;
+class CoreChanges;
+class CoreChangeTracker;
+class ScheduleTime;
+
+class Report_;
+class BootKeyboardReport_;
+class KeyboardReport_;
+class MouseReport_;
+class AbsoluteMouseReport_;
+class ConsumerControlReport_;
+class SystemControlReport_;
+class RawHIDReport_;
+struct ReportData;
+
+class Action_;
+class ReportAction_;
+
+template<typename _ReportType>
+class ReportAction;
+
+template<typename _ActionType>
+class ActionContainer;
+
+class CompositeCore;
+class DifferentialCore;
+class CoreLibrary;
+class KeyboardRenderer;
+class TestRunner;
+class Fuzzer;
+class KeymapSweep;
+class TypingLoadGenerator;
+class FailureBisector;
+class HostPollingModel;
+
+} // namespace papilio
@@ -19,12 +19,12 @@
 
 #include "papilio/actions/Grouped.h"
 #include "papilio/aux/demangle.h"
+#include "papilio/aux/RingBuffer.h"
 
 // Undefine some macros that are defined by Arduino
 #undef min
 #undef max
 
-#include <deque>
 #include <vector>
 #include <memory>
 
@@ -41,6 +41,7 @@ class ActionContainer
       
       typedef ActionContainer<_ActionType> ThisType;
       typedef _ActionType ActionType;
+      typedef RingBuffer<std::shared_ptr<_ActionType>> StorageType;
       
       /// @brief Constructor.
       /// @param simulator The associated Simulator object.
@@ -66,12 +67,14 @@ class ActionContainer
       /// @tparam actions The actions to be added to the container.
       ///
       template<typename..._Actions>
-      ThisType &add(_Actions...actions) {
-         this->add(
-            std::vector<std::shared_ptr<_ActionType>>{
-               unwrapAction(actions)...
-            }      
-         );
+      ThisType &add(const _Actions &...actions) {
+         
+         // Add actions one by one without collecting them
+         // in a temporary vector first.
+         //
+         int expand[] = { 0, (this->add(
+                  std::shared_ptr<_ActionType>{unwrapAction(actions)}), 0)... };
+         (void)expand;
          return *this;
       }
       
@@ -133,14 +136,34 @@ class ActionContainer
       ///
       void clear() {
          container_.clear();
+         ++revision_;
       }
       
-      /// @brief Enables direct access to the undelying std::deque object.
+      /// @brief Enables direct access to the undelying storage object.
       ///
-      const std::deque<std::shared_ptr<_ActionType>> &directAccess() {
+      const StorageType &directAccess() const {
          return container_;
       }
       
+      /// @brief Replaces the entire content of the container.
+      /// @details The actions are expected to be already configured, e.g.
+      ///        because they were retreived from another container 
+      ///        via directAccess().
+      ///
+      /// @param content The new content.
+      ///
+      void assign(const StorageType &content) {
+         container_ = content;
+         ++revision_;
+      }
+      
+      /// @brief Retreives the revision of the container's content.
+      /// @details The revision changes whenever actions are added 
+      ///        or removed. It enables users to cache information
+      ///        that is derived from the container's content.
+      ///
+      unsigned getRevision() const { return revision_; }
+      
    private:
       
       void configureAction(const std::shared_ptr<_ActionType> &action);
@@ -154,7 +177,8 @@ class ActionContainer
    private:
       
       Simulator &simulator_;
-      std::deque<std::shared_ptr<_ActionType>> container_;
+      StorageType container_;
+      unsigned revision_ = 0;
 };
 
 } // namespace papilio
@@ -25,7 +25,6 @@
 #undef min
 #undef max
 
-#include <deque>
 #include <vector>
 #include <memory>
 
@@ -38,7 +37,8 @@ ActionContainer<_ActionType> &
 {
    this->configureAction(action);
    container_.push_back(action);
-   simulator_.log() << "Adding " << _ActionType::typeString() << " action: " 
+   ++revision_;
+   PAPILIO_TRACE(simulator_) << "Adding " << _ActionType::typeString() << " action: " 
          << type(*action);
    return *this;
 }
@@ -72,11 +72,14 @@ ActionContainer<_ActionType> &
 
    this->configureAction(grouped_actions);
    container_.push_back(grouped_actions);
+   ++revision_;
    
-   simulator_.log() << "Adding grouped " << _ActionType::typeString() << " actions";
-   for(const auto &action: actions) {
-      simulator_.log() << "   " << type(*action);
-   }   
+   if(simulator_.isLogLevelEnabled(TraceLogLevel)) {
+      simulator_.trace() << "Adding grouped " << _ActionType::typeString() << " actions";
+      for(const auto &action: actions) {
+         simulator_.trace() << "   " << type(*action);
+      }
+   }
    
    return *this;
 }
@@ -91,6 +94,7 @@ ActionContainer<_ActionType> &
    for (auto iter = container_.begin(); iter != container_.end() ; ) {
    if(*iter == action) {
       iter = container_.erase(iter);
+      ++revision_;
       remove_success = true;
       break;
    }
@@ -125,8 +129,9 @@ std::shared_ptr<_ActionType>
    ActionContainer<_ActionType>
       ::popFront()
 {
-   auto front_element = container_.front();
+   auto front_element = std::move(container_.front());
    container_.pop_front();
+   ++revision_;
    return front_element;
 }
 
@@ -52,12 +52,8 @@ class ActionQueueAdaptor
       /// @tparam actions The actions to be added to the queue.
       ///
       template<typename..._Actions>
-      ThisType &queue(_Actions...actions) {
-         container_.add(
-            std::vector<std::shared_ptr<ActionType>>{
-               unwrapAction(actions)...
-            }
-         );
+      ThisType &queue(const _Actions &...actions) {
+         container_.add(actions...);
          return *this;
       }
       
@@ -0,0 +1,351 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/CompositeCore.h"
+#include "papilio/aux/state_image.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace papilio {
+
+CompositeCore::~CompositeCore()
+{
+   this->stopWorkers();
+}
+
+CompositeCore &CompositeCore::addCore(const std::shared_ptr<SimulatorCore_> &core)
+{
+   CoreEntry entry;
+   entry.core_ = core;
+   core->getKeyMatrixDimensions(entry.rows_, entry.cols_);
+   entry.col_offset_ = cols_;
+   
+   cores_.push_back(entry);
+   deferred_reports_.resize(cores_.size());
+   
+   if(entry.rows_ > rows_) { rows_ = entry.rows_; }
+   cols_ = uint8_t(cols_ + entry.cols_);
+   
+   return *this;
+}
+
+CompositeCore &CompositeCore::addLink(const std::shared_ptr<SerialLink> &link)
+{
+   links_.push_back(link);
+   return *this;
+}
+
+void CompositeCore::setParallel(bool state)
+{
+   parallel_ = state;
+   if(!parallel_) {
+      this->stopWorkers();
+   }
+}
+
+void CompositeCore::init()
+{
+   for(auto &entry: cores_) {
+      entry.core_->init();
+   }
+}
+
+const CompositeCore::CoreEntry *
+   CompositeCore::findCore(uint8_t row, uint8_t col, uint8_t &core_col) const
+{
+   for(const auto &entry: cores_) {
+      if(col < entry.col_offset_ + entry.cols_) {
+         if(row >= entry.rows_) { return nullptr; }
+         core_col = uint8_t(col - entry.col_offset_);
+         return &entry;
+      }
+   }
+   return nullptr;
+}
+
+void CompositeCore::pressKey(uint8_t row, uint8_t col)
+{
+   uint8_t core_col = 0;
+   if(const CoreEntry *entry = this->findCore(row, col, core_col)) {
+      entry->core_->pressKey(row, core_col);
+   }
+}
+
+void CompositeCore::releaseKey(uint8_t row, uint8_t col)
+{
+   uint8_t core_col = 0;
+   if(const CoreEntry *entry = this->findCore(row, col, core_col)) {
+      entry->core_->releaseKey(row, core_col);
+   }
+}
+
+void CompositeCore::tapKey(uint8_t row, uint8_t col)
+{
+   uint8_t core_col = 0;
+   if(const CoreEntry *entry = this->findCore(row, col, core_col)) {
+      entry->core_->tapKey(row, core_col);
+   }
+}
+
+bool CompositeCore::isKeyPressed(uint8_t row, uint8_t col) const
+{
+   uint8_t core_col = 0;
+   if(const CoreEntry *entry = this->findCore(row, col, core_col)) {
+      return entry->core_->isKeyPressed(row, core_col);
+   }
+   return false;
+}
+
+void CompositeCore::getCurrentKeyLEDColor(KeyOffset key_offset, 
+                                 uint8_t &red, uint8_t &green, uint8_t &blue) const
+{
+   red = green = blue = 0;
+   
+   if(cols_ == 0) { return; }
+   
+   uint8_t row = uint8_t(key_offset/cols_);
+   uint8_t core_col = 0;
+   const CoreEntry *entry = this->findCore(row, uint8_t(key_offset%cols_), core_col);
+   if(!entry) { return; }
+   
+   KeyOffset core_key_offset = keyOffset(row, core_col, entry->cols_);
+   if(core_key_offset < entry->core_->getNumLEDs()) {
+      entry->core_->getCurrentKeyLEDColor(core_key_offset, red, green, blue);
+   }
+}
+
+void CompositeCore::getCurrentKeyLabel(uint8_t row, uint8_t col,
+                                       std::string &label_string) const
+{
+   uint8_t core_col = 0;
+   if(const CoreEntry *entry = this->findCore(row, col, core_col)) {
+      entry->core_->getCurrentKeyLabel(row, core_col, label_string);
+   }
+   else {
+      label_string = "    ";
+   }
+}
+
+int CompositeCore::getKeycode(uint8_t row, uint8_t col) const
+{
+   uint8_t core_col = 0;
+   if(const CoreEntry *entry = this->findCore(row, col, core_col)) {
+      return entry->core_->getKeycode(row, core_col);
+   }
+   return -1;
+}
+
+bool CompositeCore::takeChanges(CoreChanges &changes)
+{
+   core_changes_.resize(cores_.size());
+   
+   // The changes of all cores are taken, even if one of them
+   // does not track changes.
+   //
+   bool tracked = true;
+   
+   for(size_t i = 0; i < cores_.size(); ++i) {
+      
+      const CoreEntry &entry = cores_[i];
+      CoreChanges &core_changes = core_changes_[i];
+      
+      if(   (core_changes.getRows() != entry.rows_)
+         || (core_changes.getCols() != entry.cols_)) {
+         core_changes.resize(entry.rows_, entry.cols_);
+      }
+      else {
+         core_changes.clear();
+      }
+      
+      if(!entry.core_->takeChanges(core_changes)) {
+         tracked = false;
+         continue;
+      }
+      
+      for(int type = 0; type < CoreChanges::NumTypes; ++type) {
+         core_changes.getKeys(CoreChanges::Type(type)).forEachSet(
+            [&changes, &entry, type](KeyOffset key_offset) {
+               changes.mark(CoreChanges::Type(type), uint8_t(key_offset/entry.cols_),
+                            uint8_t(entry.col_offset_ + key_offset % entry.cols_));
+            });
+      }
+   }
+   
+   return tracked;
+}
+
+void CompositeCore::setTime(uint32_t time)
+{
+   for(auto &entry: cores_) {
+      entry.core_->setTime(time);
+   }
+}
+
+const char *CompositeCore::keycodeToName(uint8_t keycode) const
+{
+   if(cores_.empty()) { return ""; }
+   return cores_[0].core_->keycodeToName(keycode);
+}
+
+void CompositeCore::stepCore(size_t index)
+{
+   DeferredReports::Scope scope(deferred_reports_[index]);
+   MemoryTracker::HeapScope heap_scope(track_heap_);
+   cores_[index].core_->loop();
+}
+
+void CompositeCore::loop()
+{
+   // Worker threads inherit heap tracking from the simulator's thread.
+   //
+   track_heap_ = MemoryTracker::isHeapTrackingActive();
+   
+   if(parallel_ && (cores_.size() > 1)) {
+      
+      if(workers_.empty()) {
+         this->startWorkers();
+      }
+      
+      // The first core runs on the simulator's thread.
+      //
+      start_barrier_->wait();
+      this->stepCore(0);
+      end_barrier_->wait();
+   }
+   else {
+      for(size_t i = 0; i < cores_.size(); ++i) {
+         this->stepCore(i);
+      }
+   }
+   
+   for(auto &link: links_) {
+      link->exchange();
+   }
+   
+   for(auto &reports: deferred_reports_) {
+      reports.processAll();
+   }
+}
+
+void CompositeCore::startWorkers()
+{
+   unsigned n_threads = unsigned(cores_.size());
+   
+   start_barrier_.reset(new SpinBarrier{n_threads});
+   end_barrier_.reset(new SpinBarrier{n_threads});
+   stopping_ = false;
+   
+   for(size_t i = 1; i < cores_.size(); ++i) {
+      workers_.emplace_back([this, i]() {
+         while(1) {
+            start_barrier_->wait();
+            if(stopping_.load(std::memory_order_relaxed)) { break; }
+            this->stepCore(i);
+            end_barrier_->wait();
+         }
+      });
+   }
+}
+
+void CompositeCore::stopWorkers()
+{
+   if(workers_.empty()) { return; }
+   
+   stopping_ = true;
+   start_barrier_->wait();
+   
+   for(auto &worker: workers_) {
+      worker.join();
+   }
+   workers_.clear();
+}
+
+bool CompositeCore::isQuiescent(TimeType &next_wakeup_time) const
+{
+   next_wakeup_time = std::numeric_limits<TimeType>::max();
+   
+   for(const auto &entry: cores_) {
+      TimeType core_wakeup_time = 0;
+      if(!entry.core_->isQuiescent(core_wakeup_time)) {
+         return false;
+      }
+      if(core_wakeup_time < next_wakeup_time) {
+         next_wakeup_time = core_wakeup_time;
+      }
+   }
+   
+   // Data in transit must be delivered.
+   //
+   for(const auto &link: links_) {
+      if(link->endpoint(0).getSize() || link->endpoint(1).getSize()) {
+         return false;
+      }
+   }
+   
+   return true;
+}
+
+bool CompositeCore::saveState(std::vector<uint8_t> &image) const
+{
+   // One image part per core, followed by the parts 
+   // of the bytes in transit on every link.
+   //
+   image.clear();
+   
+   std::vector<uint8_t> core_image;
+   for(const auto &entry: cores_) {
+      if(!entry.core_->saveState(core_image)) {
+         return false;
+      }
+      appendImagePart(image, core_image);
+   }
+   
+   for(const auto &link: links_) {
+      link->saveState(image);
+   }
+   return true;
+}
+
+bool CompositeCore::restoreState(const std::vector<uint8_t> &image)
+{
+   std::vector<uint8_t> core_image;
+   size_t pos = 0;
+   
+   for(auto &entry: cores_) {
+      if(   !readImagePart(image, pos, core_image)
+         || !entry.core_->restoreState(core_image)) {
+         return false;
+      }
+   }
+   
+   for(auto &link: links_) {
+      if(!link->restoreState(image, pos)) {
+         return false;
+      }
+   }
+   return pos == image.size();
+}
+
+void CompositeCore::setSimulator(Simulator *simulator)
+{
+   for(auto &entry: cores_) {
+      entry.core_->setSimulator(simulator);
+   }
+}
+
+} // namespace papilio
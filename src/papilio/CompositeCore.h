@@ -0,0 +1,191 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/SimulatorCore_.h"
+#include "papilio/SerialLink.h"
+#include "papilio/DeferredReports.h"
+#include "papilio/MemoryTracker.h"
+#include "papilio/aux/SpinBarrier.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace papilio {
+   
+/// @brief A core that steps several cores in lockstep, e.g. the
+///        firmware images of the two halves of a split keyboard.
+/// @details The key matrices of all cores are placed side by side. 
+///        Columns of the composite matrix are assigned to the cores
+///        in the order they were added. The number of rows is the
+///        maximum of all cores. Key LEDs are mapped the same way.
+///
+///        Every call to loop() runs one loop cycle of each core. If 
+///        running in parallel, every core but the first 
+///        is assigned its own worker thread. All threads are 
+///        synchronized by a barrier at the beginning and the end of 
+///        each cycle. Afterwards, the data of all serial links is exchanged
+///        and the reports that the cores generated are processed
+///        by the simulator, ordered by core and, per core, in the order 
+///        the reports were generated. Results are thus identical
+///        for parallel and serial execution.
+///
+///        Note that reports are processed after all cores finished
+///        their loop cycle. Report actions therefore see the core state 
+///        at the end of the cycle.
+///
+class CompositeCore : public SimulatorCore_
+{
+   public:
+      
+      /// @brief Constructor.
+      /// @details Parallel execution is enabled if the hardware
+      ///        supports more than one concurrent thread.
+      ///
+      CompositeCore() 
+         :  parallel_(std::thread::hardware_concurrency() > 1)
+      {}
+      
+      CompositeCore(const CompositeCore &) = delete;
+      CompositeCore &operator=(const CompositeCore &) = delete;
+      
+      virtual ~CompositeCore();
+      
+      /// @brief Adds a core.
+      /// @details All cores must be added before the composite core is
+      ///        passed to the simulator.
+      ///
+      /// @param core The core to add.
+      /// @returns The composite core to enable chaining.
+      ///
+      CompositeCore &addCore(const std::shared_ptr<SimulatorCore_> &core);
+      
+      /// @brief Adds a link whose data is exchanged between cycles.
+      /// @details The endpoints of the link must be passed to the 
+      ///        respective cores by the user.
+      ///
+      /// @param link The link to add.
+      /// @returns The composite core to enable chaining.
+      ///
+      CompositeCore &addLink(const std::shared_ptr<SerialLink> &link);
+      
+      /// @brief Retreives the number of cores.
+      ///
+      size_t getNumCores() const { return cores_.size(); }
+      
+      /// @brief Retreives a core.
+      ///
+      const std::shared_ptr<SimulatorCore_> &getCore(size_t index) const {
+         return cores_[index].core_;
+      }
+      
+      /// @brief Retreives the first column of a core's keys in the 
+      ///        composite key matrix.
+      ///
+      uint8_t getColumnOffset(size_t index) const { return cores_[index].col_offset_; }
+      
+      /// @brief Enables or disables running cores in parallel threads.
+      ///
+      void setParallel(bool state);
+      
+      bool getParallel() const { return parallel_; }
+      
+      virtual void init() override;
+      
+      virtual void getKeyMatrixDimensions(uint8_t &rows, uint8_t &cols) const override {
+         rows = rows_;
+         cols = cols_;
+      }
+      
+      virtual void pressKey(uint8_t row, uint8_t col) override;
+      virtual void releaseKey(uint8_t row, uint8_t col) override;
+      virtual void tapKey(uint8_t row, uint8_t col) override;
+      virtual bool isKeyPressed(uint8_t row, uint8_t col) const override;
+      
+      virtual KeyOffset getNumLEDs() const override {
+         return KeyOffset(rows_*cols_);
+      }
+      
+      virtual void getCurrentKeyLEDColor(KeyOffset key_offset, 
+                                      uint8_t &red, uint8_t &green, uint8_t &blue) const override;
+      
+      virtual void getCurrentKeyLabel(uint8_t row, uint8_t col,
+                                   std::string &label_string) const override;
+      
+      virtual int getKeycode(uint8_t row, uint8_t col) const override;
+      
+      virtual bool takeChanges(CoreChanges &changes) override;
+      
+      virtual void setTime(uint32_t time) override;
+   
+      virtual const char *keycodeToName(uint8_t keycode) const override;
+      
+      virtual void loop() override;
+      
+      virtual bool isQuiescent(TimeType &next_wakeup_time) const override;
+      
+      virtual bool saveState(std::vector<uint8_t> &image) const override;
+      
+      virtual bool restoreState(const std::vector<uint8_t> &image) override;
+      
+      virtual void setSimulator(Simulator *simulator) override;
+      
+   private:
+      
+      struct CoreEntry {
+         std::shared_ptr<SimulatorCore_> core_;
+         uint8_t rows_;
+         uint8_t cols_;
+         uint8_t col_offset_;
+      };
+      
+      /// @brief Maps a key of the composite matrix to a core.
+      /// @returns The core entry or nullptr if no core owns the key.
+      ///
+      const CoreEntry *findCore(uint8_t row, uint8_t col, uint8_t &core_col) const;
+      
+      void stepCore(size_t index);
+      
+      void startWorkers();
+      void stopWorkers();
+      
+   private:
+      
+      std::vector<CoreEntry> cores_;
+      std::vector<std::shared_ptr<SerialLink>> links_;
+      std::vector<DeferredReports> deferred_reports_;
+      std::vector<CoreChanges> core_changes_;
+      
+      uint8_t rows_ = 0;
+      uint8_t cols_ = 0;
+      
+      bool parallel_;
+      
+      std::unique_ptr<SpinBarrier> start_barrier_;
+      std::unique_ptr<SpinBarrier> end_barrier_;
+      std::vector<std::thread> workers_;
+      std::atomic<bool> stopping_{false};
+      
+      // Written before the start barrier, read by the workers.
+      //
+      bool track_heap_ = false;
+};
+
+} // namespace papilio
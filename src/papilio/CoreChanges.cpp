@@ -0,0 +1,70 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/CoreChanges.h"
+#include "papilio/SimulatorCore_.h"
+
+namespace papilio {
+
+void CoreChangeTracker::update(SimulatorCore_ &core)
+{
+   uint8_t rows = 0, cols = 0;
+   core.getKeyMatrixDimensions(rows, cols);
+   
+   if((changes_.getRows() != rows) || (changes_.getCols() != cols)) {
+      changes_.resize(rows, cols);
+      for(auto &key_revisions: key_revisions_) {
+         key_revisions.assign(std::size_t(rows)*cols, 0);
+      }
+      valid_ = false;
+   }
+   else {
+      changes_.clear();
+   }
+   
+   // The core's changes are always taken, so that they do not
+   // accumulate while the tracker is invalid.
+   //
+   tracked_by_core_ = core.takeChanges(changes_);
+   
+   if(!valid_ || !tracked_by_core_) {
+      changes_.markAll();
+      valid_ = true;
+   }
+   
+   if(changes_.none()) { return; }
+   
+   const Revision revision = revision_ + 1;
+   
+   for(int type = 0; type < CoreChanges::NumTypes; ++type) {
+      
+      const KeyMatrixState &keys = changes_.getKeys(CoreChanges::Type(type));
+      
+      if(keys.none()) { continue; }
+      
+      std::vector<Revision> &key_revisions = key_revisions_[type];
+      keys.forEachSet([&key_revisions, revision](KeyOffset key_offset) {
+         key_revisions[key_offset] = revision;
+      });
+      
+      type_revisions_[type] = revision;
+   }
+   
+   revision_ = revision;
+}
+
+} // namespace papilio
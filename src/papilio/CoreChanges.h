@@ -0,0 +1,174 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/KeyMatrixState.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace papilio {
+
+class SimulatorCore_;
+
+/// @brief The keys whose state changed, one bitmap per type of change.
+/// @details Cores that track changes mark keys while running and
+///        pass the marks on via SimulatorCore_::takeChanges(...).
+///
+class CoreChanges
+{
+   public:
+      
+      enum Type {
+         
+         /// @brief The key was pressed or released.
+         ///
+         KeyStateChange,
+         
+         /// @brief The color of the key's LED changed.
+         ///
+         KeyLEDChange,
+         
+         /// @brief The label of the key changed, e.g. because
+         ///        of a layer change.
+         ///
+         KeyLabelChange,
+         
+         NumTypes
+      };
+      
+      /// @brief Changes the matrix dimensions and clears all marks.
+      ///
+      void resize(uint8_t rows, uint8_t cols) {
+         for(auto &keys: keys_) { keys.resize(rows, cols); }
+      }
+      
+      uint8_t getRows() const { return keys_[0].getRows(); }
+      uint8_t getCols() const { return keys_[0].getCols(); }
+      
+      /// @brief Marks a key as changed.
+      ///
+      void mark(Type type, KeyOffset key_offset) { keys_[type].set(key_offset); }
+      
+      void mark(Type type, uint8_t row, uint8_t col) { keys_[type].set(row, col); }
+      
+      /// @brief Marks all keys as changed.
+      ///
+      void markAll(Type type) { keys_[type].setAll(); }
+      
+      void markAll() {
+         for(auto &keys: keys_) { keys.setAll(); }
+      }
+      
+      /// @brief Adds the marks of another object of the same dimensions.
+      ///
+      void merge(const CoreChanges &other) {
+         for(int type = 0; type < NumTypes; ++type) {
+            for(size_t w = 0; w < keys_[type].getNumWords(); ++w) {
+               keys_[type].setWord(w, keys_[type].getWord(w) | other.keys_[type].getWord(w));
+            }
+         }
+      }
+      
+      /// @brief Clears all marks.
+      ///
+      void clear() {
+         for(auto &keys: keys_) { keys.clear(); }
+      }
+      
+      /// @brief Checks if no key is marked.
+      ///
+      bool none() const {
+         for(const auto &keys: keys_) {
+            if(!keys.none()) { return false; }
+         }
+         return true;
+      }
+      
+      /// @brief Retreives the keys that changed in a given way.
+      ///
+      const KeyMatrixState &getKeys(Type type) const { return keys_[type]; }
+   
+   private:
+      
+      KeyMatrixState keys_[NumTypes];
+};
+
+/// @brief Keeps track of when the keys of a core changed.
+/// @details Every update collects the changes of the core
+///        via SimulatorCore_::takeChanges(...) and assigns them a new revision.
+///        Consumers remember the revision they processed last and only
+///        query the core for keys that changed since.
+///        If the core does not track changes, every update
+///        treats all keys as changed.
+///
+///        The simulator owns the tracker of its core,
+///        see Simulator::getCoreChanges().
+///
+class CoreChangeTracker
+{
+   public:
+      
+      typedef uint64_t Revision;
+      
+      /// @brief Collects the changes of a core.
+      ///
+      void update(SimulatorCore_ &core);
+      
+      /// @brief Treats all keys as changed with the next update,
+      ///        e.g. after the core was replaced or its state was restored.
+      ///
+      void invalidate() { valid_ = false; }
+      
+      /// @brief Retreives the revision of the most recent change.
+      /// @details Zero means that no update took place yet.
+      ///
+      Revision getRevision() const { return revision_; }
+      
+      /// @brief Checks if the core tracks changes.
+      ///
+      bool isTrackedByCore() const { return tracked_by_core_; }
+      
+      /// @brief Checks if a key changed after a given revision.
+      ///
+      bool hasChanged(CoreChanges::Type type, KeyOffset key_offset, Revision since) const {
+         return    (std::size_t(key_offset) >= key_revisions_[type].size())
+                || (key_revisions_[type][key_offset] > since);
+      }
+      
+      /// @brief Checks if any key changed in a given way after a given revision.
+      ///
+      bool anyChanged(CoreChanges::Type type, Revision since) const {
+         return type_revisions_[type] > since;
+      }
+      
+      /// @brief Checks if any key changed in any way after a given revision.
+      ///
+      bool anyChanged(Revision since) const { return revision_ > since; }
+   
+   private:
+      
+      CoreChanges changes_;
+      std::vector<Revision> key_revisions_[CoreChanges::NumTypes];
+      Revision type_revisions_[CoreChanges::NumTypes] = {};
+      Revision revision_ = 0;
+      bool valid_ = false;
+      bool tracked_by_core_ = false;
+};
+
+} // namespace papilio
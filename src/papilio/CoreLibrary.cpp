@@ -0,0 +1,205 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/CoreLibrary.h"
+#include "papilio/Simulator.h"
+#include "papilio/Profiler.h"
+
+#include <fstream>
+
+#if defined(__has_include)
+#if __has_include(<dlfcn.h>)
+#define PAPILIO_HAVE_DLOPEN
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace papilio {
+   
+namespace {
+   
+constexpr uint64_t check_interval = 200000000; // ns
+
+// Copies a file to a new temporary file.
+//
+bool copyToTemporaryFile(const std::string &filename, std::string &copy_filename)
+{
+#ifdef PAPILIO_HAVE_DLOPEN
+   std::ifstream in(filename, std::ios::binary);
+   if(!in) { return false; }
+   
+   char copy_template[] = "/tmp/papilio_core_XXXXXX.so";
+   int fd = mkstemps(copy_template, 3);
+   if(fd < 0) { return false; }
+   close(fd);
+   
+   copy_filename = copy_template;
+   
+   std::ofstream out(copy_filename, std::ios::binary | std::ios::trunc);
+   out << in.rdbuf();
+   out.close();
+   
+   if(!out) {
+      unlink(copy_filename.c_str());
+      return false;
+   }
+   return true;
+#else
+   (void)filename;
+   (void)copy_filename;
+   return false;
+#endif
+}
+
+} // namespace
+
+bool CoreLibrary::load(const std::string &filename)
+{
+#ifdef PAPILIO_HAVE_DLOPEN
+   
+   int64_t mtime = 0;
+   filename_ = filename;
+   if(!this->getModificationTime(mtime)) {
+      error_ = "Unable to access " + filename;
+      return false;
+   }
+   
+   // Loading a private copy makes sure that every load 
+   // picks up the current content of the file.
+   //
+   std::string copy_filename;
+   if(!copyToTemporaryFile(filename, copy_filename)) {
+      error_ = "Unable to copy " + filename;
+      return false;
+   }
+   
+   void *handle = dlopen(copy_filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+   
+   // The mapping remains valid after the file is removed.
+   //
+   unlink(copy_filename.c_str());
+   
+   if(!handle) {
+      const char *message = dlerror();
+      error_ = message ? message : "Unable to load " + filename;
+      return false;
+   }
+   
+   auto interface_version = reinterpret_cast<int (*)()>(
+                              dlsym(handle, "papilio_coreInterfaceVersion"));
+   auto create_core = reinterpret_cast<CreateFunction>(
+                              dlsym(handle, "papilio_createCore"));
+   auto destroy_core = reinterpret_cast<DestroyFunction>(
+                              dlsym(handle, "papilio_destroyCore"));
+   
+   if(!interface_version || !create_core || !destroy_core) {
+      error_ = filename + " does not export a simulator core";
+      dlclose(handle);
+      return false;
+   }
+   
+   if(interface_version() != PAPILIO_CORE_INTERFACE_VERSION) {
+      error_ = filename + " was built for an incompatible core interface version "
+         + std::to_string(interface_version());
+      dlclose(handle);
+      return false;
+   }
+   
+   create_core_ = create_core;
+   destroy_core_ = destroy_core;
+   loaded_mtime_ = mtime;
+   seen_mtime_ = mtime;
+   ++n_loads_;
+   error_.clear();
+   
+   return true;
+#else
+   filename_ = filename;
+   error_ = "Loading shared libraries is not supported on this platform";
+   return false;
+#endif
+}
+
+bool CoreLibrary::reload()
+{
+   return this->load(filename_);
+}
+
+std::shared_ptr<SimulatorCore_> CoreLibrary::createCore() const
+{
+   if(!create_core_) { return nullptr; }
+   
+   DestroyFunction destroy_core = destroy_core_;
+   
+   return std::shared_ptr<SimulatorCore_>(create_core_(), 
+                  [destroy_core](SimulatorCore_ *core) { destroy_core(core); });
+}
+
+bool CoreLibrary::hasChanged()
+{
+   int64_t mtime = 0;
+   
+   // The file may be missing temporarily while it is rebuilt.
+   //
+   if(!this->getModificationTime(mtime)) { return false; }
+   
+   bool stable = (mtime == seen_mtime_);
+   seen_mtime_ = mtime;
+   
+   return stable && (mtime != loaded_mtime_);
+}
+
+bool CoreLibrary::reloadIfChanged(Simulator &simulator)
+{
+   uint64_t now = Profiler::now();
+   if(now - last_check_ < check_interval) { return false; }
+   last_check_ = now;
+   
+   if(!this->hasChanged()) { return false; }
+   
+   if(!this->reload()) {
+      
+      // Do not retry before the file changes again.
+      //
+      loaded_mtime_ = seen_mtime_;
+      
+      simulator.error() << "Failed to reload core library " << filename_ 
+         << ": " << error_;
+      return false;
+   }
+   
+   simulator.log() << "Core library " << filename_ << " reloaded";
+   
+   return simulator.replaceCore(this->createCore());
+}
+
+bool CoreLibrary::getModificationTime(int64_t &mtime) const
+{
+#ifdef PAPILIO_HAVE_DLOPEN
+   struct stat status;
+   if(stat(filename_.c_str(), &status) != 0) { return false; }
+   mtime = int64_t(status.st_mtim.tv_sec)*1000000000 + status.st_mtim.tv_nsec;
+   return true;
+#else
+   (void)mtime;
+   return false;
+#endif
+}
+
+} // namespace papilio
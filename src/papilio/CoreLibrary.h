@@ -0,0 +1,157 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/SimulatorCore_.h"
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// @brief The version of the interface between simulator and a 
+///        core library. Increased for incompatible changes of SimulatorCore_
+///        and of the types that cross the library boundary.
+/// @details Version 2: SimulatorCore_::takeChanges(...) was added,
+///        Report_::setData(...) was removed, ReportData grew to 64 bytes,
+///        SimulatorCore_::isQuiescent(...) takes a TimeType.
+///        Version 3: SimulatorCore_::setSimulator(...) was added.
+///
+#define PAPILIO_CORE_INTERFACE_VERSION 3
+
+/// @brief Exports the factory functions of a core shared library.
+/// @details Use this macro once in a translation unit of the shared library.
+///
+/// @param CORE_TYPE The type of the core, a class derived from  
+///        papilio::SimulatorCore_ that is default constructible.
+///
+#define PAPILIO_EXPORT_CORE(CORE_TYPE)                                         \
+   extern "C" int papilio_coreInterfaceVersion() {                             \
+      return PAPILIO_CORE_INTERFACE_VERSION;                                   \
+   }                                                                           \
+   extern "C" papilio::SimulatorCore_ *papilio_createCore() {                  \
+      return new CORE_TYPE;                                                    \
+   }                                                                           \
+   extern "C" void papilio_destroyCore(papilio::SimulatorCore_ *core) {        \
+      delete static_cast<CORE_TYPE*>(core);                                    \
+   }
+
+namespace papilio {
+   
+class Simulator;
+
+/// @brief Loads simulator cores from a shared library.
+/// @details The library must export its core via PAPILIO_EXPORT_CORE(...).
+///        This enables rebuilding the firmware without relinking the 
+///        test executable and swapping cores of a running simulator
+///        (see Simulator::replaceCore(...)).
+///
+///        The simulator passes itself to its core via 
+///        SimulatorCore_::setSimulator(...). Cores report to it through
+///        template code of Simulator that the library instantiates, e.g. 
+///        processReport(...). That code calls into the test executable,
+///        e.g. to processReportProfiled(...) and to DeferredReports.
+///        The test executable must therefore export its symbols, i.e. it 
+///        must be linked with -rdynamic. Otherwise, loading the library
+///        fails with undefined symbols.
+///
+///        Every load operates on a private copy of the library file.
+///        Thus, the library can be rebuilt while loaded and every reload
+///        picks up the new code. Libraries are never unloaded, as
+///        objects that were created by an old core, e.g. copies of 
+///        reports, may still refer to its code.
+///
+class CoreLibrary
+{
+   public:
+      
+      /// @brief Loads a core library.
+      ///
+      /// @param filename The name of the shared object file.
+      ///
+      /// @returns False if the library could not be loaded or does not
+      ///        export a compatible core (see getError()).
+      ///
+      bool load(const std::string &filename);
+      
+      /// @brief Loads the library again from the file that was
+      ///        passed to the last call to load(...).
+      ///
+      /// @returns False if loading failed. The library that was loaded 
+      ///        before remains in use.
+      ///
+      bool reload();
+      
+      bool isLoaded() const { return create_core_ != nullptr; }
+      
+      /// @brief Retreives the description of the last error.
+      ///
+      const std::string &getError() const { return error_; }
+      
+      /// @brief Retreives the number of successful loads.
+      ///
+      int getNumLoads() const { return n_loads_; }
+      
+      /// @brief Creates a core.
+      ///
+      /// @returns The core or nullptr if no library is loaded.
+      ///
+      std::shared_ptr<SimulatorCore_> createCore() const;
+      
+      /// @brief Checks if the library file was modified since it was loaded.
+      /// @details A modification is reported only if the file did not 
+      ///        change any further since the previous call. This avoids
+      ///        loading files that are still being written.
+      ///
+      bool hasChanged();
+      
+      /// @brief Reloads the library if its file was modified and replaces
+      ///        the simulator's core by a new one.
+      /// @details Intended to be called after every cycle, e.g. by the cycle callback
+      ///        of Simulator::runRemoteControlled(...). The file is checked at most
+      ///        every 200 ms.
+      ///
+      /// @param simulator The simulator whose core is replaced.
+      ///
+      /// @returns True if the core was replaced.
+      ///
+      bool reloadIfChanged(Simulator &simulator);
+      
+   private:
+      
+      typedef SimulatorCore_ *(*CreateFunction)();
+      typedef void (*DestroyFunction)(SimulatorCore_ *);
+      
+      bool getModificationTime(int64_t &mtime) const;
+      
+   private:
+      
+      std::string filename_;
+      std::string error_;
+      
+      CreateFunction create_core_ = nullptr;
+      DestroyFunction destroy_core_ = nullptr;
+      
+      int n_loads_ = 0;
+      
+      int64_t loaded_mtime_ = 0;
+      int64_t seen_mtime_ = 0;
+      uint64_t last_check_ = 0;
+};
+
+} // namespace papilio
@@ -0,0 +1,33 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/DeferredReports.h"
+#include "papilio/reports/Report_.h"
+
+namespace papilio {
+   
+thread_local DeferredReports *DeferredReports::current_ = nullptr;
+
+void DeferredReports::processAll()
+{
+   for(auto &entry: entries_) {
+      entry.process_(*entry.simulator_, *entry.report_);
+   }
+   entries_.clear();
+}
+
+} // namespace papilio
@@ -0,0 +1,114 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace papilio {
+   
+class Simulator;
+class Report_;
+
+/// @brief A queue of reports whose processing is postponed.
+/// @details While a queue is installed for the current thread 
+///        by means of a Scope object, reports that are passed to
+///        the simulator's report processing are copied to the queue 
+///        instead of being processed immediately. This enables 
+///        cores to run in worker threads, while all reports 
+///        are processed on the simulator's thread in a deterministic 
+///        order.
+///
+class DeferredReports
+{
+   public:
+      
+      typedef void (*ProcessFunction)(Simulator &simulator, const Report_ &report);
+      
+      /// @brief Installs a queue for the current thread during its lifetime.
+      ///
+      class Scope
+      {
+         public:
+            
+            explicit Scope(DeferredReports &reports) 
+               :  previous_(current_)
+            {
+               current_ = &reports;
+            }
+            
+            ~Scope() { current_ = previous_; }
+            
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+            
+         private:
+            
+            DeferredReports *previous_;
+      };
+      
+      /// @brief Retreives the queue that is installed for the current thread.
+      /// @returns The queue or nullptr if reports are to be 
+      ///        processed immediately.
+      ///
+      static DeferredReports *getCurrent() { return current_; }
+      
+      /// @brief Adds a report.
+      ///
+      /// @param simulator The simulator that processes the report.
+      /// @param report A copy of the report.
+      /// @param process The function that processes the report.
+      ///
+      void add(Simulator &simulator, std::shared_ptr<Report_> report, 
+               ProcessFunction process) {
+         entries_.push_back(Entry{&simulator, std::move(report), process});
+      }
+      
+      bool empty() const { return entries_.empty(); }
+      
+      /// @brief Retreives the number of reports.
+      ///
+      std::size_t size() const { return entries_.size(); }
+      
+      /// @brief Retreives a report.
+      /// @param pos The position of the report in the order reports were added.
+      ///
+      const Report_ &getReport(std::size_t pos) const { return *entries_[pos].report_; }
+      
+      /// @brief Removes all reports without processing them.
+      ///
+      void clear() { entries_.clear(); }
+      
+      /// @brief Processes and removes all reports in the order they were added.
+      ///
+      void processAll();
+      
+   private:
+      
+      struct Entry {
+         Simulator *simulator_;
+         std::shared_ptr<Report_> report_;
+         ProcessFunction process_;
+      };
+      
+      static thread_local DeferredReports *current_;
+      
+      std::vector<Entry> entries_;
+};
+
+} // namespace papilio
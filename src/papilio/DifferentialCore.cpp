@@ -0,0 +1,457 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/DifferentialCore.h"
+#include "papilio/Simulator.h"
+#include "papilio/reports/Report_.h"
+#include "papilio/reports/ReportTypes.h"
+#include "papilio/aux/state_image.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace papilio {
+   
+DifferentialCore::DifferentialCore(const std::shared_ptr<SimulatorCore_> &reference,
+                                   const std::shared_ptr<SimulatorCore_> &candidate)
+   :  reference_(reference),
+      candidate_(candidate),
+      parallel_(std::thread::hardware_concurrency() > 1)
+{
+   assert(reference_);
+   assert(candidate_);
+}
+
+DifferentialCore::~DifferentialCore()
+{
+   this->stopWorker();
+}
+
+void DifferentialCore::setParallel(bool state)
+{
+   parallel_ = state;
+   if(!parallel_) {
+      this->stopWorker();
+   }
+}
+
+void DifferentialCore::setContextSize(std::size_t n_reports)
+{
+   context_size_ = n_reports;
+   while(context_.size() > context_size_) {
+      context_.pop_front();
+   }
+}
+
+void DifferentialCore::init()
+{
+   reference_->init();
+   candidate_->init();
+}
+
+void DifferentialCore::pressKey(uint8_t row, uint8_t col)
+{
+   reference_->pressKey(row, col);
+   candidate_->pressKey(row, col);
+}
+
+void DifferentialCore::releaseKey(uint8_t row, uint8_t col)
+{
+   reference_->releaseKey(row, col);
+   candidate_->releaseKey(row, col);
+}
+
+void DifferentialCore::tapKey(uint8_t row, uint8_t col)
+{
+   reference_->tapKey(row, col);
+   candidate_->tapKey(row, col);
+}
+
+void DifferentialCore::pressKeys(const KeyMatrixState &mask)
+{
+   reference_->pressKeys(mask);
+   candidate_->pressKeys(mask);
+}
+
+void DifferentialCore::releaseKeys(const KeyMatrixState &mask)
+{
+   reference_->releaseKeys(mask);
+   candidate_->releaseKeys(mask);
+}
+
+void DifferentialCore::setTime(uint32_t time)
+{
+   time_ = time;
+   reference_->setTime(time);
+   candidate_->setTime(time);
+}
+
+void DifferentialCore::stepReference()
+{
+   DeferredReports::Scope scope(reference_reports_);
+   MemoryTracker::HeapScope heap_scope(track_heap_);
+   reference_->loop();
+}
+
+void DifferentialCore::stepCandidate()
+{
+   DeferredReports::Scope scope(candidate_reports_);
+   MemoryTracker::HeapScope heap_scope(track_heap_);
+   candidate_->loop();
+}
+
+void DifferentialCore::loop()
+{
+   // Both cores stop at the first mismatch.
+   //
+   if(has_mismatch_) { return; }
+   
+   // The worker thread inherits heap tracking from the simulator's thread.
+   //
+   track_heap_ = MemoryTracker::isHeapTrackingActive();
+   
+   if(parallel_) {
+      
+      if(!worker_.joinable()) {
+         this->startWorker();
+      }
+      
+      start_barrier_->wait();
+      this->stepReference();
+      end_barrier_->wait();
+   }
+   else {
+      this->stepReference();
+      this->stepCandidate();
+   }
+   
+   this->compareReports();
+   
+   if(compare_leds_ && !has_mismatch_) {
+      this->compareLEDs();
+   }
+   
+   ++n_cycles_;
+   
+   candidate_reports_.clear();
+   reference_reports_.processAll();
+}
+
+void DifferentialCore::compareReports()
+{
+   const std::size_t n_reference = reference_reports_.size();
+   const std::size_t n_candidate = candidate_reports_.size();
+   const std::size_t n_reports = std::max(n_reference, n_candidate);
+   
+   ReportData reference_data, candidate_data;
+   
+   for(std::size_t pos = 0; pos < n_reports; ++pos) {
+      
+      const bool has_reference = pos < n_reference;
+      const bool has_candidate = pos < n_candidate;
+      
+      reference_data.reset(0, 0);
+      candidate_data.reset(0, 0);
+      
+      if(has_reference) { reference_reports_.getReport(pos).getData(reference_data); }
+      if(has_candidate) { candidate_reports_.getReport(pos).getData(candidate_data); }
+      
+      if(has_reference && has_candidate && (reference_data == candidate_data)) {
+         
+         ++n_reports_;
+         
+         if(context_size_ > 0) {
+            if(context_.size() == context_size_) {
+               context_.pop_front();
+            }
+            context_.push_back(ContextEntry{n_cycles_, time_, reference_data});
+         }
+         continue;
+      }
+      
+      mismatch_.type_ = (has_reference && has_candidate) 
+                              ? Mismatch::ReportMismatch : Mismatch::ReportMissing;
+      mismatch_.n_cycles_before_ = n_cycles_;
+      mismatch_.time_ = time_;
+      mismatch_.report_pos_ = pos;
+      mismatch_.has_reference_report_ = has_reference;
+      mismatch_.has_candidate_report_ = has_candidate;
+      mismatch_.reference_report_ = reference_data;
+      mismatch_.candidate_report_ = candidate_data;
+      
+      has_mismatch_ = true;
+      return;
+   }
+}
+
+void DifferentialCore::compareLEDs()
+{
+   const KeyOffset n_keys = reference_->getNumLEDs();
+   
+   if(n_keys != candidate_->getNumLEDs()) {
+      mismatch_.type_ = Mismatch::LEDMismatch;
+      mismatch_.key_offset_ = std::min(n_keys, candidate_->getNumLEDs());
+   }
+   else {
+      
+      if(n_keys == 0) { return; }
+      
+      reference_colors_.resize(3*std::size_t(n_keys));
+      candidate_colors_.resize(3*std::size_t(n_keys));
+      
+      reference_->getCurrentKeyLEDColors(&reference_colors_[0], n_keys);
+      candidate_->getCurrentKeyLEDColors(&candidate_colors_[0], n_keys);
+      
+      if(reference_colors_ == candidate_colors_) { return; }
+      
+      auto mismatch = std::mismatch(reference_colors_.begin(), reference_colors_.end(),
+                                    candidate_colors_.begin());
+      
+      mismatch_.type_ = Mismatch::LEDMismatch;
+      mismatch_.key_offset_ = KeyOffset((mismatch.first - reference_colors_.begin())/3);
+                                         
+      std::copy_n(&reference_colors_[3*std::size_t(mismatch_.key_offset_)], 3, 
+                  mismatch_.reference_color_);
+      std::copy_n(&candidate_colors_[3*std::size_t(mismatch_.key_offset_)], 3, 
+                  mismatch_.candidate_color_);
+   }
+   
+   mismatch_.n_cycles_before_ = n_cycles_;
+   mismatch_.time_ = time_;
+   mismatch_.report_pos_ = reference_reports_.size();
+   mismatch_.has_reference_report_ = false;
+   mismatch_.has_candidate_report_ = false;
+   
+   has_mismatch_ = true;
+}
+
+namespace {
+   
+void describeReport(const Simulator &simulator, const char *add_indent, 
+                    const char *label, const ReportData &data)
+{
+   simulator.log() << add_indent << "   " << label << ": " 
+      << getReportTypeString(data.type_id_) << " report [" 
+      << data.toHexString() << "]";
+}
+
+void describeColor(const Simulator &simulator, const char *add_indent, 
+                   const char *label, const uint8_t *color)
+{
+   simulator.log() << add_indent << "   " << label << ": (" 
+      << (int)color[0] << ", " << (int)color[1] << ", " << (int)color[2] << ")";
+}
+
+} // namespace
+
+void DifferentialCore::describeMismatch(const Simulator &simulator, 
+                                        const char *add_indent) const
+{
+   if(!has_mismatch_) {
+      simulator.log() << add_indent << "Cores agree on " << n_reports_ 
+         << " reports in " << n_cycles_ << " cycles";
+      return;
+   }
+   
+   simulator.log() << add_indent << "Cores disagree in loop cycle " 
+      << mismatch_.n_cycles_before_ + 1 << " (t = " << mismatch_.time_ << " ms)"
+      << " after agreeing on " << n_reports_ << " reports";
+   
+   switch(mismatch_.type_) {
+      
+      case Mismatch::ReportMismatch:
+      case Mismatch::ReportMissing:
+         simulator.log() << add_indent << "Report " << mismatch_.report_pos_ + 1 
+            << " of the cycle differs";
+         if(mismatch_.has_reference_report_) {
+            describeReport(simulator, add_indent, "reference", mismatch_.reference_report_);
+         }
+         else {
+            simulator.log() << add_indent << "   reference: no report";
+         }
+         if(mismatch_.has_candidate_report_) {
+            describeReport(simulator, add_indent, "candidate", mismatch_.candidate_report_);
+         }
+         else {
+            simulator.log() << add_indent << "   candidate: no report";
+         }
+         break;
+         
+      case Mismatch::LEDMismatch:
+         if(reference_->getNumLEDs() != candidate_->getNumLEDs()) {
+            simulator.log() << add_indent << "Number of key LEDs differs (" 
+               << (int)reference_->getNumLEDs() << " vs. " 
+               << (int)candidate_->getNumLEDs() << ")";
+            break;
+         }
+         simulator.log() << add_indent << "Color of key LED " 
+            << (int)mismatch_.key_offset_ << " differs";
+         describeColor(simulator, add_indent, "reference", mismatch_.reference_color_);
+         describeColor(simulator, add_indent, "candidate", mismatch_.candidate_color_);
+         break;
+   }
+   
+   if(context_.empty()) { return; }
+   
+   simulator.log() << add_indent << "Last " << context_.size() << " agreed reports:";
+   for(const auto &entry: context_) {
+      simulator.log() << add_indent << "   loop cycle " << entry.n_cycles_before_ + 1 
+         << " (t = " << entry.time_ << " ms): " 
+         << getReportTypeString(entry.report_.type_id_) << " report [" 
+         << entry.report_.toHexString() << "]";
+   }
+}
+
+void DifferentialCore::startWorker()
+{
+   start_barrier_.reset(new SpinBarrier{2});
+   end_barrier_.reset(new SpinBarrier{2});
+   stopping_ = false;
+   
+   worker_ = std::thread([this]() {
+      while(1) {
+         start_barrier_->wait();
+         if(stopping_.load(std::memory_order_relaxed)) { break; }
+         this->stepCandidate();
+         end_barrier_->wait();
+      }
+   });
+}
+
+void DifferentialCore::stopWorker()
+{
+   if(!worker_.joinable()) { return; }
+   
+   stopping_ = true;
+   start_barrier_->wait();
+   worker_.join();
+}
+
+bool DifferentialCore::isQuiescent(TimeType &next_wakeup_time) const
+{
+   // Stopped cores never wake up.
+   //
+   if(has_mismatch_) {
+      next_wakeup_time = std::numeric_limits<TimeType>::max();
+      return true;
+   }
+   
+   TimeType reference_wakeup_time = 0, candidate_wakeup_time = 0;
+   
+   if(   !reference_->isQuiescent(reference_wakeup_time)
+      || !candidate_->isQuiescent(candidate_wakeup_time)) {
+      return false;
+   }
+   
+   next_wakeup_time = std::min(reference_wakeup_time, candidate_wakeup_time);
+   return true;
+}
+
+// Comparison state and context are stored as raw bytes.
+//
+static_assert(std::is_trivially_copyable<DifferentialCore::Mismatch>::value,
+              "Mismatch must be trivially copyable");
+static_assert(std::is_trivially_copyable<DifferentialCore::ContextEntry>::value,
+              "ContextEntry must be trivially copyable");
+
+bool DifferentialCore::saveState(std::vector<uint8_t> &image) const
+{
+   // The images of both cores, followed by the comparison state:
+   // counters, mismatch record and context.
+   //
+   image.clear();
+   
+   std::vector<uint8_t> core_image;
+   for(const SimulatorCore_ *core: { reference_.get(), candidate_.get() }) {
+      if(!core->saveState(core_image)) {
+         return false;
+      }
+      appendImagePart(image, core_image);
+   }
+   
+   ComparisonState state;
+   state.n_cycles_ = n_cycles_;
+   state.n_reports_ = n_reports_;
+   state.time_ = time_;
+   state.has_mismatch_ = has_mismatch_;
+   state.mismatch_ = mismatch_;
+   appendImagePart(image, &state, sizeof(state));
+   
+   std::vector<ContextEntry> context;
+   context.reserve(context_.size());
+   for(const auto &entry: context_) {
+      context.push_back(entry);
+   }
+   appendImagePart(image, context.data(), context.size()*sizeof(ContextEntry));
+   
+   return true;
+}
+
+bool DifferentialCore::restoreState(const std::vector<uint8_t> &image)
+{
+   std::vector<uint8_t> part;
+   size_t pos = 0;
+   
+   for(SimulatorCore_ *core: { reference_.get(), candidate_.get() }) {
+      if(   !readImagePart(image, pos, part)
+         || !core->restoreState(part)) {
+         return false;
+      }
+   }
+   
+   if(!readImagePart(image, pos, part) || (part.size() != sizeof(ComparisonState))) {
+      return false;
+   }
+   
+   ComparisonState state;
+   memcpy(&state, part.data(), sizeof(state));
+   n_cycles_ = state.n_cycles_;
+   n_reports_ = state.n_reports_;
+   time_ = state.time_;
+   has_mismatch_ = state.has_mismatch_;
+   mismatch_ = state.mismatch_;
+   
+   if(!readImagePart(image, pos, part) || (part.size() % sizeof(ContextEntry) != 0)) {
+      return false;
+   }
+   
+   context_.clear();
+   for(size_t offset = 0; offset < part.size(); offset += sizeof(ContextEntry)) {
+      ContextEntry entry;
+      memcpy(&entry, &part[offset], sizeof(entry));
+      context_.push_back(entry);
+   }
+   
+   reference_reports_.clear();
+   candidate_reports_.clear();
+   
+   return pos == image.size();
+}
+
+void DifferentialCore::setSimulator(Simulator *simulator)
+{
+   // The reports of the candidate are intercepted before they 
+   // reach the simulator.
+   //
+   reference_->setSimulator(simulator);
+   candidate_->setSimulator(simulator);
+}
+
+} // namespace papilio
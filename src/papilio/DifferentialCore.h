@@ -0,0 +1,304 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/SimulatorCore_.h"
+#include "papilio/DeferredReports.h"
+#include "papilio/MemoryTracker.h"
+#include "papilio/reports/ReportData.h"
+#include "papilio/aux/RingBuffer.h"
+#include "papilio/aux/SpinBarrier.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace papilio {
+   
+class Simulator;
+
+/// @brief A core that runs two builds of a firmware side by side and 
+///        compares their output, e.g. the build before and after an 
+///        optimization.
+/// @details Both cores, the reference and the candidate, receive the same 
+///        key events and time. Every call to loop() runs one loop cycle 
+///        of each core. If running in parallel, the candidate is
+///        stepped by a worker thread while the reference runs on the
+///        simulator's thread. Both are synchronized by a barrier at
+///        the beginning and the end of each cycle.
+///
+///        After every cycle the reports of both cores are compared as
+///        ReportData, optionally followed by the key LED colors. 
+///        The reports of the reference are then processed
+///        by the simulator, the reports of the candidate are discarded.
+///        Key states, LEDs and labels are those of the reference.
+///
+///        At the first mismatch both cores stop. Further cycles do not 
+///        run their loops. Register an actions::AssertCoresAgree cycle 
+///        action to report the mismatch as a test failure.
+///
+///        Both cores must have identical key matrix dimensions.
+///
+class DifferentialCore : public SimulatorCore_
+{
+   public:
+      
+      /// @brief Information about the first mismatch.
+      ///
+      struct Mismatch {
+         
+         enum Type { 
+            
+            /// @brief The reports at the same position of the
+            ///        cycle's report streams differ.
+            ///
+            ReportMismatch, 
+            
+            /// @brief Only one of the cores generated a report at the 
+            ///        given position of the cycle's report streams.
+            ///
+            ReportMissing, 
+            
+            /// @brief A key LED color differs.
+            ///
+            LEDMismatch 
+         };
+         
+         Type type_;
+         
+         /// @brief The number of loop cycles that ran before the 
+         ///        mismatching one.
+         ///
+         uint64_t n_cycles_before_;
+         
+         /// @brief The time of the mismatching cycle.
+         ///
+         uint32_t time_;
+         
+         /// @brief The position of the report in the cycle.
+         ///
+         std::size_t report_pos_;
+         
+         bool has_reference_report_;
+         bool has_candidate_report_;
+         
+         ReportData reference_report_;
+         ReportData candidate_report_;
+         
+         /// @brief The first LED that differs (LED mismatches only).
+         ///
+         KeyOffset key_offset_;
+         
+         uint8_t reference_color_[3];
+         uint8_t candidate_color_[3];
+      };
+      
+      /// @brief A report that both cores agreed upon.
+      ///
+      struct ContextEntry {
+         uint64_t n_cycles_before_;
+         uint32_t time_;
+         ReportData report_;
+      };
+      
+      /// @brief Constructor.
+      /// @details Parallel execution is enabled if the hardware
+      ///        supports more than one concurrent thread.
+      ///
+      /// @param reference The core whose reports are processed by the simulator.
+      /// @param candidate The core that is compared with the reference.
+      ///
+      DifferentialCore(const std::shared_ptr<SimulatorCore_> &reference,
+                       const std::shared_ptr<SimulatorCore_> &candidate);
+      
+      DifferentialCore(const DifferentialCore &) = delete;
+      DifferentialCore &operator=(const DifferentialCore &) = delete;
+      
+      virtual ~DifferentialCore();
+      
+      const std::shared_ptr<SimulatorCore_> &getReference() const { return reference_; }
+      const std::shared_ptr<SimulatorCore_> &getCandidate() const { return candidate_; }
+      
+      /// @brief Enables or disables running the candidate in a worker thread.
+      ///
+      void setParallel(bool state);
+      
+      bool getParallel() const { return parallel_; }
+      
+      /// @brief Enables or disables comparing key LED colors after every cycle.
+      /// @details Disabled by default.
+      ///
+      void setCompareLEDs(bool state) { compare_leds_ = state; }
+      
+      bool getCompareLEDs() const { return compare_leds_; }
+      
+      /// @brief Sets the number of agreed reports that are kept 
+      ///        as context of a mismatch.
+      /// @details Default: 8
+      ///
+      void setContextSize(std::size_t n_reports);
+      
+      /// @brief Checks if the cores disagreed.
+      ///
+      bool hasMismatch() const { return has_mismatch_; }
+      
+      /// @brief Retreives the first mismatch.
+      /// @details Only valid if hasMismatch() returns true.
+      ///
+      const Mismatch &getMismatch() const { return mismatch_; }
+      
+      /// @brief Retreives the last reports that both cores agreed upon,
+      ///        oldest first.
+      ///
+      const RingBuffer<ContextEntry> &getContext() const { return context_; }
+      
+      /// @brief Retreives the number of cycles that were compared.
+      ///
+      uint64_t getNumCyclesCompared() const { return n_cycles_; }
+      
+      /// @brief Retreives the number of reports that both cores agreed upon.
+      ///
+      uint64_t getNumReportsCompared() const { return n_reports_; }
+      
+      /// @brief Writes the mismatch and its context to the simulator's log.
+      ///
+      /// @param simulator The simulator to log with.
+      /// @param add_indent An indentation string.
+      ///
+      void describeMismatch(const Simulator &simulator, const char *add_indent = "") const;
+      
+      virtual void init() override;
+      
+      virtual void getKeyMatrixDimensions(uint8_t &rows, uint8_t &cols) const override {
+         reference_->getKeyMatrixDimensions(rows, cols);
+      }
+      
+      virtual void pressKey(uint8_t row, uint8_t col) override;
+      virtual void releaseKey(uint8_t row, uint8_t col) override;
+      virtual void tapKey(uint8_t row, uint8_t col) override;
+      
+      virtual bool isKeyPressed(uint8_t row, uint8_t col) const override {
+         return reference_->isKeyPressed(row, col);
+      }
+      
+      virtual void pressKeys(const KeyMatrixState &mask) override;
+      virtual void releaseKeys(const KeyMatrixState &mask) override;
+      
+      virtual void getKeyMatrixState(KeyMatrixState &state) const override {
+         reference_->getKeyMatrixState(state);
+      }
+      
+      virtual KeyOffset getNumLEDs() const override {
+         return reference_->getNumLEDs();
+      }
+      
+      virtual void getCurrentKeyLEDColor(KeyOffset key_offset, 
+                                      uint8_t &red, uint8_t &green, uint8_t &blue) const override {
+         reference_->getCurrentKeyLEDColor(key_offset, red, green, blue);
+      }
+      
+      virtual void getCurrentKeyLEDColors(uint8_t *rgb, KeyOffset n_keys) const override {
+         reference_->getCurrentKeyLEDColors(rgb, n_keys);
+      }
+      
+      virtual void getCurrentKeyLabel(uint8_t row, uint8_t col,
+                                   std::string &label_string) const override {
+         reference_->getCurrentKeyLabel(row, col, label_string);
+      }
+      
+      virtual int getKeycode(uint8_t row, uint8_t col) const override {
+         return reference_->getKeycode(row, col);
+      }
+      
+      virtual bool takeChanges(CoreChanges &changes) override {
+         return reference_->takeChanges(changes);
+      }
+      
+      virtual void setTime(uint32_t time) override;
+   
+      virtual const char *keycodeToName(uint8_t keycode) const override {
+         return reference_->keycodeToName(keycode);
+      }
+      
+      virtual void loop() override;
+      
+      virtual bool isQuiescent(TimeType &next_wakeup_time) const override;
+      
+      virtual bool saveState(std::vector<uint8_t> &image) const override;
+      
+      virtual bool restoreState(const std::vector<uint8_t> &image) override;
+      
+      virtual void setSimulator(Simulator *simulator) override;
+      
+   private:
+      
+      void stepReference();
+      void stepCandidate();
+      
+      void compareReports();
+      void compareLEDs();
+      
+      void startWorker();
+      void stopWorker();
+      
+      // The comparison state that is part of state images.
+      //
+      struct ComparisonState {
+         uint64_t n_cycles_;
+         uint64_t n_reports_;
+         uint32_t time_;
+         bool has_mismatch_;
+         Mismatch mismatch_;
+      };
+      
+   private:
+      
+      std::shared_ptr<SimulatorCore_> reference_;
+      std::shared_ptr<SimulatorCore_> candidate_;
+      
+      DeferredReports reference_reports_;
+      DeferredReports candidate_reports_;
+      
+      bool parallel_;
+      bool compare_leds_ = false;
+      
+      bool has_mismatch_ = false;
+      Mismatch mismatch_;
+      
+      std::size_t context_size_ = 8;
+      RingBuffer<ContextEntry> context_;
+      
+      uint64_t n_cycles_ = 0;
+      uint64_t n_reports_ = 0;
+      uint32_t time_ = 0;
+      
+      std::vector<uint8_t> reference_colors_;
+      std::vector<uint8_t> candidate_colors_;
+      
+      std::unique_ptr<SpinBarrier> start_barrier_;
+      std::unique_ptr<SpinBarrier> end_barrier_;
+      std::thread worker_;
+      std::atomic<bool> stopping_{false};
+      
+      // Written before the start barrier, read by the worker.
+      //
+      bool track_heap_ = false;
+};
+
+} // namespace papilio
@@ -0,0 +1,193 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/FailureBisector.h"
+
+#include <algorithm>
+
+namespace papilio {
+
+FailureBisector &FailureBisector::addProbe(const std::string &name, const Probe &probe)
+{
+   probes_.push_back(NamedProbe{name, probe});
+   return *this;
+}
+
+const FailureBisector::NamedProbe *FailureBisector::findFailingProbe(Simulator &simulator) const
+{
+   for(const auto &probe: probes_) {
+      if(!probe.probe_(simulator)) {
+         return &probe;
+      }
+   }
+   return nullptr;
+}
+
+void FailureBisector::takeCheckpoint(Simulator &simulator)
+{
+   checkpoints_.push_back(simulator.snapshot());
+   
+   if((max_checkpoints_ < 2) || (checkpoints_.size() <= max_checkpoints_)) {
+      return;
+   }
+   
+   // Keep every other checkpoint, including the first one.
+   //
+   std::size_t n_kept = 0;
+   for(std::size_t i = 0; i < checkpoints_.size(); i += 2) {
+      checkpoints_[n_kept++] = checkpoints_[i];
+   }
+   checkpoints_.resize(n_kept);
+   
+   interval_ *= 2;
+}
+
+bool FailureBisector::run(Simulator &simulator, int n_cycles)
+{
+   checkpoints_.clear();
+   interval_ = std::max(checkpoint_interval_, 1);
+   first_failing_cycle_ = -1;
+   detection_cycle_ = -1;
+   failed_probe_.clear();
+   n_replayed_cycles_ = 0;
+   
+   const int log_level = simulator.getLogLevel();
+   simulator.setLogLevel(run_log_level_);
+   
+   const int error_count = simulator.getErrorCount();
+   const int end_cycle_id = simulator.getCycleId() + n_cycles;
+   
+   this->takeCheckpoint(simulator);
+   
+   if(!checkpoints_.back().hasCoreState()) {
+      simulator.setLogLevel(log_level);
+      simulator.error() << "Bisecting failures requires a core that supports saving its state";
+      return false;
+   }
+   
+   while(simulator.getCycleId() < end_cycle_id) {
+      
+      simulator.cycles(std::min(interval_, end_cycle_id - simulator.getCycleId()));
+      
+      if(simulator.getErrorCount() != error_count) {
+         detection_cycle_ = simulator.getCycleId();
+         break;
+      }
+      
+      if(simulator.getCycleId() < end_cycle_id) {
+         this->takeCheckpoint(simulator);
+      }
+   }
+   
+   if(detection_cycle_ >= 0) {
+      this->bisect(simulator);
+   }
+   
+   checkpoints_.clear();
+   simulator.setLogLevel(log_level);
+   
+   if(detection_cycle_ < 0) {
+      return true;
+   }
+   
+   if(first_failing_cycle_ < 0) {
+      simulator.error() << "Failure detected at cycle " << detection_cycle_
+         << " could not be reproduced. Is the simulation deterministic?";
+   }
+   else {
+      simulator.log() << "First failing cycle: " << first_failing_cycle_
+         << " (detected at cycle " << detection_cycle_ << ", "
+         << (failed_probe_.empty() ? std::string("error reported")
+                                   : "probe \"" + failed_probe_ + "\" failed")
+         << ", " << n_replayed_cycles_ << " cycles replayed)";
+   }
+   
+   return false;
+}
+
+void FailureBisector::bisect(Simulator &simulator)
+{
+   // The index of the first checkpoint that fails a probe.
+   // The state at detection counts as the checkpoint after the last one.
+   //
+   std::size_t first_bad = checkpoints_.size();
+   
+   // If the probes do not cover the failure, the cycles since the last
+   // checkpoint are replayed until the error is reported again.
+   //
+   if(const NamedProbe *probe = this->findFailingProbe(simulator)) {
+      
+      // Probes are assumed to fail for all states that follow
+      // a bad transition.
+      //
+      std::size_t begin = 0;
+      while(begin < first_bad) {
+         std::size_t mid = begin + (first_bad - begin)/2;
+         simulator.restore(checkpoints_[mid]);
+         if(const NamedProbe *mid_probe = this->findFailingProbe(simulator)) {
+            first_bad = mid;
+            probe = mid_probe;
+         }
+         else {
+            begin = mid + 1;
+         }
+      }
+      
+      if(first_bad == 0) {
+         simulator.restore(checkpoints_[0]);
+         first_failing_cycle_ = checkpoints_[0].getCycleId();
+         failed_probe_ = probe->name_;
+         return;
+      }
+   }
+   
+   const Simulator::Snapshot &window_begin = checkpoints_[first_bad - 1];
+   const int window_end = (first_bad < checkpoints_.size())
+                        ? checkpoints_[first_bad].getCycleId() : detection_cycle_;
+   
+   simulator.restore(window_begin);
+   
+   const bool debug = simulator.getDebug();
+   simulator.setDebug(true);
+   simulator.setLogLevel(TraceLogLevel);
+   
+   simulator.header() << "Replaying cycles " << (window_begin.getCycleId() + 1)
+      << " to " << window_end;
+   
+   const int error_count = simulator.getErrorCount();
+   
+   while(simulator.getCycleId() < window_end) {
+      
+      simulator.cycles(1);
+      ++n_replayed_cycles_;
+      
+      if(simulator.getErrorCount() != error_count) {
+         first_failing_cycle_ = simulator.getCycleId();
+         break;
+      }
+      
+      if(const NamedProbe *failed_probe = this->findFailingProbe(simulator)) {
+         first_failing_cycle_ = simulator.getCycleId();
+         failed_probe_ = failed_probe->name_;
+         break;
+      }
+   }
+   
+   simulator.setDebug(debug);
+}
+
+} // namespace papilio
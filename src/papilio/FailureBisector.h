@@ -0,0 +1,148 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/Simulator.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace papilio {
+
+/// @brief Runs a long simulation and locates the first cycle in which
+///        the state of the simulation went wrong.
+/// @details While running, a snapshot (see Simulator::snapshot()) is
+///        taken at regular cycle intervals. Log output is restricted
+///        to a log level that is ErrorLogLevel by default.
+///        The run stops as soon as an error is reported, e.g. by a
+///        permanent invariant action.
+///
+///        On failure, the checkpoints are binary searched for the
+///        last one whose state passes all probes. Probes are user
+///        supplied functions that examine the state of simulator and
+///        core without changing it. Probes are assumed to fail for
+///        all states after the first bad transition.
+///        Finally, the window between the last passing and the first
+///        failing checkpoint is replayed cycle by cycle with
+///        debug output and TraceLogLevel, until a probe fails or
+///        the error is reported again. The simulator is left in the
+///        state of the first failing cycle.
+///
+///        If no probes are registered or all probes pass at the
+///        time of the failure, the cycles since the last checkpoint
+///        are replayed.
+///
+///        Bisecting requires a core that supports saving its
+///        state (see SimulatorCore_::saveState(...)). Action objects are
+///        not duplicated by snapshots. Permanent actions that keep
+///        state of their own are not reset when checkpoints are restored.
+///
+class FailureBisector
+{
+   public:
+      
+      typedef std::function<bool(Simulator &)> Probe;
+      
+      /// @brief Registers a probe.
+      ///
+      /// @param name The name that is used to report failures of the probe.
+      /// @param probe A function that returns false if the state of the
+      ///        simulation is bad.
+      ///
+      FailureBisector &addProbe(const std::string &name, const Probe &probe);
+      
+      /// @brief Sets the number of cycles between checkpoints.
+      /// @details Default: 1000
+      ///
+      void setCheckpointInterval(int n_cycles) { checkpoint_interval_ = n_cycles; }
+      
+      /// @brief Sets the maximum number of checkpoints that are kept.
+      /// @details If exceeded, every other checkpoint is discarded
+      ///        and the checkpoint interval is doubled. Default: 1024
+      ///
+      void setMaxCheckpoints(std::size_t n_checkpoints) { max_checkpoints_ = n_checkpoints; }
+      
+      /// @brief Sets the log level of the checkpointed run.
+      /// @details Default: ErrorLogLevel
+      ///
+      void setRunLogLevel(int log_level) { run_log_level_ = log_level; }
+      
+      /// @brief Runs a number of cycles and bisects a failure.
+      ///
+      /// @param simulator The simulator to run.
+      /// @param n_cycles The number of cycles to run.
+      ///
+      /// @returns True if no error was reported.
+      ///
+      bool run(Simulator &simulator, int n_cycles);
+      
+      /// @brief Retreives the id of the first failing cycle of the
+      ///        most recent run, or -1 if the run passed or the failure
+      ///        could not be reproduced.
+      ///
+      int getFirstFailingCycle() const { return first_failing_cycle_; }
+      
+      /// @brief Retreives the id of the cycle at which the failure
+      ///        was detected by the most recent run, or -1 if it passed.
+      ///
+      int getDetectionCycle() const { return detection_cycle_; }
+      
+      /// @brief Retreives the name of the probe that failed first
+      ///        during the replay, or an empty string if the failure was
+      ///        an error.
+      ///
+      const std::string &getFailedProbe() const { return failed_probe_; }
+      
+      /// @brief Retreives the number of cycles that were replayed
+      ///        with full logging by the most recent run.
+      ///
+      int getNumReplayedCycles() const { return n_replayed_cycles_; }
+   
+   private:
+      
+      struct NamedProbe {
+         std::string name_;
+         Probe probe_;
+      };
+      
+      const NamedProbe *findFailingProbe(Simulator &simulator) const;
+      
+      void takeCheckpoint(Simulator &simulator);
+      
+      void bisect(Simulator &simulator);
+   
+   private:
+      
+      std::vector<NamedProbe> probes_;
+      
+      int checkpoint_interval_ = 1000;
+      std::size_t max_checkpoints_ = 1024;
+      int run_log_level_ = ErrorLogLevel;
+      
+      std::vector<Simulator::Snapshot> checkpoints_;
+      int interval_ = 0;
+      
+      int first_failing_cycle_ = -1;
+      int detection_cycle_ = -1;
+      std::string failed_probe_;
+      int n_replayed_cycles_ = 0;
+};
+
+} // namespace papilio
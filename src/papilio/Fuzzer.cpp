@@ -0,0 +1,367 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/Fuzzer.h"
+#include "papilio/Simulator.h"
+#include "papilio/SimulatorCore_.h"
+#include "papilio/aux/WallTimer.h"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace papilio {
+   
+namespace {
+   
+// A simulator that runs a single sequence.
+//
+class FuzzSimulator : public Simulator
+{
+   public:
+      
+      FuzzSimulator(std::ostream &out, const Simulator &parent)
+         :  Simulator(out, parent.getDebug(), parent.getCycleDuration(), false)
+      {}
+};
+
+// Bounds the number of runs that minimizing a sequence may take.
+//
+constexpr int max_minimization_runs = 2000;
+
+std::string eventToCode(const Fuzzer::Event &event)
+{
+   std::ostringstream code;
+   
+   switch(event.type_) {
+      case Fuzzer::Event::Press:
+         code << "simulator.pressKey(" << int(event.row_) << ", " << int(event.col_) << ");";
+         break;
+      case Fuzzer::Event::Release:
+         code << "simulator.releaseKey(" << int(event.row_) << ", " << int(event.col_) << ");";
+         break;
+      case Fuzzer::Event::Tap:
+         code << "simulator.tapKey(" << int(event.row_) << ", " << int(event.col_) << ");";
+         break;
+      case Fuzzer::Event::MultiTap:
+         code << "simulator.multiTapKey(" << int(event.n_taps_) << ", " 
+            << int(event.row_) << ", " << int(event.col_) << ");";
+         break;
+   }
+   
+   if(event.n_cycles_ > 0) {
+      code << " simulator.cycles(" << event.n_cycles_ << ");";
+   }
+   
+   return code.str();
+}
+
+} // namespace
+
+Fuzzer::Fuzzer(const CoreFactory &core_factory, const SetupFunction &setup)
+   :  core_factory_(core_factory),
+      setup_(setup)
+{}
+
+Fuzzer::Sequence Fuzzer::generateSequence(uint8_t rows, uint8_t cols, 
+                                          std::size_t index) const
+{
+   Sequence sequence;
+   
+   if((rows == 0) || (cols == 0)) { return sequence; }
+   
+   std::mt19937_64 random(seed_ + index);
+   
+   std::uniform_int_distribution<std::size_t> length_distribution(1, max_length_ ? max_length_ : 1);
+   std::uniform_int_distribution<int> type_distribution(0, 3);
+   std::uniform_int_distribution<int> row_distribution(0, rows - 1);
+   std::uniform_int_distribution<int> col_distribution(0, cols - 1);
+   std::uniform_int_distribution<int> taps_distribution(2, 4);
+   std::uniform_int_distribution<int> cycles_distribution(0, max_cycles_);
+   
+   // Releases preferably target pressed keys.
+   //
+   std::vector<std::pair<uint8_t, uint8_t>> pressed;
+   
+   const std::size_t length = length_distribution(random);
+   
+   for(std::size_t i = 0; i < length; ++i) {
+      
+      Event event;
+      event.type_ = Event::Type(type_distribution(random));
+      event.row_ = uint8_t(row_distribution(random));
+      event.col_ = uint8_t(col_distribution(random));
+      event.n_taps_ = 1;
+      event.n_cycles_ = uint16_t(cycles_distribution(random));
+      
+      switch(event.type_) {
+         case Event::Press:
+            pressed.push_back(std::make_pair(event.row_, event.col_));
+            break;
+         case Event::Release:
+            if(!pressed.empty()) {
+               std::size_t key_id = random() % pressed.size();
+               event.row_ = pressed[key_id].first;
+               event.col_ = pressed[key_id].second;
+               pressed.erase(pressed.begin() + key_id);
+            }
+            break;
+         case Event::MultiTap:
+            event.n_taps_ = uint8_t(taps_distribution(random));
+            break;
+         default:
+            break;
+      }
+      
+      sequence.push_back(event);
+   }
+   
+   return sequence;
+}
+
+bool Fuzzer::runSequence(const Simulator &parent, 
+                         const Sequence &sequence, 
+                         std::ostream &out,
+                         int log_level) const
+{
+   // Header and footer text are not part of the output.
+   //
+   std::ostream null_stream(nullptr);
+   
+   std::unique_ptr<Simulator> simulator_ptr 
+      = simulator_factory_ ? simulator_factory_(null_stream)
+                           : std::unique_ptr<Simulator>(new FuzzSimulator(null_stream, parent));
+   
+   Simulator &simulator = *simulator_ptr;
+   simulator.setDebug(parent.getDebug());
+   simulator.setCycleDuration(parent.getCycleDuration());
+   simulator.setTerminateOnFailure(false);
+   simulator.setLogLevel(log_level);
+   simulator.setOStream(out);
+   simulator.setCore(core_factory_());
+   
+   setup_(simulator);
+   
+   bool failed = false;
+   
+   for(const auto &event: sequence) {
+      
+      switch(event.type_) {
+         case Event::Press:
+            simulator.pressKey(event.row_, event.col_);
+            break;
+         case Event::Release:
+            simulator.releaseKey(event.row_, event.col_);
+            break;
+         case Event::Tap:
+            simulator.tapKey(event.row_, event.col_);
+            break;
+         case Event::MultiTap:
+            simulator.multiTapKey(event.n_taps_, event.row_, event.col_);
+            break;
+      }
+      
+      if(event.n_cycles_ > 0) {
+         simulator.cycles(event.n_cycles_);
+      }
+      
+      // The remaining events do not matter once an invariant failed.
+      //
+      if(simulator.getErrorCount() != 0) {
+         failed = true;
+         break;
+      }
+   }
+   
+   if(!failed) {
+      simulator.clearAllKeys();
+      if(n_settle_cycles_ > 0) {
+         simulator.cycles(n_settle_cycles_);
+      }
+      if(final_check_) {
+         final_check_(simulator);
+      }
+   }
+   
+   simulator.assertNothingQueued();
+   
+   const bool success = (simulator.getErrorCount() == 0);
+   
+   simulator.setOStream(null_stream);
+   
+   return success;
+}
+
+Fuzzer::Sequence Fuzzer::minimizeSequence(const Simulator &parent, 
+                                          const Sequence &sequence) const
+{
+   std::ostream null_stream(nullptr);
+   
+   Sequence current = sequence;
+   Sequence candidate;
+   
+   int n_runs = 0;
+   
+   // Remove chunks of events, halving the chunk size whenever no 
+   // chunk can be removed.
+   //
+   std::size_t chunk_size = (current.size() + 1)/2;
+   
+   while((chunk_size > 0) && (n_runs < max_minimization_runs)) {
+      
+      bool removed = false;
+      
+      for(std::size_t start = 0; 
+          (start < current.size()) && (n_runs < max_minimization_runs); ) {
+         
+         const std::size_t end = std::min(start + chunk_size, current.size());
+         
+         candidate.assign(current.begin(), current.begin() + start);
+         candidate.insert(candidate.end(), current.begin() + end, current.end());
+         
+         ++n_runs;
+         
+         if(!this->runSequence(parent, candidate, null_stream)) {
+            current.swap(candidate);
+            removed = true;
+         }
+         else {
+            start = end;
+         }
+      }
+      
+      if(!removed) {
+         chunk_size /= 2;
+      }
+      else if(chunk_size > current.size()) {
+         chunk_size = (current.size() + 1)/2;
+      }
+   }
+   
+   return current;
+}
+
+std::string Fuzzer::toCode(const Sequence &sequence, const char *add_indent)
+{
+   std::string code;
+   for(const auto &event: sequence) {
+      code += add_indent;
+      code += eventToCode(event);
+      code += '\n';
+   }
+   return code;
+}
+
+std::size_t Fuzzer::runWorker(Simulator &simulator, std::size_t begin, std::size_t end) const
+{
+   std::size_t n_failed = 0;
+   
+   uint8_t rows = 0, cols = 0;
+   simulator.getCore().getKeyMatrixDimensions(rows, cols);
+   
+   std::ostream null_stream(nullptr);
+   
+   for(std::size_t index = begin; index < end; ++index) {
+      
+      Sequence sequence = this->generateSequence(rows, cols, index);
+      
+      if(this->runSequence(simulator, sequence, null_stream)) {
+         continue;
+      }
+      
+      ++n_failed;
+      
+      simulator.error() << "Sequence " << index << " of seed " << seed_ << " failed";
+      
+      Sequence minimized = minimize_ ? this->minimizeSequence(simulator, sequence) 
+                                     : sequence;
+      
+      simulator.log() << "Failing sequence (" << minimized.size() << " of " 
+         << sequence.size() << " events):";
+      for(const auto &event: minimized) {
+         simulator.log() << "   " << eventToCode(event);
+      }
+      
+      // Replay the sequence to show what went wrong.
+      //
+      simulator.log() << "Output of the failing sequence:";
+      simulator.flush();
+      this->runSequence(simulator, minimized, simulator.getOStream(), 
+                        simulator.getLogLevel());
+   }
+   
+   return n_failed;
+}
+
+int Fuzzer::run(Simulator &simulator)
+{
+   int n_workers = n_workers_;
+   if(n_workers <= 0) {
+      n_workers = std::thread::hardware_concurrency();
+   }
+   if(n_workers > int(n_sequences_)) {
+      n_workers = int(n_sequences_);
+   }
+   if(n_workers < 1) {
+      n_workers = 1;
+   }
+   
+   simulator.log() << "Fuzzing " << n_sequences_ << " sequences of seed " << seed_;
+   
+   TestRunner runner(core_factory_);
+   runner.setNumWorkers(n_workers);
+   runner.setWorkerType(worker_type_);
+   runner.setSimulatorFactory(simulator_factory_);
+   
+   for(int w = 0; w < n_workers; ++w) {
+      
+      std::size_t begin = w*n_sequences_/n_workers;
+      std::size_t end = (w + 1)*n_sequences_/n_workers;
+      
+      std::string name = "Fuzzing sequences " + std::to_string(begin) 
+                       + " to " + std::to_string(end - 1);
+      
+      runner.addChecks(name.c_str(), end - begin, 
+                       [this, begin, end](Simulator &worker_simulator) {
+         return this->runWorker(worker_simulator, begin, end);
+      });
+   }
+   
+   WallTimer timer;
+   timer.start();
+   
+   runner.run(simulator);
+   
+   double elapsed_ms = timer.elapsed();
+   
+   // All sequences of a worker that terminated abnormally count as failed.
+   //
+   int n_failed = 0;
+   for(const auto &result: runner.getResults()) {
+      n_failed += int(result.n_failed_checks_);
+   }
+   
+   sequences_per_second_ = (elapsed_ms > 0.0) ? 1000.0*n_sequences_/elapsed_ms : 0.0;
+   
+   simulator.log() << n_sequences_ << " sequences in " << elapsed_ms << " ms ("
+      << sequences_per_second_ << " sequences/s), " << n_failed << " failed";
+   
+   return n_failed;
+}
+
+} // namespace papilio
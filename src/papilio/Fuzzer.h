@@ -0,0 +1,204 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/TestRunner.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace papilio {
+   
+class Simulator;
+class SimulatorCore_;
+
+/// @brief Runs random key sequences against a set of invariant actions.
+/// @details Every sequence is run with a new simulator and a fresh 
+///        simulator core that is created by a factory function. A setup
+///        function registers the invariants, typically as permanent
+///        report and cycle actions. A sequence fails if any
+///        error is reported while it runs, or by an optional final check 
+///        that runs after all keys were released via clearAllKeys().
+///
+///        Failing sequences are minimized by removing events as long as 
+///        the sequence still fails. Sequences are derived from a seed
+///        and their index, so every sequence can be reproduced.
+///        Sequences are distributed over the workers of a TestRunner.
+///
+class Fuzzer
+{
+   public:
+      
+      typedef TestRunner::CoreFactory CoreFactory;
+      typedef TestRunner::SimulatorFactory SimulatorFactory;
+      typedef std::function<void(Simulator &)> SetupFunction;
+      
+      /// @brief A single key event, followed by a number of cycles.
+      ///
+      struct Event {
+         
+         enum Type { Press, Release, Tap, MultiTap };
+         
+         Type type_;
+         uint8_t row_;
+         uint8_t col_;
+         uint8_t n_taps_;
+         uint16_t n_cycles_;
+      };
+      
+      typedef std::vector<Event> Sequence;
+      
+      /// @brief Constructor.
+      ///
+      /// @param core_factory A function that creates a new simulator core 
+      ///        in its initial state.
+      /// @param setup A function that registers the invariant actions
+      ///        with a new simulator.
+      ///
+      Fuzzer(const CoreFactory &core_factory, const SetupFunction &setup);
+      
+      /// @brief Sets a check that runs after every sequence once all keys 
+      ///        were released and the keyboard settled, e.g. to make sure
+      ///        that no modifiers got stuck.
+      ///
+      void setFinalCheck(const SetupFunction &final_check) { final_check_ = final_check; }
+      
+      /// @brief Sets the function that creates the simulator of every sequence.
+      /// @details By default, plain simulators are created that are 
+      ///        configured like the parent simulator. The factory must be
+      ///        fork-safe, see TestRunner::setSimulatorFactory(...).
+      ///
+      void setSimulatorFactory(const SimulatorFactory &simulator_factory) {
+         simulator_factory_ = simulator_factory;
+      }
+      
+      /// @brief Sets the number of sequences to run.
+      ///
+      void setNumSequences(std::size_t n_sequences) { n_sequences_ = n_sequences; }
+      
+      /// @brief Sets the maximum number of key events per sequence.
+      ///
+      void setMaxSequenceLength(std::size_t max_length) { max_length_ = max_length; }
+      
+      /// @brief Sets the maximum number of cycles that follow a key event.
+      ///
+      void setMaxCyclesBetweenEvents(uint16_t max_cycles) { max_cycles_ = max_cycles; }
+      
+      /// @brief Sets the number of cycles that are run after clearAllKeys().
+      ///
+      void setNumSettleCycles(int n_cycles) { n_settle_cycles_ = n_cycles; }
+      
+      /// @brief Sets the seed that all sequences are derived from.
+      ///
+      void setSeed(uint64_t seed) { seed_ = seed; }
+      
+      /// @brief Enables or disables the minimization of failing sequences.
+      ///
+      void setMinimize(bool state = true) { minimize_ = state; }
+      
+      /// @brief Sets the number of workers.
+      /// @param n_workers The number of workers. If zero, one
+      ///        worker per hardware thread is used.
+      ///
+      void setNumWorkers(int n_workers) { n_workers_ = n_workers; }
+      
+      /// @brief Selects the type of workers, see TestRunner.
+      ///
+      void setWorkerType(TestRunner::WorkerType worker_type) { worker_type_ = worker_type; }
+      
+      /// @brief Generates the sequence with a given index.
+      ///
+      /// @param rows The number of matrix rows.
+      /// @param cols The number of matrix columns.
+      /// @param index The index of the sequence.
+      ///
+      Sequence generateSequence(uint8_t rows, uint8_t cols, std::size_t index) const;
+      
+      /// @brief Runs a sequence with a new simulator.
+      ///
+      /// @param parent The simulator whose configuration is used.
+      /// @param sequence The sequence to run.
+      /// @param out The stream that receives the output.
+      /// @param log_level The log level of the output.
+      ///
+      /// @returns True if no errors occurred.
+      ///
+      bool runSequence(const Simulator &parent, 
+                       const Sequence &sequence, 
+                       std::ostream &out,
+                       int log_level = ErrorLogLevel) const;
+      
+      /// @brief Removes events from a failing sequence as long as it keeps failing.
+      ///
+      /// @param parent The simulator whose configuration is used.
+      /// @param sequence The failing sequence.
+      ///
+      /// @returns The minimized sequence.
+      ///
+      Sequence minimizeSequence(const Simulator &parent, const Sequence &sequence) const;
+      
+      /// @brief Runs all sequences.
+      /// @details Every failing sequence is reported as an error, along with 
+      ///        its minimized version as C++ code and the output of 
+      ///        the minimized run.
+      ///
+      /// @param simulator The parent simulator.
+      ///
+      /// @returns The number of failing sequences.
+      ///
+      int run(Simulator &simulator);
+      
+      /// @brief Retreives the throughput of the most recent run.
+      ///
+      double getSequencesPerSecond() const { return sequences_per_second_; }
+      
+      /// @brief Converts a sequence to C++ code.
+      ///
+      /// @param sequence The sequence.
+      /// @param add_indent An indentation string for every line.
+      ///
+      static std::string toCode(const Sequence &sequence, const char *add_indent = "");
+      
+   private:
+      
+      std::size_t runWorker(Simulator &simulator, std::size_t begin, std::size_t end) const;
+      
+   private:
+      
+      CoreFactory core_factory_;
+      SimulatorFactory simulator_factory_;
+      SetupFunction setup_;
+      SetupFunction final_check_;
+      
+      std::size_t n_sequences_ = 1000;
+      std::size_t max_length_ = 20;
+      uint16_t max_cycles_ = 50;
+      int n_settle_cycles_ = 10;
+      uint64_t seed_ = 0;
+      bool minimize_ = true;
+      
+      int n_workers_ = 0;
+      TestRunner::WorkerType worker_type_ = TestRunner::ProcessWorkers;
+      
+      double sequences_per_second_ = 0.0;
+};
+
+} // namespace papilio
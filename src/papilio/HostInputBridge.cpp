@@ -0,0 +1,475 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/HostInputBridge.h"
+#include "papilio/Simulator.h"
+#include "papilio/Profiler.h"
+#include "papilio/actions/CustomAction.h"
+#include "papilio/actions/generic_report/CustomReportAction.h"
+#include "papilio/reports/KeyboardReport_.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+#endif
+
+#if defined(__has_include)
+#if __has_include(<X11/extensions/XTest.h>)
+#define PAPILIO_HAVE_XTEST
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+#endif
+#endif
+
+namespace papilio {
+   
+namespace {
+   
+// Maps HID keyboard usages to Linux input event key codes 
+// (zero if there is no equivalent), see drivers/hid/hid-input.c.
+//
+const uint8_t hid_to_linux_keycode[256] = {
+     0,  0,  0,  0, 30, 48, 46, 32, 18, 33, 34, 35, 23, 36, 37, 38,
+    50, 49, 24, 25, 16, 19, 31, 20, 22, 47, 17, 45, 21, 44,  2,  3,
+     4,  5,  6,  7,  8,  9, 10, 11, 28,  1, 14, 15, 57, 12, 13, 26,
+    27, 43, 43, 39, 40, 41, 51, 52, 53, 58, 59, 60, 61, 62, 63, 64,
+    65, 66, 67, 68, 87, 88, 99, 70,119,110,102,104,111,107,109,106,
+   105,108,103, 69, 98, 55, 74, 78, 96, 79, 80, 81, 75, 76, 77, 71,
+    72, 73, 82, 83, 86,127,116,117,183,184,185,186,187,188,189,190,
+   191,192,193,194,134,138,130,132,128,129,131,137,133,135,136,113,
+   115,114,  0,  0,  0,121,  0, 89, 93,124, 92, 94, 95,  0,  0,  0,
+   122,123, 90, 91, 85,  0,  0,  0,  0,  0,  0,  0,111,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,179,180,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,111,  0,  0,  0,  0,  0,  0,  0,
+    29, 42, 56,125, 97, 54,100,126,164,166,165,163,161,115,114,113,
+   150,158,159,128,136,177,178,176,142,152,173,140,  0,  0,  0,  0
+};
+
+constexpr int n_mouse_buttons = 3;
+
+#ifdef __linux__
+
+class UInputSink : public HostInputSink_
+{
+   public:
+      
+      explicit UInputSink(int fd) : fd_(fd) {}
+      
+      virtual ~UInputSink() override {
+         ioctl(fd_, UI_DEV_DESTROY);
+         close(fd_);
+      }
+      
+      static std::shared_ptr<HostInputSink_> create(const char *device_name) {
+         
+         int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+         if(fd < 0) { return nullptr; }
+         
+         ioctl(fd, UI_SET_EVBIT, EV_KEY);
+         ioctl(fd, UI_SET_EVBIT, EV_REL);
+         ioctl(fd, UI_SET_EVBIT, EV_SYN);
+         
+         for(int code = 1; code < 256; ++code) {
+            ioctl(fd, UI_SET_KEYBIT, code);
+         }
+         for(int button = 0; button < n_mouse_buttons; ++button) {
+            ioctl(fd, UI_SET_KEYBIT, buttonCode(button));
+         }
+         
+         ioctl(fd, UI_SET_RELBIT, REL_X);
+         ioctl(fd, UI_SET_RELBIT, REL_Y);
+         ioctl(fd, UI_SET_RELBIT, REL_WHEEL);
+         ioctl(fd, UI_SET_RELBIT, REL_HWHEEL);
+         
+         struct uinput_user_dev device;
+         memset(&device, 0, sizeof(device));
+         strncpy(device.name, device_name, UINPUT_MAX_NAME_SIZE - 1);
+         device.id.bustype = BUS_VIRTUAL;
+         device.id.vendor = 1;
+         device.id.product = 1;
+         device.id.version = 1;
+         
+         if(   (write(fd, &device, sizeof(device)) != ssize_t(sizeof(device)))
+            || (ioctl(fd, UI_DEV_CREATE) < 0)) {
+            close(fd);
+            return nullptr;
+         }
+         
+         return std::make_shared<UInputSink>(fd);
+      }
+      
+      virtual void keyEvent(uint16_t code, bool pressed) override {
+         this->emit(EV_KEY, code, pressed ? 1 : 0);
+      }
+      
+      virtual void mouseButtonEvent(int button, bool pressed) override {
+         this->emit(EV_KEY, buttonCode(button), pressed ? 1 : 0);
+      }
+      
+      virtual void mouseMotionEvent(int dx, int dy, int wheel, int h_wheel) override {
+         if(dx) { this->emit(EV_REL, REL_X, dx); }
+         if(dy) { this->emit(EV_REL, REL_Y, dy); }
+         if(wheel) { this->emit(EV_REL, REL_WHEEL, wheel); }
+         if(h_wheel) { this->emit(EV_REL, REL_HWHEEL, h_wheel); }
+      }
+      
+      virtual void sync() override {
+         this->emit(EV_SYN, SYN_REPORT, 0);
+      }
+      
+   private:
+      
+      static uint16_t buttonCode(int button) {
+         static const uint16_t codes[n_mouse_buttons] = { BTN_LEFT, BTN_RIGHT, BTN_MIDDLE };
+         return codes[button];
+      }
+      
+      void emit(uint16_t type, uint16_t code, int32_t value) {
+         struct input_event event;
+         memset(&event, 0, sizeof(event));
+         event.type = type;
+         event.code = code;
+         event.value = value;
+         
+         // Events that cannot be written are lost. There is nothing
+         // sensible to do about it in the injection thread.
+         //
+         ssize_t result = write(fd_, &event, sizeof(event));
+         (void)result;
+      }
+      
+   private:
+      
+      int fd_;
+};
+
+#endif // #ifdef __linux__
+
+#ifdef PAPILIO_HAVE_XTEST
+
+class XTestSink : public HostInputSink_
+{
+   public:
+      
+      explicit XTestSink(Display *display) : display_(display) {}
+      
+      virtual ~XTestSink() override {
+         XCloseDisplay(display_);
+      }
+      
+      static std::shared_ptr<HostInputSink_> create() {
+         
+         Display *display = XOpenDisplay(nullptr);
+         if(!display) { return nullptr; }
+         
+         int event_base, error_base, major_version, minor_version;
+         if(!XTestQueryExtension(display, &event_base, &error_base, 
+                                 &major_version, &minor_version)) {
+            XCloseDisplay(display);
+            return nullptr;
+         }
+         
+         return std::make_shared<XTestSink>(display);
+      }
+      
+      virtual void keyEvent(uint16_t code, bool pressed) override {
+         
+         // X servers that use evdev offset Linux key codes by 8.
+         //
+         XTestFakeKeyEvent(display_, code + 8, pressed ? True : False, CurrentTime);
+      }
+      
+      virtual void mouseButtonEvent(int button, bool pressed) override {
+         static const unsigned int x_buttons[n_mouse_buttons] = { 1, 3, 2 };
+         XTestFakeButtonEvent(display_, x_buttons[button], pressed ? True : False, CurrentTime);
+      }
+      
+      virtual void mouseMotionEvent(int dx, int dy, int wheel, int h_wheel) override {
+         
+         if(dx || dy) {
+            XTestFakeRelativeMotionEvent(display_, dx, dy, CurrentTime);
+         }
+         
+         // X reports wheel motion as clicks of buttons 4/5 (up/down)
+         // and 6/7 (left/right).
+         //
+         this->click((wheel > 0) ? 4 : 5, std::abs(wheel));
+         this->click((h_wheel > 0) ? 7 : 6, std::abs(h_wheel));
+      }
+      
+      virtual void sync() override {
+         XFlush(display_);
+      }
+      
+   private:
+      
+      void click(unsigned int button, int n_clicks) {
+         for(int i = 0; i < n_clicks; ++i) {
+            XTestFakeButtonEvent(display_, button, True, CurrentTime);
+            XTestFakeButtonEvent(display_, button, False, CurrentTime);
+         }
+      }
+      
+   private:
+      
+      Display *display_;
+};
+
+#endif // #ifdef PAPILIO_HAVE_XTEST
+
+} // namespace
+
+std::shared_ptr<HostInputSink_> createXTestSink()
+{
+#ifdef PAPILIO_HAVE_XTEST
+   return XTestSink::create();
+#else
+   return nullptr;
+#endif
+}
+
+std::shared_ptr<HostInputSink_> createUInputSink(const char *device_name)
+{
+#ifdef __linux__
+   return UInputSink::create(device_name);
+#else
+   (void)device_name;
+   return nullptr;
+#endif
+}
+
+std::shared_ptr<HostInputSink_> createHostInputSink()
+{
+   if(std::getenv("DISPLAY")) {
+      if(auto sink = createXTestSink()) {
+         return sink;
+      }
+   }
+   return createUInputSink();
+}
+
+HostInputBridge::HostInputBridge(const std::shared_ptr<HostInputSink_> &sink)
+   :  sink_(sink)
+{
+   thread_ = std::thread(&HostInputBridge::run, this);
+}
+
+HostInputBridge::~HostInputBridge()
+{
+   this->detach();
+   
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+   }
+   condition_.notify_one();
+   thread_.join();
+   
+   // Do not leave keys pressed on the host.
+   //
+   InputState released = injected_;
+   memset(released.keycodes_, 0, sizeof(released.keycodes_));
+   released.buttons_ = 0;
+   released.timestamp_ = Profiler::now();
+   this->inject(released);
+}
+
+void HostInputBridge::attach(Simulator &simulator)
+{
+   this->detach();
+   
+   report_action_ = actions::CustomReportAction<Report_>{
+         [this](const Report_ &report) -> bool {
+            ReportData data;
+            report.getData(data);
+            this->addReport(data);
+            return true;
+         }
+      }.ptr();
+   
+   cycle_action_ = actions::CustomAction{
+         [this]() -> bool {
+            this->endCycle();
+            return true;
+         }
+      }.ptr();
+   
+   simulator.permanentReportActions().add(report_action_);
+   simulator.permanentCycleActions().add(cycle_action_);
+   
+   simulator_ = &simulator;
+}
+
+void HostInputBridge::detach()
+{
+   if(!simulator_) { return; }
+   
+   simulator_->permanentReportActions().remove(report_action_);
+   simulator_->permanentCycleActions().remove(cycle_action_);
+   
+   report_action_.reset();
+   cycle_action_.reset();
+   simulator_ = nullptr;
+}
+
+void HostInputBridge::addReport(const ReportData &data)
+{
+   switch(data.type_id_) {
+      
+      case BootKeyboardReportTypeIdId:
+      case KeyboardReportTypeId:
+      {
+         for(int w = 0; w < 4; ++w) {
+            uint64_t word = 0;
+            for(int b = 7; b >= 0; --b) {
+               word = (word << 8) | data.bytes_[1 + 8*w + b];
+            }
+            current_.keycodes_[w] = word;
+         }
+         
+         // Modifier keycodes 0xE0 - 0xE7 are bits 32 - 39 of the last word.
+         //
+         current_.keycodes_[3] |= uint64_t(data.bytes_[0]) 
+               << (KeyboardReport_::first_modifier_keycode - 192);
+      }
+         break;
+         
+      case MouseReportTypeId:
+         current_.buttons_ = data.bytes_[0];
+         current_.x_ += int8_t(data.bytes_[1]);
+         current_.y_ += int8_t(data.bytes_[2]);
+         current_.wheel_ += int8_t(data.bytes_[3]);
+         current_.h_wheel_ += int8_t(data.bytes_[4]);
+         break;
+         
+      default:
+         break;
+   }
+}
+
+void HostInputBridge::endCycle()
+{
+   if(current_.equals(published_)) {
+      return;
+   }
+   
+   current_.timestamp_ = Profiler::now();
+   
+   states_.back() = current_;
+   states_.publish();
+   published_ = current_;
+   ++n_published_;
+   
+   // Taking the lock ensures that the injection thread either 
+   // sees the new state or waits for the notification.
+   //
+   { std::lock_guard<std::mutex> lock(mutex_); }
+   condition_.notify_one();
+}
+
+void HostInputBridge::run()
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   
+   while(running_) {
+      if(states_.update()) {
+         lock.unlock();
+         this->inject(states_.front());
+         lock.lock();
+         continue;
+      }
+      condition_.wait(lock);
+   }
+}
+
+void HostInputBridge::inject(const InputState &state)
+{
+   if(sink_) {
+      for(int w = 0; w < 4; ++w) {
+         uint64_t changed = state.keycodes_[w] ^ injected_.keycodes_[w];
+         while(changed) {
+            int bit = __builtin_ctzll(changed);
+            changed &= changed - 1;
+            uint8_t code = hid_to_linux_keycode[64*w + bit];
+            if(code) {
+               sink_->keyEvent(code, (state.keycodes_[w] >> bit) & 1);
+            }
+         }
+      }
+      
+      uint8_t changed_buttons = state.buttons_ ^ injected_.buttons_;
+      for(int button = 0; button < n_mouse_buttons; ++button) {
+         if(changed_buttons & (1 << button)) {
+            sink_->mouseButtonEvent(button, (state.buttons_ >> button) & 1);
+         }
+      }
+      
+      int dx = int(state.x_ - injected_.x_);
+      int dy = int(state.y_ - injected_.y_);
+      int wheel = int(state.wheel_ - injected_.wheel_);
+      int h_wheel = int(state.h_wheel_ - injected_.h_wheel_);
+      if(dx || dy || wheel || h_wheel) {
+         sink_->mouseMotionEvent(dx, dy, wheel, h_wheel);
+      }
+      
+      sink_->sync();
+   }
+   
+   injected_ = state;
+   
+   uint64_t latency = Profiler::now() - state.timestamp_;
+   {
+      std::lock_guard<std::mutex> lock(latency_mutex_);
+      latency_.add(latency);
+   }
+   ++n_injected_;
+}
+
+Histogram HostInputBridge::getInjectionLatency() const
+{
+   std::lock_guard<std::mutex> lock(latency_mutex_);
+   return latency_;
+}
+
+void HostInputBridge::report(const Simulator &simulator) const
+{
+   static constexpr double ns_per_us = 1e3;
+   
+   Histogram latency = this->getInjectionLatency();
+   
+   std::ostringstream out;
+   out << std::fixed << std::setprecision(2)
+      << "mean " << latency.getMean()/ns_per_us 
+      << ", p50 " << latency.getPercentile(50)/ns_per_us
+      << ", p99 " << latency.getPercentile(99)/ns_per_us
+      << ", max " << latency.getMax()/ns_per_us;
+   
+   simulator.log() << "Host input: " << n_published_ << " states published, " 
+      << n_injected_ << " injected";
+   simulator.log() << "Host injection latency (us): " << out.str();
+}
+
+} // namespace papilio
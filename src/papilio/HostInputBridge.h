@@ -0,0 +1,217 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/aux/Histogram.h"
+#include "papilio/aux/TripleBuffer.h"
+#include "papilio/reports/ReportData.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace papilio {
+   
+class Simulator;
+class Action_;
+class ReportAction_;
+
+/// @brief An abstract receiver of host input events.
+/// @details Implementations inject events into the host's input system.
+///
+class HostInputSink_
+{
+   public:
+      
+      virtual ~HostInputSink_() {}
+      
+      /// @brief Presses or releases a key.
+      /// @param code A Linux input event key code (KEY_...).
+      /// @param pressed True for a press, false for a release.
+      ///
+      virtual void keyEvent(uint16_t code, bool pressed) = 0;
+      
+      /// @brief Presses or releases a mouse button.
+      /// @param button The button (0: left, 1: right, 2: middle).
+      /// @param pressed True for a press, false for a release.
+      ///
+      virtual void mouseButtonEvent(int button, bool pressed) = 0;
+      
+      /// @brief Moves the mouse pointer and scrolls the wheels.
+      ///
+      virtual void mouseMotionEvent(int dx, int dy, int wheel, int h_wheel) = 0;
+      
+      /// @brief Delivers all events since the last call.
+      ///
+      virtual void sync() = 0;
+};
+
+/// @brief Creates a sink that injects events via XTest.
+/// @returns The sink or nullptr if XTest is unavailable or no X display
+///        could be opened.
+///
+std::shared_ptr<HostInputSink_> createXTestSink();
+
+/// @brief Creates a sink that injects events via a Linux uinput device.
+/// @param device_name The name of the virtual input device.
+/// @returns The sink or nullptr if /dev/uinput is unavailable.
+///
+std::shared_ptr<HostInputSink_> createUInputSink(const char *device_name = "Papilio virtual keyboard");
+
+/// @brief Creates the most suitable host input sink, i.e. XTest if an
+///        X display is available, uinput otherwise.
+/// @returns The sink or nullptr if none is available.
+///
+std::shared_ptr<HostInputSink_> createHostInputSink();
+
+/// @brief Forwards simulated keyboard and mouse reports to the host as real
+///        input events, e.g. while running remote controlled.
+/// @details Reports are collected during each cycle. Redundant reports 
+///        within a cycle are coalesced. At the end of the cycle, the resulting 
+///        input state is handed to a background thread that injects 
+///        only the differences to the state that was injected before, i.e. 
+///        presses and releases of individual keys and buttons,
+///        and relative mouse motion. If the thread falls behind, intermediate
+///        states are skipped, so injection never slows the simulation.
+///        Mouse motion is never lost, as it is accumulated.
+///
+///        Absolute mouse reports are not forwarded.
+///
+///        All keys and buttons that are still pressed on the host are 
+///        released when the bridge is destroyed. A bridge that is 
+///        attached to a simulator is detached when it is destroyed.
+///
+class HostInputBridge
+{
+   public:
+      
+      /// @brief Constructor.
+      /// @param sink The sink that receives the input events.
+      ///
+      explicit HostInputBridge(const std::shared_ptr<HostInputSink_> &sink);
+      
+      ~HostInputBridge();
+      
+      HostInputBridge(const HostInputBridge &) = delete;
+      HostInputBridge &operator=(const HostInputBridge &) = delete;
+      
+      /// @brief Registers permanent actions that forward the simulator's
+      ///        reports to the bridge.
+      /// @details A bridge is attached to at most one simulator at a time.
+      ///        Attaching detaches it from any previous simulator.
+      ///        The simulator must outlive the attachment.
+      ///
+      void attach(Simulator &simulator);
+      
+      /// @brief Removes the actions that were registered by attach(...).
+      ///
+      void detach();
+      
+      /// @brief Registers a report.
+      /// @details Keyboard, boot keyboard and mouse reports are considered.
+      ///
+      void addReport(const ReportData &data);
+      
+      /// @brief Hands the input state that results from all reports 
+      ///        of the current cycle to the injection thread.
+      ///
+      void endCycle();
+      
+      /// @brief Retreives the latency between the end of a cycle and the 
+      ///        completed injection of the resulting events, in nanoseconds.
+      ///
+      Histogram getInjectionLatency() const;
+      
+      /// @brief Retreives the number of input states that were handed
+      ///        to the injection thread.
+      ///
+      uint64_t getNumStatesPublished() const { return n_published_; }
+      
+      /// @brief Retreives the number of input states that were injected.
+      /// @details Less than the number of published states if the 
+      ///        injection thread skipped states.
+      ///
+      uint64_t getNumStatesInjected() const { return n_injected_; }
+      
+      /// @brief Writes a summary to the simulator's log.
+      ///
+      void report(const Simulator &simulator) const;
+      
+   private:
+      
+      struct InputState {
+         
+         // Bit n: keycode n, including modifier keycodes 0xE0 - 0xE7
+         //
+         uint64_t keycodes_[4];
+         
+         uint8_t buttons_;
+         
+         // Accumulated relative mouse motion
+         //
+         int64_t x_;
+         int64_t y_;
+         int64_t wheel_;
+         int64_t h_wheel_;
+         
+         uint64_t timestamp_;
+         
+         // Compares everything but the timestamp
+         //
+         bool equals(const InputState &other) const {
+            return    (memcmp(keycodes_, other.keycodes_, sizeof(keycodes_)) == 0)
+                   && (buttons_ == other.buttons_)
+                   && (x_ == other.x_) && (y_ == other.y_)
+                   && (wheel_ == other.wheel_) && (h_wheel_ == other.h_wheel_);
+         }
+      };
+      
+      void run();
+      void inject(const InputState &state);
+      
+   private:
+      
+      std::shared_ptr<HostInputSink_> sink_;
+      
+      Simulator *simulator_ = nullptr;
+      std::shared_ptr<ReportAction_> report_action_;
+      std::shared_ptr<Action_> cycle_action_;
+      
+      InputState current_ = InputState();
+      InputState published_ = InputState();
+      InputState injected_ = InputState();
+      
+      TripleBuffer<InputState> states_;
+      
+      std::thread thread_;
+      std::mutex mutex_;
+      std::condition_variable condition_;
+      std::atomic<bool> running_{true};
+      
+      mutable std::mutex latency_mutex_;
+      Histogram latency_;
+      
+      uint64_t n_published_ = 0;
+      std::atomic<uint64_t> n_injected_{0};
+};
+
+} // namespace papilio
@@ -0,0 +1,247 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/HostPollingModel.h"
+#include "papilio/Simulator.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace papilio {
+
+namespace {
+
+const char *policyString(HostPollingModel::Policy policy)
+{
+   switch(policy) {
+      case HostPollingModel::DropNewest:
+         return "drop newest";
+      case HostPollingModel::DropOldest:
+         return "drop oldest";
+      case HostPollingModel::Coalesce:
+         return "coalesce";
+   }
+   return "";
+}
+
+} // namespace
+
+void HostPollingModel::Endpoint::clearStatistics()
+{
+   queue_depth_.clear();
+   n_arrived_ = 0;
+   n_delivered_ = 0;
+   n_delivered_bytes_ = 0;
+   n_dropped_ = 0;
+   n_merged_ = 0;
+}
+
+void HostPollingModel::setPolicy(Policy policy)
+{
+   for(auto &endpoint: endpoints_) {
+      endpoint.setPolicy(policy);
+   }
+}
+
+void HostPollingModel::setCapacity(std::size_t capacity)
+{
+   for(auto &endpoint: endpoints_) {
+      endpoint.setCapacity(capacity);
+   }
+}
+
+void HostPollingModel::add(int type_id, std::shared_ptr<const Report_> report,
+                           ProcessFunction process)
+{
+   Endpoint &endpoint = endpoints_[type_id];
+   Queue &queue = endpoint.queue_;
+   
+   ++endpoint.n_arrived_;
+   endpoint.queue_depth_.add(queue.size());
+   
+   if(queue.size() >= endpoint.capacity_) {
+      switch(endpoint.policy_) {
+         case DropNewest:
+            ++endpoint.n_dropped_;
+            return;
+         case DropOldest:
+            queue.pop_front();
+            --n_queued_;
+            ++endpoint.n_dropped_;
+            break;
+         case Coalesce:
+            queue.back().report_ = std::move(report);
+            queue.back().process_ = process;
+            ++endpoint.n_merged_;
+            return;
+      }
+   }
+   
+   QueuedReport queued_report;
+   queued_report.report_ = std::move(report);
+   queued_report.process_ = process;
+   queue.push_back(std::move(queued_report));
+   ++n_queued_;
+}
+
+void HostPollingModel::deliver(Simulator &simulator, Endpoint &endpoint)
+{
+   // The report is moved out of the queue first, as report
+   // processing may queue further reports.
+   //
+   QueuedReport queued_report = std::move(endpoint.queue_.front());
+   endpoint.queue_.pop_front();
+   --n_queued_;
+   
+   ReportData data;
+   queued_report.report_->getData(data);
+   
+   ++endpoint.n_delivered_;
+   endpoint.n_delivered_bytes_ += data.size_;
+   
+   queued_report.process_(simulator, *queued_report.report_);
+}
+
+void HostPollingModel::poll(Simulator &simulator, uint64_t begin, uint64_t end)
+{
+   if(!enabled_) {
+      for(auto &endpoint: endpoints_) {
+         while(!endpoint.queue_.empty()) {
+            this->deliver(simulator, endpoint);
+         }
+      }
+      return;
+   }
+   
+   if(!polled_) {
+      first_poll_time_ = begin;
+      polled_ = true;
+   }
+   if(end > end_poll_time_) {
+      end_poll_time_ = end;
+   }
+   
+   if(n_queued_ == 0) { return; }
+   
+   // The number of multiples of the poll interval in [begin, end).
+   //
+   uint64_t n_polls = 1;
+   if(end > begin) {
+      uint64_t first_poll = (begin + poll_interval_ - 1)/poll_interval_*poll_interval_;
+      n_polls = (first_poll < end) ? (end - 1 - first_poll)/poll_interval_ + 1 : 0;
+   }
+   
+   for(uint64_t i = 0; (i < n_polls) && (n_queued_ > 0); ++i) {
+      for(auto &endpoint: endpoints_) {
+         if(!endpoint.queue_.empty()) {
+            this->deliver(simulator, endpoint);
+         }
+      }
+   }
+}
+
+double HostPollingModel::getReportsPerSecond() const
+{
+   uint64_t n_delivered = 0;
+   for(const auto &endpoint: endpoints_) {
+      n_delivered += endpoint.n_delivered_;
+   }
+   uint64_t duration = end_poll_time_ - first_poll_time_;
+   return (duration > 0) ? 1000.0*n_delivered/duration : 0.0;
+}
+
+double HostPollingModel::getBytesPerSecond() const
+{
+   uint64_t n_bytes = 0;
+   for(const auto &endpoint: endpoints_) {
+      n_bytes += endpoint.n_delivered_bytes_;
+   }
+   uint64_t duration = end_poll_time_ - first_poll_time_;
+   return (duration > 0) ? 1000.0*n_bytes/duration : 0.0;
+}
+
+void HostPollingModel::saveQueues(std::vector<Queue> &queues) const
+{
+   queues.clear();
+   for(const auto &endpoint: endpoints_) {
+      queues.push_back(endpoint.queue_);
+   }
+}
+
+void HostPollingModel::restoreQueues(const std::vector<Queue> &queues)
+{
+   n_queued_ = 0;
+   for(std::size_t i = 0; i < NumReportTypeIds; ++i) {
+      endpoints_[i].queue_ = (i < queues.size()) ? queues[i] : Queue{};
+      n_queued_ += endpoints_[i].queue_.size();
+   }
+}
+
+void HostPollingModel::clearQueues()
+{
+   for(auto &endpoint: endpoints_) {
+      endpoint.queue_.clear();
+   }
+   n_queued_ = 0;
+}
+
+void HostPollingModel::clearStatistics()
+{
+   for(auto &endpoint: endpoints_) {
+      endpoint.clearStatistics();
+   }
+   polled_ = false;
+   first_poll_time_ = 0;
+   end_poll_time_ = 0;
+}
+
+void HostPollingModel::report(const Simulator &simulator) const
+{
+   std::ostringstream header;
+   header << std::left << std::setw(20) << "endpoint" << std::right
+      << std::setw(10) << "arrived" << std::setw(10) << "polled"
+      << std::setw(10) << "dropped" << std::setw(10) << "merged"
+      << std::setw(11) << "mean depth" << std::setw(10) << "max depth";
+   
+   simulator.log() << "Host polling (every " << poll_interval_ << " ms):";
+   simulator.log() << header.str();
+   
+   for(int type_id = 1; type_id < NumReportTypeIds; ++type_id) {
+      
+      const Endpoint &endpoint = endpoints_[type_id];
+      
+      if(endpoint.n_arrived_ == 0) { continue; }
+      
+      std::ostringstream line;
+      line << std::left << std::setw(20) << getReportTypeString(type_id) << std::right
+         << std::fixed << std::setprecision(2)
+         << std::setw(10) << endpoint.n_arrived_
+         << std::setw(10) << endpoint.n_delivered_
+         << std::setw(10) << endpoint.n_dropped_
+         << std::setw(10) << endpoint.n_merged_
+         << std::setw(11) << endpoint.queue_depth_.getMean()
+         << std::setw(10) << endpoint.queue_depth_.getMax()
+         << "  (" << policyString(endpoint.policy_) << ", capacity "
+         << endpoint.capacity_ << ")";
+      simulator.log() << line.str();
+   }
+   
+   simulator.log() << "throughput: " << this->getReportsPerSecond() << " reports/s, "
+      << this->getBytesPerSecond() << " bytes/s (" << n_queued_ << " reports queued)";
+}
+
+} // namespace papilio
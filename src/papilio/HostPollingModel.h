@@ -0,0 +1,266 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/aux/Histogram.h"
+#include "papilio/aux/RingBuffer.h"
+#include "papilio/reports/ReportTypes.h"
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+namespace papilio {
+
+class Simulator;
+class Report_;
+
+/// @brief Models a USB host that polls the keyboard's HID endpoints
+///        at a fixed interval.
+/// @details While the model is enabled, reports are not processed
+///        when the core emits them. Instead, they are queued at
+///        the endpoint of their report type. Every poll of the host
+///        takes one report from every endpoint and passes it to the
+///        simulator's report processing. Polls happen at all multiples of
+///        the poll interval. They are evaluated after the core loop of
+///        the cycle during whose time span they occur. If the poll interval
+///        exceeds the cycle duration, reports thus wait for several cycles.
+///        If it is shorter, several reports per endpoint may be delivered
+///        in one cycle.
+///
+///        A policy decides what happens to a report that arrives
+///        at an endpoint whose queue is full. Queued reports are part of
+///        simulator snapshots, statistics are not.
+///
+///        The model is disabled by default. While disabled, the cost
+///        is a single branch per report and cycle.
+///
+class HostPollingModel
+{
+   public:
+      
+      typedef void (*ProcessFunction)(Simulator &simulator, const Report_ &report);
+      
+      /// @brief What happens to reports that arrive at a full queue.
+      ///
+      enum Policy {
+         
+         /// @brief The arriving report is dropped.
+         ///
+         DropNewest,
+         
+         /// @brief The oldest queued report is dropped.
+         ///
+         DropOldest,
+         
+         /// @brief The arriving report replaces the most recently
+         ///        queued report, which is counted as merged.
+         /// @details As HID reports transfer the complete state
+         ///        of their device, the host only misses the
+         ///        intermediate state.
+         ///
+         Coalesce
+      };
+      
+      /// @brief A report that waits to be polled.
+      ///
+      struct QueuedReport {
+         std::shared_ptr<const Report_> report_;
+         ProcessFunction process_ = nullptr;
+      };
+      
+      typedef RingBuffer<QueuedReport> Queue;
+      
+      /// @brief The endpoint of a report type.
+      ///
+      class Endpoint {
+         
+         public:
+            
+            /// @brief Sets the policy for reports that arrive at a full queue.
+            /// @details Default: DropNewest
+            ///
+            void setPolicy(Policy policy) { policy_ = policy; }
+            
+            Policy getPolicy() const { return policy_; }
+            
+            /// @brief Sets the number of reports that can be queued.
+            /// @details Default: 8
+            ///
+            void setCapacity(std::size_t capacity) { capacity_ = (capacity > 0) ? capacity : 1; }
+            
+            std::size_t getCapacity() const { return capacity_; }
+            
+            /// @brief Retreives the number of reports that wait to be polled.
+            ///
+            std::size_t getQueueDepth() const { return queue_.size(); }
+            
+            /// @brief Retreives a histogram of the queue depth that
+            ///        arriving reports found.
+            ///
+            const Histogram &getQueueDepthHistogram() const { return queue_depth_; }
+            
+            /// @brief Retreives the number of reports that arrived.
+            ///
+            uint64_t getNumArrived() const { return n_arrived_; }
+            
+            /// @brief Retreives the number of reports that were polled by the host.
+            ///
+            uint64_t getNumDelivered() const { return n_delivered_; }
+            
+            /// @brief Retreives the number of bytes of all reports that
+            ///        were polled by the host.
+            ///
+            uint64_t getNumDeliveredBytes() const { return n_delivered_bytes_; }
+            
+            /// @brief Retreives the number of reports that were dropped.
+            ///
+            uint64_t getNumDropped() const { return n_dropped_; }
+            
+            /// @brief Retreives the number of reports that were replaced
+            ///        by a more recent one.
+            ///
+            uint64_t getNumMerged() const { return n_merged_; }
+         
+         private:
+            
+            void clearStatistics();
+         
+         private:
+            
+            Policy policy_ = DropNewest;
+            std::size_t capacity_ = 8;
+            
+            Queue queue_;
+            
+            Histogram queue_depth_;
+            uint64_t n_arrived_ = 0;
+            uint64_t n_delivered_ = 0;
+            uint64_t n_delivered_bytes_ = 0;
+            uint64_t n_dropped_ = 0;
+            uint64_t n_merged_ = 0;
+            
+            friend class HostPollingModel;
+      };
+      
+      /// @brief Enables or disables the model.
+      /// @details Reports that are still queued when the model is
+      ///        disabled are delivered with the next cycle.
+      ///
+      void setEnabled(bool state) { enabled_ = state; }
+      
+      bool isEnabled() const { return enabled_; }
+      
+      /// @brief Sets the poll interval [ms].
+      /// @details Full speed USB hosts poll at 1 ms, low speed hosts
+      ///        at up to 10 ms. Default: 1
+      ///
+      void setPollInterval(unsigned interval) { poll_interval_ = (interval > 0) ? interval : 1; }
+      
+      unsigned getPollInterval() const { return poll_interval_; }
+      
+      /// @brief Sets the policy of all endpoints.
+      ///
+      void setPolicy(Policy policy);
+      
+      /// @brief Sets the queue capacity of all endpoints.
+      ///
+      void setCapacity(std::size_t capacity);
+      
+      /// @brief Retreives the endpoint of a report type.
+      ///
+      /// @param type_id The report type id, e.g. KeyboardReportTypeId.
+      ///
+      Endpoint &endpoint(int type_id) { return endpoints_[type_id]; }
+      
+      const Endpoint &getEndpoint(int type_id) const { return endpoints_[type_id]; }
+      
+      /// @brief Checks if any reports wait to be polled.
+      ///
+      bool hasQueuedReports() const { return n_queued_ > 0; }
+      
+      /// @brief Queues a report.
+      ///
+      /// @param type_id The report type id.
+      /// @param report A copy of the report.
+      /// @param process The function that processes the report when polled.
+      ///
+      void add(int type_id, std::shared_ptr<const Report_> report,
+               ProcessFunction process);
+      
+      /// @brief Runs all polls that occur in a time span.
+      /// @details If the model is disabled, all queued reports
+      ///        are delivered.
+      ///
+      /// @param simulator The simulator that processes polled reports.
+      /// @param begin The start of the time span [ms].
+      /// @param end The end of the time span [ms], exclusive. If not
+      ///        greater than begin, a single poll takes place.
+      ///
+      void poll(Simulator &simulator, uint64_t begin, uint64_t end);
+      
+      /// @brief Retreives the number of reports polled by the host per second
+      ///        of simulator time, over all endpoints.
+      ///
+      double getReportsPerSecond() const;
+      
+      /// @brief Retreives the number of report bytes polled by the host
+      ///        per second of simulator time, over all endpoints.
+      ///
+      double getBytesPerSecond() const;
+      
+      /// @brief Copies the queues of all endpoints.
+      ///
+      void saveQueues(std::vector<Queue> &queues) const;
+      
+      /// @brief Restores queues that were saved by saveQueues(...).
+      ///
+      void restoreQueues(const std::vector<Queue> &queues);
+      
+      /// @brief Discards all queued reports.
+      ///
+      void clearQueues();
+      
+      /// @brief Discards all statistics.
+      ///
+      void clearStatistics();
+      
+      /// @brief Writes a summary to the simulator's log.
+      ///
+      void report(const Simulator &simulator) const;
+   
+   private:
+      
+      void deliver(Simulator &simulator, Endpoint &endpoint);
+   
+   private:
+      
+      bool enabled_ = false;
+      unsigned poll_interval_ = 1;
+      
+      Endpoint endpoints_[NumReportTypeIds];
+      std::size_t n_queued_ = 0;
+      
+      // The time span covered by polls since statistics were cleared.
+      //
+      bool polled_ = false;
+      uint64_t first_poll_time_ = 0;
+      uint64_t end_poll_time_ = 0;
+};
+
+} // namespace papilio
@@ -0,0 +1,249 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/InputJournal.h"
+#include "papilio/aux/little_endian.h"
+
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace papilio {
+   
+namespace {
+   
+const char journal_magic[8] = { 'P', 'A', 'P', 'J', 'R', 'N', 'A', 'L' };
+constexpr uint32_t journal_version = 1;
+constexpr size_t header_size = 16;
+
+// Type byte, two varints of at most 10 bytes and row/col.
+//
+constexpr size_t max_record_size = 1 + 2*10 + 2;
+
+// Unsigned LEB128. Consecutive records are mostly a few cycles
+// apart, so that deltas fit into a single byte.
+//
+size_t encodeVarint(uint8_t *buffer, uint64_t value)
+{
+   size_t n_bytes = 0;
+   do {
+      uint8_t byte = value & 0x7F;
+      value >>= 7;
+      if(value) { byte |= 0x80; }
+      buffer[n_bytes++] = byte;
+   } while(value);
+   return n_bytes;
+}
+
+bool hasKey(uint8_t type)
+{
+   return    (type == InputJournalRecord::PressKey)
+          || (type == InputJournalRecord::ReleaseKey)
+          || (type == InputJournalRecord::TapKey);
+}
+
+} // namespace
+
+bool InputJournalWriter::open(const std::string &filename,
+                              uint8_t rows, uint8_t cols,
+                              uint32_t cycle_duration,
+                              uint64_t start_cycle_id,
+                              uint64_t start_time)
+{
+   this->close();
+   
+   file_ = fopen(filename.c_str(), "wb");
+   if(!file_) { return false; }
+   
+   uint8_t header[header_size] = {};
+   memcpy(header, journal_magic, sizeof(journal_magic));
+   encodeLittleEndian(header + 8, journal_version, 2);
+   header[10] = rows;
+   header[11] = cols;
+   encodeLittleEndian(header + 12, cycle_duration, 4);
+   
+   if(fwrite(header, 1, header_size, file_) != header_size) {
+      this->close();
+      return false;
+   }
+   
+   fflush(file_);
+   
+   n_records_ = 0;
+   last_cycle_id_ = start_cycle_id;
+   last_time_ = start_time;
+   
+   return true;
+}
+
+bool InputJournalWriter::write(InputJournalRecord::Type type, 
+                               uint64_t cycle_id, uint64_t time,
+                               uint8_t row, uint8_t col)
+{
+   if(!file_) { return false; }
+   
+   if((cycle_id < last_cycle_id_) || (time < last_time_)) { return false; }
+   
+   uint8_t buffer[max_record_size];
+   
+   size_t n_bytes = 0;
+   buffer[n_bytes++] = uint8_t(type);
+   n_bytes += encodeVarint(buffer + n_bytes, cycle_id - last_cycle_id_);
+   n_bytes += encodeVarint(buffer + n_bytes, time - last_time_);
+   
+   if(hasKey(type)) {
+      buffer[n_bytes++] = row;
+      buffer[n_bytes++] = col;
+   }
+   
+   // Key events are rare compared to cycles. Flushing every record
+   // keeps the journal complete if the process is killed.
+   //
+   if(   (fwrite(buffer, 1, n_bytes, file_) != n_bytes)
+      || (fflush(file_) != 0)) {
+      return false;
+   }
+   
+   last_cycle_id_ = cycle_id;
+   last_time_ = time;
+   ++n_records_;
+   
+   return true;
+}
+
+void InputJournalWriter::close()
+{
+   if(file_) {
+      fclose(file_);
+      file_ = nullptr;
+   }
+}
+
+bool InputJournalReader::open(const std::string &filename)
+{
+   this->close();
+   
+   int fd = ::open(filename.c_str(), O_RDONLY);
+   if(fd < 0) { return false; }
+   
+   struct stat file_stat;
+   if((fstat(fd, &file_stat) != 0) || (size_t(file_stat.st_size) < header_size)) {
+      ::close(fd);
+      return false;
+   }
+   
+   size_t size = file_stat.st_size;
+   
+   void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   
+   // The mapping stays valid after the file descriptor is closed.
+   //
+   ::close(fd);
+   
+   if(data == MAP_FAILED) { return false; }
+   
+   madvise(data, size, MADV_SEQUENTIAL);
+   
+   data_ = static_cast<const uint8_t*>(data);
+   size_ = size;
+   
+   if(   (memcmp(data_, journal_magic, sizeof(journal_magic)) != 0)
+      || (decodeLittleEndian(data_ + 8, 2) != journal_version)) {
+      this->close();
+      return false;
+   }
+   
+   rows_ = data_[10];
+   cols_ = data_[11];
+   cycle_duration_ = uint32_t(decodeLittleEndian(data_ + 12, 4));
+   
+   pos_ = header_size;
+   
+   return true;
+}
+
+bool InputJournalReader::decodeVarint(uint64_t &value)
+{
+   value = 0;
+   for(int shift = 0; shift < 64; shift += 7) {
+      if(pos_ >= size_) { return false; }
+      uint8_t byte = data_[pos_++];
+      value |= uint64_t(byte & 0x7F) << shift;
+      if(!(byte & 0x80)) { return true; }
+   }
+   return false;
+}
+
+bool InputJournalReader::next(InputJournalRecord &record)
+{
+   if(!data_ || (pos_ >= size_)) { return false; }
+   
+   uint8_t type = data_[pos_++];
+   uint64_t cycle_delta = 0, time_delta = 0;
+   
+   bool valid =    (type <= InputJournalRecord::EndOfJournal)
+                && this->decodeVarint(cycle_delta)
+                && this->decodeVarint(time_delta)
+                && (!hasKey(type) || (pos_ + 2 <= size_));
+                
+   if(!valid) {
+      corrupt_ = true;
+      pos_ = size_;
+      return false;
+   }
+   
+   cycle_id_ += cycle_delta;
+   time_ += time_delta;
+   
+   record.type_ = type;
+   record.cycle_id_ = cycle_id_;
+   record.time_ = time_;
+   record.row_ = 0;
+   record.col_ = 0;
+   
+   if(hasKey(type)) {
+      record.row_ = data_[pos_];
+      record.col_ = data_[pos_ + 1];
+      pos_ += 2;
+   }
+   
+   ++n_records_;
+   
+   return true;
+}
+
+void InputJournalReader::close()
+{
+   if(data_) {
+      munmap(const_cast<uint8_t*>(data_), size_);
+      data_ = nullptr;
+   }
+   size_ = 0;
+   pos_ = 0;
+   n_records_ = 0;
+   corrupt_ = false;
+   rows_ = 0;
+   cols_ = 0;
+   cycle_duration_ = 0;
+   cycle_id_ = 0;
+   time_ = 0;
+}
+
+} // namespace papilio
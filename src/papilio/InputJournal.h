@@ -0,0 +1,206 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+
+namespace papilio {
+   
+/// @brief A single entry of an input journal.
+/// @details Cycle id and time are relative to the start of the recording.
+///        A key event with cycle id n was applied after n cycles had run,
+///        i.e. before the core loop of cycle n + 1.
+///
+struct InputJournalRecord {
+   
+   enum Type { 
+      PressKey = 0, 
+      ReleaseKey = 1, 
+      TapKey = 2, 
+      ReleaseAllKeys = 3, 
+      EndOfJournal = 4 
+   };
+   
+   uint8_t type_;
+   uint64_t cycle_id_;
+   uint64_t time_;
+   uint8_t row_;
+   uint8_t col_;
+};
+
+/// @brief Writes input journal files.
+/// @details An input journal file consists of a 16 byte header followed 
+///        by a sequence of variable length records. The header stores
+///        the key matrix dimensions and the cycle duration of the recording.
+///        Every record stores the record type (1 byte), the number of cycles 
+///        and the time elapsed since the previous record (variable length 
+///        integers, mostly 1 byte each) and, for events of a single key, 
+///        row and column (1 byte each). All integers are little endian.
+///
+///        Records are flushed as they are written, so that the journal of 
+///        a session that is killed remains usable.
+///
+class InputJournalWriter
+{
+   public:
+      
+      InputJournalWriter() = default;
+      InputJournalWriter(const InputJournalWriter &) = delete;
+      InputJournalWriter &operator=(const InputJournalWriter &) = delete;
+      
+      ~InputJournalWriter() { this->close(); }
+      
+      /// @brief Opens a journal file for writing.
+      /// @details An existing file is overwritten.
+      ///
+      /// @param filename The name of the journal file.
+      /// @param rows The number of key matrix rows.
+      /// @param cols The number of key matrix columns.
+      /// @param cycle_duration The cycle duration [ms].
+      /// @param start_cycle_id The cycle id at the start of the recording.
+      /// @param start_time The time at the start of the recording.
+      ///
+      /// @returns True if the file could be opened.
+      ///
+      bool open(const std::string &filename,
+                uint8_t rows, uint8_t cols,
+                uint32_t cycle_duration,
+                uint64_t start_cycle_id,
+                uint64_t start_time);
+      
+      /// @brief Appends a record to the journal.
+      ///
+      /// @param type The record type.
+      /// @param cycle_id The absolute cycle id.
+      /// @param time The absolute time.
+      /// @param row The key row (key events only).
+      /// @param col The key column (key events only).
+      ///
+      /// @returns False if writing failed or if cycle id or time are 
+      ///        before those of the previous record.
+      ///
+      bool write(InputJournalRecord::Type type, 
+                 uint64_t cycle_id, uint64_t time,
+                 uint8_t row = 0, uint8_t col = 0);
+      
+      /// @brief Closes the journal file.
+      /// @details No end record is written. Call write(...) with 
+      ///        InputJournalRecord::EndOfJournal before to record the
+      ///        duration of the recording.
+      ///
+      void close();
+      
+      bool isOpen() const { return file_ != nullptr; }
+      
+      /// @brief Retreives the number of records written.
+      ///
+      size_t getNumRecords() const { return n_records_; }
+      
+   private:
+      
+      FILE *file_ = nullptr;
+      size_t n_records_ = 0;
+      uint64_t last_cycle_id_ = 0;
+      uint64_t last_time_ = 0;
+};
+
+/// @brief Streams records from an input journal file.
+/// @details The file is memory mapped and read sequentially.
+///
+class InputJournalReader
+{
+   public:
+      
+      InputJournalReader() = default;
+      InputJournalReader(const InputJournalReader &) = delete;
+      InputJournalReader &operator=(const InputJournalReader &) = delete;
+      
+      ~InputJournalReader() { this->close(); }
+      
+      /// @brief Opens a journal file for reading.
+      ///
+      /// @param filename The name of the journal file.
+      ///
+      /// @returns True if the file could be opened and has a valid header.
+      ///
+      bool open(const std::string &filename);
+      
+      /// @brief Reads the next record.
+      ///
+      /// @param record The record to fill. Cycle id and time are
+      ///        relative to the start of the recording.
+      ///
+      /// @returns False if the end of the journal was reached or the
+      ///        next record is corrupt.
+      ///
+      bool next(InputJournalRecord &record);
+      
+      /// @brief Unmaps and closes the journal file.
+      ///
+      void close();
+      
+      bool isOpen() const { return data_ != nullptr; }
+      
+      /// @brief Checks if all records have been read.
+      ///
+      bool atEnd() const { return pos_ >= size_; }
+      
+      /// @brief Checks if a corrupt record was encountered.
+      ///
+      bool isCorrupt() const { return corrupt_; }
+      
+      /// @brief Retreives the number of records read so far.
+      ///
+      size_t getNumRecordsRead() const { return n_records_; }
+      
+      /// @brief Retreives the number of key matrix rows of the recording.
+      ///
+      uint8_t getRows() const { return rows_; }
+      
+      /// @brief Retreives the number of key matrix columns of the recording.
+      ///
+      uint8_t getCols() const { return cols_; }
+      
+      /// @brief Retreives the cycle duration [ms] of the recording.
+      ///
+      uint32_t getCycleDuration() const { return cycle_duration_; }
+      
+   private:
+      
+      bool decodeVarint(uint64_t &value);
+      
+   private:
+      
+      const uint8_t *data_ = nullptr;
+      size_t size_ = 0;
+      size_t pos_ = 0;
+      size_t n_records_ = 0;
+      bool corrupt_ = false;
+      
+      uint8_t rows_ = 0;
+      uint8_t cols_ = 0;
+      uint32_t cycle_duration_ = 0;
+      
+      uint64_t cycle_id_ = 0;
+      uint64_t time_ = 0;
+};
+
+} // namespace papilio
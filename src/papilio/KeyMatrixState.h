@@ -0,0 +1,233 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace papilio {
+   
+/// @brief The linear index of a key, row*cols + col.
+/// @details Wide enough to address every key of the largest 
+///        matrix that can be described by 8 bit rows and columns.
+///
+typedef uint16_t KeyOffset;
+
+/// @brief Computes the linear index of a key.
+///
+/// @param row The row index of the key.
+/// @param col The column index of the key.
+/// @param cols The number of matrix columns.
+///
+inline KeyOffset keyOffset(uint8_t row, uint8_t col, uint8_t cols) {
+   return KeyOffset(KeyOffset(row)*cols + col);
+}
+   
+/// @brief The state of all keys of a key matrix, stored as a packed bitset.
+/// @details Bit pos % 64 of word pos / 64 represents the key at
+///        pos = row*cols + col. Bits beyond the last key are always zero.
+///        Comparisons and change detection work on entire 64 bit words.
+///
+class KeyMatrixState {
+   
+   public:
+      
+      /// @brief Constructs an empty state of an empty matrix.
+      ///
+      KeyMatrixState() = default;
+      
+      /// @brief Constructs a state with all keys released.
+      ///
+      /// @param rows The number of matrix rows.
+      /// @param cols The number of matrix columns.
+      ///
+      KeyMatrixState(uint8_t rows, uint8_t cols) {
+         this->resize(rows, cols);
+      }
+      
+      /// @brief Changes the matrix dimensions and releases all keys.
+      /// @details Does not allocate if the number of words does not grow.
+      ///
+      /// @param rows The number of matrix rows.
+      /// @param cols The number of matrix columns.
+      ///
+      void resize(uint8_t rows, uint8_t cols) {
+         rows_ = rows;
+         cols_ = cols;
+         n_keys_ = KeyOffset(rows)*cols;
+         words_.assign((size_t(n_keys_) + 63)/64, 0);
+      }
+      
+      uint8_t getRows() const { return rows_; }
+      uint8_t getCols() const { return cols_; }
+      
+      /// @brief Retreives the number of keys, rows*cols.
+      ///
+      size_t getNumKeys() const { return n_keys_; }
+      
+      /// @brief Releases all keys.
+      ///
+      void clear() {
+         for(auto &word: words_) { word = 0; }
+      }
+      
+      /// @brief Presses all keys.
+      ///
+      void setAll() {
+         for(auto &word: words_) { word = ~uint64_t(0); }
+         if(!words_.empty()) {
+            this->maskLastWord();
+         }
+      }
+      
+      void set(KeyOffset key_offset) {
+         words_[key_offset >> 6] |= uint64_t(1) << (key_offset & 63);
+      }
+      
+      void reset(KeyOffset key_offset) {
+         words_[key_offset >> 6] &= ~(uint64_t(1) << (key_offset & 63));
+      }
+      
+      bool test(KeyOffset key_offset) const {
+         return (words_[key_offset >> 6] >> (key_offset & 63)) & 1;
+      }
+      
+      void set(uint8_t row, uint8_t col) { this->set(keyOffset(row, col, cols_)); }
+      void reset(uint8_t row, uint8_t col) { this->reset(keyOffset(row, col, cols_)); }
+      bool test(uint8_t row, uint8_t col) const { return this->test(keyOffset(row, col, cols_)); }
+      
+      /// @brief Checks if no key is pressed.
+      ///
+      bool none() const {
+         for(auto word: words_) {
+            if(word) { return false; }
+         }
+         return true;
+      }
+      
+      /// @brief Counts the keys pressed.
+      ///
+      size_t count() const {
+         size_t n = 0;
+         for(auto word: words_) {
+            n += __builtin_popcountll(word);
+         }
+         return n;
+      }
+      
+      /// @brief Retreives the number of bytes that represent the state,
+      ///        (rows*cols + 7)/8.
+      ///
+      size_t getNumBytes() const { return (size_t(n_keys_) + 7)/8; }
+      
+      /// @brief Assigns eight keys at once.
+      /// @details Bit n of the value represents the key at 8*byte_id + n.
+      ///        Bits beyond the last key are ignored.
+      ///
+      /// @param byte_id The byte index in the range [0, getNumBytes()).
+      /// @param value The key states.
+      ///
+      void setByte(size_t byte_id, uint8_t value) {
+         uint64_t &word = words_[byte_id/8];
+         int shift = int(8*(byte_id%8));
+         word = (word & ~(uint64_t(0xFF) << shift)) | (uint64_t(value) << shift);
+         if(byte_id/8 + 1 == words_.size()) {
+            this->maskLastWord();
+         }
+      }
+      
+      /// @brief Retreives the number of 64 bit words.
+      ///
+      size_t getNumWords() const { return words_.size(); }
+      
+      /// @brief Retreives one 64 bit word. Word w represents the 
+      ///        keys 64*w to 64*w + 63.
+      ///
+      uint64_t getWord(size_t w) const { return words_[w]; }
+      
+      /// @brief Sets one 64 bit word. Bits beyond the last key are ignored.
+      ///
+      void setWord(size_t w, uint64_t word) {
+         words_[w] = word;
+         if(w + 1 == words_.size()) {
+            this->maskLastWord();
+         }
+      }
+      
+      /// @brief Calls a function for every key pressed, in ascending order.
+      ///
+      /// @param f A function with signature void(KeyOffset).
+      ///
+      template<typename _Function>
+      void forEachSet(_Function f) const {
+         for(size_t w = 0; w < words_.size(); ++w) {
+            uint64_t word = words_[w];
+            while(word) {
+               int bit_id = __builtin_ctzll(word);
+               word &= word - 1;
+               f(KeyOffset(64*w + bit_id));
+            }
+         }
+      }
+      
+      /// @brief Calls a function for every key whose state differs from
+      ///        another state of a matrix of the same size, in ascending order.
+      ///
+      /// @param other The state to compare with.
+      /// @param f A function with signature void(KeyOffset, bool) that
+      ///        is passed the key and its state in this object.
+      ///
+      template<typename _Function>
+      void forEachDifference(const KeyMatrixState &other, _Function f) const {
+         for(size_t w = 0; w < words_.size(); ++w) {
+            uint64_t changed = words_[w] ^ other.words_[w];
+            while(changed) {
+               int bit_id = __builtin_ctzll(changed);
+               changed &= changed - 1;
+               f(KeyOffset(64*w + bit_id), bool((words_[w] >> bit_id) & 1));
+            }
+         }
+      }
+      
+      bool operator==(const KeyMatrixState &other) const {
+         return (n_keys_ == other.n_keys_) && (words_ == other.words_);
+      }
+      
+      bool operator!=(const KeyMatrixState &other) const {
+         return !(*this == other);
+      }
+      
+   private:
+      
+      void maskLastWord() {
+         const int n_used = n_keys_ % 64;
+         if(n_used != 0) {
+            words_.back() &= (uint64_t(1) << n_used) - 1;
+         }
+      }
+      
+   private:
+      
+      uint8_t rows_ = 0;
+      uint8_t cols_ = 0;
+      KeyOffset n_keys_ = 0;
+      std::vector<uint64_t> words_;
+};
+
+} // namespace papilio
@@ -0,0 +1,347 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/KeymapSweep.h"
+#include "papilio/Simulator.h"
+#include "papilio/SimulatorCore_.h"
+#include "papilio/KeyMatrixState.h"
+#include "papilio/actions/generic_report/CustomReportAction.h"
+#include "papilio/aux/WallTimer.h"
+
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstring>
+
+namespace papilio {
+   
+namespace {
+   
+// A simulator that is owned by a sweep worker.
+//
+class SweepSimulator : public Simulator
+{
+   public:
+      
+      SweepSimulator(std::ostream &out, const Simulator &parent)
+         :  Simulator(out, parent.getDebug(), parent.getCycleDuration(), false)
+      {}
+};
+
+// The status of a probe, the first byte of its serialized result.
+//
+enum {
+   ProbeRecorded = 'r',
+   ProbeSkipped = 's',
+   ProbeFailed = 'f'
+};
+
+void formatReport(std::ostream &out, const ReportData &data)
+{
+   out << getReportTypeString(data.type_id_);
+   
+   if(   (data.type_id_ == KeyboardReportTypeId) 
+      || (data.type_id_ == BootKeyboardReportTypeIdId)) {
+      
+      // Keycodes in ascending order, modifiers last.
+      //
+      static const char digits[] = "0123456789abcdef";
+      for(int keycode = 0; keycode < 256; ++keycode) {
+         if(data.bytes_[1 + keycode/8] & (1 << (keycode % 8))) {
+            out << ' ' << digits[keycode >> 4] << digits[keycode & 0xF];
+         }
+      }
+      for(int i = 0; i < 8; ++i) {
+         if(data.bytes_[0] & (1 << i)) {
+            out << " e" << digits[i];
+         }
+      }
+      return;
+   }
+   
+   ReportData stripped = data;
+   while((stripped.size_ > 0) && (stripped.bytes_[stripped.size_ - 1] == 0)) {
+      --stripped.size_;
+   }
+   if(stripped.size_ > 0) {
+      out << ' ' << stripped.toHexString();
+   }
+}
+
+} // namespace
+
+KeymapSweep::KeymapSweep(const CoreFactory &core_factory)
+   :  core_factory_(core_factory)
+{}
+
+KeymapSweep &KeymapSweep::addLayer(const char *name, 
+                                   const LayerActivation &activation)
+{
+   layers_.push_back(Layer{name, activation});
+   return *this;
+}
+
+void KeymapSweep::runProbes(const Simulator &parent, 
+                            std::size_t begin, std::size_t end,
+                            std::vector<std::string> &results) const
+{
+   std::ostream null_stream(nullptr);
+   
+   std::unique_ptr<Simulator> simulator_ptr 
+      = simulator_factory_ ? simulator_factory_(null_stream)
+                           : std::unique_ptr<Simulator>(new SweepSimulator(null_stream, parent));
+   
+   Simulator &simulator = *simulator_ptr;
+   simulator.setLogLevel(parent.getLogLevel());
+   simulator.setQuiet(true);
+   simulator.setTerminateOnFailure(false);
+   simulator.setCore(core_factory_());
+   simulator.init();
+   
+   if(setup_) {
+      setup_(simulator);
+   }
+   
+   // The recording action is added before the snapshots are taken.
+   // Thus, it survives every restore.
+   //
+   std::vector<ReportData> *reports = nullptr;
+   
+   simulator.permanentReportActions().add(
+      actions::CustomReportAction<Report_>{[&reports](const Report_ &report) {
+         if(reports && !report.isEmpty()) {
+            ReportData data;
+            report.getData(data);
+            reports->push_back(data);
+         }
+         return true;
+      }}
+   );
+   
+   const Simulator::Snapshot base = simulator.snapshot();
+   Simulator::Snapshot layer_snapshot;
+   KeyMatrixState held_keys;
+   std::size_t current_layer = layers_.size();
+   
+   const std::size_t n_keys = std::size_t(rows_)*cols_;
+   
+   std::vector<ReportData> probe_reports;
+   
+   for(std::size_t i = begin; i < end; ++i) {
+      
+      std::string &result = results[i - begin];
+      
+      std::size_t layer_id = i/n_keys;
+      KeyOffset key_offset = KeyOffset(i % n_keys);
+      
+      if(layer_id != current_layer) {
+         current_layer = layer_id;
+         simulator.restore(base);
+         if(layers_[layer_id].activation_) {
+            layers_[layer_id].activation_(simulator);
+         }
+         layer_snapshot = simulator.snapshot();
+         simulator.getCore().getKeyMatrixState(held_keys);
+      }
+      
+      if(held_keys.test(key_offset)) {
+         result.assign(1, char(ProbeSkipped));
+         continue;
+      }
+      
+      if(!layer_snapshot.hasCoreState() || !simulator.restore(layer_snapshot)) {
+         result.assign(1, char(ProbeFailed));
+         continue;
+      }
+      
+      uint8_t row = uint8_t(key_offset/cols_);
+      uint8_t col = uint8_t(key_offset % cols_);
+      
+      probe_reports.clear();
+      reports = &probe_reports;
+      
+      simulator.pressKey(row, col);
+      simulator.cycles(n_cycles_);
+      simulator.releaseKey(row, col);
+      simulator.cycles(n_cycles_);
+      
+      reports = nullptr;
+      
+      result.assign(1, char(ProbeRecorded));
+      result.append(reinterpret_cast<const char*>(probe_reports.data()), 
+                    probe_reports.size()*sizeof(ReportData));
+   }
+}
+
+bool KeymapSweep::run(Simulator &simulator)
+{
+   probes_.clear();
+   
+   if(layers_.empty()) {
+      this->addLayer("0");
+   }
+   
+   core_factory_()->getKeyMatrixDimensions(rows_, cols_);
+   
+   const std::size_t n_keys = std::size_t(rows_)*cols_;
+   const std::size_t n_items = layers_.size()*n_keys;
+   
+   int n_workers = WorkerPool::getNumWorkers(n_workers_, n_items);
+   
+   WallTimer timer;
+   timer.start();
+   
+   // Make sure that buffered output is not duplicated by 
+   // worker processes.
+   //
+   simulator.flush();
+   
+   std::vector<std::string> results;
+   std::vector<bool> valid;
+   
+   WorkerPool::run(worker_type_, n_workers, n_items,
+      [this, &simulator](std::size_t begin, std::size_t end, 
+                         std::vector<std::string> &share) {
+         this->runProbes(simulator, begin, end, share);
+      },
+      results, valid);
+   
+   int n_failed = 0;
+   
+   for(std::size_t i = 0; i < n_items; ++i) {
+      
+      const std::string &result = results[i];
+      
+      if(   !valid[i] || result.empty() || (result[0] == ProbeFailed)
+         || ((result.size() - 1) % sizeof(ReportData) != 0)) {
+         ++n_failed;
+         continue;
+      }
+      
+      if(result[0] == ProbeSkipped) { continue; }
+      
+      Probe probe;
+      probe.layer_id_ = i/n_keys;
+      probe.row_ = uint8_t((i % n_keys)/cols_);
+      probe.col_ = uint8_t((i % n_keys) % cols_);
+      probe.reports_.resize((result.size() - 1)/sizeof(ReportData));
+      if(!probe.reports_.empty()) {
+         std::memcpy(probe.reports_.data(), result.data() + 1, result.size() - 1);
+      }
+      
+      probes_.push_back(std::move(probe));
+   }
+   
+   simulator.log() << "Keymap sweep: " << probes_.size() << " probes on " 
+      << layers_.size() << " layers with " << n_workers << " workers in "
+      << timer.elapsed() << " ms";
+      
+   if(n_failed != 0) {
+      simulator.error() << n_failed << " keymap probes failed. Does the core "
+         "support saving its state?";
+   }
+   
+   return n_failed == 0;
+}
+
+std::string KeymapSweep::formatProbe(const Probe &probe) const
+{
+   std::ostringstream out;
+   
+   out << layers_[probe.layer_id_].name_ << ' ' << int(probe.row_) 
+      << ' ' << int(probe.col_) << ' ';
+   
+   if(probe.reports_.empty()) {
+      out << '-';
+   }
+   
+   for(std::size_t i = 0; i < probe.reports_.size(); ++i) {
+      if(i > 0) { out << " | "; }
+      formatReport(out, probe.reports_[i]);
+   }
+   
+   return out.str();
+}
+
+bool KeymapSweep::write(const std::string &filename) const
+{
+   std::ofstream out(filename, std::ios::trunc);
+   
+   for(const auto &probe: probes_) {
+      out << this->formatProbe(probe) << "\n";
+   }
+   
+   return (bool)out;
+}
+
+int KeymapSweep::compare(Simulator &simulator, const std::string &filename) const
+{
+   std::ifstream in(filename);
+   if(!in) {
+      simulator.error() << "Unable to read golden keymap " << filename;
+      return 1;
+   }
+   
+   // Lines are keyed by layer name, row and col.
+   //
+   auto keyOf = [](const std::string &line) -> std::string {
+      std::size_t pos = 0;
+      for(int field = 0; (field < 3) && (pos != std::string::npos); ++field) {
+         pos = line.find(' ', pos + 1);
+      }
+      return line.substr(0, pos);
+   };
+   
+   std::map<std::string, std::string> golden;
+   std::string line;
+   while(std::getline(in, line)) {
+      if(!line.empty()) {
+         golden[keyOf(line)] = line;
+      }
+   }
+   
+   int n_differences = 0;
+   
+   for(const auto &probe: probes_) {
+      
+      std::string actual = this->formatProbe(probe);
+      auto it = golden.find(keyOf(actual));
+      
+      if(it == golden.end()) {
+         simulator.error() << "Keymap probe not in golden keymap: " << actual;
+         ++n_differences;
+         continue;
+      }
+      
+      if(it->second != actual) {
+         simulator.error() << "Keymap probe differs: expected \"" << it->second 
+            << "\", encountered \"" << actual << "\"";
+         ++n_differences;
+      }
+      
+      golden.erase(it);
+   }
+   
+   for(const auto &entry: golden) {
+      simulator.error() << "Golden keymap probe missing: " << entry.second;
+      ++n_differences;
+   }
+   
+   return n_differences;
+}
+
+} // namespace papilio
@@ -0,0 +1,187 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/reports/ReportData.h"
+#include "papilio/aux/WorkerPool.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace papilio {
+   
+class Simulator;
+class SimulatorCore_;
+
+/// @brief Determines the reports that every key generates on every layer.
+/// @details For every layer, the sweep activates the layer once, takes
+///        a snapshot and then probes all keys of the matrix. A probe
+///        restores the snapshot, taps the key and records all non-empty 
+///        reports. Keys that are held by the layer activation are not probed.
+///
+///        Probes are distributed over a number of workers, each with its
+///        own simulator and a fresh core that is created by a factory
+///        function. Cores must support saving their state 
+///        (see SimulatorCore_::saveState(...)).
+///
+///        The resulting table can be written to a file and compared 
+///        to a golden table, e.g. one that was written by a previous run.
+///        Every line of the file represents one probe:
+///
+///           <layer> <row> <col> <report> | <report> ...
+///
+///        with every report represented by its type followed by its
+///        active keycodes (keyboard reports) or data bytes without 
+///        trailing zeros (all other reports). Keys that generate no
+///        reports are represented by a "-". 
+///
+class KeymapSweep
+{
+   public:
+      
+      typedef std::function<std::shared_ptr<SimulatorCore_>()> CoreFactory;
+      
+      /// @brief A function that creates a simulator writing to a given stream.
+      /// @details Cores pass their reports to simulators of a specific
+      ///        type, e.g. a simulator class of the firmware's integration.
+      ///
+      typedef std::function<std::unique_ptr<Simulator>(std::ostream &out)> SimulatorFactory;
+      
+      /// @brief A function that activates a layer, e.g. by pressing
+      ///        and holding a layer key.
+      ///
+      typedef std::function<void(Simulator &)> LayerActivation;
+      
+      /// @brief The result of probing a key on a layer.
+      ///
+      struct Probe {
+         std::size_t layer_id_ = 0;
+         uint8_t row_ = 0;
+         uint8_t col_ = 0;
+         std::vector<ReportData> reports_;
+      };
+      
+      /// @brief Constructor.
+      /// @param core_factory A function that creates a new simulator core 
+      ///        for every worker.
+      ///
+      KeymapSweep(const CoreFactory &core_factory);
+      
+      /// @brief Registers a layer to sweep.
+      /// @details If no layers are registered, a single layer "0" is
+      ///        swept without activation.
+      ///
+      /// @param name The name of the layer. It must not contain whitespace.
+      /// @param activation A function that activates the layer, starting 
+      ///        from the state after initialization. No activation is
+      ///        required for the default layer.
+      ///
+      KeymapSweep &addLayer(const char *name, 
+                            const LayerActivation &activation = LayerActivation());
+      
+      /// @brief Sets the function that creates worker simulators.
+      /// @details By default, plain simulators are created that are 
+      ///        configured like the parent simulator.
+      ///
+      void setSimulatorFactory(const SimulatorFactory &simulator_factory) {
+         simulator_factory_ = simulator_factory;
+      }
+      
+      /// @brief Registers a function that is run on every worker simulator
+      ///        after the core was initialized.
+      ///
+      void setSetup(const std::function<void(Simulator &)> &setup) { setup_ = setup; }
+      
+      /// @brief Sets the number of cycles that are run after pressing
+      ///        and after releasing the probed key.
+      ///
+      void setNumCyclesPerProbe(int n_cycles) { n_cycles_ = n_cycles; }
+      
+      /// @brief Sets the number of workers.
+      /// @param n_workers The number of workers. If zero, one
+      ///        worker per hardware thread is used.
+      ///
+      void setNumWorkers(int n_workers) { n_workers_ = n_workers; }
+      
+      /// @brief Selects the type of workers.
+      /// @details Use thread workers only if cores do not share any global state.
+      ///
+      void setWorkerType(WorkerPool::WorkerType worker_type) { worker_type_ = worker_type; }
+      
+      /// @brief Probes all keys on all layers.
+      /// @details Worker simulators are configured like the given simulator.
+      ///        Errors are registered with it.
+      ///
+      /// @param simulator The parent simulator.
+      /// @returns True if all probes succeeded.
+      ///
+      bool run(Simulator &simulator);
+      
+      /// @brief Retreives the probes of the most recent run.
+      ///
+      const std::vector<Probe> &getProbes() const { return probes_; }
+      
+      /// @brief Generates the textual representation of a probe.
+      ///
+      std::string formatProbe(const Probe &probe) const;
+      
+      /// @brief Writes the table of the most recent run to a file.
+      /// @returns True if the file was written.
+      ///
+      bool write(const std::string &filename) const;
+      
+      /// @brief Compares the table of the most recent run to a golden table.
+      /// @details Every difference is registered as an error with the simulator.
+      ///
+      /// @param simulator The simulator that reports differences.
+      /// @param filename The name of the golden table file.
+      /// @returns The number of differences. 
+      ///
+      int compare(Simulator &simulator, const std::string &filename) const;
+      
+   private:
+      
+      struct Layer {
+         std::string name_;
+         LayerActivation activation_;
+      };
+      
+      void runProbes(const Simulator &parent, 
+                     std::size_t begin, std::size_t end,
+                     std::vector<std::string> &results) const;
+      
+   private:
+      
+      CoreFactory core_factory_;
+      SimulatorFactory simulator_factory_;
+      std::function<void(Simulator &)> setup_;
+      std::vector<Layer> layers_;
+      std::vector<Probe> probes_;
+      
+      uint8_t rows_ = 0;
+      uint8_t cols_ = 0;
+      
+      int n_cycles_ = 1;
+      int n_workers_ = 0;
+      WorkerPool::WorkerType worker_type_ = WorkerPool::ProcessWorkers;
+};
+
+} // namespace papilio
@@ -0,0 +1,303 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/LEDRecording.h"
+#include "papilio/aux/little_endian.h"
+
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace papilio {
+   
+namespace {
+   
+const char recording_magic[8] = { 'P', 'A', 'P', 'L', 'E', 'D', 'R', 'C' };
+constexpr uint32_t recording_version = 1;
+constexpr size_t header_size = 16;
+constexpr size_t frame_header_size = 13;
+constexpr size_t delta_entry_size = 5;
+
+enum FrameKind : uint8_t { KeyframeKind = 0, DeltaFrameKind = 1 };
+
+} // namespace
+
+bool LEDRecordingWriter::open(const std::string &filename, 
+                              KeyOffset n_keys,
+                              unsigned keyframe_interval)
+{
+   this->close();
+   
+   file_ = fopen(filename.c_str(), "wb");
+   if(!file_) { return false; }
+   
+   setvbuf(file_, nullptr, _IOFBF, 1 << 16);
+   
+   n_keys_ = n_keys;
+   keyframe_interval_ = (keyframe_interval == 0) ? 1 
+                      : ((keyframe_interval > 0xFFFF) ? 0xFFFF : keyframe_interval);
+   n_frames_ = 0;
+   previous_.assign(3*size_t(n_keys), 0);
+   buffer_.reserve(frame_header_size + 3*size_t(n_keys));
+   
+   uint8_t header[header_size] = {};
+   memcpy(header, recording_magic, sizeof(recording_magic));
+   encodeLittleEndian(header + 8, recording_version, 4);
+   encodeLittleEndian(header + 12, n_keys_, 2);
+   encodeLittleEndian(header + 14, keyframe_interval_, 2);
+   
+   if(fwrite(header, 1, header_size, file_) != header_size) {
+      this->close();
+      return false;
+   }
+   
+   return true;
+}
+
+bool LEDRecordingWriter::write(uint32_t cycle_id, uint64_t time, const uint8_t *colors)
+{
+   if(!file_) { return false; }
+   
+   const size_t n_color_bytes = 3*size_t(n_keys_);
+   
+   size_t n_changed = 0;
+   
+   if(n_frames_ > 0) {
+      
+      if(memcmp(colors, previous_.data(), n_color_bytes) == 0) {
+         return true;
+      }
+      
+      for(size_t i = 0; i < n_color_bytes; i += 3) {
+         if(memcmp(colors + i, previous_.data() + i, 3) != 0) {
+            ++n_changed;
+         }
+      }
+   }
+   
+   const bool keyframe 
+      =     (n_frames_ % keyframe_interval_ == 0)
+         || (2 + delta_entry_size*n_changed >= n_color_bytes);
+      
+   buffer_.resize(frame_header_size);
+   encodeLittleEndian(&buffer_[0], cycle_id, 4);
+   encodeLittleEndian(&buffer_[4], time, 8);
+   buffer_[12] = keyframe ? KeyframeKind : DeltaFrameKind;
+   
+   if(keyframe) {
+      buffer_.insert(buffer_.end(), colors, colors + n_color_bytes);
+   }
+   else {
+      uint8_t entry[delta_entry_size];
+      encodeLittleEndian(entry, n_changed, 2);
+      buffer_.insert(buffer_.end(), entry, entry + 2);
+      
+      for(size_t i = 0; i < n_color_bytes; i += 3) {
+         if(memcmp(colors + i, previous_.data() + i, 3) != 0) {
+            encodeLittleEndian(entry, i/3, 2);
+            memcpy(entry + 2, colors + i, 3);
+            buffer_.insert(buffer_.end(), entry, entry + delta_entry_size);
+         }
+      }
+   }
+   
+   if(fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+      return false;
+   }
+   
+   memcpy(previous_.data(), colors, n_color_bytes);
+   ++n_frames_;
+   
+   return true;
+}
+
+void LEDRecordingWriter::close()
+{
+   if(file_) {
+      fclose(file_);
+      file_ = nullptr;
+   }
+}
+
+bool LEDRecordingReader::open(const std::string &filename)
+{
+   this->close();
+   
+   int fd = ::open(filename.c_str(), O_RDONLY);
+   if(fd < 0) { return false; }
+   
+   struct stat file_stat;
+   if((fstat(fd, &file_stat) != 0) || (size_t(file_stat.st_size) < header_size)) {
+      ::close(fd);
+      return false;
+   }
+   
+   size_t size = file_stat.st_size;
+   
+   void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   
+   // The mapping stays valid after the file descriptor is closed.
+   //
+   ::close(fd);
+   
+   if(data == MAP_FAILED) { return false; }
+   
+   data_ = static_cast<const uint8_t*>(data);
+   size_ = size;
+   
+   if(   (memcmp(data_, recording_magic, sizeof(recording_magic)) != 0)
+      || (decodeLittleEndian(data_ + 8, 4) != recording_version)) {
+      this->close();
+      return false;
+   }
+   
+   n_keys_ = KeyOffset(decodeLittleEndian(data_ + 12, 2));
+   
+   const size_t n_color_bytes = 3*size_t(n_keys_);
+   
+   // Index the keyframes. Only frame headers are inspected.
+   //
+   size_t pos = header_size;
+   while(pos < size_) {
+      
+      const size_t n_left = size_ - pos;
+      
+      if(n_left < frame_header_size) { break; }
+      
+      const uint8_t kind = data_[pos + 12];
+      size_t frame_size = frame_header_size;
+      
+      if(kind == KeyframeKind) {
+         frame_size += n_color_bytes;
+      }
+      else if((kind == DeltaFrameKind) && (n_frames_ > 0) && (n_left >= frame_header_size + 2)) {
+         frame_size += 2 + delta_entry_size*decodeLittleEndian(data_ + pos + frame_header_size, 2);
+      }
+      else {
+         break;
+      }
+      
+      if(n_left < frame_size) { break; }
+      
+      if(kind == KeyframeKind) {
+         keyframes_.push_back(Keyframe{uint32_t(decodeLittleEndian(data_ + pos, 4)), pos});
+      }
+      
+      pos += frame_size;
+      ++n_frames_;
+   }
+   
+   corrupt_ = (pos != size_);
+   end_ = pos;
+   pos_ = header_size;
+   colors_.assign(n_color_bytes, 0);
+   
+   madvise(data, size, MADV_SEQUENTIAL);
+   
+   return true;
+}
+
+void LEDRecordingReader::close()
+{
+   if(data_) {
+      munmap(const_cast<uint8_t*>(data_), size_);
+      data_ = nullptr;
+   }
+   size_ = 0;
+   end_ = 0;
+   pos_ = 0;
+   corrupt_ = false;
+   n_keys_ = 0;
+   n_frames_ = 0;
+   keyframes_.clear();
+   has_frame_ = false;
+   colors_.clear();
+}
+
+uint32_t LEDRecordingReader::getNextCycleId() const
+{
+   return uint32_t(decodeLittleEndian(data_ + pos_, 4));
+}
+
+bool LEDRecordingReader::next()
+{
+   if(!data_ || (pos_ >= end_)) { return false; }
+   
+   // Frames were validated when the file was opened.
+   //
+   const uint8_t *frame = data_ + pos_;
+   
+   cycle_id_ = uint32_t(decodeLittleEndian(frame, 4));
+   time_ = decodeLittleEndian(frame + 4, 8);
+   
+   const uint8_t *payload = frame + frame_header_size;
+   
+   if(frame[12] == KeyframeKind) {
+      memcpy(colors_.data(), payload, colors_.size());
+      pos_ += frame_header_size + colors_.size();
+   }
+   else {
+      const size_t n_changed = decodeLittleEndian(payload, 2);
+      const uint8_t *entry = payload + 2;
+      for(size_t i = 0; i < n_changed; ++i, entry += delta_entry_size) {
+         const size_t key_offset = decodeLittleEndian(entry, 2);
+         if(key_offset < n_keys_) {
+            memcpy(&colors_[3*key_offset], entry + 2, 3);
+         }
+      }
+      pos_ += frame_header_size + 2 + delta_entry_size*n_changed;
+   }
+   
+   has_frame_ = true;
+   
+   return true;
+}
+
+bool LEDRecordingReader::seek(uint32_t cycle_id)
+{
+   // Find the last keyframe at or before the cycle.
+   //
+   size_t lower = 0, upper = keyframes_.size();
+   while(lower < upper) {
+      size_t middle = (lower + upper)/2;
+      if(keyframes_[middle].cycle_id_ <= cycle_id) {
+         lower = middle + 1;
+      }
+      else {
+         upper = middle;
+      }
+   }
+   
+   if(lower == 0) {
+      has_frame_ = false;
+      return false;
+   }
+   
+   pos_ = keyframes_[lower - 1].pos_;
+   this->next();
+   
+   while(!this->atEnd() && (this->getNextCycleId() <= cycle_id)) {
+      this->next();
+   }
+   
+   return true;
+}
+
+} // namespace papilio
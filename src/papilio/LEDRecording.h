@@ -0,0 +1,201 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/KeyMatrixState.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace papilio {
+   
+/// @brief Writes LED recording files.
+/// @details An LED recording file consists of a 16 byte header, storing
+///        the number of key LEDs, followed by a sequence of frames. 
+///        Frames are only written if the LED colors changed since the 
+///        previous frame. Every frame stores cycle id (4 bytes),
+///        time (8 bytes) and a kind (1 byte). 
+///        A keyframe stores the colors of all key LEDs (3 bytes each). 
+///        A delta frame stores the number of changed keys (2 bytes) followed
+///        by key offset (2 bytes) and color (3 bytes) of every changed key. 
+///        All integers are little endian.
+///
+class LEDRecordingWriter
+{
+   public:
+      
+      LEDRecordingWriter() = default;
+      LEDRecordingWriter(const LEDRecordingWriter &) = delete;
+      LEDRecordingWriter &operator=(const LEDRecordingWriter &) = delete;
+      
+      ~LEDRecordingWriter() { this->close(); }
+      
+      /// @brief Opens a recording file for writing.
+      /// @details An existing file is overwritten.
+      ///
+      /// @param filename The name of the recording file.
+      /// @param n_keys The number of key LEDs per frame.
+      /// @param keyframe_interval Every nth frame written is a keyframe.
+      ///        This bounds the work of seeking.
+      ///
+      /// @returns True if the file could be opened.
+      ///
+      bool open(const std::string &filename, 
+                KeyOffset n_keys,
+                unsigned keyframe_interval = 64);
+      
+      /// @brief Appends a frame if the LED colors changed.
+      ///
+      /// @param cycle_id The cycle id of the frame.
+      /// @param time The time of the frame.
+      /// @param colors The red, green and blue values of all key LEDs.
+      ///
+      /// @returns False if writing failed.
+      ///
+      bool write(uint32_t cycle_id, uint64_t time, const uint8_t *colors);
+      
+      /// @brief Flushes and closes the recording file.
+      ///
+      void close();
+      
+      bool isOpen() const { return file_ != nullptr; }
+      
+      /// @brief Retreives the number of frames written.
+      ///
+      size_t getNumFrames() const { return n_frames_; }
+      
+   private:
+      
+      FILE *file_ = nullptr;
+      KeyOffset n_keys_ = 0;
+      unsigned keyframe_interval_ = 64;
+      size_t n_frames_ = 0;
+      std::vector<uint8_t> previous_;
+      std::vector<uint8_t> buffer_;
+};
+
+/// @brief Reads LED recording files.
+/// @details The file is memory mapped. Frames are decoded 
+///        one at a time, starting from the last keyframe when seeking.
+///
+class LEDRecordingReader
+{
+   public:
+      
+      LEDRecordingReader() = default;
+      LEDRecordingReader(const LEDRecordingReader &) = delete;
+      LEDRecordingReader &operator=(const LEDRecordingReader &) = delete;
+      
+      ~LEDRecordingReader() { this->close(); }
+      
+      /// @brief Opens a recording file for reading.
+      /// @details The frame headers are scanned once to index the keyframes.
+      ///        Frames that follow a corrupt frame are ignored.
+      ///
+      /// @param filename The name of the recording file.
+      ///
+      /// @returns True if the file could be opened and has a valid header.
+      ///
+      bool open(const std::string &filename);
+      
+      /// @brief Unmaps and closes the recording file.
+      ///
+      void close();
+      
+      bool isOpen() const { return data_ != nullptr; }
+      
+      /// @brief Checks if a corrupt frame was encountered.
+      ///
+      bool isCorrupt() const { return corrupt_; }
+      
+      /// @brief Retreives the number of key LEDs per frame.
+      ///
+      KeyOffset getNumKeys() const { return n_keys_; }
+      
+      /// @brief Retreives the overall number of frames.
+      ///
+      size_t getNumFrames() const { return n_frames_; }
+      
+      /// @brief Decodes the next frame.
+      ///
+      /// @returns False if there are no more frames.
+      ///
+      bool next();
+      
+      /// @brief Checks if there are no more frames.
+      ///
+      bool atEnd() const { return pos_ >= end_; }
+      
+      /// @brief Retreives the cycle id of the next frame.
+      /// @details Must only be called if not atEnd().
+      ///
+      uint32_t getNextCycleId() const;
+      
+      /// @brief Decodes the frame that represents the LED state at a given cycle, 
+      ///        i.e. the last frame recorded at or before the cycle.
+      ///
+      /// @param cycle_id The cycle id.
+      ///
+      /// @returns False if the recording starts after the cycle.
+      ///
+      bool seek(uint32_t cycle_id);
+      
+      /// @brief Checks if a frame has been decoded.
+      ///
+      bool hasFrame() const { return has_frame_; }
+      
+      /// @brief Retreives the cycle id of the current frame.
+      ///
+      uint32_t getCycleId() const { return cycle_id_; }
+      
+      /// @brief Retreives the time of the current frame.
+      ///
+      uint64_t getTime() const { return time_; }
+      
+      /// @brief Retreives the colors of the current frame, three bytes
+      ///        (red, green, blue) per key LED.
+      ///
+      const uint8_t *getColors() const { return colors_.data(); }
+      
+   private:
+      
+      struct Keyframe {
+         uint32_t cycle_id_;
+         size_t pos_;
+      };
+      
+      const uint8_t *data_ = nullptr;
+      size_t size_ = 0;
+      size_t end_ = 0;
+      size_t pos_ = 0;
+      bool corrupt_ = false;
+      
+      KeyOffset n_keys_ = 0;
+      size_t n_frames_ = 0;
+      std::vector<Keyframe> keyframes_;
+      
+      bool has_frame_ = false;
+      uint32_t cycle_id_ = 0;
+      uint64_t time_ = 0;
+      std::vector<uint8_t> colors_;
+};
+
+} // namespace papilio
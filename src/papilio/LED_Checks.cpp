@@ -20,76 +20,187 @@
 #include "papilio/SimulatorCore_.h"
 
 #include <iostream>
+#include <vector>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace papilio {
    
-void dumpKeyLEDState(const Simulator &simulator) {
+void LEDFrameDiff::reset(KeyOffset n_keys)
+{
+   n_keys_ = n_keys;
+   n_mismatches_ = 0;
+   mismatch_bitmap_.assign((size_t(n_keys) + 63)/64, 0);
+   mismatches_.clear();
+}
+
+void LEDFrameDiff::addMismatch(KeyOffset key_offset, 
+                               const uint8_t *expected, 
+                               const uint8_t *actual)
+{
+   uint64_t &word = mismatch_bitmap_[key_offset >> 6];
+   const uint64_t bit = uint64_t(1) << (key_offset & 63);
    
-   std::cout << "const uint8_t key_led_colors[][3] = {\n";
+   if(word & bit) { return; }
    
-   const auto &simulator_core = simulator.getCore();
+   word |= bit;
+   ++n_mismatches_;
    
+   if(mismatches_.size() < max_mismatches_) {
+      mismatches_.push_back(Mismatch{key_offset, 
+         {expected[0], expected[1], expected[2]},
+         {actual[0], actual[1], actual[2]}});
+   }
+}
+
+namespace {
+   
+inline void addMismatchingByte(const uint8_t *expected, 
+                               const uint8_t *actual,
+                               size_t byte_id,
+                               LEDFrameDiff &diff)
+{
+   const size_t key_start = byte_id - byte_id%3;
+   diff.addMismatch(KeyOffset(byte_id/3), expected + key_start, actual + key_start);
+}
+
+// Retreives the colors of all key LEDs, three bytes per key.
+//
+KeyOffset getKeyLEDColors(const SimulatorCore_ &simulator_core,
+                          std::vector<uint8_t> &colors)
+{
    uint8_t rows = 0, cols = 0;
    simulator_core.getKeyMatrixDimensions(rows, cols);
    
-   for(uint8_t row = 0; row < rows; ++row) {
-      for(uint8_t col = 0; col < cols; ++col) {
-         
-         uint8_t red = 0, green = 0, blue = 0;
-         
-         uint8_t key_offset = row*cols + col;
-         
-         simulator_core.getCurrentKeyLEDColor(key_offset, 
-                               red, green, blue);
-         
-         std::cout << "   {" << (int)red << ", " 
-                             << (int)green << ", " 
-                             << (int)blue << "},\n";
+   const KeyOffset n_keys = KeyOffset(rows*cols);
+   
+   colors.resize(3*size_t(n_keys));
+   if(n_keys > 0) {
+      simulator_core.getCurrentKeyLEDColors(&colors[0], n_keys);
+   }
+   
+   return n_keys;
+}
+
+} // anonymous namespace
+
+bool compareLEDFrames(const uint8_t *expected, 
+                      const uint8_t *actual,
+                      KeyOffset n_keys,
+                      LEDFrameDiff &diff,
+                      uint8_t tolerance)
+{
+   diff.reset(n_keys);
+   
+   const size_t n_bytes = 3*size_t(n_keys);
+   
+   if((tolerance == 0) && (memcmp(expected, actual, n_bytes) == 0)) {
+      return true;
+   }
+   
+   size_t byte_id = 0;
+   
+#ifdef __SSE2__
+   const __m128i max_difference = _mm_set1_epi8(char(tolerance));
+   const __m128i zero = _mm_setzero_si128();
+   
+   for(; byte_id + 16 <= n_bytes; byte_id += 16) {
+      
+      const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(expected + byte_id));
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(actual + byte_id));
+      
+      // The absolute difference of unsigned bytes, and the part of
+      // it that exceeds the tolerance.
+      //
+      const __m128i difference = _mm_or_si128(_mm_subs_epu8(e, a), _mm_subs_epu8(a, e));
+      const __m128i excess = _mm_subs_epu8(difference, max_difference);
+      
+      unsigned mismatching = ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(excess, zero))) & 0xFFFF;
+      
+      while(mismatching) {
+         const int bit_id = __builtin_ctz(mismatching);
+         mismatching &= mismatching - 1;
+         addMismatchingByte(expected, actual, byte_id + bit_id, diff);
       }
    }
+#endif
+
+   for(; byte_id < n_bytes; ++byte_id) {
+      const int difference = int(expected[byte_id]) - int(actual[byte_id]);
+      if((difference > tolerance) || (-difference > tolerance)) {
+         addMismatchingByte(expected, actual, byte_id, diff);
+      }
+   }
+   
+   return diff.empty();
+}
+   
+void dumpKeyLEDState(const Simulator &simulator) {
+   
+   std::vector<uint8_t> colors;
+   getKeyLEDColors(simulator.getCore(), colors);
+   
+   std::cout << "const uint8_t key_led_colors[][3] = {\n";
+   
+   for(std::size_t i = 0; i < colors.size(); i += 3) {
+      std::cout << "   {" << (int)colors[i] << ", " 
+                          << (int)colors[i + 1] << ", " 
+                          << (int)colors[i + 2] << "},\n";
+   }
    
    std::cout << "};\n\n";
 }
 
+bool diffKeyLEDState(const Simulator &simulator,
+                     const uint8_t key_led_colors[][3],
+                     LEDFrameDiff &diff,
+                     uint8_t tolerance)
+{
+   // LED states are typically checked in every cycle.
+   //
+   static thread_local std::vector<uint8_t> colors;
+   
+   const KeyOffset n_keys = getKeyLEDColors(simulator.getCore(), colors);
+   
+   if(n_keys == 0) {
+      diff.reset(0);
+      return true;
+   }
+   
+   return compareLEDFrames(&key_led_colors[0][0], &colors[0], n_keys, 
+                           diff, tolerance);
+}
+
 void assertKeyLEDState(const Simulator &simulator,
-                       const uint8_t key_led_colors[][3])
+                       const uint8_t key_led_colors[][3],
+                       uint8_t tolerance)
 {
-   const auto &simulator_core = simulator.getCore();
+   static thread_local LEDFrameDiff diff;
    
-   uint8_t num_leds = simulator_core.getNumLEDs();
+   if(diffKeyLEDState(simulator, key_led_colors, diff, tolerance)) {
+      return;
+   }
    
-   uint8_t rows = 0, cols = 0;
-   simulator_core.getKeyMatrixDimensions(rows, cols);
+   simulator.error() << "LED color mismatch at " << diff.getNumMismatches()
+      << " of " << diff.getNumKeys() << " key LEDs";
+      
+   for(const auto &mismatch: diff.getMismatches()) {
+      simulator.log() << "   key LED " << (int)mismatch.key_offset_ 
+         << ": expected (" << (int)mismatch.expected_[0] << ", " 
+                           << (int)mismatch.expected_[1] << ", " 
+                           << (int)mismatch.expected_[2] << ")"
+         << ", actual (" << (int)mismatch.actual_[0] << ", " 
+                         << (int)mismatch.actual_[1] << ", " 
+                         << (int)mismatch.actual_[2] << ")";
+   }
    
-   for(uint8_t row = 0; row < rows; ++row) {
-      for(uint8_t col = 0; col < cols; ++col) {
-         
-         uint8_t key_offset = row*cols + col;
-         
-         const uint8_t &red_expected = key_led_colors[key_offset][0];
-         const uint8_t &green_expected = key_led_colors[key_offset][1];
-         const uint8_t &blue_expected = key_led_colors[key_offset][2];
-         
-         uint8_t red_actual = 0, green_actual = 0, blue_actual = 0;
-         
-         simulator_core.getCurrentKeyLEDColor(key_offset, 
-                                 red_actual, green_actual, blue_actual);
-         
-         if(   (red_expected != red_actual)
-            || (green_expected != green_actual)
-            || (blue_expected != blue_actual)) {
-            
-            simulator.error() << "LED color mismatch at key LED " << (int)key_offset;
-         
-            simulator.error() << "   expected: (" << (int)red_expected << ", " 
-                                                << (int)green_expected << ", " 
-                                                << (int)blue_expected << ")";
-                                                
-            simulator.error() << "   actual: ("   << (int)red_actual << ", " 
-                                                << (int)green_actual << ", " 
-                                                << (int)blue_actual << ")";                                   
-         }
-      }
+   if(diff.getNumMismatches() > diff.getMismatches().size()) {
+      simulator.log() << "   ... and " 
+         << (diff.getNumMismatches() - diff.getMismatches().size()) 
+         << " more";
    }
 }
 
@@ -17,22 +17,145 @@
 
 #pragma once
 
+#include "papilio/KeyMatrixState.h"
+
 #include <stdint.h>
+#include <stddef.h>
+#include <vector>
 
 namespace papilio {
    
 class Simulator;
 
+/// @brief The difference of two LED frames.
+/// @details Records which keys mismatch as a bitmap and the
+///        colors of the first few mismatching keys.
+///
+class LEDFrameDiff
+{
+   public:
+      
+      /// @brief A single key LED mismatch.
+      ///
+      struct Mismatch {
+         KeyOffset key_offset_;
+         uint8_t expected_[3];
+         uint8_t actual_[3];
+      };
+      
+      /// @brief Constructor.
+      ///
+      /// @param max_mismatches The maximum number of mismatches whose
+      ///        colors are recorded.
+      ///
+      explicit LEDFrameDiff(size_t max_mismatches = 8)
+         :  max_mismatches_(max_mismatches)
+      {}
+      
+      /// @brief Removes all mismatches and prepares for a frame
+      ///        of a given size. Does not allocate for frames of known size.
+      ///
+      /// @param n_keys The number of key LEDs of the frame.
+      ///
+      void reset(KeyOffset n_keys);
+      
+      /// @brief Records a mismatch. Keys must be added in ascending order.
+      ///
+      /// @param key_offset The mismatching key.
+      /// @param expected The expected red, green and blue values.
+      /// @param actual The actual red, green and blue values.
+      ///
+      void addMismatch(KeyOffset key_offset, 
+                       const uint8_t *expected, 
+                       const uint8_t *actual);
+      
+      /// @brief Checks if both frames matched.
+      ///
+      bool empty() const { return n_mismatches_ == 0; }
+      
+      /// @brief Retreives the overall number of mismatching keys.
+      ///
+      size_t getNumMismatches() const { return n_mismatches_; }
+      
+      /// @brief Retreives the number of keys of the compared frames.
+      ///
+      KeyOffset getNumKeys() const { return n_keys_; }
+      
+      /// @brief Checks if a key mismatched.
+      ///
+      bool isMismatch(KeyOffset key_offset) const {
+         return (mismatch_bitmap_[key_offset >> 6] >> (key_offset & 63)) & 1;
+      }
+      
+      /// @brief Retreives the bitmap of mismatching keys. 
+      /// @details Bit key_offset % 64 of word key_offset / 64 
+      ///        represents a key.
+      ///
+      const std::vector<uint64_t> &getMismatchBitmap() const { return mismatch_bitmap_; }
+      
+      /// @brief Retreives the first mismatches, in ascending key order.
+      ///
+      const std::vector<Mismatch> &getMismatches() const { return mismatches_; }
+      
+   private:
+      
+      size_t max_mismatches_;
+      KeyOffset n_keys_ = 0;
+      size_t n_mismatches_ = 0;
+      std::vector<uint64_t> mismatch_bitmap_;
+      std::vector<Mismatch> mismatches_;
+};
+
+/// @brief Compares two LED frames of three bytes (red, green, blue) per key.
+/// @details The comparison works on 16 bytes at a time 
+///        if the host supports SSE2 and only examines individual keys 
+///        of blocks that contain a mismatch.
+///
+/// @param expected The expected frame.
+/// @param actual The actual frame.
+/// @param n_keys The number of keys of both frames.
+/// @param diff Receives the difference.
+/// @param tolerance The maximum difference per color channel that is 
+///        considered a match, e.g. to allow for dithering.
+/// @returns True if the frames match.
+///
+bool compareLEDFrames(const uint8_t *expected, 
+                      const uint8_t *actual,
+                      KeyOffset n_keys,
+                      LEDFrameDiff &diff,
+                      uint8_t tolerance = 0);
+
 /// @brief Dumps the state of the key LEDs as C++ code
 ///
 void dumpKeyLEDState(const Simulator &simulator);
 
+/// @brief Compares the current state of the key LEDs to a representation
+///        stored in an array, without reporting errors.
+///
+/// @param key_led_colors An array of key LED state data to compare the current
+///                       state with.
+/// @param diff Receives the difference.
+/// @param tolerance The maximum difference per color channel that is 
+///        considered a match.
+/// @returns True if the states match.
+///
+bool diffKeyLEDState(const Simulator &simulator,
+                     const uint8_t key_led_colors[][3],
+                     LEDFrameDiff &diff,
+                     uint8_t tolerance = 0);
+
 /// @brief Compares the current state of the key LEDs to a representation
 ///        stored in an array.
+/// @details A mismatch is reported as a single error, followed by
+///        the colors of the first mismatching keys.
+///
 /// @param key_led_colors An array of key LED state data to compare the current
 ///                       state with.
+/// @param tolerance The maximum difference per color channel that is 
+///        considered a match.
 ///
 void assertKeyLEDState(const Simulator &simulator,
-                       const uint8_t key_led_colors[][3]);
+                       const uint8_t key_led_colors[][3],
+                       uint8_t tolerance = 0);
    
 } // namespace papilio
@@ -0,0 +1,178 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/LatencyTracker.h"
+#include "papilio/Simulator.h"
+#include "papilio/reports/KeyboardReport_.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace papilio {
+   
+namespace {
+   
+std::string formatStatistics(const std::string &name, const Histogram &histogram)
+{
+   std::ostringstream out;
+   out << std::left << std::setw(24) << name << std::right 
+      << std::fixed << std::setprecision(2)
+      << std::setw(10) << histogram.getCount()
+      << std::setw(11) << histogram.getMean()
+      << std::setw(11) << histogram.getPercentile(50)
+      << std::setw(11) << histogram.getPercentile(99)
+      << std::setw(11) << histogram.getMax();
+   return out.str();
+}
+
+} // namespace
+
+void LatencyTracker::keyEvent(uint8_t row, uint8_t col, bool pressed, int keycode,
+                              int cycle_id, uint64_t time)
+{
+   this->discardExpired(cycle_id);
+   
+   pending_.push_back(PendingEvent{
+      uint16_t((uint16_t(row) << 8) | col),
+      pressed,
+      int16_t((keycode >= 0) ? keycode : -1),
+      cycle_id,
+      time
+   });
+}
+
+void LatencyTracker::keyboardReport(const ReportData &data, int cycle_id, uint64_t time)
+{
+   KeycodeBitmap keycodes;
+   keycodes.assignBytes(data.bytes_ + 1, 32);
+   for(int i = 0; i < 8; ++i) {
+      if(data.bytes_[0] & (1 << i)) {
+         keycodes.set(uint8_t(KeyboardReport_::first_modifier_keycode + i));
+      }
+   }
+   
+   // Count the keycodes whose state changed. Every change can be 
+   // caused by at most one key event.
+   //
+   int n_changes = 0;
+   for(int w = 0; w < KeycodeBitmap::num_words; ++w) {
+      n_changes += __builtin_popcountll(keycodes.getWord(w) ^ active_keycodes_.getWord(w));
+   }
+   
+   if(n_changes == 0) { return; }
+   
+   this->discardExpired(cycle_id);
+   
+   for(auto it = pending_.begin(); (it != pending_.end()) && (n_changes > 0); ) {
+      
+      bool matches = true;
+      
+      if(it->keycode_ >= 0) {
+         uint8_t keycode = uint8_t(it->keycode_);
+         matches =    (keycodes.test(keycode) != active_keycodes_.test(keycode))
+                   && (keycodes.test(keycode) == it->pressed_);
+      }
+         
+      if(!matches) {
+         ++it;
+         continue;
+      }
+      
+      uint64_t latency_cycles = uint64_t(cycle_id - it->cycle_id_);
+      uint64_t latency_time = time - it->time_;
+      
+      statistics_.cycles_.add(latency_cycles);
+      statistics_.time_.add(latency_time);
+      
+      auto &key_statistics = key_statistics_[it->key_];
+      key_statistics.cycles_.add(latency_cycles);
+      key_statistics.time_.add(latency_time);
+      
+      it = pending_.erase(it);
+      --n_changes;
+   }
+   
+   active_keycodes_ = keycodes;
+}
+
+const LatencyTracker::Statistics *
+   LatencyTracker::getKeyStatistics(uint8_t row, uint8_t col) const
+{
+   auto it = key_statistics_.find(uint16_t((uint16_t(row) << 8) | col));
+   if(it == key_statistics_.end()) {
+      return nullptr;
+   }
+   return &it->second;
+}
+
+void LatencyTracker::clear()
+{
+   pending_.clear();
+   active_keycodes_ = KeycodeBitmap{};
+   statistics_.cycles_.clear();
+   statistics_.time_.clear();
+   key_statistics_.clear();
+   n_unmatched_ = 0;
+}
+
+void LatencyTracker::discardExpired(int cycle_id)
+{
+   auto expired = [&](const PendingEvent &event) {
+      return cycle_id - event.cycle_id_ > max_pending_cycles_;
+   };
+   
+   auto it = std::remove_if(pending_.begin(), pending_.end(), expired);
+   n_unmatched_ += uint64_t(pending_.end() - it);
+   pending_.erase(it, pending_.end());
+}
+
+void LatencyTracker::report(const Simulator &simulator) const
+{
+   std::ostringstream header;
+   header << std::left << std::setw(24) << "key (latency in cycles)" << std::right
+      << std::setw(10) << "count" << std::setw(11) << "mean" 
+      << std::setw(11) << "p50" << std::setw(11) << "p99" << std::setw(11) << "max";
+   
+   simulator.log() << "Key to report latency:";
+   simulator.log() << header.str();
+   
+   simulator.log() << formatStatistics("all keys", statistics_.cycles_);
+   
+   // Sort keys by matrix position for a stable output.
+   //
+   std::vector<uint16_t> keys;
+   keys.reserve(key_statistics_.size());
+   for(const auto &entry: key_statistics_) {
+      keys.push_back(entry.first);
+   }
+   std::sort(keys.begin(), keys.end());
+   
+   for(auto key: keys) {
+      std::ostringstream name;
+      name << "(" << (key >> 8) << ", " << (key & 0xFF) << ")";
+      simulator.log() << formatStatistics(name.str(), key_statistics_.at(key).cycles_);
+   }
+   
+   simulator.log() << "latency in ms (all keys): mean " << statistics_.time_.getMean()
+      << ", p99 " << statistics_.time_.getPercentile(99)
+      << ", max " << statistics_.time_.getMax();
+   simulator.log() << "unmatched key events: " << n_unmatched_ 
+      << " (" << pending_.size() << " pending)";
+}
+
+} // namespace papilio
@@ -0,0 +1,171 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/aux/Histogram.h"
+#include "papilio/reports/KeycodeBitmap.h"
+#include "papilio/reports/ReportData.h"
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace papilio {
+   
+class Simulator;
+
+/// @brief Measures the latency between key events and the keyboard 
+///        reports they cause.
+/// @details Every key press or release that is triggered via the 
+///        simulator is timestamped. It is matched with the first 
+///        keyboard or boot keyboard report that changes the 
+///        state of the key's keycode accordingly. If the core 
+///        does not know the keycode of a key (see SimulatorCore_::getKeycode(...)),
+///        the event is matched with the first report that changes
+///        any keycode or modifier. Events that are not matched within
+///        a configurable number of cycles, e.g. those of layer keys,
+///        are discarded and counted as unmatched.
+///
+///        Latencies are recorded in cycles and in milliseconds
+///        of simulator time, both globally and per key. A report that
+///        is generated by the first loop cycle after a key event has a 
+///        latency of one cycle and zero milliseconds, as the core
+///        processes the event at the time it happened.
+///
+///        Taps are registered as key presses only, as the core releases
+///        the key on its own.
+///
+///        Tracking is disabled by default. While disabled, the cost 
+///        is a single branch per key event and report.
+///
+class LatencyTracker
+{
+   public:
+      
+      /// @brief Latency histograms.
+      ///
+      struct Statistics {
+         
+         /// @brief The latency in cycles.
+         ///
+         Histogram cycles_;
+         
+         /// @brief The latency in milliseconds.
+         ///
+         Histogram time_;
+      };
+      
+      /// @brief Enables or disables latency tracking.
+      ///
+      void setEnabled(bool state) { enabled_ = state; }
+      
+      bool isEnabled() const { return enabled_; }
+      
+      /// @brief Sets the number of cycles after which unmatched key
+      ///        events are discarded.
+      ///
+      void setMaxPendingCycles(int cycles) { max_pending_cycles_ = cycles; }
+      
+      int getMaxPendingCycles() const { return max_pending_cycles_; }
+      
+      /// @brief Registers a key event.
+      ///
+      /// @param row The key row.
+      /// @param col The key column.
+      /// @param pressed True if the key was pressed, false if it was released.
+      /// @param keycode The keycode of the key or a negative value if unknown.
+      /// @param cycle_id The id of the current cycle.
+      /// @param time The current simulator time.
+      ///
+      void keyEvent(uint8_t row, uint8_t col, bool pressed, int keycode,
+                    int cycle_id, uint64_t time);
+      
+      /// @brief Matches pending key events with a keyboard report.
+      ///
+      /// @param data The data of a keyboard or boot keyboard report.
+      /// @param cycle_id The id of the current cycle.
+      /// @param time The current simulator time.
+      ///
+      void keyboardReport(const ReportData &data, int cycle_id, uint64_t time);
+      
+      /// @brief Retreives the latency statistics of all keys.
+      ///
+      const Statistics &getStatistics() const { return statistics_; }
+      
+      /// @brief Retreives the latency statistics of an individual key.
+      ///
+      /// @returns The statistics or nullptr if no latency was recorded
+      ///        for the key.
+      ///
+      const Statistics *getKeyStatistics(uint8_t row, uint8_t col) const;
+      
+      /// @brief Calls a function with row, column and statistics
+      ///        of every key for which latencies were recorded.
+      ///
+      template<typename _Function>
+      void forEachKey(_Function function) const {
+         for(const auto &entry: key_statistics_) {
+            function(uint8_t(entry.first >> 8), uint8_t(entry.first & 0xFF), 
+                     entry.second);
+         }
+      }
+      
+      /// @brief Retreives the number of key events that still wait 
+      ///        for a matching report.
+      ///
+      size_t getNumPending() const { return pending_.size(); }
+      
+      /// @brief Retreives the number of key events that were discarded
+      ///        without a matching report.
+      ///
+      uint64_t getNumUnmatched() const { return n_unmatched_; }
+      
+      /// @brief Discards all statistics and pending events.
+      ///
+      void clear();
+      
+      /// @brief Writes a summary to the simulator's log.
+      ///
+      void report(const Simulator &simulator) const;
+      
+   private:
+      
+      struct PendingEvent {
+         uint16_t key_;
+         bool pressed_;
+         int16_t keycode_;
+         int cycle_id_;
+         uint64_t time_;
+      };
+      
+      void discardExpired(int cycle_id);
+      
+   private:
+      
+      bool enabled_ = false;
+      int max_pending_cycles_ = 1000;
+      
+      std::vector<PendingEvent> pending_;
+      KeycodeBitmap active_keycodes_;
+      
+      Statistics statistics_;
+      std::unordered_map<uint16_t, Statistics> key_statistics_;
+      uint64_t n_unmatched_ = 0;
+};
+
+} // namespace papilio
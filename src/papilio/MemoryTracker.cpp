@@ -0,0 +1,213 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/MemoryTracker.h"
+#include "papilio/Simulator.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace papilio {
+   
+namespace {
+   
+thread_local bool heap_tracking_active = false;
+
+std::atomic<int64_t> current_heap{0};
+std::atomic<int64_t> peak_heap{0};
+std::atomic<int64_t> cycle_heap_peak{0};
+std::atomic<uint64_t> n_allocations{0};
+
+constexpr uint64_t stack_fill_pattern = 0xA5A5A5A5A5A5A5A5ull;
+
+// Painting and scanning happens in separate frames below that of the caller.
+// The painted region remains untouched until the core loop uses
+// the stack.
+//
+__attribute__((noinline))
+uintptr_t paintStack(size_t n_words)
+{
+   volatile uint64_t *region = static_cast<volatile uint64_t*>(__builtin_alloca(n_words*sizeof(uint64_t)));
+   for(size_t i = 0; i < n_words; ++i) {
+      region[i] = stack_fill_pattern;
+   }
+   return reinterpret_cast<uintptr_t>(region);
+}
+
+__attribute__((noinline))
+size_t scanStack(uintptr_t region_begin, size_t n_words)
+{
+   const volatile uint64_t *region = reinterpret_cast<const volatile uint64_t*>(region_begin);
+   size_t i = 0;
+   while((i < n_words) && (region[i] == stack_fill_pattern)) {
+      ++i;
+   }
+   return (n_words - i)*sizeof(uint64_t);
+}
+
+} // namespace
+
+#ifdef PAPILIO_TRACK_HEAP
+
+namespace {
+   
+void updateMaximum(std::atomic<int64_t> &maximum, int64_t value)
+{
+   int64_t previous = maximum.load(std::memory_order_relaxed);
+   while(   (value > previous)
+         && !maximum.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {}
+}
+
+// Every allocation is preceeded by a header that keeps its size and
+// whether it is tracked. The header size preserves the 
+// alignment guaranteed by malloc.
+//
+struct alignas(16) AllocationHeader {
+   size_t size_;
+   bool tracked_;
+};
+
+void *allocate(size_t size)
+{
+   auto header = static_cast<AllocationHeader*>(malloc(sizeof(AllocationHeader) + size));
+   if(!header) { return nullptr; }
+   
+   header->size_ = size;
+   header->tracked_ = heap_tracking_active;
+   
+   if(header->tracked_) {
+      int64_t current = current_heap.fetch_add(int64_t(size), std::memory_order_relaxed) + int64_t(size);
+      updateMaximum(peak_heap, current);
+      updateMaximum(cycle_heap_peak, current);
+      n_allocations.fetch_add(1, std::memory_order_relaxed);
+   }
+   
+   return header + 1;
+}
+
+void deallocate(void *ptr)
+{
+   if(!ptr) { return; }
+   
+   auto header = static_cast<AllocationHeader*>(ptr) - 1;
+   if(header->tracked_) {
+      current_heap.fetch_sub(int64_t(header->size_), std::memory_order_relaxed);
+   }
+   free(header);
+}
+
+} // namespace
+
+#endif // #ifdef PAPILIO_TRACK_HEAP
+
+MemoryTracker::HeapScope::HeapScope(bool state)
+   :  previous_(heap_tracking_active)
+{
+   heap_tracking_active = state;
+}
+
+MemoryTracker::HeapScope::~HeapScope()
+{
+   heap_tracking_active = previous_;
+}
+
+bool MemoryTracker::isHeapTrackingAvailable()
+{
+#ifdef PAPILIO_TRACK_HEAP
+   return true;
+#else
+   return false;
+#endif
+}
+
+bool MemoryTracker::isHeapTrackingActive() { return heap_tracking_active; }
+
+int64_t MemoryTracker::getCurrentHeap() { return current_heap.load(std::memory_order_relaxed); }
+int64_t MemoryTracker::getPeakHeap() { return peak_heap.load(std::memory_order_relaxed); }
+int64_t MemoryTracker::getCycleHeapPeak() { return cycle_heap_peak.load(std::memory_order_relaxed); }
+uint64_t MemoryTracker::getNumAllocations() { return n_allocations.load(std::memory_order_relaxed); }
+
+void MemoryTracker::resetPeaks()
+{
+   peak_heap.store(current_heap.load(std::memory_order_relaxed), std::memory_order_relaxed);
+   peak_stack_depth_ = 0;
+}
+
+void MemoryTracker::beginCycle()
+{
+   cycle_heap_peak.store(current_heap.load(std::memory_order_relaxed), std::memory_order_relaxed);
+   stack_region_begin_ = paintStack(stack_region_size_/sizeof(uint64_t));
+}
+
+void MemoryTracker::endCycle()
+{
+   cycle_stack_depth_ = scanStack(stack_region_begin_, stack_region_size_/sizeof(uint64_t));
+   if(cycle_stack_depth_ > peak_stack_depth_) {
+      peak_stack_depth_ = cycle_stack_depth_;
+   }
+}
+
+void MemoryTracker::report(const Simulator &simulator, const char *add_indent) const
+{
+   if(isHeapTrackingAvailable()) {
+      simulator.log() << add_indent << "heap: " << getCurrentHeap() 
+         << " bytes current, " << getPeakHeap() << " bytes peak (" 
+         << getNumAllocations() << " allocations overall)";
+   }
+   else {
+      simulator.log() << add_indent << "heap: not tracked (build with PAPILIO_TRACK_HEAP)";
+   }
+   
+   simulator.log() << add_indent << "stack: at most " << peak_stack_depth_ << " bytes peak, " 
+      << cycle_stack_depth_ << " bytes in last cycle (simulator thread, including report processing)";
+}
+
+} // namespace papilio
+
+#ifdef PAPILIO_TRACK_HEAP
+
+void *operator new(std::size_t size)
+{
+   void *ptr = papilio::allocate(size);
+   if(!ptr) { throw std::bad_alloc(); }
+   return ptr;
+}
+
+void *operator new[](std::size_t size)
+{
+   void *ptr = papilio::allocate(size);
+   if(!ptr) { throw std::bad_alloc(); }
+   return ptr;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+   return papilio::allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+   return papilio::allocate(size);
+}
+
+void operator delete(void *ptr) noexcept { papilio::deallocate(ptr); }
+void operator delete[](void *ptr) noexcept { papilio::deallocate(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { papilio::deallocate(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { papilio::deallocate(ptr); }
+
+#endif // #ifdef PAPILIO_TRACK_HEAP
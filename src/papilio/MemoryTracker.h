@@ -0,0 +1,161 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace papilio {
+   
+class Simulator;
+
+/// @brief Tracks the heap and stack footprint of the firmware.
+/// @details Heap tracking requires the library to be built with 
+///        PAPILIO_TRACK_HEAP defined. This replaces the global
+///        operators new and delete. Only allocations that happen
+///        during SimulatorCore_::loop() are accounted for, 
+///        excluding the processing of reports by the simulator. 
+///        Memory that is allocated via malloc(...) is not tracked.
+///
+///        The stack depth of SimulatorCore_::loop() is measured by painting a 
+///        region of the stack with a fill pattern before and searching for 
+///        the deepest overwritten word after every loop.
+///        The measured depth is an upper bound of the firmware's stack 
+///        usage. Reports are processed by the simulator while the 
+///        firmware's frames are still on the stack, so the depth includes 
+///        the frames of report processing, which may well exceed those 
+///        of the firmware. Stack tracking is only applied on the
+///        simulator's thread. Cores that are stepped by worker 
+///        threads of a CompositeCore are not covered.
+///
+///        Tracking is disabled by default. While disabled, the cost 
+///        is a single branch per cycle and report.
+///
+class MemoryTracker
+{
+   public:
+      
+      /// @brief Enables heap tracking on the current thread while alive.
+      ///
+      class HeapScope {
+         
+         public:
+            
+            /// @brief Constructor.
+            /// @param state The tracking state to apply while the scope is alive.
+            ///
+            explicit HeapScope(bool state);
+            ~HeapScope();
+            
+            HeapScope(const HeapScope &) = delete;
+            HeapScope &operator=(const HeapScope &) = delete;
+            
+         private:
+            
+            bool previous_;
+      };
+      
+      /// @brief Checks if the library was built with heap tracking support.
+      ///
+      static bool isHeapTrackingAvailable();
+      
+      /// @brief Checks if heap allocations on the current thread are tracked.
+      ///
+      static bool isHeapTrackingActive();
+      
+      /// @brief Retreives the number of bytes that are currently allocated
+      ///        by tracked allocations.
+      ///
+      static int64_t getCurrentHeap();
+      
+      /// @brief Retreives the maximum of getCurrentHeap() since the last
+      ///        call to resetPeaks().
+      ///
+      static int64_t getPeakHeap();
+      
+      /// @brief Retreives the maximum of getCurrentHeap() during 
+      ///        the most recent cycle.
+      ///
+      static int64_t getCycleHeapPeak();
+      
+      /// @brief Retreives the overall number of tracked allocations.
+      ///
+      static uint64_t getNumAllocations();
+      
+      /// @brief Enables or disables tracking.
+      ///
+      void setEnabled(bool state) { enabled_ = state; }
+      
+      bool isEnabled() const { return enabled_; }
+      
+      /// @brief Sets the size of the stack region that is painted 
+      ///        before every core loop.
+      /// @details Stack usage beyond this size is not detected. 
+      ///        Painting costs time proportional to the size.
+      ///
+      /// @param bytes The size in bytes (default 64 kB).
+      ///
+      void setStackRegionSize(size_t bytes) { stack_region_size_ = bytes; }
+      
+      size_t getStackRegionSize() const { return stack_region_size_; }
+      
+      /// @brief Retreives the stack depth of the most recent core loop in bytes.
+      /// @details An upper bound that includes report processing, measured 
+      ///        on the simulator's thread only.
+      ///
+      size_t getCycleStackDepth() const { return cycle_stack_depth_; }
+      
+      /// @brief Retreives the maximum stack depth of the core loop
+      ///        since the last call to resetPeaks().
+      /// @details An upper bound that includes report processing, measured 
+      ///        on the simulator's thread only.
+      ///
+      size_t getPeakStackDepth() const { return peak_stack_depth_; }
+      
+      /// @brief Resets heap and stack peaks to the current values.
+      /// @details Called at the beginning of every test.
+      ///
+      void resetPeaks();
+      
+      /// @brief Prepares measuring a core loop.
+      ///
+      void beginCycle();
+      
+      /// @brief Finishes measuring a core loop.
+      ///
+      void endCycle();
+      
+      /// @brief Writes a summary to the simulator's log.
+      ///
+      /// @param simulator The simulator.
+      /// @param add_indent An additional indentation string.
+      ///
+      void report(const Simulator &simulator, const char *add_indent = "") const;
+      
+   private:
+      
+      bool enabled_ = false;
+      size_t stack_region_size_ = 64*1024;
+      
+      uintptr_t stack_region_begin_ = 0;
+      
+      size_t cycle_stack_depth_ = 0;
+      size_t peak_stack_depth_ = 0;
+};
+
+} // namespace papilio
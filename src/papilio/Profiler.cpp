@@ -0,0 +1,245 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/Profiler.h"
+#include "papilio/Simulator.h"
+#include "papilio/actions/Action_.h"
+#include "papilio/aux/demangle.h"
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <typeinfo>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace papilio {
+   
+namespace {
+   
+std::string formatStatistics(const std::string &name, const Histogram &histogram)
+{
+   static constexpr double ns_per_us = 1e3;
+   
+   std::ostringstream out;
+   out << std::left << std::setw(56) << name << std::right 
+      << std::fixed << std::setprecision(2)
+      << std::setw(10) << histogram.getCount()
+      << std::setw(11) << histogram.getMean()/ns_per_us
+      << std::setw(11) << histogram.getPercentile(50)/ns_per_us
+      << std::setw(11) << histogram.getPercentile(99)/ns_per_us
+      << std::setw(11) << histogram.getMax()/ns_per_us;
+   return out.str();
+}
+
+void writeJSONString(std::ostream &out, const std::string &text)
+{
+   out << '\"';
+   for(char c: text) {
+      if(c == '\"' || c == '\\') { out << '\\'; }
+      out << c;
+   }
+   out << '\"';
+}
+
+void writeJSONStatistics(std::ostream &out, const Histogram &histogram)
+{
+   out << "{\"count\": " << histogram.getCount()
+      << ", \"mean_ns\": " << histogram.getMean()
+      << ", \"p50_ns\": " << histogram.getPercentile(50)
+      << ", \"p99_ns\": " << histogram.getPercentile(99)
+      << ", \"max_ns\": " << histogram.getMax() << "}";
+}
+
+} // namespace
+
+Profiler::~Profiler()
+{
+   this->setCPUCycleCounting(false);
+}
+
+bool Profiler::setCPUCycleCounting(bool state)
+{
+#ifdef __linux__
+   if(state == this->isCPUCycleCounting()) { return true; }
+   
+   if(!state) {
+      close(cpu_cycle_counter_);
+      cpu_cycle_counter_ = -1;
+      return true;
+   }
+   
+   struct perf_event_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = PERF_TYPE_HARDWARE;
+   attr.config = PERF_COUNT_HW_CPU_CYCLES;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   
+   cpu_cycle_counter_ = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+   
+   return cpu_cycle_counter_ >= 0;
+#else
+   return !state;
+#endif
+}
+
+uint64_t Profiler::readCPUCycles() const
+{
+   uint64_t value = 0;
+#ifdef __linux__
+   if(cpu_cycle_counter_ >= 0) {
+      if(read(cpu_cycle_counter_, &value, sizeof(value)) != ssize_t(sizeof(value))) {
+         value = 0;
+      }
+   }
+#endif
+   return value;
+}
+
+uint64_t Profiler::now()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *Profiler::getPhaseName(Phase phase)
+{
+   switch(phase) {
+      case CoreLoopPhase: return "core loop";
+      case ReportProcessingPhase: return "report processing";
+      case QueuedCycleActionsPhase: return "queued cycle actions";
+      case PermanentCycleActionsPhase: return "permanent cycle actions";
+      default: break;
+   }
+   return "unknown";
+}
+
+void Profiler::addPhaseTime(Phase phase, uint64_t duration)
+{
+   phase_histograms_[phase].add(duration);
+   
+   if(phase == ReportProcessingPhase) {
+      nested_report_time_ += duration;
+   }
+}
+
+void Profiler::addActionTime(const Action_ &action, uint64_t duration)
+{
+   std::type_index type_id(typeid(action));
+   
+   auto it = action_stats_.find(type_id);
+   
+   // Demangle only once per action type.
+   //
+   if(it == action_stats_.end()) {
+      it = action_stats_.emplace(type_id, ActionStats{}).first;
+      it->second.name_ = type(action);
+   }
+   
+   it->second.histogram_.add(duration);
+}
+
+void Profiler::clear()
+{
+   for(auto &histogram: phase_histograms_) {
+      histogram.clear();
+   }
+   nested_report_time_ = 0;
+   core_loop_cpu_cycles_.clear();
+   nested_report_cpu_cycles_ = 0;
+   worst_cycle_ = WorstCycle();
+   action_stats_.clear();
+}
+
+void Profiler::report(const Simulator &simulator) const
+{
+   std::ostringstream header;
+   header << std::left << std::setw(56) << "phase/action (times in us)" << std::right
+      << std::setw(10) << "count" << std::setw(11) << "mean" 
+      << std::setw(11) << "p50" << std::setw(11) << "p99" << std::setw(11) << "max";
+   
+   simulator.log() << "Profile:";
+   simulator.log() << header.str();
+   
+   for(int phase = 0; phase < NumPhases; ++phase) {
+      simulator.log() << formatStatistics(getPhaseName(Phase(phase)), 
+                                          phase_histograms_[phase]);
+   }
+   
+   for(const auto &entry: action_stats_) {
+      simulator.log() << formatStatistics(entry.second.name_, entry.second.histogram_);
+   }
+   
+   if(core_loop_cpu_cycles_.getCount() > 0) {
+      simulator.log() << "core loop CPU cycles: mean " 
+         << uint64_t(core_loop_cpu_cycles_.getMean())
+         << ", p50 " << core_loop_cpu_cycles_.getPercentile(50)
+         << ", p99 " << core_loop_cpu_cycles_.getPercentile(99)
+         << ", max " << core_loop_cpu_cycles_.getMax();
+   }
+   
+   if(worst_cycle_.cycle_id_ >= 0) {
+      std::ostringstream keys;
+      const auto &pressed_keys = worst_cycle_.pressed_keys_;
+      for(uint8_t row = 0; row < pressed_keys.getRows(); ++row) {
+         for(uint8_t col = 0; col < pressed_keys.getCols(); ++col) {
+            if(pressed_keys.test(row, col)) {
+               keys << " (" << int(row) << ", " << int(col) << ")";
+            }
+         }
+      }
+      
+      simulator.log() << "slowest core loop: " << std::fixed << std::setprecision(2)
+         << worst_cycle_.duration_/1e3 << " us in cycle " << worst_cycle_.cycle_id_
+         << " (t=" << worst_cycle_.time_ << ")";
+      simulator.log() << "   keys pressed:" << (keys.str().empty() ? " none" : keys.str());
+   }
+}
+
+void Profiler::writeJSON(std::ostream &out) const
+{
+   out << "{\n   \"phases\": {";
+   
+   for(int phase = 0; phase < NumPhases; ++phase) {
+      out << ((phase > 0) ? ",\n      " : "\n      ");
+      writeJSONString(out, getPhaseName(Phase(phase)));
+      out << ": ";
+      writeJSONStatistics(out, phase_histograms_[phase]);
+   }
+   
+   out << "\n   },\n   \"actions\": {";
+   
+   bool first = true;
+   for(const auto &entry: action_stats_) {
+      out << (first ? "\n      " : ",\n      ");
+      first = false;
+      writeJSONString(out, entry.second.name_);
+      out << ": ";
+      writeJSONStatistics(out, entry.second.histogram_);
+   }
+   
+   out << "\n   }\n}\n";
+}
+
+} // namespace papilio
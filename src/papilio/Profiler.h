@@ -0,0 +1,249 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/aux/Histogram.h"
+#include "papilio/KeyMatrixState.h"
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+
+namespace papilio {
+   
+class Simulator;
+class Action_;
+
+/// @brief Collects wall time statistics of the phases of simulator cycles 
+///        and of individual action types.
+/// @details Profiling is disabled by default. While disabled, the
+///        simulator does not take any timestamps and the cost
+///        of profiling is a single branch per cycle, report and action.
+///        All times are recorded in nanoseconds.
+///
+///        For the core loop, the slowest cycle is recorded together
+///        with the keys that were pressed at that moment. Optionally,
+///        the core loop's CPU cycles are counted by means of a hardware 
+///        performance counter, which is less sensitive to frequency 
+///        scaling and preemption than wall time.
+///
+class Profiler
+{
+   public:
+      
+      /// @brief Information about the slowest core loop.
+      ///
+      struct WorstCycle {
+         
+         /// @brief The wall time in nanoseconds.
+         ///
+         uint64_t duration_ = 0;
+         
+         /// @brief The number of CPU cycles, if counted.
+         ///
+         uint64_t cpu_cycles_ = 0;
+         
+         int cycle_id_ = -1;
+         unsigned long time_ = 0;
+         
+         /// @brief The keys that were pressed when the cycle started.
+         ///
+         KeyMatrixState pressed_keys_;
+      };
+      
+      Profiler() = default;
+      Profiler(const Profiler &) = delete;
+      Profiler &operator=(const Profiler &) = delete;
+      
+      ~Profiler();
+      
+      /// @brief The phases of a simulator cycle.
+      ///
+      enum Phase {
+         
+         /// @brief The call to SimulatorCore_::loop(), excluding
+         ///        the processing of reports.
+         ///
+         CoreLoopPhase,
+         
+         /// @brief The processing of individual reports, including
+         ///        report actions.
+         ///
+         ReportProcessingPhase,
+         
+         /// @brief The evaluation of queued cycle actions.
+         ///
+         QueuedCycleActionsPhase,
+         
+         /// @brief The evaluation of permanent cycle actions.
+         ///
+         PermanentCycleActionsPhase,
+         
+         NumPhases
+      };
+      
+      /// @brief Retreives a monotonic timestamp in nanoseconds.
+      ///
+      static uint64_t now();
+      
+      /// @brief Retreives a human readable name of a phase.
+      ///
+      static const char *getPhaseName(Phase phase);
+      
+      /// @brief Enables or disables profiling.
+      ///
+      void setEnabled(bool state) { enabled_ = state; }
+      
+      bool isEnabled() const { return enabled_; }
+      
+      /// @brief Records the duration of a phase.
+      ///
+      void addPhaseTime(Phase phase, uint64_t duration);
+      
+      /// @brief Enables or disables counting CPU cycles of the core loop.
+      /// @details Requires a hardware performance counter (Linux perf events).
+      ///
+      /// @param state The new state.
+      ///
+      /// @returns False if counting was requested but no counter is available.
+      ///
+      bool setCPUCycleCounting(bool state);
+      
+      bool isCPUCycleCounting() const { return cpu_cycle_counter_ >= 0; }
+      
+      /// @brief Reads the CPU cycle counter.
+      /// @returns The current counter value or zero if CPU cycles are not counted.
+      ///
+      uint64_t readCPUCycles() const;
+      
+      /// @brief Records the CPU cycles of report processing that
+      ///        happened during the core loop.
+      ///
+      void addNestedReportCPUCycles(uint64_t cpu_cycles) {
+         nested_report_cpu_cycles_ += cpu_cycles;
+      }
+      
+      /// @private
+      /// @brief Retreives the report processing CPU cycles that were 
+      ///        recorded since the last call, and resets them.
+      ///
+      uint64_t takeNestedReportCPUCycles() {
+         uint64_t result = nested_report_cpu_cycles_;
+         nested_report_cpu_cycles_ = 0;
+         return result;
+      }
+      
+      /// @brief Records the CPU cycles of a core loop.
+      ///
+      void addCoreLoopCPUCycles(uint64_t cpu_cycles) {
+         core_loop_cpu_cycles_.add(cpu_cycles);
+      }
+      
+      /// @brief Retreives the histogram of CPU cycles per core loop.
+      ///
+      const Histogram &getCoreLoopCPUCycles() const {
+         return core_loop_cpu_cycles_;
+      }
+      
+      /// @brief Checks if a core loop duration exceeds that of the 
+      ///        slowest core loop recorded so far.
+      ///
+      bool isWorstCoreLoop(uint64_t duration) const {
+         return (worst_cycle_.cycle_id_ < 0) || (duration > worst_cycle_.duration_);
+      }
+      
+      /// @brief Replaces the information about the slowest core loop.
+      ///
+      void setWorstCoreLoop(const WorstCycle &worst_cycle) {
+         worst_cycle_ = worst_cycle;
+      }
+      
+      /// @brief Retreives information about the slowest core loop.
+      /// @details The cycle id is negative if no core loop was recorded.
+      ///
+      const WorstCycle &getWorstCoreLoop() const { return worst_cycle_; }
+      
+      /// @brief Records the duration of an action's evaluation.
+      /// @details Statistics are collected per dynamic action type.
+      ///
+      void addActionTime(const Action_ &action, uint64_t duration);
+      
+      /// @brief Retreives the time histogram of a phase.
+      ///
+      const Histogram &getPhaseHistogram(Phase phase) const {
+         return phase_histograms_[phase];
+      }
+      
+      /// @brief Calls a function with the demangled name and the time
+      ///        histogram of every action type that was evaluated.
+      ///
+      template<typename _Function>
+      void forEachActionType(_Function function) const {
+         for(const auto &entry: action_stats_) {
+            function(entry.second.name_, entry.second.histogram_);
+         }
+      }
+      
+      /// @brief Discards all statistics.
+      ///
+      void clear();
+      
+      /// @brief Writes a summary to the simulator's log.
+      ///
+      void report(const Simulator &simulator) const;
+      
+      /// @brief Writes all statistics as a JSON object.
+      ///
+      void writeJSON(std::ostream &out) const;
+      
+      /// @private
+      /// @brief Retreives the report processing time that was 
+      ///        recorded since the last call, and resets it.
+      /// @details Reports are processed during SimulatorCore_::loop().
+      ///        This enables separating the two.
+      ///
+      uint64_t takeNestedReportTime() {
+         uint64_t result = nested_report_time_;
+         nested_report_time_ = 0;
+         return result;
+      }
+      
+   private:
+      
+      struct ActionStats {
+         std::string name_;
+         Histogram histogram_;
+      };
+      
+      bool enabled_ = false;
+      
+      Histogram phase_histograms_[NumPhases];
+      uint64_t nested_report_time_ = 0;
+      
+      int cpu_cycle_counter_ = -1;
+      Histogram core_loop_cpu_cycles_;
+      uint64_t nested_report_cpu_cycles_ = 0;
+      
+      WorstCycle worst_cycle_;
+      
+      std::unordered_map<std::type_index, ActionStats> action_stats_;
+};
+
+} // namespace papilio
@@ -0,0 +1,138 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/ReportFlightRecorder.h"
+#include "papilio/reports/ReportTypes.h"
+
+#include <algorithm>
+
+namespace papilio {
+   
+void ReportFlightRecorder::setCapacity(size_t n_reports)
+{
+   records_.assign(n_reports, ReportTraceRecord());
+   next_ = 0;
+   n_recorded_ = 0;
+}
+
+std::vector<ReportTraceRecord> ReportFlightRecorder::getRecords() const
+{
+   size_t n_records = size_t(std::min<uint64_t>(n_recorded_, records_.size()));
+   
+   std::vector<ReportTraceRecord> result;
+   result.reserve(n_records);
+   
+   size_t first = (n_records < records_.size()) ? 0 : next_;
+   for(size_t i = 0; i < n_records; ++i) {
+      result.push_back(records_[(first + i) % records_.size()]);
+   }
+   
+   return result;
+}
+
+void ReportFlightRecorder::dump(std::ostream &out) const
+{
+   auto records = this->getRecords();
+   
+   out << "Flight recorder: last " << records.size() 
+      << " of " << n_recorded_ << " reports\n";
+      
+   uint64_t report_id = n_recorded_ - records.size();
+   for(const auto &record: records) {
+      this->dumpRecord(out, ++report_id, record);
+   }
+}
+
+void ReportFlightRecorder::dumpOnce(std::ostream &out) const
+{
+   if(dumped_ || !this->isEnabled()) { return; }
+   dumped_ = true;
+   this->dump(out);
+}
+
+void ReportFlightRecorder::clear()
+{
+   next_ = 0;
+   n_recorded_ = 0;
+}
+
+void ReportFlightRecorder::dumpRecord(std::ostream &out, uint64_t report_id, 
+                                      const ReportTraceRecord &record) const
+{
+   const ReportData &data = record.data_;
+   
+   out << "report " << report_id << " (t=" << record.time_ 
+      << ", c=" << record.cycle_id_ << "): " 
+      << getReportTypeString(data.type_id_) << "\n   ";
+   
+   switch(data.type_id_) {
+      
+      case BootKeyboardReportTypeIdId:
+      case KeyboardReportTypeId:
+         out << "modifiers:";
+         for(int i = 0; i < 8; ++i) {
+            if(data.bytes_[0] & (1 << i)) {
+               out << " " << (KeyboardReport_::first_modifier_keycode + i);
+            }
+         }
+         out << ", keycodes:";
+         for(int keycode = 0; keycode < 256; ++keycode) {
+            if(data.bytes_[1 + keycode/8] & (1 << (keycode % 8))) {
+               out << " " << keycode;
+            }
+         }
+         break;
+         
+      case MouseReportTypeId:
+         out << "buttons: " << int(data.bytes_[0])
+            << ", x: " << int(int8_t(data.bytes_[1]))
+            << ", y: " << int(int8_t(data.bytes_[2]))
+            << ", wheel: " << int(int8_t(data.bytes_[3]))
+            << ", horizontal wheel: " << int(int8_t(data.bytes_[4]));
+         break;
+         
+      case AbsoluteMouseReportTypeId:
+         out << "buttons: " << int(data.bytes_[0])
+            << ", x: " << (data.bytes_[1] | (data.bytes_[2] << 8))
+            << ", y: " << (data.bytes_[3] | (data.bytes_[4] << 8))
+            << ", wheel: " << int(int8_t(data.bytes_[5]))
+            << ", horizontal wheel: " << int(int8_t(data.bytes_[6]));
+         break;
+         
+      case ConsumerControlReportTypeId:
+         out << "usages:";
+         for(int i = 0; i < ConsumerControlReport_::max_usages; ++i) {
+            int usage = data.bytes_[2*i] | (data.bytes_[2*i + 1] << 8);
+            if(usage != 0) {
+               out << " " << usage;
+            }
+         }
+         break;
+         
+      case SystemControlReportTypeId:
+         out << "usage: " << int(data.bytes_[0]);
+         break;
+         
+      default:
+         out << data.toHexString();
+         break;
+   }
+   
+   out << "\n";
+}
+
+} // namespace papilio
@@ -0,0 +1,118 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/ReportTrace.h"
+#include "papilio/reports/Report_.h"
+
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+namespace papilio {
+
+/// @brief Keeps a bounded history of the most recent reports.
+/// @details Every report is stored in compact form together with the 
+///        cycle and time of its arrival in a fixed size ring buffer. 
+///        This allows running tests without report logging and 
+///        still get context when something fails. The history 
+///        is dumped when the first error occurs 
+///        and when a test fails (see dumpOnce(...)).
+///
+///        Dumps decode the recorded data and are written directly to
+///        an output stream, independent of quiet mode and log level.
+///
+///        The recorder is disabled by default. While disabled, the cost 
+///        is a single branch per report.
+///
+class ReportFlightRecorder
+{
+   public:
+      
+      /// @brief Sets the number of reports to keep.
+      /// @details Any recorded reports are discarded.
+      ///
+      /// @param n_reports The number of reports. Zero disables recording.
+      ///
+      void setCapacity(size_t n_reports);
+      
+      /// @brief Retreives the number of reports that are kept.
+      ///
+      size_t getCapacity() const { return records_.size(); }
+      
+      bool isEnabled() const { return !records_.empty(); }
+      
+      /// @brief Records a report.
+      ///
+      /// @param report The report.
+      /// @param cycle_id The current cycle.
+      /// @param time The current time.
+      ///
+      void record(const Report_ &report, uint32_t cycle_id, uint64_t time) {
+         
+         ReportTraceRecord &record = records_[next_];
+         report.getData(record.data_);
+         record.cycle_id_ = cycle_id;
+         record.time_ = time;
+         
+         if(++next_ == records_.size()) {
+            next_ = 0;
+         }
+         ++n_recorded_;
+      }
+      
+      /// @brief Retreives the total number of reports recorded.
+      ///
+      uint64_t getNumRecorded() const { return n_recorded_; }
+      
+      /// @brief Retreives the recorded reports, the oldest first.
+      ///
+      std::vector<ReportTraceRecord> getRecords() const;
+      
+      /// @brief Writes the recorded reports to a stream.
+      ///
+      void dump(std::ostream &out) const;
+      
+      /// @brief Dumps the recorded reports unless this was already
+      ///        done since the last call to rearm().
+      ///
+      void dumpOnce(std::ostream &out) const;
+      
+      /// @brief Enables the next call to dumpOnce(...) to dump.
+      ///
+      void rearm() { dumped_ = false; }
+      
+      /// @brief Discards all recorded reports.
+      ///
+      void clear();
+      
+   private:
+      
+      void dumpRecord(std::ostream &out, uint64_t report_id, 
+                      const ReportTraceRecord &record) const;
+      
+   private:
+      
+      std::vector<ReportTraceRecord> records_;
+      size_t next_ = 0;
+      uint64_t n_recorded_ = 0;
+      
+      mutable bool dumped_ = false;
+};
+
+} // namespace papilio
@@ -0,0 +1,179 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/ReportTrace.h"
+#include "papilio/aux/little_endian.h"
+
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace papilio {
+   
+namespace {
+   
+const char trace_magic[8] = { 'P', 'A', 'P', 'T', 'R', 'A', 'C', 'E' };
+constexpr uint32_t trace_version = 1;
+constexpr size_t header_size = 16;
+constexpr size_t record_header_size = 15;
+
+} // namespace
+
+bool ReportTraceWriter::open(const std::string &filename)
+{
+   this->close();
+   
+   file_ = fopen(filename.c_str(), "wb");
+   if(!file_) { return false; }
+   
+   // Records are small. Let stdio collect them in large chunks.
+   //
+   setvbuf(file_, nullptr, _IOFBF, 1 << 16);
+   
+   uint8_t header[header_size] = {};
+   memcpy(header, trace_magic, sizeof(trace_magic));
+   encodeLittleEndian(header + 8, trace_version, 4);
+   
+   if(fwrite(header, 1, header_size, file_) != header_size) {
+      this->close();
+      return false;
+   }
+   
+   return true;
+}
+
+bool ReportTraceWriter::write(const ReportTraceRecord &record)
+{
+   if(!file_) { return false; }
+   
+   uint8_t buffer[record_header_size + ReportData::max_size];
+   
+   encodeLittleEndian(buffer, record.time_, 8);
+   encodeLittleEndian(buffer + 8, record.cycle_id_, 4);
+   // Trailing zero bytes are not stored. Keyboard reports
+   // mostly consist of them.
+   //
+   uint8_t n_stored = record.data_.size_;
+   while((n_stored > 0) && (record.data_.bytes_[n_stored - 1] == 0)) {
+      --n_stored;
+   }
+   
+   buffer[12] = record.data_.type_id_;
+   buffer[13] = record.data_.size_;
+   buffer[14] = n_stored;
+   memcpy(buffer + record_header_size, record.data_.bytes_, n_stored);
+   
+   size_t n_bytes = record_header_size + n_stored;
+   
+   if(fwrite(buffer, 1, n_bytes, file_) != n_bytes) {
+      return false;
+   }
+   
+   ++n_records_;
+   return true;
+}
+
+void ReportTraceWriter::close()
+{
+   if(file_) {
+      fclose(file_);
+      file_ = nullptr;
+   }
+}
+
+bool ReportTraceReader::open(const std::string &filename)
+{
+   this->close();
+   
+   int fd = ::open(filename.c_str(), O_RDONLY);
+   if(fd < 0) { return false; }
+   
+   struct stat file_stat;
+   if((fstat(fd, &file_stat) != 0) || (size_t(file_stat.st_size) < header_size)) {
+      ::close(fd);
+      return false;
+   }
+   
+   size_t size = file_stat.st_size;
+   
+   void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   
+   // The mapping stays valid after the file descriptor is closed.
+   //
+   ::close(fd);
+   
+   if(data == MAP_FAILED) { return false; }
+   
+   madvise(data, size, MADV_SEQUENTIAL);
+   
+   data_ = static_cast<const uint8_t*>(data);
+   size_ = size;
+   
+   if(   (memcmp(data_, trace_magic, sizeof(trace_magic)) != 0)
+      || (decodeLittleEndian(data_ + 8, 4) != trace_version)) {
+      this->close();
+      return false;
+   }
+   
+   pos_ = header_size;
+   
+   return true;
+}
+
+bool ReportTraceReader::next(ReportTraceRecord &record)
+{
+   if(!data_ || (pos_ >= size_)) { return false; }
+   
+   const uint8_t *buffer = data_ + pos_;
+   size_t n_left = size_ - pos_;
+   
+   if(   (n_left < record_header_size)
+      || (buffer[13] > ReportData::max_size)
+      || (buffer[14] > buffer[13])
+      || (n_left < record_header_size + buffer[14])) {
+      corrupt_ = true;
+      pos_ = size_;
+      return false;
+   }
+   
+   record.time_ = decodeLittleEndian(buffer, 8);
+   record.cycle_id_ = uint32_t(decodeLittleEndian(buffer + 8, 4));
+   record.data_.reset(buffer[12], buffer[13]);
+   memcpy(record.data_.bytes_, buffer + record_header_size, buffer[14]);
+   
+   pos_ += record_header_size + buffer[14];
+   ++n_records_;
+   
+   return true;
+}
+
+void ReportTraceReader::close()
+{
+   if(data_) {
+      munmap(const_cast<uint8_t*>(data_), size_);
+      data_ = nullptr;
+   }
+   size_ = 0;
+   pos_ = 0;
+   n_records_ = 0;
+   corrupt_ = false;
+}
+
+} // namespace papilio
@@ -0,0 +1,147 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/reports/ReportData.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+
+namespace papilio {
+   
+/// @brief A single entry of a report trace.
+///
+struct ReportTraceRecord {
+   
+   uint64_t time_;
+   uint32_t cycle_id_;
+   ReportData data_;
+};
+
+/// @brief Writes report trace files.
+/// @details A report trace file consists of a 16 byte header followed by
+///        a sequence of variable length records. Every record stores
+///        time (8 bytes), cycle id (4 bytes), report type id (1 byte), 
+///        data size (1 byte), the number of stored data bytes (1 byte)
+///        and the data bytes of a report without trailing zeros. 
+///        All integers are little endian.
+///
+class ReportTraceWriter
+{
+   public:
+      
+      ReportTraceWriter() = default;
+      ReportTraceWriter(const ReportTraceWriter &) = delete;
+      ReportTraceWriter &operator=(const ReportTraceWriter &) = delete;
+      
+      ~ReportTraceWriter() { this->close(); }
+      
+      /// @brief Opens a trace file for writing.
+      /// @details An existing file is overwritten.
+      ///
+      /// @param filename The name of the trace file.
+      ///
+      /// @returns True if the file could be opened.
+      ///
+      bool open(const std::string &filename);
+      
+      /// @brief Appends a record to the trace.
+      ///
+      /// @param record The record to write.
+      ///
+      /// @returns False if writing failed.
+      ///
+      bool write(const ReportTraceRecord &record);
+      
+      /// @brief Flushes and closes the trace file.
+      ///
+      void close();
+      
+      bool isOpen() const { return file_ != nullptr; }
+      
+      /// @brief Retreives the number of records written.
+      ///
+      size_t getNumRecords() const { return n_records_; }
+      
+   private:
+      
+      FILE *file_ = nullptr;
+      size_t n_records_ = 0;
+};
+
+/// @brief Streams records from a report trace file.
+/// @details The file is memory mapped and read sequentially. It is
+///        never loaded into memory as a whole.
+///
+class ReportTraceReader
+{
+   public:
+      
+      ReportTraceReader() = default;
+      ReportTraceReader(const ReportTraceReader &) = delete;
+      ReportTraceReader &operator=(const ReportTraceReader &) = delete;
+      
+      ~ReportTraceReader() { this->close(); }
+      
+      /// @brief Opens a trace file for reading.
+      ///
+      /// @param filename The name of the trace file.
+      ///
+      /// @returns True if the file could be opened and has a valid header.
+      ///
+      bool open(const std::string &filename);
+      
+      /// @brief Reads the next record.
+      ///
+      /// @param record The record to fill.
+      ///
+      /// @returns False if the end of the trace was reached or the
+      ///        next record is corrupt.
+      ///
+      bool next(ReportTraceRecord &record);
+      
+      /// @brief Unmaps and closes the trace file.
+      ///
+      void close();
+      
+      bool isOpen() const { return data_ != nullptr; }
+      
+      /// @brief Checks if all records have been read.
+      ///
+      bool atEnd() const { return pos_ >= size_; }
+      
+      /// @brief Checks if a corrupt record was encountered.
+      ///
+      bool isCorrupt() const { return corrupt_; }
+      
+      /// @brief Retreives the number of records read so far.
+      ///
+      size_t getNumRecordsRead() const { return n_records_; }
+      
+   private:
+      
+      const uint8_t *data_ = nullptr;
+      size_t size_ = 0;
+      size_t pos_ = 0;
+      size_t n_records_ = 0;
+      bool corrupt_ = false;
+};
+
+} // namespace papilio
@@ -0,0 +1,151 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/aux/state_image.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace papilio {
+   
+/// @brief A bidirectional byte link between two cores, e.g. the serial 
+///        connection between the halves of a split keyboard.
+/// @details Each of the two endpoints writes to its own transmit 
+///        buffer during a cycle and reads the bytes that the other 
+///        endpoint sent during the previous cycle. Between cycles, 
+///        exchange() swaps transmit and receive buffers without copying 
+///        and without allocating once the buffers have reached their 
+///        working size.
+///
+///        As both endpoints never access the same buffer during a cycle, 
+///        cores that run in parallel threads need no synchronization
+///        to use a link.
+///
+class SerialLink
+{
+   public:
+      
+      /// @brief One side of a link.
+      ///
+      class Endpoint
+      {
+         public:
+            
+            /// @brief Sends bytes to the other endpoint.
+            /// @details The bytes are received during the next cycle.
+            ///
+            void write(const uint8_t *bytes, size_t n_bytes) {
+               tx_->insert(tx_->end(), bytes, bytes + n_bytes);
+            }
+            
+            /// @brief Sends a single byte to the other endpoint.
+            ///
+            void write(uint8_t byte) { tx_->push_back(byte); }
+            
+            /// @brief Retreives the bytes that the other endpoint sent
+            ///        during the previous cycle.
+            ///
+            const uint8_t *getData() const { return rx_->data(); }
+            
+            /// @brief Retreives the number of bytes that the other endpoint 
+            ///        sent during the previous cycle.
+            ///
+            size_t getSize() const { return rx_->size(); }
+            
+         private:
+            
+            friend class SerialLink;
+            
+            std::vector<uint8_t> *tx_ = nullptr;
+            std::vector<uint8_t> *rx_ = nullptr;
+      };
+      
+      SerialLink() {
+         endpoints_[0].tx_ = &buffers_[0];
+         endpoints_[0].rx_ = &buffers_[1];
+         endpoints_[1].tx_ = &buffers_[2];
+         endpoints_[1].rx_ = &buffers_[3];
+      }
+      
+      SerialLink(const SerialLink &) = delete;
+      SerialLink &operator=(const SerialLink &) = delete;
+      
+      /// @brief Retreives one of the endpoints.
+      /// @param side The side of the link, either 0 or 1.
+      ///
+      Endpoint &endpoint(int side) { return endpoints_[side]; }
+      
+      /// @brief Delivers the bytes sent during the current cycle.
+      /// @details Called between cycles by CompositeCore.
+      ///
+      void exchange() {
+         
+         // What endpoint 0 sent is what endpoint 1 receives next,
+         // and vice versa. Old receive buffers become the new, empty 
+         // transmit buffers.
+         //
+         std::vector<uint8_t> *tx_0 = endpoints_[0].tx_;
+         std::vector<uint8_t> *tx_1 = endpoints_[1].tx_;
+         
+         endpoints_[0].tx_ = endpoints_[0].rx_;
+         endpoints_[1].tx_ = endpoints_[1].rx_;
+         endpoints_[0].tx_->clear();
+         endpoints_[1].tx_->clear();
+         
+         endpoints_[1].rx_ = tx_0;
+         endpoints_[0].rx_ = tx_1;
+      }
+      
+      /// @brief Appends the bytes in transit to a state image.
+      /// @details One image part per transmit and receive buffer 
+      ///        of each endpoint.
+      ///
+      void saveState(std::vector<uint8_t> &image) const {
+         for(const Endpoint &endpoint: endpoints_) {
+            appendImagePart(image, *endpoint.tx_);
+            appendImagePart(image, *endpoint.rx_);
+         }
+      }
+      
+      /// @brief Restores the bytes in transit from a state image.
+      ///
+      /// @param image The image.
+      /// @param pos The position of the link's first part. Advanced 
+      ///        past its last part.
+      ///
+      /// @returns False if the image is truncated.
+      ///
+      bool restoreState(const std::vector<uint8_t> &image, size_t &pos) {
+         for(Endpoint &endpoint: endpoints_) {
+            if(   !readImagePart(image, pos, *endpoint.tx_)
+               || !readImagePart(image, pos, *endpoint.rx_)) {
+               return false;
+            }
+         }
+         return true;
+      }
+      
+   private:
+      
+      std::vector<uint8_t> buffers_[4];
+      Endpoint endpoints_[2];
+};
+
+} // namespace papilio
@@ -15,39 +15,64 @@
  * this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "Arduino.h"
-
 #include "papilio/Simulator.h"
 #include "papilio/ActionContainer_Impl.h"
 #include "papilio/actions/Action_.h"
 #include "papilio/aux/WallTimer.h"
+#include "papilio/aux/BufferedOStream.h"
+#include "papilio/aux/AsyncOStream.h"
+#include "papilio/aux/TripleBuffer.h"
+#include "papilio/aux/RealtimeScheduler.h"
 #include "papilio/SimulatorCore_.h"
 
 #include <iostream>
 #include <iomanip>
 #include <sstream>
 #include <thread>
-#include <mutex>
+#include <algorithm>
+#include <iterator>
+#include <cerrno>
+#include <cstdlib>
+#include <cassert>
+#include <type_traits>
+
+#include <unistd.h>
 
 namespace papilio {
+   
+static_assert(std::is_same<Simulator::TimeType, SimulatorCore_::TimeType>::value,
+              "Simulator and cores must use the same time type");
 
-// Explicit template instanciations
+// Explicit template instantiations
+//
+// (the containers of typed report actions are instantiated 
+// in reports/ReportTypes.cpp)
 //
-template class ActionContainer<ReportAction<BootKeyboardReport_>>;
-template class ActionContainer<ReportAction<KeyboardReport_>>;
-template class ActionContainer<ReportAction<MouseReport_>>;
-template class ActionContainer<ReportAction<AbsoluteMouseReport_>>;
 template class ActionContainer<ReportAction_>;
 template class ActionContainer<Action_>;
 
-std::ostream &SimulatorStream_::getOStream() const
+SimulatorStream_::SimulatorStream_(const Simulator *simulator, int log_level) 
+   :  simulator_(simulator),
+      mute_(!simulator->isLogLevelEnabled(log_level))
 {
-   return simulator_->getOStream();
+   // Asynchronous output treats the entire output of a stream object 
+   // as one message. Debug and trace messages may be dropped.
+   //
+   if(AsyncOStream *async_out = simulator_->getAsyncOStream()) {
+      async_out->beginMessage(log_level >= DebugLogLevel);
+   }
 }
 
-bool SimulatorStream_::mute() const
-{ 
-   return simulator_->getQuiet(); 
+SimulatorStream_::~SimulatorStream_()
+{
+   if(AsyncOStream *async_out = simulator_->getAsyncOStream()) {
+      async_out->endMessage();
+   }
+}
+
+std::ostream &SimulatorStream_::getOStream() const
+{
+   return simulator_->getOStream();
 }
 
 void SimulatorStream_::checkLineStart() {
@@ -78,7 +103,7 @@ void SimulatorStream_::reactOnLineEnd()
 }
    
 ErrorStream::ErrorStream(const Simulator *simulator) 
-   :  SimulatorStream_(simulator)
+   :  SimulatorStream_(simulator, ErrorLogLevel)
 {   
    auto &out = this->getOStream();
    
@@ -96,15 +121,22 @@ ErrorStream::~ErrorStream()
    this->SimulatorStream_::reactOnLineStart();
    this->getOStream() << "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n";
    
+   simulator_->dumpFlightRecorder();
+   
    if(simulator_->getAbortOnFirstError()) {
       this->SimulatorStream_::reactOnLineStart();
       this->getOStream() << "Bailing out.";
+      simulator_->flush();
       exit(1);
    }
    
    // Restore color to neutral.
    //
    this->getOStream() << "\x1B[0m";
+   
+   // Errors are never held back by buffered output.
+   //
+   simulator_->flush();
 }
 
 void ErrorStream::reactOnLineStart()
@@ -114,7 +146,7 @@ void ErrorStream::reactOnLineStart()
 }
    
 DebugStream::DebugStream(const Simulator *simulator) 
-   :  SimulatorStream_(simulator)
+   :  SimulatorStream_(simulator, DebugLogLevel)
 {
    if(this->mute()) { return; }
    
@@ -146,8 +178,8 @@ void DebugStream::reactOnLineStart()
    this->getOStream() << "***Debug: ";
 }
 
-LogStream::LogStream(const Simulator *simulator) 
-   :  SimulatorStream_(simulator)
+LogStream::LogStream(const Simulator *simulator, int log_level) 
+   :  SimulatorStream_(simulator, log_level)
 {
 }
 
@@ -158,7 +190,7 @@ LogStream::~LogStream() {
 }
 
 HeaderStream::HeaderStream(const Simulator *simulator) 
-   :  SimulatorStream_(simulator)
+   :  SimulatorStream_(simulator, HeaderLogLevel)
 {  
    if(this->mute()) { return; }
    
@@ -197,6 +229,8 @@ Test::Test(Simulator *simulator, const char *name)
       error_count_start_(simulator->getErrorCount())
 {
    simulator->header() << "Test " << name;
+   simulator->flightRecorder().rearm();
+   simulator->memoryTracker().resetPeaks();
 }
 
 Test::~Test() {
@@ -204,11 +238,43 @@ Test::~Test() {
    
    auto error_count_end = simulator_->getErrorCount();
    
+   if(simulator_->getMemoryTracker().isEnabled()) {
+      simulator_->log() << "Memory footprint of test " << name_ << ":";
+      simulator_->getMemoryTracker().report(*simulator_, "   ");
+   }
+   
    if(error_count_start_ != error_count_end) {
+      simulator_->dumpFlightRecorder();
       simulator_->error() << "Test " << name_ << " failed";
    }
 }
 
+namespace {
+   
+struct SaveTypedReportActions {
+   
+   const PermanentReportActionsTuple::Type &actions_;
+   PermanentReportActionsStorageTuple::Type &storage_;
+   
+   template<size_t _I>
+   void apply() {
+      std::get<_I>(storage_) = std::get<_I>(actions_).directAccess();
+   }
+};
+
+struct RestoreTypedReportActions {
+   
+   PermanentReportActionsTuple::Type &actions_;
+   const PermanentReportActionsStorageTuple::Type &storage_;
+   
+   template<size_t _I>
+   void apply() {
+      std::get<_I>(actions_).assign(std::get<_I>(storage_));
+   }
+};
+
+} // namespace
+   
 Simulator::Simulator(std::ostream &out, 
          bool debug, 
          int cycle_duration, 
@@ -221,10 +287,7 @@ Simulator::Simulator(std::ostream &out,
       
       queued_report_actions_{*this},
       
-      permanent_boot_keyboard_report_actions_{*this},
-      permanent_keyboard_report_actions_{*this},
-      permanent_mouse_report_actions_{*this},
-      permanent_absolute_mouse_report_actions_{*this},
+      permanent_typed_report_actions_(PermanentReportActionsTuple::create(*this)),
       permanent_generic_report_actions_{*this},
       
       queued_cycle_actions_{*this},
@@ -234,29 +297,136 @@ Simulator::Simulator(std::ostream &out,
 }
 
 Simulator::~Simulator() {
+   this->stopInputJournal();
    this->footerText();
    
-   if(!test_success_) {
+   // The core may outlive the simulator, e.g. in a test runner.
+   //
+   if(simulator_core_) {
+      simulator_core_->setSimulator(nullptr);
+   }
+   
+   if(!test_success_ && terminate_on_failure_) {
       this->error() << "Terminating with exit code 1";
       exit(1);
    }
 }
 
+void Simulator::dumpFlightRecorder() const
+{
+   flight_recorder_.dumpOnce(this->getOStream());
+}
+
+void Simulator::setOStream(std::ostream &out) {
+   if(buffered_out_) {
+      buffered_out_->setTarget(out);
+   }
+   else if(async_out_) {
+      async_out_->setTarget(out);
+   }
+   else {
+      out_ = &out;
+   }
+}
+
+void Simulator::resetOutputWrapper() {
+   
+   if(buffered_out_) {
+      std::ostream &target = buffered_out_->getTarget();
+      buffered_out_->flush();
+      out_ = &target;
+      buffered_out_.reset();
+   }
+   
+   if(async_out_) {
+      std::ostream &target = async_out_->getTarget();
+      async_out_->flush();
+      out_ = &target;
+      async_out_.reset();
+   }
+}
+
+void Simulator::setOutputBuffered(bool state, std::size_t buffer_size) {
+   
+   this->resetOutputWrapper();
+   
+   if(state) {
+      buffered_out_ = std::make_shared<BufferedOStream>(*out_, buffer_size);
+      out_ = buffered_out_.get();
+   }
+}
+
+void Simulator::setOutputAsync(bool state, std::size_t buffer_size, 
+                               bool drop_debug_output) {
+   
+   this->resetOutputWrapper();
+   
+   if(state) {
+      async_out_ = std::make_shared<AsyncOStream>(*out_, buffer_size, 
+            drop_debug_output ? AsyncOStream::DropOnOverflow 
+                              : AsyncOStream::BlockOnOverflow);
+      out_ = async_out_.get();
+   }
+}
+
+void Simulator::flush() const {
+   out_->flush();
+}
+
 void Simulator::pressKey(uint8_t row, uint8_t col) {
    this->log() << "+ Activating key (" << (unsigned)row << ", " << (unsigned)col << ")";
+   this->trackKeyEvent(row, col, true);
+   this->journalKeyEvent(InputJournalRecord::PressKey, row, col);
    simulator_core_->pressKey(row, col);
 }
 
 void Simulator::releaseKey(uint8_t row, uint8_t col) {
    this->log() << "+ Releasing key (" << (unsigned)row << ", " << (unsigned)col << ")";
+   this->trackKeyEvent(row, col, false);
+   this->journalKeyEvent(InputJournalRecord::ReleaseKey, row, col);
    simulator_core_->releaseKey(row, col);
 }
 
 void Simulator::tapKey(uint8_t row, uint8_t col) {
    this->log() << "+- Tapping key (" << (unsigned)row << ", " << (unsigned)col << ")";
+   this->trackKeyEvent(row, col, true);
+   this->journalKeyEvent(InputJournalRecord::TapKey, row, col);
    simulator_core_->tapKey(row, col);
 }
 
+void Simulator::trackKeyEvent(uint8_t row, uint8_t col, bool pressed) {
+   if(!latency_tracker_.isEnabled()) { return; }
+   latency_tracker_.keyEvent(row, col, pressed, simulator_core_->getKeycode(row, col),
+                             cycle_id_, time_);
+}
+
+void Simulator::trackKeyEvents(const KeyMatrixState &mask, bool pressed) {
+   if(!latency_tracker_.isEnabled()) { return; }
+   mask.forEachSet([&](KeyOffset key_offset) {
+      this->trackKeyEvent(uint8_t(key_offset/mask.getCols()), 
+                          uint8_t(key_offset%mask.getCols()), pressed);
+   });
+}
+
+void Simulator::journalKeyEvent(InputJournalRecord::Type type, 
+                                uint8_t row, uint8_t col) {
+   if(!input_journal_.isOpen()) { return; }
+   if(!input_journal_.write(type, uint64_t(cycle_id_), time_, row, col)) {
+      input_journal_.close();
+      this->error() << "Failed to write input journal record at cycle " 
+         << cycle_id_ << ", recording stopped";
+   }
+}
+
+void Simulator::journalKeyEvents(const KeyMatrixState &mask, 
+                                 InputJournalRecord::Type type) {
+   if(!input_journal_.isOpen()) { return; }
+   mask.forEachSet([&](KeyOffset key_offset) {
+      this->journalKeyEvent(type, uint8_t(key_offset/mask.getCols()), 
+                            uint8_t(key_offset%mask.getCols()));
+   });
+}
+
 void Simulator::multiTapKeyInternal(int num_taps, uint8_t row, uint8_t col, 
                          int tap_interval_cycles,
                          std::shared_ptr<Action_> after_tap_and_cycles_action ) {
@@ -270,6 +440,8 @@ void Simulator::multiTapKeyInternal(int num_taps, uint8_t row, uint8_t col,
       
       // Do the tap
       //
+      this->trackKeyEvent(row, col, true);
+      this->journalKeyEvent(InputJournalRecord::TapKey, row, col);
       simulator_core_->tapKey(row, col);
       
       // Run a user-defined number of cycles
@@ -281,7 +453,7 @@ void Simulator::multiTapKeyInternal(int num_taps, uint8_t row, uint8_t col,
       // Check and execute the action
       //
       if(after_tap_and_cycles_action) {
-         this->log() << "Checking action after tap no. " << i;
+         PAPILIO_TRACE(*this) << "Checking action after tap no. " << i;
          if(!after_tap_and_cycles_action->eval()) {
             this->error() << "Action after tap " << i << " failed";
             after_tap_and_cycles_action->report();
@@ -297,11 +469,11 @@ void Simulator::clearAllKeys() {
    
    simulator_core_->getKeyMatrixDimensions(rows, cols);
    
-   for(uint8_t row = 0; row < rows; row++) {
-      for(uint8_t col = 0; col < cols; col++) {
-         simulator_core_->releaseKey(row, col);
-      }
-   }
+   KeyMatrixState all_keys(rows, cols);
+   all_keys.setAll();
+   
+   this->journalKeyEvent(InputJournalRecord::ReleaseAllKeys);
+   simulator_core_->releaseKeys(all_keys);
 }
 
 void Simulator::cycle(bool suppress_cycle_info_log) {
@@ -323,11 +495,21 @@ void Simulator::cyclesInternal(int n,
    }
    
    this->log() << "Running " << n << " scan cycles";
-         
-   for(int i = 0; i < n; ++i) { 
-      this->cycleInternal(true /* on_log_reports */);
-      this->evaluateActionsInternal(cycle_action_list);
+   
+   WallTimer timer;
+   timer.start();
+   
+   if(fast_forward_ && cycle_action_list.empty()) {
+      this->fastForwardInternal(n);
    }
+   else {
+      for(int i = 0; i < n; ++i) { 
+         this->cycleInternal(true /* on_log_reports */);
+         this->evaluateActionsInternal(cycle_action_list);
+      }
+   }
+   
+   this->logCycleRate(n, timer.elapsed());
       
    this->log() << "";
 }
@@ -343,21 +525,157 @@ void Simulator::advanceTimeBy(Simulator::TimeType delta_t) {
 
 void Simulator::skipTimeInternal(Simulator::TimeType delta_t) {
    
+   if(cycle_duration_ == 0) { return; }
+   
    auto start_cycle = cycle_id_;
          
    auto start_time = time_;
    
-   Simulator::TimeType elapsed_time = 0;
-   while(elapsed_time < delta_t) {
-      this->cycleInternal(true /* only_log_reports */);
-      elapsed_time = time_ - start_time;
+   WallTimer timer;
+   timer.start();
+   
+   if(fast_forward_) {
+      
+      int n_cycles = (delta_t + cycle_duration_ - 1)/cycle_duration_;
+      
+      this->fastForwardInternal(n_cycles);
+   }
+   else {
+      while(time_ - start_time < delta_t) {
+         this->cycleInternal(true /* only_log_reports */);
+      }
    }
+   
+   Simulator::TimeType elapsed_time = time_ - start_time;
       
    this->log() << elapsed_time << " ms (" << (cycle_id_ - start_cycle) << " cycles) skipped";
+   
+   this->logCycleRate(cycle_id_ - start_cycle, timer.elapsed());
       
    this->log() << "";
 }
 
+void Simulator::fastForwardInternal(int n_cycles) {
+   
+   // Everything that does not change from cycle to cycle is
+   // hoisted out of the loop.
+   //
+   SimulatorCore_ &core = *simulator_core_;
+   const TimeType cycle_duration = cycle_duration_;
+   const bool skip_idle_cycles = skip_idle_cycles_ && (cycle_duration > 0);
+   
+   int i = 0;
+   while(i < n_cycles) {
+      
+      TimeType next_wakeup_time = 0;
+      
+      TimeType n_idle = 0;
+      
+      // Queued reports are delivered by the polls of 
+      // subsequent cycles.
+      //
+      if(   skip_idle_cycles 
+         && !host_polling_.hasQueuedReports()
+         && core.isQuiescent(next_wakeup_time) 
+         && (next_wakeup_time > time_)) {
+         
+         // Cycles that start before the wakeup time do not need
+         // to run the core loop.
+         //
+         n_idle = (next_wakeup_time - time_ + cycle_duration - 1)
+                              /cycle_duration;
+                              
+         if(   !queued_cycle_actions_.empty() 
+            || !permanent_cycle_actions_.empty()) {
+            
+            // Cycle actions are due in every cycle and may
+            // change the state of the core.
+            //
+            n_idle = 1;
+         }
+         else if(n_idle > TimeType(n_cycles - i)) {
+            n_idle = n_cycles - i;
+         }
+         
+         // Scheduled events may change the state of the core as well.
+         //
+         if(!scheduled_events_.empty()) {
+            TimeType n_before_event 
+               = TimeType(scheduled_events_.getNextDue() - cycle_id_ - 1);
+            if(n_idle > n_before_event) {
+               n_idle = n_before_event;
+            }
+         }
+      }
+      else {
+         n_idle = 0;
+      }
+      
+      if(n_idle > 0) {
+         
+         if(!scheduled_events_.empty()) {
+            scheduled_events_.skip(n_idle);
+         }
+         
+         cycle_id_ += n_idle;
+         time_ += n_idle*cycle_duration;
+         n_idle_cycles_skipped_ += n_idle;
+         i += n_idle;
+         
+         std::fill(std::begin(n_typed_reports_in_cycle_), 
+                   std::end(n_typed_reports_in_cycle_), 0);
+         
+         if(   !queued_cycle_actions_.empty() 
+            || !permanent_cycle_actions_.empty()) {
+            this->processCycleActions();
+         }
+         
+         continue;
+      }
+      
+      // See cycleInternal(...) for the order.
+      //
+      if(!scheduled_events_.empty()) {
+         this->processScheduledEvents();
+      }
+      
+      ++cycle_id_;
+      ++i;
+      
+      std::fill(std::begin(n_typed_reports_in_cycle_), 
+                std::end(n_typed_reports_in_cycle_), 0);
+      
+      core.setTime(time_);
+      this->runCoreLoop(core);
+      
+      // Polls follow the core loop, as reports of cores that run
+      // in worker threads are processed at its end.
+      //
+      if(host_polling_.isEnabled() || host_polling_.hasQueuedReports()) {
+         host_polling_.poll(*this, time_, time_ + cycle_duration);
+      }
+      
+      time_ += cycle_duration;
+      
+      // Actions may have been queued or registered during the cycle, 
+      // e.g. by report actions.
+      //
+      if(   !queued_cycle_actions_.empty() 
+         || !permanent_cycle_actions_.empty()
+         || !due_scheduled_actions_.empty()) {
+         this->processCycleActions();
+      }
+   }
+}
+
+void Simulator::logCycleRate(int n_cycles, double elapsed_ms) {
+   
+   cycle_rate_ = (elapsed_ms > 0.0) ? 1000.0*n_cycles/elapsed_ms : 0.0;
+   
+   PAPILIO_LOG(*this) << n_cycles << " cycles in " << elapsed_ms << " ms ("
+      << cycle_rate_ << " cycles/s)";
+}
+
 void Simulator::advanceTimeTo(TimeType time)
 {
    if(time <= time_) {
@@ -377,6 +695,151 @@ void Simulator::init() {
    simulator_core_->init();
 }
 
+void Simulator::setCore(const std::shared_ptr<SimulatorCore_> &core) {
+   assert(core);
+   if(simulator_core_ && (simulator_core_ != core)) {
+      simulator_core_->setSimulator(nullptr);
+   }
+   simulator_core_ = core;
+   simulator_core_->setSimulator(this);
+   core_changes_.invalidate();
+}
+
+bool Simulator::replaceCore(const std::shared_ptr<SimulatorCore_> &core) {
+   
+   if(!core) {
+      this->error() << "Unable to replace the core by a null core";
+      return false;
+   }
+   
+   if(!simulator_core_) {
+      this->setCore(core);
+      core->init();
+      core->setTime(time_);
+      return true;
+   }
+   
+   uint8_t rows = 0, cols = 0;
+   simulator_core_->getKeyMatrixDimensions(rows, cols);
+   
+   uint8_t new_rows = 0, new_cols = 0;
+   core->getKeyMatrixDimensions(new_rows, new_cols);
+   
+   if((rows != new_rows) || (cols != new_cols)) {
+      this->error() << "Unable to replace the core. Key matrix dimensions differ ("
+         << int(rows) << "x" << int(cols) << " vs. " 
+         << int(new_rows) << "x" << int(new_cols) << ")";
+      return false;
+   }
+   
+   std::vector<uint8_t> core_image;
+   bool state_saved = simulator_core_->saveState(core_image);
+   
+   KeyMatrixState pressed_keys;
+   simulator_core_->getKeyMatrixState(pressed_keys);
+   
+   core->setSimulator(this);
+   core->init();
+   core->setTime(time_);
+   
+   bool state_restored = state_saved && core->restoreState(core_image);
+   
+   if(!pressed_keys.none()) {
+      core->pressKeys(pressed_keys);
+   }
+   
+   simulator_core_->setSimulator(nullptr);
+   simulator_core_ = core;
+   core_changes_.invalidate();
+   
+   if(state_restored) {
+      this->log() << "Core replaced, core state transferred";
+   }
+   else {
+      this->log() << "Core replaced, core state could not be transferred";
+   }
+   
+   return state_restored;
+}
+
+Simulator::Snapshot Simulator::snapshot() const {
+   
+   Snapshot snapshot;
+   
+   snapshot.time_ = time_;
+   snapshot.cycle_id_ = cycle_id_;
+   
+   std::copy(std::begin(n_typed_reports_in_cycle_), std::end(n_typed_reports_in_cycle_),
+             std::begin(snapshot.n_typed_reports_in_cycle_));
+   std::copy(std::begin(n_typed_overall_reports_), std::end(n_typed_overall_reports_),
+             std::begin(snapshot.n_typed_overall_reports_));
+   snapshot.n_reports_in_cycle_ = n_reports_in_cycle_;
+   snapshot.n_overall_reports_ = n_overall_reports_;
+   
+   snapshot.queued_report_actions_ = queued_report_actions_.directAccess();
+   SaveTypedReportActions save_typed_report_actions{
+         permanent_typed_report_actions_, snapshot.permanent_typed_report_actions_};
+   ForEachReportType<>::apply(save_typed_report_actions);
+   snapshot.permanent_generic_report_actions_ = permanent_generic_report_actions_.directAccess();
+   snapshot.queued_cycle_actions_ = queued_cycle_actions_.directAccess();
+   snapshot.permanent_cycle_actions_ = permanent_cycle_actions_.directAccess();
+   snapshot.scheduled_events_ = scheduled_events_;
+   host_polling_.saveQueues(snapshot.host_polling_queues_);
+   
+   auto core_image = std::make_shared<std::vector<uint8_t>>();
+   
+   if(simulator_core_->saveState(*core_image)) {
+      snapshot.core_image_ = core_image;
+   }
+   else {
+      this->error() << "The simulator core does not support saving its state";
+   }
+   
+   this->log() << "Snapshot taken";
+   
+   return snapshot;
+}
+
+bool Simulator::restore(const Snapshot &snapshot) {
+   
+   time_ = snapshot.time_;
+   cycle_id_ = snapshot.cycle_id_;
+   
+   std::copy(std::begin(snapshot.n_typed_reports_in_cycle_), std::end(snapshot.n_typed_reports_in_cycle_),
+             std::begin(n_typed_reports_in_cycle_));
+   std::copy(std::begin(snapshot.n_typed_overall_reports_), std::end(snapshot.n_typed_overall_reports_),
+             std::begin(n_typed_overall_reports_));
+   n_reports_in_cycle_ = snapshot.n_reports_in_cycle_;
+   n_overall_reports_ = snapshot.n_overall_reports_;
+   
+   queued_report_actions_.assign(snapshot.queued_report_actions_);
+   RestoreTypedReportActions restore_typed_report_actions{
+         permanent_typed_report_actions_, snapshot.permanent_typed_report_actions_};
+   ForEachReportType<>::apply(restore_typed_report_actions);
+   permanent_generic_report_actions_.assign(snapshot.permanent_generic_report_actions_);
+   queued_cycle_actions_.assign(snapshot.queued_cycle_actions_);
+   permanent_cycle_actions_.assign(snapshot.permanent_cycle_actions_);
+   scheduled_events_ = snapshot.scheduled_events_;
+   due_scheduled_actions_.clear();
+   host_polling_.restoreQueues(snapshot.host_polling_queues_);
+   
+   if(!snapshot.core_image_) {
+      this->error() << "Unable to restore core state. The snapshot does not contain it";
+      return false;
+   }
+   
+   core_changes_.invalidate();
+   
+   if(!simulator_core_->restoreState(*snapshot.core_image_)) {
+      this->error() << "Failed to restore the core state";
+      return false;
+   }
+   
+   this->log() << "Snapshot of t = " << time_ << " ms restored";
+   
+   return true;
+}
+
 bool Simulator::checkStatus() {
    
    if(!queued_report_actions_.empty()) {
@@ -385,6 +848,12 @@ bool Simulator::checkStatus() {
       test_success_ = false;
    }
    
+   if(!scheduled_events_.empty()) {
+      this->error() << "There are " << scheduled_events_.size()
+         << " scheduled events that were never due.";
+      test_success_ = false;
+   }
+   
    if(!actions_passed_) {
       this->error() << "Not all actions passed.";
       test_success_ = false;
@@ -444,11 +913,33 @@ void Simulator::footerText() {
    this->log() << "error_count: " << error_count_;
    this->log() << "";
    this->log() << "num. overall reports processed: " << n_typed_overall_reports_[AnyTypeReportTypeId];
-   this->log() << "num. boot keyboard reports processed: " << n_typed_overall_reports_[BootKeyboardReportTypeIdId];
-   this->log() << "num. keyboard reports processed: " << n_typed_overall_reports_[KeyboardReportTypeId];
-   this->log() << "num. mouse reports processed: " << n_typed_overall_reports_[MouseReportTypeId];
-   this->log() << "num. absolute mouse reports processed: " << n_typed_overall_reports_[AbsoluteMouseReportTypeId];
+   for(int type_id = 1; type_id < NumReportTypeIds; ++type_id) {
+      this->log() << "num. " << getReportTypeString(type_id) << " reports processed: " 
+         << n_typed_overall_reports_[type_id];
+   }
    this->log() << "";
+   if(profiler_.isEnabled()) {
+      profiler_.report(*this);
+      this->log() << "";
+   }
+   if(memory_tracker_.isEnabled()) {
+      this->log() << "Memory footprint:";
+      memory_tracker_.report(*this, "   ");
+   }
+   
+   if(latency_tracker_.isEnabled()) {
+      latency_tracker_.report(*this);
+      this->log() << "";
+   }
+   if(host_polling_.isEnabled()) {
+      host_polling_.report(*this);
+      this->log() << "";
+   }
+   if(async_out_ && (async_out_->getNumDroppedMessages() > 0)) {
+      this->log() << "num. debug messages dropped by asynchronous output: " 
+         << async_out_->getNumDroppedMessages();
+      this->log() << "";
+   }
    this->checkStatus();
    this->getOStream() << "\x1B[33;1m";
    this->log() << "";
@@ -459,52 +950,299 @@ void Simulator::footerText() {
    //
    //this->getOStream() << "\x1B[0m";
    this->getOStream() << "\x1B[0m";
+   
+   this->flush();
 }
             
 void Simulator::cycleInternal(bool only_log_reports) {
    
+   // Scheduled key events are applied before the cycle id is advanced,
+   // exactly like key events that are applied between two cycles. 
+   // They are thus journaled and latency tracked with the same cycle id 
+   // and time as their direct counterparts.
+   //
+   if(!scheduled_events_.empty()) {
+      this->processScheduledEvents();
+   }
+   
    ++cycle_id_;
    n_reports_in_cycle_ = 0;
    
-   for(int i = 0; i < 3; ++i) {
-      n_typed_reports_in_cycle_[i] = 0;
-   }
+   std::fill(std::begin(n_typed_reports_in_cycle_), 
+             std::end(n_typed_reports_in_cycle_), 0);
    
    if(!only_log_reports) {
-      this->log() << "Scan cycle " << cycle_id_;
+      PAPILIO_TRACE(*this) << "Scan cycle " << cycle_id_;
    }
    
    // Set the global simulator time.
    //
    simulator_core_->setTime(time_);
 
-   simulator_core_->loop();
+   this->runCoreLoop(*simulator_core_);
+   
+   if(host_polling_.isEnabled() || host_polling_.hasQueuedReports()) {
+      host_polling_.poll(*this, time_, time_ + cycle_duration_);
+   }
    
    if(n_reports_in_cycle_ == 0) {
       if(!only_log_reports) {
-         this->log() << "No keyboard reports processed";
+         PAPILIO_TRACE(*this) << "No keyboard reports processed";
       }
    }
    else {
-      this->log() << n_reports_in_cycle_ << " keyboard reports processed";
+      PAPILIO_TRACE(*this) << n_reports_in_cycle_ << " keyboard reports processed";
    }
    
    time_ += cycle_duration_;
    
+   this->processCycleActions();
+}
+
+void Simulator::processCycleActions() {
+   
+   if(!due_scheduled_actions_.empty()) {
+      PAPILIO_TRACE(*this) << "Processing " << due_scheduled_actions_.size()
+         << " scheduled actions";
+      
+      this->evaluateActionsInternal(due_scheduled_actions_);
+      due_scheduled_actions_.clear();
+   }
+   
    if(!queued_cycle_actions_.empty()) {
-      this->log() << "Processing " << queued_cycle_actions_.size()
+      PAPILIO_TRACE(*this) << "Processing " << queued_cycle_actions_.size()
          << " queued cycle actions";
+      uint64_t start = profiler_.isEnabled() ? Profiler::now() : 0;
+      
       this->evaluateActionsInternal(queued_cycle_actions_.directAccess());
       
+      if(profiler_.isEnabled()) {
+         profiler_.addPhaseTime(Profiler::QueuedCycleActionsPhase, 
+                                Profiler::now() - start);
+      }
+      
       queued_cycle_actions_.clear();
    }
    
    if(!permanent_cycle_actions_.empty()) {
-      this->log() << "Processing " << permanent_cycle_actions_.size()
+      PAPILIO_TRACE(*this) << "Processing " << permanent_cycle_actions_.size()
          << " permanent cycle actions";
       
+      uint64_t start = profiler_.isEnabled() ? Profiler::now() : 0;
+      
       this->evaluateActionsInternal(permanent_cycle_actions_.directAccess());
+      
+      if(profiler_.isEnabled()) {
+         profiler_.addPhaseTime(Profiler::PermanentCycleActionsPhase, 
+                                Profiler::now() - start);
+      }
+   }
+}
+
+void Simulator::schedulePressKey(const ScheduleTime &when, uint8_t row, uint8_t col) {
+   ScheduledEvent event;
+   event.type_ = ScheduledEvent::PressKey;
+   event.row_ = row;
+   event.col_ = col;
+   this->scheduleEvent(when, event);
+}
+
+void Simulator::scheduleReleaseKey(const ScheduleTime &when, uint8_t row, uint8_t col) {
+   ScheduledEvent event;
+   event.type_ = ScheduledEvent::ReleaseKey;
+   event.row_ = row;
+   event.col_ = col;
+   this->scheduleEvent(when, event);
+}
+
+void Simulator::scheduleTapKey(const ScheduleTime &when, uint8_t row, uint8_t col) {
+   ScheduledEvent event;
+   event.type_ = ScheduledEvent::TapKey;
+   event.row_ = row;
+   event.col_ = col;
+   this->scheduleEvent(when, event);
+}
+
+void Simulator::scheduleAction(const ScheduleTime &when, 
+                               const std::shared_ptr<Action_> &action) {
+   action->setSimulator(this);
+   ScheduledEvent event;
+   event.type_ = ScheduledEvent::EvaluateAction;
+   event.action_ = action;
+   this->scheduleEvent(when, event);
+}
+
+void Simulator::scheduleEvent(const ScheduleTime &when, const ScheduledEvent &event) {
+   
+   // The cycle that runs next has id cycle_id_ + 1 and starts at time_.
+   //
+   uint64_t cycle_id = 0;
+   
+   switch(when.type_) {
+      
+      case ScheduleTime::AbsoluteCycle:
+         cycle_id = when.value_;
+         break;
+         
+      case ScheduleTime::RelativeCycles:
+         cycle_id = uint64_t(cycle_id_) + when.value_;
+         break;
+         
+      case ScheduleTime::AbsoluteTime:
+      case ScheduleTime::RelativeTime:
+         {
+            this->checkCycleDurationSet();
+            
+            TimeType time = (when.type_ == ScheduleTime::RelativeTime) 
+                                 ? time_ + when.value_ : when.value_;
+            
+            cycle_id = uint64_t(cycle_id_) + 1;
+            if((time > time_) && (cycle_duration_ > 0)) {
+               cycle_id += (time - time_ + cycle_duration_ - 1)/cycle_duration_;
+            }
+         }
+         break;
+   }
+   
+   // The wheel only advances while it contains events.
+   //
+   if(scheduled_events_.empty()) {
+      scheduled_events_.reset(cycle_id_);
+   }
+   
+   scheduled_events_.insert(cycle_id, event);
+}
+
+void Simulator::clearScheduledEvents() {
+   scheduled_events_ = TimerWheel<ScheduledEvent>{};
+   due_scheduled_actions_.clear();
+}
+
+void Simulator::processScheduledEvents() {
+   
+   scheduled_events_.step([this](ScheduledEvent &event) {
+      switch(event.type_) {
+         case ScheduledEvent::PressKey:
+            this->pressKey(event.row_, event.col_);
+            break;
+         case ScheduledEvent::ReleaseKey:
+            this->releaseKey(event.row_, event.col_);
+            break;
+         case ScheduledEvent::TapKey:
+            this->tapKey(event.row_, event.col_);
+            break;
+         case ScheduledEvent::EvaluateAction:
+            due_scheduled_actions_.push_back(event.action_);
+            break;
+      }
+   });
+}
+
+void Simulator::runCoreLoop(SimulatorCore_ &core) {
+   
+   if(!memory_tracker_.isEnabled()) {
+      this->runCoreLoopProfiled(core);
+      return;
+   }
+   
+   memory_tracker_.beginCycle();
+   {
+      MemoryTracker::HeapScope heap_scope(true);
+      this->runCoreLoopProfiled(core);
+   }
+   memory_tracker_.endCycle();
+}
+
+void Simulator::runCoreLoopProfiled(SimulatorCore_ &core) {
+   
+   if(!profiler_.isEnabled()) {
+      core.loop();
+      return;
+   }
+   
+   profiler_.takeNestedReportTime();
+   profiler_.takeNestedReportCPUCycles();
+   
+   // The key state is sampled before the loop runs, as the
+   // loop may change it.
+   //
+   core.getKeyMatrixState(cycle_start_keys_);
+   
+   uint64_t start_cpu_cycles = profiler_.readCPUCycles();
+   uint64_t start = Profiler::now();
+   core.loop();
+   uint64_t duration = Profiler::now() - start;
+   uint64_t cpu_cycles = profiler_.readCPUCycles() - start_cpu_cycles;
+   
+   // Reports are processed during the core loop. Their processing
+   // time is accounted for separately.
+   //
+   uint64_t report_time = profiler_.takeNestedReportTime();
+   uint64_t report_cpu_cycles = profiler_.takeNestedReportCPUCycles();
+   
+   uint64_t core_time = (duration > report_time) ? duration - report_time : 0;
+   uint64_t core_cpu_cycles = (cpu_cycles > report_cpu_cycles) ? cpu_cycles - report_cpu_cycles : 0;
+   
+   profiler_.addPhaseTime(Profiler::CoreLoopPhase, core_time);
+   
+   if(profiler_.isCPUCycleCounting()) {
+      profiler_.addCoreLoopCPUCycles(core_cpu_cycles);
    }
+   
+   if(profiler_.isWorstCoreLoop(core_time)) {
+      
+      Profiler::WorstCycle worst_cycle;
+      worst_cycle.duration_ = core_time;
+      worst_cycle.cpu_cycles_ = core_cpu_cycles;
+      worst_cycle.cycle_id_ = cycle_id_;
+      worst_cycle.time_ = time_;
+      worst_cycle.pressed_keys_ = cycle_start_keys_;
+      
+      profiler_.setWorstCoreLoop(worst_cycle);
+   }
+}
+
+bool Simulator::evalProfiled(Action_ &action) {
+   
+   uint64_t start = Profiler::now();
+   bool result = action.eval();
+   profiler_.addActionTime(action, Profiler::now() - start);
+   
+   return result;
+}
+
+std::size_t Simulator::getPermanentReportActionBucketSize(int type_id) const {
+   this->updateGenericReportActionBuckets();
+   return generic_report_action_buckets_[type_id].size();
+}
+
+void Simulator::updateGenericReportActionBuckets() const {
+   
+   if(generic_report_action_buckets_revision_ 
+                  == permanent_generic_report_actions_.getRevision()) {
+      return;
+   }
+   
+   for(auto &bucket: generic_report_action_buckets_) {
+      bucket.clear();
+   }
+   
+   for(auto &action: permanent_generic_report_actions_.directAccess()) {
+      
+      auto type_id = action->getReportTypeId();
+      
+      if(type_id == AnyTypeReportTypeId) {
+         for(auto &bucket: generic_report_action_buckets_) {
+            bucket.push_back(action);
+         }
+      }
+      else if(type_id < NumReportTypeIds) {
+         generic_report_action_buckets_[type_id].push_back(action);
+      }
+   }
+   
+   generic_report_action_buckets_revision_ 
+      = permanent_generic_report_actions_.getRevision();
 }
 
 void Simulator::checkCycleDurationSet() {
@@ -537,108 +1275,229 @@ void Simulator::runRealtime(TimeType duration,
 {
    auto n_cycles = duration/cycle_duration_;
    
-   WallTimer timer;
-      
-   for(decltype(n_cycles) i = 0; i < n_cycles; ++i) {
+   realtime_lateness_.clear();
+   
+   RealtimeScheduler scheduler(cycle_duration_, realtime_spin_duration_,
+                               &realtime_lateness_);
+   scheduler.start();
       
-      timer.start();
+   for(decltype(n_cycles) i = 0; (duration == 0) || (i < n_cycles); ++i) {
       
       this->cycle();
       cycle_function();
       
       // Slow down the simulation if necessary.
       //
-      do {} while(timer.elapsed() < cycle_duration_);
+      scheduler.wait();
    }
+   
+   this->logRealtimeLateness();
 }
 
-class DataCollectorThread
+void Simulator::logRealtimeLateness()
+{
+   static constexpr double ns_per_ms = 1e6;
+   
+   PAPILIO_LOG(*this) << "Realtime lateness of " << realtime_lateness_.getCount() 
+      << " cycles: p99 " << realtime_lateness_.getPercentile(99)/ns_per_ms
+      << " ms, max " << realtime_lateness_.getMax()/ns_per_ms << " ms";
+}
+
+namespace {
+   
+// Reads key frames from a file descriptor and hands the latest one 
+// over to the simulation loop. Reads are blocking, so the thread 
+// sleeps while there is no input.
+//
+// Two framings are accepted and may be mixed.
+//
+//    text:    a line of whitespace separated integers, the lower 8 bits
+//             of each representing the state of 8 keys. Missing integers
+//             represent released keys. Lines starting with '.' are ignored.
+//    binary:  the byte 0x02 followed by a bitfield of (rows*cols + 7)/8
+//             bytes but at least 32 bytes. Bits beyond the last key 
+//             are ignored.
+//
+class RemoteInputThread
 {
    public:
       
-      static constexpr uint8_t n_bytes_per_row = 8;
+      static constexpr uint8_t binary_frame_start = 0x02;
+      
+      static constexpr std::size_t min_binary_frame_bytes = 32;
       
-      void operator()()     
+      RemoteInputThread(int fd, uint8_t rows, uint8_t cols,
+                        TripleBuffer<KeyMatrixState> &frames)
+         :  fd_(fd),
+            rows_(rows),
+            cols_(cols),
+            frames_(frames)
       {
-         std::string line;
+         std::size_t n_bytes = KeyMatrixState(rows, cols).getNumBytes();
+         n_binary_frame_bytes_ = (n_bytes > min_binary_frame_bytes) 
+                                    ? n_bytes : min_binary_frame_bytes;
+      }
+      
+      void operator()() {
+         
+         uint8_t buffer[4096];
          
          while(1) {
             
-            if(std::cin.peek() == EOF) {
-               continue;
-            }
-            std::getline(std::cin, line);
+            ssize_t n_read = ::read(fd_, buffer, sizeof(buffer));
             
-            if(line.empty() || line[0] == '.') {
-               continue;
+            if(n_read == 0) { break; } // End of input
+            
+            if(n_read < 0) {
+               if(errno == EINTR) { continue; }
+               break;
             }
-
-            std::unique_lock<std::mutex> lock(mutex_);
             
-            std::istringstream line_stream(line);
-            for(uint8_t byte_id = 0; byte_id < n_bytes_per_row; ++byte_id) {
-               line_stream >> key_bitfield_[byte_id];
+            for(ssize_t i = 0; i < n_read; ++i) {
+               this->parse(buffer[i]);
             }
          }
       }
       
    private:
-   
-      uint16_t key_bitfield_[n_bytes_per_row] = {};
-      std::mutex mutex_;
       
-      friend class Simulator;
+      enum Mode { Idle, Text, Binary };
+      
+      void parse(uint8_t byte) {
+         
+         switch(mode_) {
+            
+            case Idle:
+               if(byte == binary_frame_start) {
+                  mode_ = Binary;
+                  n_frame_bytes_ = 0;
+                  this->backFrame().clear();
+               }
+               else if(byte != '\n') {
+                  mode_ = Text;
+                  line_.clear();
+                  this->parse(byte);
+               }
+               break;
+               
+            case Text:
+               if(byte == '\n') {
+                  this->parseLine();
+                  mode_ = Idle;
+               }
+               else {
+                  line_ += char(byte);
+               }
+               break;
+               
+            case Binary:
+               {
+                  KeyMatrixState &frame = frames_.back();
+                  if(n_frame_bytes_ < frame.getNumBytes()) {
+                     frame.setByte(n_frame_bytes_, byte);
+                  }
+               }
+               ++n_frame_bytes_;
+               if(n_frame_bytes_ == n_binary_frame_bytes_) {
+                  frames_.publish();
+                  mode_ = Idle;
+               }
+               break;
+         }
+      }
+      
+      void parseLine() {
+         
+         if(line_[0] == '.') { return; }
+         
+         KeyMatrixState &frame = this->backFrame();
+         frame.clear();
+         
+         const char *pos = line_.c_str();
+         for(std::size_t byte_id = 0; byte_id < frame.getNumBytes(); ++byte_id) {
+            char *end = nullptr;
+            unsigned long value = strtoul(pos, &end, 10);
+            if(end == pos) { break; }
+            frame.setByte(byte_id, uint8_t(value));
+            pos = end;
+         }
+         
+         frames_.publish();
+      }
+      
+      // Buffers are sized lazily, so that only the first use
+      // of each of them allocates.
+      //
+      KeyMatrixState &backFrame() {
+         KeyMatrixState &frame = frames_.back();
+         if((frame.getRows() != rows_) || (frame.getCols() != cols_)) {
+            frame.resize(rows_, cols_);
+         }
+         return frame;
+      }
+      
+   private:
+      
+      int fd_;
+      uint8_t rows_;
+      uint8_t cols_;
+      TripleBuffer<KeyMatrixState> &frames_;
+      
+      Mode mode_ = Idle;
+      std::string line_;
+      std::size_t n_frame_bytes_ = 0;
+      std::size_t n_binary_frame_bytes_ = 0;
 };
+
+} // namespace
  
 void Simulator::runRemoteControlled(const std::function<void()> &cycle_callback,
-                                    bool realtime
+                                    bool realtime,
+                                    int input_fd
 )
 {
-   WallTimer timer;
+   uint8_t rows = 0, cols = 0;
+   simulator_core_->getKeyMatrixDimensions(rows, cols);
+   
+   TripleBuffer<KeyMatrixState> frames;
    
-   DataCollectorThread dct;
+   std::thread thread_obj(RemoteInputThread{input_fd, rows, cols, frames});
    
-   std::thread thread_obj(std::ref(dct));
+   KeyMatrixState applied(rows, cols);
+   KeyMatrixState pressed(rows, cols), released(rows, cols);
+   
+   realtime_lateness_.clear();
+   
+   RealtimeScheduler scheduler(cycle_duration_, realtime_spin_duration_,
+                               &realtime_lateness_);
+   scheduler.start();
    
    while(1) {
       
-      if(realtime) {
-         timer.start();
-      }
-      
-      // The additional scope is necessary to limit the lifetime
-      // of the mutex lock
+      // Only keys whose state changed since the last frame 
+      // are applied to the core.
       //
-      {
-      std::unique_lock<std::mutex> lock(dct.mutex_);
-   
-      uint8_t rows = 0, cols = 0;
-      
-      simulator_core_->getKeyMatrixDimensions(rows, cols);
-      
-      for(uint8_t row = 0; row < rows; row++) {
-         for(uint8_t col = 0; col < cols; col++) {
-            
-            uint16_t pos = row*cols + col;
-            
-            uint8_t byte_id = pos/DataCollectorThread::n_bytes_per_row;
-            uint8_t bit_id = pos%DataCollectorThread::n_bytes_per_row;
-            
-            bool is_keyswitch_pressed = bitRead(dct.key_bitfield_[byte_id], bit_id);// & (1 << bit_id);
-            
-            if(is_keyswitch_pressed) {
-               
-               if(!simulator_core_->isKeyPressed(row, col)) {
-                  simulator_core_->pressKey(row, col);
-               }
-            }
-            else {
-               if(simulator_core_->isKeyPressed(row, col)) {
-                  simulator_core_->releaseKey(row, col);
-               }
-            }
+      if(frames.update()) {
+         
+         const KeyMatrixState &frame = frames.front();
+         
+         for(std::size_t w = 0; w < frame.getNumWords(); ++w) {
+            pressed.setWord(w, frame.getWord(w) & ~applied.getWord(w));
+            released.setWord(w, applied.getWord(w) & ~frame.getWord(w));
          }
-      }
+         
+         if(!released.none()) {
+            this->trackKeyEvents(released, false);
+            this->journalKeyEvents(released, InputJournalRecord::ReleaseKey);
+            simulator_core_->releaseKeys(released);
+         }
+         if(!pressed.none()) {
+            this->trackKeyEvents(pressed, true);
+            this->journalKeyEvents(pressed, InputJournalRecord::PressKey);
+            simulator_core_->pressKeys(pressed);
+         }
+         
+         applied = frame;
       }
       
       this->cycleInternal(true /*only log reports*/);
@@ -648,15 +1507,138 @@ void Simulator::runRemoteControlled(const std::function<void()> &cycle_callback,
       // Slow down the simulation if necessary.
       //
       if(realtime) {
-         double elapsed = 0;
-         do {
-            elapsed = timer.elapsed();
-            //std::cout << "Elapsed: " << elapsed << std::endl;
-         } while(elapsed < cycle_duration_);
+         scheduler.wait();
       }
    }
    
    thread_obj.join();
 }
 
+bool Simulator::startInputJournal(const std::string &filename)
+{
+   uint8_t rows = 0, cols = 0;
+   simulator_core_->getKeyMatrixDimensions(rows, cols);
+   
+   if(!input_journal_.open(filename, rows, cols, uint32_t(cycle_duration_),
+                           uint64_t(cycle_id_), time_)) {
+      this->error() << "Unable to open input journal " << filename;
+      return false;
+   }
+   
+   this->log() << "Recording input journal " << filename;
+   
+   return true;
+}
+
+void Simulator::stopInputJournal()
+{
+   if(!input_journal_.isOpen()) { return; }
+   
+   this->journalKeyEvent(InputJournalRecord::EndOfJournal);
+   
+   if(input_journal_.isOpen()) {
+      this->log() << "Input journal stopped after " 
+         << input_journal_.getNumRecords() - 1 << " key events";
+      input_journal_.close();
+   }
+}
+
+bool Simulator::replayInputJournal(const std::string &filename, bool fast_forward)
+{
+   InputJournalReader reader;
+   
+   if(!reader.open(filename)) {
+      this->error() << "Unable to open input journal " << filename;
+      return false;
+   }
+   
+   uint8_t rows = 0, cols = 0;
+   simulator_core_->getKeyMatrixDimensions(rows, cols);
+   
+   if((reader.getRows() != rows) || (reader.getCols() != cols)) {
+      this->error() << "Unable to replay input journal " << filename 
+         << ". Key matrix dimensions differ ("
+         << int(reader.getRows()) << "x" << int(reader.getCols()) << " vs. " 
+         << int(rows) << "x" << int(cols) << ")";
+      return false;
+   }
+   
+   if(int(reader.getCycleDuration()) != int(cycle_duration_)) {
+      this->error() << "Unable to replay input journal " << filename 
+         << ". Cycle durations differ (" << reader.getCycleDuration() 
+         << " ms vs. " << cycle_duration_ << " ms)";
+      return false;
+   }
+   
+   this->log() << "Replaying input journal " << filename;
+   
+   WallTimer timer;
+   timer.start();
+   
+   const uint64_t start_cycle_id = uint64_t(cycle_id_);
+   const TimeType start_time = time_;
+   
+   bool time_diverged = false;
+   
+   InputJournalRecord record;
+   
+   while(reader.next(record)) {
+      
+      uint64_t cycle_id = start_cycle_id + record.cycle_id_;
+      
+      if(cycle_id > uint64_t(cycle_id_)) {
+         
+         int n_cycles = int(cycle_id - uint64_t(cycle_id_));
+         
+         if(fast_forward) {
+            this->fastForwardInternal(n_cycles);
+         }
+         else {
+            for(int i = 0; i < n_cycles; ++i) {
+               this->cycleInternal(true /* only log reports */);
+            }
+         }
+      }
+      
+      // Times only diverge if the cycle duration was changed 
+      // during the recording.
+      //
+      if(!time_diverged && (time_ - start_time != record.time_)) {
+         this->error() << "Input journal time " << record.time_ 
+            << " ms diverges from replay time " << time_ - start_time 
+            << " ms at cycle " << cycle_id_;
+         time_diverged = true;
+      }
+      
+      switch(record.type_) {
+         case InputJournalRecord::PressKey:
+            this->pressKey(record.row_, record.col_);
+            break;
+         case InputJournalRecord::ReleaseKey:
+            this->releaseKey(record.row_, record.col_);
+            break;
+         case InputJournalRecord::TapKey:
+            this->tapKey(record.row_, record.col_);
+            break;
+         case InputJournalRecord::ReleaseAllKeys:
+            this->clearAllKeys();
+            break;
+         case InputJournalRecord::EndOfJournal:
+            break;
+      }
+   }
+   
+   if(reader.isCorrupt()) {
+      this->error() << "Input journal " << filename << " is corrupt after " 
+         << reader.getNumRecordsRead() << " records";
+      return false;
+   }
+   
+   this->logCycleRate(int(uint64_t(cycle_id_) - start_cycle_id), timer.elapsed());
+   
+   this->log() << "Replayed " << reader.getNumRecordsRead() << " journal records";
+   
+   return !time_diverged;
+}
+
 } // namespace papilio
@@ -19,11 +19,18 @@
 
 #include "papilio/ActionContainer.h"
 #include "papilio/ActionQueueAdaptor.h"
-#include "papilio/reports/BootKeyboardReport_.h"
-#include "papilio/reports/KeyboardReport_.h"
-#include "papilio/reports/MouseReport_.h"
-#include "papilio/reports/AbsoluteMouseReport_.h"
+#include "papilio/reports/ReportTypes.h"
 #include "papilio/actions/generic_report/ReportAction.h"
+#include "papilio/aux/Histogram.h"
+#include "papilio/Profiler.h"
+#include "papilio/CoreChanges.h"
+#include "papilio/LatencyTracker.h"
+#include "papilio/ReportFlightRecorder.h"
+#include "papilio/HostPollingModel.h"
+#include "papilio/MemoryTracker.h"
+#include "papilio/DeferredReports.h"
+#include "papilio/InputJournal.h"
+#include "papilio/aux/TimerWheel.h"
 
 #include <vector>
 #include <functional>
@@ -34,7 +41,24 @@ namespace papilio {
    
 class Simulator;
 class SimulatorCore_;
+class KeyMatrixState;
 class Action_;
+class BufferedOStream;
+class AsyncOStream;
+
+// The action containers are explicitly instantiated in Simulator.cpp
+// and reports/ReportTypes.cpp. The declarations prevent every 
+// translation unit that includes this file from instantiating them again.
+//
+extern template class ActionContainer<Action_>;
+extern template class ActionContainer<ReportAction_>;
+
+#define PAPILIO_EXTERN_REPORT_ACTION_CONTAINER_(REPORT_TYPE, TYPE_ID)          \
+   extern template class ActionContainer<ReportAction<REPORT_TYPE>>;
+
+PAPILIO_FOR_EACH_REPORT_TYPE(PAPILIO_EXTERN_REPORT_ACTION_CONTAINER_)
+
+#undef PAPILIO_EXTERN_REPORT_ACTION_CONTAINER_
 
 /// @brief An auxiliary tag template for method selection.
 /// @details This class is necessary as C++ does not allow
@@ -51,39 +75,87 @@ struct ReportType {};
 /// @private
 ///
 template<typename _ReportType>
-struct ReportTraits {};
+struct PermanentReportActionsOf {
+   typedef ActionContainer<ReportAction<_ReportType>> Type;
+};
 
 /// @private
 ///
-template<>
-struct ReportTraits<BootKeyboardReport_>
-{
-   static constexpr int type_id = BootKeyboardReportTypeIdId;
+template<typename _ReportType>
+struct PermanentReportActionsStorageOf {
+   typedef typename ActionContainer<ReportAction<_ReportType>>::StorageType Type;
 };
 
 /// @private
 ///
-template<>
-struct ReportTraits<KeyboardReport_>
-{
-   static constexpr int type_id = KeyboardReportTypeId;
-};
+typedef ReportTypeTuple<PermanentReportActionsOf, ReportTypes> 
+   PermanentReportActionsTuple;
 
 /// @private
 ///
-template<>
-struct ReportTraits<MouseReport_>
-{
-   static constexpr int type_id = MouseReportTypeId;
+typedef ReportTypeTuple<PermanentReportActionsStorageOf, ReportTypes> 
+   PermanentReportActionsStorageTuple;
+
+/// @brief The log levels of simulator output.
+/// @details Output is only generated for log levels that are less or 
+///        equal to the current log level of the simulator
+///        (see Simulator::setLogLevel(...)). Errors are always reported.
+///        Per-cycle and per-report output is generated at trace level.
+///
+enum {
+   ErrorLogLevel = 0,
+   HeaderLogLevel = 1,
+   StandardLogLevel = 2,
+   DebugLogLevel = 3,
+   TraceLogLevel = 4
 };
 
+/// @brief The maximum log level that is compiled in.
+/// @details Log statements of a higher level that are issued through
+///        the PAPILIO_LOG, PAPILIO_TRACE, ... macros are removed
+///        at compile time. Define e.g. PAPILIO_MAX_LOG_LEVEL=2 
+///        to strip all per-cycle and per-report output from the hot path.
+///
+#ifndef PAPILIO_MAX_LOG_LEVEL
+#define PAPILIO_MAX_LOG_LEVEL 4
+#endif
+
 /// @private
 ///
-template<>
-struct ReportTraits<AbsoluteMouseReport_>
-{
-   static constexpr int type_id = AbsoluteMouseReportTypeId;
-};
+#define PAPILIO_LOG_AT_LEVEL_(SIMULATOR, LOG_LEVEL, STREAM)                    \
+   if(   ((LOG_LEVEL) > PAPILIO_MAX_LOG_LEVEL)                                 \
+      || !(SIMULATOR).isLogLevelEnabled(LOG_LEVEL)) {}                         \
+   else (SIMULATOR).STREAM()
+   
+/// @brief Generates header output.
+/// @details In contrast to calling the Simulator's header() method directly,
+///        stream operands are not evaluated at all if header output 
+///        is disabled, e.g. PAPILIO_HEADER(simulator) << "Text";
+///
+#define PAPILIO_HEADER(SIMULATOR)                                              \
+   PAPILIO_LOG_AT_LEVEL_(SIMULATOR, papilio::HeaderLogLevel, header)
+   
+/// @brief Generates log output.
+/// @details Stream operands are not evaluated if logging is disabled, 
+///        e.g. PAPILIO_LOG(simulator) << "Text " << expensiveFunction();
+///
+#define PAPILIO_LOG(SIMULATOR)                                                 \
+   PAPILIO_LOG_AT_LEVEL_(SIMULATOR, papilio::StandardLogLevel, log)
+   
+/// @brief Generates debug output.
+/// @details Stream operands are not evaluated if debug output is disabled.
+///
+#define PAPILIO_DEBUG(SIMULATOR)                                               \
+   PAPILIO_LOG_AT_LEVEL_(SIMULATOR, papilio::DebugLogLevel, debug)
+   
+/// @brief Generates trace output.
+/// @details Use this for output that is generated in every cycle or for 
+///        every report. Stream operands are not evaluated if trace output
+///        is disabled. Trace output is removed at compile time if
+///        PAPILIO_MAX_LOG_LEVEL is less than TraceLogLevel.
+///
+#define PAPILIO_TRACE(SIMULATOR)                                               \
+   PAPILIO_LOG_AT_LEVEL_(SIMULATOR, papilio::TraceLogLevel, trace)
 
 /// @brief An abstract simulator output stream.
 ///
@@ -98,9 +170,9 @@ class SimulatorStream_ {
       ///
       struct Endl {};
       
-      SimulatorStream_(const Simulator *simulator) : simulator_(simulator) {}
+      SimulatorStream_(const Simulator *simulator, int log_level);
       
-      virtual ~SimulatorStream_() {}
+      virtual ~SimulatorStream_();
 
    protected:
       
@@ -120,10 +192,10 @@ class SimulatorStream_ {
       void output(const Endl &) {
          line_start_ = true;
          this->reactOnLineEnd();
-         this->getOStream() << std::endl;
+         this->getOStream() << '\n';
       }
       
-      bool mute() const;
+      bool mute() const { return mute_; }
       
    protected:
       
@@ -131,6 +203,7 @@ class SimulatorStream_ {
       
    private:
       
+      const bool mute_;
       bool line_start_ = true;
 };
    
@@ -183,7 +256,7 @@ class LogStream : public SimulatorStream_ {
    
    public:
       
-      LogStream(const Simulator *simulator);
+      LogStream(const Simulator *simulator, int log_level = StandardLogLevel);
       virtual ~LogStream() override;
       
       template<typename _T>
@@ -233,6 +306,57 @@ class Test {
 };
 
         
+/// @brief The point in time at which a scheduled event is due.
+/// @details Events are always due at the start of a cycle. Times are 
+///        converted to cycles when an event is scheduled, based on the
+///        current cycle duration. Scheduling an event for a cycle that 
+///        already ran makes it due in the next cycle.
+///
+///        See Simulator::schedulePressKey(...) and related methods.
+///
+class ScheduleTime
+{
+   public:
+      
+      /// @brief The first cycle that starts at or after a given time [ms].
+      ///
+      static ScheduleTime at(unsigned long time) { 
+         return ScheduleTime{AbsoluteTime, time}; 
+      }
+      
+      /// @brief A given cycle.
+      ///
+      static ScheduleTime atCycle(int cycle_id) { 
+         return ScheduleTime{AbsoluteCycle, (unsigned long)cycle_id}; 
+      }
+      
+      /// @brief The first cycle that starts at least a given time [ms] 
+      ///        after the start of the next cycle.
+      ///
+      static ScheduleTime in(unsigned long delta_t) { 
+         return ScheduleTime{RelativeTime, delta_t}; 
+      }
+      
+      /// @brief The n-th next cycle. inCycles(1) is the next cycle.
+      ///
+      static ScheduleTime inCycles(int n_cycles) { 
+         return ScheduleTime{RelativeCycles, (unsigned long)n_cycles}; 
+      }
+      
+   private:
+      
+      enum Type { AbsoluteTime, AbsoluteCycle, RelativeTime, RelativeCycles };
+      
+      ScheduleTime(Type type, unsigned long value) 
+         :  type_(type), value_(value) 
+      {}
+      
+      Type type_;
+      unsigned long value_;
+      
+      friend class Simulator;
+};
+
 /// @brief The main simulator object.
 ///
 class Simulator {
@@ -244,8 +368,11 @@ class Simulator {
    private:
       
       std::ostream *out_;
+      std::shared_ptr<BufferedOStream> buffered_out_;
+      std::shared_ptr<AsyncOStream> async_out_;
       bool debug_;
       bool quiet_ = false;
+      int log_level_ = TraceLogLevel;
       int cycle_duration_;
       bool abort_on_first_error_;
       
@@ -256,24 +383,77 @@ class Simulator {
       TimeType time_ = 0;
       int scan_cycles_default_count_ = 5;
       
+      bool fast_forward_ = true;
+      bool skip_idle_cycles_ = true;
+      unsigned long n_idle_cycles_skipped_ = 0;
+      double cycle_rate_ = 0.0;
+      
+      // A key event or action that is scheduled for a cycle.
+      //
+      struct ScheduledEvent {
+         
+         enum Type { PressKey, ReleaseKey, TapKey, EvaluateAction };
+         
+         Type type_ = EvaluateAction;
+         uint8_t row_ = 0;
+         uint8_t col_ = 0;
+         std::shared_ptr<Action_> action_;
+      };
+      
+      TimerWheel<ScheduledEvent> scheduled_events_;
+      
+      // Scheduled actions of the current cycle. They are evaluated 
+      // after the core loop.
+      //
+      std::vector<std::shared_ptr<Action_>> due_scheduled_actions_;
+      
+      double realtime_spin_duration_ = 0.0;
+      Histogram realtime_lateness_;
+      
+      Profiler profiler_;
+      
+      // The key state at the start of the current profiled core loop.
+      //
+      KeyMatrixState cycle_start_keys_;
+      
+      LatencyTracker latency_tracker_;
+      
+      // Mutable as changes are collected from the core when they
+      // are queried.
+      //
+      mutable CoreChangeTracker core_changes_;
+      
+      ReportFlightRecorder flight_recorder_;
+      HostPollingModel host_polling_;
+      MemoryTracker memory_tracker_;
+      InputJournalWriter input_journal_;
+      
       mutable int error_count_ = 0;
       
       bool error_if_report_without_queued_actions_ = false;
       
-      int n_typed_reports_in_cycle_[5] = {};
-      int n_typed_overall_reports_[5] = {};
+      int n_typed_reports_in_cycle_[NumReportTypeIds] = {};
+      int n_typed_overall_reports_[NumReportTypeIds] = {};
       
       int n_reports_in_cycle_ = 0;
       int n_overall_reports_ = 0;
       
       ActionContainer<ReportAction_> queued_report_actions_;
             
-      ActionContainer<ReportAction<BootKeyboardReport_>> permanent_boot_keyboard_report_actions_;
-      ActionContainer<ReportAction<KeyboardReport_>> permanent_keyboard_report_actions_;
-      ActionContainer<ReportAction<MouseReport_>> permanent_mouse_report_actions_;
-      ActionContainer<ReportAction<AbsoluteMouseReport_>> permanent_absolute_mouse_report_actions_;
+      // One permanent action container per entry of ReportTypes,
+      // indexed by ReportTraits<...>::index.
+      //
+      PermanentReportActionsTuple::Type permanent_typed_report_actions_;
       ActionContainer<ReportAction_> permanent_generic_report_actions_;
       
+      // The permanent generic report actions bucketed by the report
+      // type they apply to. Rebuilt whenever the revision of 
+      // permanent_generic_report_actions_ changes.
+      //
+      mutable std::vector<std::shared_ptr<ReportAction_>> 
+         generic_report_action_buckets_[NumReportTypeIds];
+      mutable unsigned generic_report_action_buckets_revision_ = 0;
+      
       ActionContainer<Action_> queued_cycle_actions_;
       ActionContainer<Action_> permanent_cycle_actions_;
       
@@ -281,6 +461,56 @@ class Simulator {
       
    public:
       
+      /// @brief The state of the simulator at a given point in time.
+      /// @details Snapshots are created via snapshot() and can be
+      ///        restored any number of times via restore(...).
+      ///        Copying snapshots is cheap as the image of the 
+      ///        core state is shared between copies.
+      ///
+      ///        Action objects are not duplicated. A restored
+      ///        action queue refers to the same action objects as the
+      ///        queue at the time of the snapshot.
+      ///
+      class Snapshot {
+         
+         public:
+            
+            /// @brief Checks if the snapshot contains the state of the
+            ///        simulator core.
+            ///
+            bool hasCoreState() const { return (bool)core_image_; }
+            
+            /// @brief Retreives the time at which the snapshot was taken.
+            ///
+            TimeType getTime() const { return time_; }
+            
+            /// @brief Retreives the cycle at which the snapshot was taken.
+            ///
+            int getCycleId() const { return cycle_id_; }
+            
+         private:
+            
+            TimeType time_ = 0;
+            int cycle_id_ = 0;
+            
+            int n_typed_reports_in_cycle_[NumReportTypeIds] = {};
+            int n_typed_overall_reports_[NumReportTypeIds] = {};
+            int n_reports_in_cycle_ = 0;
+            int n_overall_reports_ = 0;
+            
+            ActionContainer<ReportAction_>::StorageType queued_report_actions_;
+            PermanentReportActionsStorageTuple::Type permanent_typed_report_actions_;
+            ActionContainer<ReportAction_>::StorageType permanent_generic_report_actions_;
+            ActionContainer<Action_>::StorageType queued_cycle_actions_;
+            ActionContainer<Action_>::StorageType permanent_cycle_actions_;
+            TimerWheel<ScheduledEvent> scheduled_events_;
+            std::vector<HostPollingModel::Queue> host_polling_queues_;
+            
+            std::shared_ptr<const std::vector<uint8_t>> core_image_;
+            
+            friend class Simulator;
+      };
+      
       ~Simulator();
       
       /// @details If the ErrorIfReportWithoutQueuedActions is enabled
@@ -307,25 +537,34 @@ class Simulator {
       /// @brief Retreives the permanent boot keyboard report actions.
       ///
       ActionContainer<ReportAction<BootKeyboardReport_>> &permanentBootKeyboardReportActions() {
-         return permanent_boot_keyboard_report_actions_;
+         return this->permanentReportActions<BootKeyboardReport_>();
       }
       
       /// @brief Retreives the permanent keyboard report actions.
       ///
       ActionContainer<ReportAction<KeyboardReport_>> &permanentKeyboardReportActions() {
-         return permanent_keyboard_report_actions_;
+         return this->permanentReportActions<KeyboardReport_>();
       }
       
       /// @brief Retreives the permanent mouse report actions.
       ///
       ActionContainer<ReportAction<MouseReport_>> &permanentMouseReportActions() {
-         return permanent_mouse_report_actions_;
+         return this->permanentReportActions<MouseReport_>();
       }
       
       /// @brief Retreives the absolute mouse report actions.
       ///
       ActionContainer<ReportAction<AbsoluteMouseReport_>> &permanentAbsoluteMouseReportActions() {
-         return permanent_absolute_mouse_report_actions_;
+         return this->permanentReportActions<AbsoluteMouseReport_>();
+      }
+      
+      /// @brief Retreives the permanent report actions of a given report type.
+      /// @tparam _ReportType The report type, e.g. ConsumerControlReport_.
+      ///
+      template<typename _ReportType>
+      ActionContainer<ReportAction<typename ReportTraits<_ReportType>::BaseReportType>> &
+         permanentReportActions() {
+         return std::get<ReportTraits<_ReportType>::index>(permanent_typed_report_actions_);
       }
       
       /// @brief Retreives the generic report actions.
@@ -334,6 +573,18 @@ class Simulator {
          return permanent_generic_report_actions_;
       }
       
+      /// @brief Retreives the number of generic report actions that 
+      ///        are evaluated for reports of a given type.
+      /// @details Permanent generic report actions are sorted into 
+      ///        one bucket per report type. Actions that apply to 
+      ///        reports of any type are part of every bucket.
+      ///
+      /// @param type_id The report type id, e.g. KeyboardReportTypeId.
+      ///        For AnyTypeReportTypeId the number of actions that 
+      ///        apply to any type of report is returned.
+      ///
+      std::size_t getPermanentReportActionBucketSize(int type_id) const;
+      
       /// @brief Retreives the queued cycle actions.
       /// @details The head of the action queue is applied at the end of
       ///        the next cycle and removed afterwards.
@@ -416,7 +667,7 @@ class Simulator {
       void cycles(int n = 0, _Actions...actions) {
          this->cyclesInternal(n,
             std::vector<std::shared_ptr<Action_>>{
-               std::forward<_Actions>(actions)...
+               unwrapAction(actions)...
             }
          );
       }
@@ -446,6 +697,93 @@ class Simulator {
       ///
       void advanceTimeTo(TimeType time);
       
+      /// @brief Enables or disables fast forward mode.
+      /// @details In fast forward mode, cycles(...), advanceTimeBy(...)
+      ///        and advanceTimeTo(...) run their cycles as a batch. 
+      ///        Cycle actions are only processed in cycles where any are
+      ///        queued or registered. Fast forward mode is enabled
+      ///        by default.
+      ///
+      /// @param state The fast forward state.
+      ///
+      void setFastForward(bool state = true) { fast_forward_ = state; }
+      
+      /// @brief Retreives the fast forward state.
+      ///
+      bool getFastForward() const { return fast_forward_; }
+      
+      /// @brief Enables or disables skipping idle cycles.
+      /// @details In fast forward mode, the core loop is not run in cycles 
+      ///        where the core reports to be quiescent, see 
+      ///        SimulatorCore_::isQuiescent(...). Time and cycle id advance 
+      ///        as usual and due cycle actions are processed. Skipping 
+      ///        idle cycles is enabled by default.
+      ///
+      /// @param state The new state.
+      ///
+      void setSkipIdleCycles(bool state = true) { skip_idle_cycles_ = state; }
+      
+      /// @brief Retreives whether idle cycles are skipped.
+      ///
+      bool getSkipIdleCycles() const { return skip_idle_cycles_; }
+      
+      /// @brief Retreives the overall number of cycles whose core loop
+      ///        was skipped because the core was quiescent.
+      ///
+      unsigned long getNumIdleCyclesSkipped() const { return n_idle_cycles_skipped_; }
+      
+      /// @brief Retreives the number of cycles per second of wall time 
+      ///        that were achieved by the most recent call to 
+      ///        cycles(...), advanceTimeBy(...) or advanceTimeTo(...).
+      ///
+      double getCycleRate() const { return cycle_rate_; }
+      
+      /// @brief Schedules pressing a key.
+      /// @details Scheduled key events are processed at the start of the cycle 
+      ///        they are due in, before the core loop runs. Events that are due 
+      ///        in the same cycle are processed in the order they were scheduled.
+      ///        Scheduling and processing an event take constant time.
+      ///        Scheduled events are processed by all methods that run 
+      ///        cycles, e.g. advanceTimeTo(...). Idle cycles are only skipped 
+      ///        up to the next scheduled event (see setSkipIdleCycles(...)).
+      ///
+      /// @param when The cycle the event is due in, e.g. ScheduleTime::at(350).
+      /// @param row The keyboard matrix row.
+      /// @param col The keyboard matrix col.
+      ///
+      void schedulePressKey(const ScheduleTime &when, uint8_t row, uint8_t col);
+      
+      /// @brief Schedules releasing a key. See schedulePressKey(...).
+      ///
+      void scheduleReleaseKey(const ScheduleTime &when, uint8_t row, uint8_t col);
+      
+      /// @brief Schedules tapping a key. See schedulePressKey(...).
+      ///
+      void scheduleTapKey(const ScheduleTime &when, uint8_t row, uint8_t col);
+      
+      /// @brief Schedules actions.
+      /// @details Scheduled actions are evaluated after the core loop of 
+      ///        the cycle they are due in, before the cycle actions.
+      ///
+      /// @param when The cycle the actions are due in.
+      /// @tparam actions The actions to be evaluated.
+      ///
+      template<typename..._Actions>
+      void scheduleActions(const ScheduleTime &when, _Actions...actions) {
+         int expand[] = { 0, (this->scheduleAction(when, 
+               std::shared_ptr<Action_>{unwrapAction(actions)}), 0)... };
+         (void)expand;
+      }
+      
+      /// @brief Retreives the number of scheduled key events and actions
+      ///        that are not yet due.
+      ///
+      std::size_t getNumScheduledEvents() const { return scheduled_events_.size(); }
+      
+      /// @brief Discards all scheduled key events and actions.
+      ///
+      void clearScheduledEvents();
+      
       /// @brief Immediately evaluates a number of actions
       ///
       /// @tparam actions A number actions to be evaluated immediately.
@@ -454,7 +792,7 @@ class Simulator {
       void evaluateActions(_Actions...actions) {
          this->evaluateActionsInternal(
             std::vector<std::shared_ptr<Action_>>{
-               std::forward<_Actions>(actions)...
+               unwrapAction(actions)...
             }
          );
       }
@@ -465,6 +803,15 @@ class Simulator {
       /// 
       LogStream log() const { return LogStream{this}; }
       
+      /// @brief Retreives a stream object for trace log output.
+      /// @details Trace output is meant for information that is 
+      ///        generated in every cycle or for every report.
+      ///        Prefer the PAPILIO_TRACE macro on hot paths.
+      ///
+      /// @returns The log stream object.
+      /// 
+      LogStream trace() const { return LogStream{this, TraceLogLevel}; }
+      
       /// @brief Retreives a log stream for header output.
       ///
       /// @returns The header log stream object.
@@ -544,6 +891,36 @@ class Simulator {
       ///
       bool getQuiet() const { return quiet_; }
       
+      /// @brief Enables or disables terminating the process with a 
+      ///        non-zero exit code if the simulator is destroyed after 
+      ///        errors occurred.
+      /// @details This is e.g. disabled for simulators of workers.
+      ///
+      void setTerminateOnFailure(bool state) { terminate_on_failure_ = state; }
+      
+      /// @brief Sets the log level.
+      /// @details Output of log levels greater than the given level
+      ///        is suppressed.
+      ///
+      /// @param log_level The new log level, e.g. StandardLogLevel.
+      ///
+      void setLogLevel(int log_level) { log_level_ = log_level; }
+      
+      /// @brief Retreives the current log level.
+      ///
+      int getLogLevel() const { return log_level_; }
+      
+      /// @brief Checks if output is generated for a given log level.
+      /// @details Errors are always reported, even in quiet mode.
+      ///
+      /// @param log_level The log level to check.
+      /// @returns True if output is generated for the log level.
+      ///
+      bool isLogLevelEnabled(int log_level) const {
+         return    (log_level == ErrorLogLevel) 
+               || (!quiet_ && (log_level <= log_level_));
+      }
+      
       /// @brief Asserts that no actions (keyboard report and cycle)
       ///        are currently queued.
       /// @details This function is automatically called at the end of each 
@@ -586,14 +963,48 @@ class Simulator {
       ///        by using a std::ofstream.
       /// @param out The new ostream object.
       ///
-      void setOStream(std::ostream &out) {
-         out_ = &out;
-      }
+      void setOStream(std::ostream &out);
       
       /// @brief Retreives the currently associated ostream object.
       ///
       std::ostream &getOStream() const { return *out_; }
       
+      /// @brief Enables or disables buffered output.
+      /// @details If enabled, all output is collected in a buffer that is
+      ///        only written to the ostream object when it is full,
+      ///        when an error is reported or when the simulator flushes
+      ///        explicitly. Line breaks never flush.
+      ///
+      /// @param state The buffering state.
+      /// @param buffer_size The size of the output buffer in bytes.
+      ///
+      void setOutputBuffered(bool state = true, std::size_t buffer_size = 1 << 16);
+      
+      /// @brief Enables or disables asynchronous output.
+      /// @details If enabled, output is collected in a bounded buffer
+      ///        that a background thread writes to the ostream object.
+      ///        Slow output, e.g. log capture, then only delays the simulation 
+      ///        if the buffer is full. Errors, the footer text and explicit 
+      ///        calls to flush() wait until all output was written.
+      ///        Asynchronous output replaces buffered output.
+      ///
+      /// @param state The asynchronous output state.
+      /// @param buffer_size The size of the output buffer in bytes.
+      /// @param drop_debug_output If true, debug and trace output is dropped 
+      ///        while the buffer is full, instead of waiting.
+      ///
+      void setOutputAsync(bool state = true, std::size_t buffer_size = 1 << 20,
+                          bool drop_debug_output = false);
+      
+      /// @brief Retreives the asynchronous output stream.
+      /// @returns The stream or nullptr if asynchronous output is disabled.
+      ///
+      AsyncOStream *getAsyncOStream() const { return async_out_.get(); }
+      
+      /// @brief Writes all buffered output to the ostream object.
+      ///
+      void flush() const;
+      
       /// @brief Runs the simulator for a given amount of time.
       /// @details The simulation runs in real time, i.e. if necessary
       ///        the simulator waits for a given amount of time in each
@@ -607,15 +1018,167 @@ class Simulator {
       ///
       void runRealtime(TimeType duration, const std::function<void()> &cycle_function);
       
+      /// @brief Sets the time to busy-wait before the end of each
+      ///        realtime cycle instead of sleeping.
+      /// @details Realtime simulation sleeps until the end of each cycle.
+      ///        Waking up takes a system dependent amount of time. 
+      ///        Spinning for a short time before the deadline improves 
+      ///        precision at the expense of CPU time. 
+      ///
+      /// @param duration The spin duration in milliseconds. Zero disables
+      ///        spinning (default).
+      ///
+      void setRealtimeSpinDuration(double duration) { realtime_spin_duration_ = duration; }
+      
+      /// @brief Retreives the realtime spin duration.
+      ///
+      double getRealtimeSpinDuration() const { return realtime_spin_duration_; }
+      
+      /// @brief Retreives the lateness of cycle ends during the last (or
+      ///        the current) realtime run.
+      /// @details Values are in nanoseconds.
+      ///
+      const Histogram &getRealtimeLateness() const { return realtime_lateness_; }
+      
+      /// @brief Retreives the profiler.
+      /// @details Enable profiling via profiler().setEnabled(true)
+      ///        to collect wall time statistics of cycle phases and 
+      ///        action types. If enabled, a summary is written as part 
+      ///        of the footer text.
+      ///
+      Profiler &profiler() { return profiler_; }
+      
+      /// @brief Retreives the profiler.
+      ///
+      const Profiler &getProfiler() const { return profiler_; }
+      
+      /// @brief Retreives the latency tracker.
+      /// @details Enable latency tracking via latencyTracker().setEnabled(true)
+      ///        to measure the number of cycles between key events and 
+      ///        the keyboard reports they cause. If enabled, a summary 
+      ///        is written as part of the footer text.
+      ///
+      LatencyTracker &latencyTracker() { return latency_tracker_; }
+      
+      /// @brief Retreives the latency tracker.
+      ///
+      const LatencyTracker &getLatencyTracker() const { return latency_tracker_; }
+      
+      /// @brief Retreives the memory tracker.
+      /// @details Enable tracking via memoryTracker().setEnabled(true)
+      ///        to measure the heap and stack footprint of the core loop.
+      ///        If enabled, a summary is written at the end of every test
+      ///        and as part of the footer text.
+      ///
+      MemoryTracker &memoryTracker() { return memory_tracker_; }
+      
+      /// @brief Retreives the memory tracker.
+      ///
+      const MemoryTracker &getMemoryTracker() const { return memory_tracker_; }
+      
+      /// @brief Retreives the report flight recorder.
+      /// @details Enable the recorder via flightRecorder().setCapacity(n)
+      ///        to keep the last n reports. They are dumped when the 
+      ///        first error occurs and when a test fails, even if
+      ///        logging is disabled.
+      ///
+      ReportFlightRecorder &flightRecorder() { return flight_recorder_; }
+      
+      /// @brief Retreives the report flight recorder.
+      ///
+      const ReportFlightRecorder &getFlightRecorder() const { return flight_recorder_; }
+      
+      /// @brief Retreives the host polling model.
+      /// @details Enable the model via hostPolling().setEnabled(true)
+      ///        to queue reports at per report type endpoints 
+      ///        that a simulated USB host polls at a fixed interval,
+      ///        instead of processing them as soon as the core emits them.
+      ///        If enabled, a summary is written as part of the footer text.
+      ///
+      HostPollingModel &hostPolling() { return host_polling_; }
+      
+      /// @brief Retreives the host polling model.
+      ///
+      const HostPollingModel &getHostPolling() const { return host_polling_; }
+      
+      /// @brief Dumps the flight recorder unless it was already dumped 
+      ///        since the start of the current test.
+      /// @details The output is generated regardless of the log level.
+      ///
+      void dumpFlightRecorder() const;
+      
       /// @brief Runs the simulator in a continuous loop an reacts on stdin.
-      /// @details Key state information is read from stdin in each loop cycle.
+      /// @details Key state information is read by a background thread 
+      ///        that blocks while there is no input. At the beginning of 
+      ///        each cycle, the most recent key state is applied. Only
+      ///        keys that changed are pressed or released.
+      ///
+      ///        Key states are accepted as text lines of integers, 
+      ///        each representing eight keys in its lower bits, or as 
+      ///        binary frames (the byte 0x02 followed by a bitfield of 
+      ///        (rows*cols + 7)/8 bytes, but at least 32 bytes).
+      ///        Bit pos % 8 of byte pos / 8 represents the key at
+      ///        pos = row*cols + col.
       ///
       /// @param cycle_callback A function that is executed after every cycle.
       /// @param realtime If this parameter is true, the simulator waits 
       ///                 if necessary at the end of cycles to synchronize.
+      /// @param input_fd The file descriptor to read from, e.g. of a pipe
+      ///                 or socket. Defaults to stdin.
       ///
       void runRemoteControlled(const std::function<void()> &cycle_callback,
-                              bool realtime = false);
+                              bool realtime = false,
+                              int input_fd = 0);
+      
+      /// @brief Starts recording key events to an input journal file.
+      /// @details Every key press, release and tap that is applied to 
+      ///        the core is recorded with its cycle id and time, 
+      ///        regardless of whether it originates from the test code,
+      ///        from scheduled events or from runRemoteControlled(...).
+      ///        Sessions that depend on wall clock timing can thus be 
+      ///        reproduced via replayInputJournal(...).
+      ///
+      ///        Cycle ids and times are stored relative to the start 
+      ///        of the recording. Restoring a snapshot that lies before
+      ///        the last recorded event stops the recording.
+      ///
+      /// @param filename The name of the journal file. An existing
+      ///        file is overwritten.
+      ///
+      /// @returns True if the journal file could be opened.
+      ///
+      bool startInputJournal(const std::string &filename);
+      
+      /// @brief Stops recording key events.
+      /// @details The current cycle id is recorded as the end of the journal.
+      ///        A recording that is still active is stopped when
+      ///        the simulator is destroyed.
+      ///
+      void stopInputJournal();
+      
+      /// @brief Checks if key events are currently being recorded.
+      ///
+      bool isRecordingInputJournal() const { return input_journal_.isOpen(); }
+      
+      /// @brief Replays a recorded input journal as fast as possible.
+      /// @details Cycles are run through the same path as cycle(), 
+      ///        key events are applied in the cycles they were recorded 
+      ///        in. There is no realtime waiting. Cycle ids and times
+      ///        are relative to the start of the replay.
+      ///        After the last event, cycles are run up to the recorded
+      ///        end of the journal if the recording was stopped regularly.
+      ///
+      ///        The cycle duration and key matrix dimensions must match 
+      ///        those of the recording.
+      ///
+      /// @param filename The name of the journal file.
+      /// @param fast_forward If true, the cycles between key events are run
+      ///        in fast forward mode and idle cycles are skipped if enabled 
+      ///        (see setFastForward(...) and setSkipIdleCycles(...)).
+      ///
+      /// @returns True if the journal was replayed completely.
+      ///
+      bool replayInputJournal(const std::string &filename, bool fast_forward = false);
       
       int getNumReportsInCycle() const { return n_typed_reports_in_cycle_[AnyTypeReportTypeId]; }
       int getNumOverallReports() const { return n_typed_overall_reports_[AnyTypeReportTypeId]; }
@@ -642,16 +1205,78 @@ class Simulator {
          return n_typed_overall_reports_[ReportTraits<_ReportType>::type_id];
       }
       
+      /// @brief Retreives the overall number of reports of a given type.
+      /// @param type_id The report type id, e.g. KeyboardReportTypeId.
+      ///
+      int getNumOverallReportsOfType(int type_id) const {
+         return n_typed_overall_reports_[type_id];
+      }
+      
       const SimulatorCore_ &getCore() const { 
          assert(simulator_core_);
          return *simulator_core_;
       }
       
-      void setCore(const std::shared_ptr<SimulatorCore_> &core) {
-         assert(core);
-         simulator_core_ = core;
+      void setCore(const std::shared_ptr<SimulatorCore_> &core);
+      
+      /// @brief Retreives the keys of the core whose state changed.
+      /// @details Changes are collected from the core when this method 
+      ///        is called (see SimulatorCore_::takeChanges(...)). Consumers 
+      ///        remember the revision they processed last, e.g.
+      ///
+      ///           const CoreChangeTracker &changes = simulator.getCoreChanges();
+      ///           if(changes.anyChanged(CoreChanges::KeyLEDChange, revision_)) {
+      ///              ...
+      ///           }
+      ///           revision_ = changes.getRevision();
+      ///
+      ///        If the core does not track changes, all keys are reported
+      ///        as changed. Replacing the core or restoring a snapshot
+      ///        also changes all keys.
+      ///
+      const CoreChangeTracker &getCoreChanges() const {
+         assert(simulator_core_);
+         core_changes_.update(*simulator_core_);
+         return core_changes_;
       }
       
+      /// @brief Replaces the core of a running simulation.
+      /// @details The new core is initialized and synchronized to the 
+      ///        simulator time. The state of the current core is transferred 
+      ///        if both cores support it (see SimulatorCore_::saveState(...)). 
+      ///        Keys that are pressed remain pressed. Actions, time and counters 
+      ///        of the simulator are not affected.
+      ///
+      ///        Both cores must have identical key matrix dimensions. 
+      ///        Must not be called from actions, e.g. use it between tests 
+      ///        or in the cycle callback of runRemoteControlled(...).
+      ///
+      /// @param core The new core.
+      ///
+      /// @returns True if the core was replaced and its state was transferred.
+      ///
+      bool replaceCore(const std::shared_ptr<SimulatorCore_> &core);
+      
+      /// @brief Saves the current state of the simulator and its core.
+      /// @details The snapshot covers time, cycle id, report counters,
+      ///        all queued, permanent and scheduled actions and key events,
+      ///        the reports that wait to be polled by the host (see hostPolling()),
+      ///        and the state of the 
+      ///        core if the core supports it (see 
+      ///        SimulatorCore_::saveState(...)). Error counts are not
+      ///        part of a snapshot.
+      ///
+      /// @returns The snapshot.
+      ///
+      Snapshot snapshot() const;
+      
+      /// @brief Restores a state that was saved by snapshot().
+      ///
+      /// @param snapshot The snapshot to restore.
+      /// @returns True if simulator and core state were restored.
+      ///
+      bool restore(const Snapshot &snapshot);
+      
    protected:
       
       /// @brief Constructor.
@@ -667,9 +1292,18 @@ class Simulator {
              int cycle_duration = 1, 
              bool abort_on_first_error = false);
       
+   protected:
+      
+      // If disabled, the destructor does not terminate the process
+      // if errors occurred.
+      //
+      bool terminate_on_failure_ = true;
+      
    protected:
       
       bool checkStatus();
+      
+      void resetOutputWrapper();
             
       void headerText();
       
@@ -677,26 +1311,27 @@ class Simulator {
                  
       void cycleInternal(bool only_log_reports = false);
       
-      void checkCycleDurationSet();
+      void fastForwardInternal(int n_cycles);
       
-      ActionContainer<ReportAction<BootKeyboardReport_>> &getPermanentReportActions(ReportType<BootKeyboardReport_>) {
-         return permanent_boot_keyboard_report_actions_;
-      }
+      void processCycleActions();
       
-      ActionContainer<ReportAction<KeyboardReport_>> &getPermanentReportActions(ReportType<KeyboardReport_>) {
-         return permanent_keyboard_report_actions_;
-      }
+      void scheduleAction(const ScheduleTime &when, const std::shared_ptr<Action_> &action);
+      void scheduleEvent(const ScheduleTime &when, const ScheduledEvent &event);
+      void processScheduledEvents();
       
-      ActionContainer<ReportAction<MouseReport_>> &getPermanentReportActions(ReportType<MouseReport_>) {
-         return permanent_mouse_report_actions_;
-      }
+      void logCycleRate(int n_cycles, double elapsed_ms);
       
-      ActionContainer<ReportAction<AbsoluteMouseReport_>> &getPermanentReportActions(ReportType<AbsoluteMouseReport_>) {
-         return permanent_absolute_mouse_report_actions_;
-      }
+      void logRealtimeLateness();
+      
+      bool evalProfiled(Action_ &action);
+      
+      void runCoreLoop(SimulatorCore_ &core);
+      void runCoreLoopProfiled(SimulatorCore_ &core);
+      
+      void checkCycleDurationSet();
       
       // This method is templated to enable it being used for std::vector
-      // and std::deque.
+      // and the RingBuffer storage of ActionContainer.
       //
       template<typename _Container>
       void evaluateActionsInternal(const _Container &actions) {
@@ -709,7 +1344,9 @@ class Simulator {
             //
             action->setSimulator(this);
             
-            bool action_passed = action->eval();
+            bool action_passed = profiler_.isEnabled() 
+                                       ? this->evalProfiled(*action) 
+                                       : action->eval();
             
             if(!action_passed || debug_) {
                action->report();
@@ -724,7 +1361,9 @@ class Simulator {
          
          action.setReport(&report);
          
-         bool action_passed = action.eval();
+         bool action_passed = profiler_.isEnabled() 
+                                    ? this->evalProfiled(action) 
+                                    : action.eval();
          
          if(!action_passed || debug_) {
             action.report();
@@ -737,66 +1376,70 @@ class Simulator {
       template<typename _ReportType>
       void processReport(const _ReportType &report) {
          
-         ++n_typed_overall_reports_[AnyTypeReportTypeId];
-         ++n_typed_reports_in_cycle_[AnyTypeReportTypeId];
-         
-         static constexpr int type_id = _ReportType::type_;
+         // Reports of cores that run in worker threads are processed
+         // later on the simulator's thread.
+         //
+         if(DeferredReports *deferred_reports = DeferredReports::getCurrent()) {
+            deferred_reports->add(*this, report.clone(), 
+               &Simulator::processDeferredReport<typename _ReportType::BaseReportType>);
+            return;
+         }
          
+         // Reports are processed as their interface type. Processing
+         // is thus compiled once per report type, not per report class.
+         //
          typedef typename _ReportType::BaseReportType BaseReportType;
+         const BaseReportType &base_report = report;
          
-         ++n_typed_overall_reports_[type_id];
-         ++n_typed_reports_in_cycle_[type_id];
-         
-         this->log() << "Processing " << _ReportType::typeString() << " report "
-               << n_typed_overall_reports_[AnyTypeReportTypeId]
-               << " (" << n_typed_reports_in_cycle_[AnyTypeReportTypeId] << ". in cycle "
-               << this->getCycleId() << ")";
-                        
-         auto n_actions_queued = queued_report_actions_.size();
-         
-         this->log() << n_actions_queued
-            << " queued " << _ReportType::typeString() << " report actions";
-         
-         if(!queued_report_actions_.empty()) {
-            auto action = queued_report_actions_.popFront();
-            
-            auto report_type = action->getReportTypeId();
-            
-            if(report_type == Report_::type_) {
-               // Generic report
-               //
-               this->processReportAction(*action, report);
-            }
-            else if(report_type == _ReportType::type_) {
-               auto &typed_action = static_cast<ReportAction<BaseReportType>&>(*action);
-               this->processReportAction(typed_action, report);
-            }
-            else {
-               this->error() << "Expected a "
-                  << action->getTypeString() << " action but encountered a "
-                  << _ReportType::typeString() << " action";
-            }
-         }
-         
-         auto &permanent_actions = this->getPermanentReportActions(ReportType<BaseReportType>{});
-         for(auto &action: permanent_actions.directAccess()) {
-            this->processReportAction(*action, report);
+         // Allocations of report processing are not accounted 
+         // to the firmware.
+         //
+         if(memory_tracker_.isEnabled()) {
+            MemoryTracker::HeapScope heap_scope(false);
+            this->queueOrProcessReport(base_report);
          }
-
-         for(auto &action: permanent_generic_report_actions_.directAccess()) {
-            if(   (action->getReportTypeId() == _ReportType::type_)
-               || (action->getReportTypeId() == AnyTypeReportTypeId)) {
-               this->processReportAction(*action, report);
-            }
+         else {
+            this->queueOrProcessReport(base_report);
          }
-               
-         if((n_actions_queued == 0) && this->getErrorIfReportWithoutQueuedActions()) {
-            this->error() << "Encountered a " << _ReportType::typeString() << " report without actions being queued";
+      }
+      
+      template<typename _ReportType>
+      void queueOrProcessReport(const _ReportType &report) {
+         
+         // Reports wait at their endpoint until the host polls it.
+         //
+         if(host_polling_.isEnabled()) {
+            host_polling_.add(ReportTraits<_ReportType>::type_id, report.clone(),
+                              &Simulator::processPolledReport<_ReportType>);
+            return;
          }
+         
+         this->processReportProfiled(report);
       }
       
+      template<typename _ReportType>
+      static void processDeferredReport(Simulator &simulator, const Report_ &report) {
+         simulator.processReport(static_cast<const _ReportType&>(report));
+      }
+      
+      template<typename _ReportType>
+      static void processPolledReport(Simulator &simulator, const Report_ &report) {
+         simulator.processReportProfiled(static_cast<const _ReportType&>(report));
+      }
+      
+      // Defined in Simulator_Impl.h and explicitly instantiated for all
+      // entries of ReportTypes in reports/ReportTypes.cpp.
+      //
+      template<typename _ReportType>
+      void processReportProfiled(const _ReportType &report);
+      
+      template<typename _ReportType>
+      void processReportInternal(const _ReportType &report);
+      
       std::string generateCycleInfo() const;
       
+      void updateGenericReportActionBuckets() const;
+      
       void skipTimeInternal(TimeType delta_t);
       
       void cyclesInternal(int n, 
@@ -806,6 +1449,16 @@ class Simulator {
                        int tap_interval_cycles = 1,
                        std::shared_ptr<Action_> after_tap_and_cycles_action = std::shared_ptr<Action_>()
                       );
+      
+      void trackKeyEvent(uint8_t row, uint8_t col, bool pressed);
+      
+      void trackKeyEvents(const KeyMatrixState &mask, bool pressed);
+      
+      void journalKeyEvent(InputJournalRecord::Type type, 
+                           uint8_t row = 0, uint8_t col = 0);
+      
+      void journalKeyEvents(const KeyMatrixState &mask, 
+                            InputJournalRecord::Type type);
 };
 
 /// @brief Asserts a condition.
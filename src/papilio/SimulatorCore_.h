@@ -17,17 +17,27 @@
 
 #pragma once
 
+#include "papilio/CoreChanges.h"
+#include "papilio/KeyMatrixState.h"
+
 #include <string>
+#include <vector>
 #include <stdint.h>
 
 namespace papilio {
    
+class Simulator;
+   
 /// @brief An interface to a specific keyboard.
 ///
 class SimulatorCore_
 {
    public:
       
+      /// @brief The type of simulator time [ms], identical to Simulator::TimeType.
+      ///
+      typedef unsigned long TimeType;
+      
       /// @brief Initializes the simulator core.
       ///
       virtual void init() = 0;
@@ -63,23 +73,27 @@ class SimulatorCore_
       virtual bool isKeyPressed(uint8_t row, uint8_t col) const = 0;
       
       /// @brief Retrieves the numbers of LEDs
+      /// @details Cores of keyboards without LEDs need not override this.
       ///
       /// @returns The number of LEDs
       //
-      virtual uint8_t getNumLEDs() const = 0;
+      virtual KeyOffset getNumLEDs() const { return 0; }
       
       /// @brief Retreives the current key LED color.
+      /// @details The default reports all LEDs as black.
       ///
-      /// @param[in] i The LED index.
+      /// @param[in] key_offset The key offset, row*cols + col.
       ///
       /// @param[out] red The red color portion. 
       /// @param[out] green The green color portion. 
       /// @param[out] blue The blue color portion.
       ///
-      virtual void getCurrentKeyLEDColor( uint8_t key_offset, 
+      virtual void getCurrentKeyLEDColor( KeyOffset /*key_offset*/, 
                                           uint8_t &red, 
                                           uint8_t &green, 
-                                          uint8_t &blue) const = 0;
+                                          uint8_t &blue) const {
+         red = 0; green = 0; blue = 0;
+      }
                           
       /// @brief The current label of the key.
       /// @details This is what describes briefly (few characters) what the
@@ -92,6 +106,98 @@ class SimulatorCore_
       virtual void getCurrentKeyLabel(uint8_t row, uint8_t col,
                                       std::string &label_string) const = 0;
       
+      /// @brief Retreives the pressed state of all keys at once.
+      /// @details Override this method if the core can provide the
+      ///        key matrix state more efficiently than key by key.
+      ///
+      /// @param[out] state The key matrix state. It is resized to the 
+      ///        matrix dimensions if necessary.
+      ///
+      virtual void getKeyMatrixState(KeyMatrixState &state) const {
+         uint8_t rows = 0, cols = 0;
+         this->getKeyMatrixDimensions(rows, cols);
+         if((state.getRows() != rows) || (state.getCols() != cols)) {
+            state.resize(rows, cols);
+         }
+         else {
+            state.clear();
+         }
+         for(uint8_t row = 0; row < rows; ++row) {
+            for(uint8_t col = 0; col < cols; ++col) {
+               if(this->isKeyPressed(row, col)) {
+                  state.set(row, col);
+               }
+            }
+         }
+      }
+      
+      /// @brief Presses all keys that are set in a mask.
+      /// @details Override this method if the core can press 
+      ///        multiple keys more efficiently than key by key.
+      ///
+      /// @param mask The keys to press.
+      ///
+      virtual void pressKeys(const KeyMatrixState &mask) {
+         const uint8_t cols = mask.getCols();
+         mask.forEachSet([this, cols](KeyOffset key_offset) {
+            this->pressKey(key_offset/cols, key_offset%cols);
+         });
+      }
+      
+      /// @brief Releases all keys that are set in a mask.
+      /// @details Override this method if the core can release 
+      ///        multiple keys more efficiently than key by key.
+      ///
+      /// @param mask The keys to release.
+      ///
+      virtual void releaseKeys(const KeyMatrixState &mask) {
+         const uint8_t cols = mask.getCols();
+         mask.forEachSet([this, cols](KeyOffset key_offset) {
+            this->releaseKey(key_offset/cols, key_offset%cols);
+         });
+      }
+      
+      /// @brief Copies the current colors of the key LEDs.
+      /// @details Override this method if the core can copy its 
+      ///        LED buffer at once, e.g. by means of memcpy.
+      ///
+      /// @param[out] rgb A buffer of at least 3*n_keys bytes that receives
+      ///        the red, green and blue portion of each key LED.
+      /// @param[in] n_keys The number of key LEDs to copy, starting with 
+      ///        key offset zero.
+      ///
+      virtual void getCurrentKeyLEDColors(uint8_t *rgb, KeyOffset n_keys) const {
+         for(KeyOffset key_offset = 0; key_offset < n_keys; ++key_offset) {
+            this->getCurrentKeyLEDColor(key_offset, rgb[3*key_offset],
+                                        rgb[3*key_offset + 1], rgb[3*key_offset + 2]);
+         }
+      }
+      
+      /// @brief Retreives the keycode that a key currently generates.
+      /// @details The latency tracker uses it to match key events with
+      ///        the reports they cause. Without it, a key event is
+      ///        matched with the first report that changes any keycode.
+      ///
+      /// @returns The keycode or a negative value if unknown.
+      ///
+      virtual int getKeycode(uint8_t /*row*/, uint8_t /*col*/) const { return -1; }
+      
+      /// @brief Passes on and clears the marks of keys whose state changed
+      ///        since the previous call.
+      /// @details Cores that track changes mark every key that was pressed 
+      ///        or released, whose LED color changed or whose label changed, 
+      ///        e.g. due to a layer change. Consumers like the keyboard renderer 
+      ///        then only query keys that changed. Override this method to 
+      ///        enable change tracking. It is called by the simulator only, 
+      ///        see Simulator::getCoreChanges().
+      ///
+      /// @param[in,out] changes The object to add the marks to. Its
+      ///        dimensions match the key matrix.
+      /// @returns True if the core tracks changes, false if all keys are
+      ///        to be considered changed.
+      ///
+      virtual bool takeChanges(CoreChanges & /*changes*/) { return false; }
+      
       /// @brief Sets the current time of the simulation.
       ///
       /// param time The current simulation time.
@@ -106,6 +212,48 @@ class SimulatorCore_
       /// @brief Run a single simulation loop cycle
       ///
       virtual void loop() = 0;
+      
+      /// @brief Checks if the firmware is idle until a given time.
+      /// @details A core is quiescent if every loop() that runs before 
+      ///        the next wakeup time, e.g. the next timer deadline,
+      ///        would neither generate reports nor change any state. 
+      ///        The simulator then skips those loop cycles. A core must 
+      ///        not be quiescent if key state changes are pending.
+      ///        Override this method to enable idle cycle skipping.
+      ///
+      /// @param[out] next_wakeup_time The time of the first cycle that 
+      ///        needs to run. Set it to the maximum value if the firmware 
+      ///        is idle until the next key state change.
+      /// @returns True if the core is quiescent.
+      ///
+      virtual bool isQuiescent(TimeType & /*next_wakeup_time*/) const { return false; }
+      
+      /// @brief Saves the entire state of the firmware, e.g. an image of its RAM.
+      /// @details Override this method and restoreState(...) to 
+      ///        enable simulator snapshots.
+      ///
+      /// @param[out] image A buffer that receives the state.
+      /// @returns True if the state was saved, false if the core
+      ///        does not support saving its state.
+      ///
+      virtual bool saveState(std::vector<uint8_t> & /*image*/) const { return false; }
+      
+      /// @brief Restores a firmware state that was saved by saveState(...).
+      ///
+      /// @param[in] image A buffer that contains the state.
+      /// @returns True if the state was restored.
+      ///
+      virtual bool restoreState(const std::vector<uint8_t> & /*image*/) { return false; }
+      
+      /// @brief Passes the simulator that the core reports to.
+      /// @details Called by Simulator::setCore(...) and Simulator::replaceCore(...),
+      ///        and with nullptr when the core is replaced or the simulator 
+      ///        is destroyed. Cores pass their reports to this simulator, 
+      ///        e.g. after casting it to the simulator class of the firmware's 
+      ///        integration. Cores that are loaded from shared libraries 
+      ///        have no other way to reach their simulator.
+      ///
+      virtual void setSimulator(Simulator * /*simulator*/) {}
 };
 
 } // namespace papilio
@@ -0,0 +1,120 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// The out of line definitions of Simulator's report processing. They are 
+// explicitly instantiated for all entries of ReportTypes in reports/ReportTypes.cpp.
+// Do not include this file in test code.
+
+#include "papilio/Simulator.h"
+
+namespace papilio {
+
+template<typename _ReportType>
+void Simulator::processReportProfiled(const _ReportType &report)
+{
+   if(profiler_.isEnabled()) {
+      uint64_t start_cpu_cycles = profiler_.readCPUCycles();
+      uint64_t start = Profiler::now();
+      this->processReportInternal(report);
+      profiler_.addPhaseTime(Profiler::ReportProcessingPhase, 
+                             Profiler::now() - start);
+      profiler_.addNestedReportCPUCycles(profiler_.readCPUCycles() - start_cpu_cycles);
+   }
+   else {
+      this->processReportInternal(report);
+   }
+}
+
+template<typename _ReportType>
+void Simulator::processReportInternal(const _ReportType &report)
+{
+   ++n_typed_overall_reports_[AnyTypeReportTypeId];
+   ++n_typed_reports_in_cycle_[AnyTypeReportTypeId];
+   
+   static constexpr int type_id = _ReportType::type_;
+   
+   typedef typename _ReportType::BaseReportType BaseReportType;
+   
+   ++n_typed_overall_reports_[type_id];
+   ++n_typed_reports_in_cycle_[type_id];
+   
+   if(flight_recorder_.isEnabled()) {
+      flight_recorder_.record(report, cycle_id_, time_);
+   }
+   
+   if(   latency_tracker_.isEnabled()
+      && (   (type_id == KeyboardReportTypeId)
+          || (type_id == BootKeyboardReportTypeIdId))) {
+      ReportData data;
+      report.getData(data);
+      latency_tracker_.keyboardReport(data, cycle_id_, time_);
+   }
+   
+   PAPILIO_TRACE(*this) << "Processing " << _ReportType::typeString() << " report "
+         << n_typed_overall_reports_[AnyTypeReportTypeId]
+         << " (" << n_typed_reports_in_cycle_[AnyTypeReportTypeId] << ". in cycle "
+         << this->getCycleId() << ")";
+   
+   auto n_actions_queued = queued_report_actions_.size();
+   
+   PAPILIO_TRACE(*this) << n_actions_queued
+      << " queued " << _ReportType::typeString() << " report actions";
+   
+   if(!queued_report_actions_.empty()) {
+      auto action = queued_report_actions_.popFront();
+      
+      auto report_type = action->getReportTypeId();
+      
+      if(report_type == Report_::type_) {
+         // Generic report
+         //
+         this->processReportAction(*action, report);
+      }
+      else if(report_type == _ReportType::type_) {
+         auto &typed_action = static_cast<ReportAction<BaseReportType>&>(*action);
+         this->processReportAction(typed_action, report);
+      }
+      else {
+         this->error() << "Expected a "
+            << action->getTypeString() << " action but encountered a "
+            << _ReportType::typeString() << " action";
+      }
+   }
+   
+   auto &permanent_actions = std::get<ReportTraits<_ReportType>::index>(
+                                 permanent_typed_report_actions_);
+   for(auto &action: permanent_actions.directAccess()) {
+      this->processReportAction(*action, report);
+   }
+   
+   this->updateGenericReportActionBuckets();
+   
+   // Actions may add or remove permanent actions. Thus, we iterate
+   // over the bucket that was valid when the report arrived.
+   //
+   for(auto &action: generic_report_action_buckets_[type_id]) {
+      this->processReportAction(*action, report);
+   }
+   
+   if((n_actions_queued == 0) && this->getErrorIfReportWithoutQueuedActions()) {
+      this->error() << "Encountered a " << _ReportType::typeString() << " report without actions being queued";
+   }
+}
+
+} // namespace papilio
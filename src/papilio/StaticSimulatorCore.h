@@ -0,0 +1,181 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/SimulatorCore_.h"
+#include "papilio/KeyMatrixState.h"
+
+#include <stdint.h>
+#include <array>
+
+namespace papilio {
+   
+/// @brief A base class for cores of keyboards whose dimensions are known
+///        at compile time.
+/// @details The matrix traits must define
+///
+///        static constexpr uint8_t rows;
+///        static constexpr uint8_t cols;
+///        static constexpr KeyOffset n_leds;
+///        static constexpr KeyOffset keyToLED(KeyOffset key_offset);
+///
+///        where keyToLED(...) maps a key offset to the index of
+///        its LED (see e.g. keyboardio::model01::MatrixTraits).
+///
+///        The key matrix state is stored in a fixed size array of 64 bit words,
+///        in the same layout as KeyMatrixState. The bulk methods of SimulatorCore_
+///        (pressKeys(...), getKeyMatrixState(...), getCurrentKeyLEDColors(...) ...)
+///        are implemented with loops of constant trip count
+///        that call the derived class non-virtually (CRTP). The derived class 
+///        must provide
+///
+///        void getLEDColor(KeyOffset led_index, uint8_t &red, 
+///                         uint8_t &green, uint8_t &blue) const;
+///
+///        and implement the remaining pure virtual methods of SimulatorCore_. 
+///        The firmware reads the key matrix via isPressed(...).
+///
+template<typename _Traits, typename _Derived>
+class StaticSimulatorCore : public SimulatorCore_
+{
+   public:
+      
+      static constexpr uint8_t rows = _Traits::rows;
+      static constexpr uint8_t cols = _Traits::cols;
+      static constexpr KeyOffset n_keys = KeyOffset(rows)*cols;
+      static constexpr KeyOffset n_leds = _Traits::n_leds;
+      static constexpr std::size_t n_words = (std::size_t(n_keys) + 63)/64;
+      
+      virtual void getKeyMatrixDimensions(uint8_t &rows_out, uint8_t &cols_out) const final override {
+         rows_out = rows;
+         cols_out = cols;
+      }
+      
+      virtual void pressKey(uint8_t row, uint8_t col) final override {
+         this->setPressed(keyOffset(row, col, cols), true);
+      }
+      
+      virtual void releaseKey(uint8_t row, uint8_t col) final override {
+         this->setPressed(keyOffset(row, col, cols), false);
+      }
+      
+      virtual bool isKeyPressed(uint8_t row, uint8_t col) const final override {
+         return this->isPressed(keyOffset(row, col, cols));
+      }
+      
+      virtual KeyOffset getNumLEDs() const final override { return n_leds; }
+      
+      virtual void getCurrentKeyLEDColor(KeyOffset key_offset, 
+                                         uint8_t &red, 
+                                         uint8_t &green, 
+                                         uint8_t &blue) const final override {
+         this->derived().getLEDColor(_Traits::keyToLED(key_offset), red, green, blue);
+      }
+      
+      virtual void getKeyMatrixState(KeyMatrixState &state) const final override {
+         if((state.getRows() != rows) || (state.getCols() != cols)) {
+            state.resize(rows, cols);
+         }
+         for(std::size_t w = 0; w < n_words; ++w) {
+            state.setWord(w, key_state_[w]);
+         }
+      }
+      
+      virtual void pressKeys(const KeyMatrixState &mask) final override {
+         if(!this->matches(mask)) {
+            this->SimulatorCore_::pressKeys(mask);
+            return;
+         }
+         for(std::size_t w = 0; w < n_words; ++w) {
+            key_state_[w] |= mask.getWord(w);
+         }
+      }
+      
+      virtual void releaseKeys(const KeyMatrixState &mask) final override {
+         if(!this->matches(mask)) {
+            this->SimulatorCore_::releaseKeys(mask);
+            return;
+         }
+         for(std::size_t w = 0; w < n_words; ++w) {
+            key_state_[w] &= ~mask.getWord(w);
+         }
+      }
+      
+      virtual void getCurrentKeyLEDColors(uint8_t *rgb, KeyOffset n_keys_requested) const final override {
+         if(n_keys_requested != n_keys) {
+            this->SimulatorCore_::getCurrentKeyLEDColors(rgb, n_keys_requested);
+            return;
+         }
+         for(KeyOffset key_offset = 0; key_offset < n_keys; ++key_offset) {
+            this->derived().getLEDColor(_Traits::keyToLED(key_offset), rgb[3*key_offset],
+                                        rgb[3*key_offset + 1], rgb[3*key_offset + 2]);
+         }
+      }
+      
+      /// @brief Checks if a key is pressed.
+      ///
+      bool isPressed(KeyOffset key_offset) const {
+         return (key_state_[key_offset >> 6] >> (key_offset & 63)) & 1;
+      }
+      
+      bool isPressed(uint8_t row, uint8_t col) const {
+         return this->isPressed(keyOffset(row, col, cols));
+      }
+      
+      /// @brief Retreives the key matrix state, 
+      ///        bit key_offset % 64 of word key_offset / 64.
+      ///
+      const std::array<uint64_t, n_words> &getKeyStateWords() const { return key_state_; }
+      
+   protected:
+      
+      void setPressed(KeyOffset key_offset, bool state) {
+         uint64_t bit = uint64_t(1) << (key_offset & 63);
+         if(state) {
+            key_state_[key_offset >> 6] |= bit;
+         }
+         else {
+            key_state_[key_offset >> 6] &= ~bit;
+         }
+      }
+      
+   private:
+      
+      const _Derived &derived() const { return static_cast<const _Derived&>(*this); }
+      
+      static bool matches(const KeyMatrixState &mask) {
+         return (mask.getRows() == rows) && (mask.getCols() == cols);
+      }
+      
+   private:
+      
+      std::array<uint64_t, n_words> key_state_ = {};
+};
+
+template<typename _Traits, typename _Derived>
+constexpr uint8_t StaticSimulatorCore<_Traits, _Derived>::rows;
+template<typename _Traits, typename _Derived>
+constexpr uint8_t StaticSimulatorCore<_Traits, _Derived>::cols;
+template<typename _Traits, typename _Derived>
+constexpr KeyOffset StaticSimulatorCore<_Traits, _Derived>::n_keys;
+template<typename _Traits, typename _Derived>
+constexpr KeyOffset StaticSimulatorCore<_Traits, _Derived>::n_leds;
+template<typename _Traits, typename _Derived>
+constexpr std::size_t StaticSimulatorCore<_Traits, _Derived>::n_words;
+
+} // namespace papilio
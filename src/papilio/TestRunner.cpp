@@ -0,0 +1,552 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/TestRunner.h"
+#include "papilio/SimulatorCore_.h"
+#include "papilio/aux/WorkerPool.h"
+
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace papilio {
+   
+namespace {
+   
+// A simulator that is owned by a test runner worker.
+//
+class WorkerSimulator : public Simulator
+{
+   public:
+      
+      WorkerSimulator(std::ostream &out, const Simulator &parent)
+         :  Simulator(out, parent.getDebug(), parent.getCycleDuration(), false)
+      {}
+};
+
+template<typename _T>
+void serialize(std::string &buffer, const _T &value)
+{
+   buffer.append(reinterpret_cast<const char*>(&value), sizeof(_T));
+}
+
+void serialize(std::string &buffer, const std::string &value)
+{
+   serialize(buffer, uint32_t(value.size()));
+   buffer.append(value);
+}
+
+template<typename _T>
+bool deserialize(const std::string &buffer, std::size_t &pos, _T &value)
+{
+   if(pos + sizeof(_T) > buffer.size()) { return false; }
+   std::memcpy(&value, buffer.data() + pos, sizeof(_T));
+   pos += sizeof(_T);
+   return true;
+}
+
+bool deserialize(const std::string &buffer, std::size_t &pos, std::string &value)
+{
+   uint32_t size = 0;
+   if(!deserialize(buffer, pos, size)) { return false; }
+   if(pos + size > buffer.size()) { return false; }
+   value.assign(buffer, pos, size);
+   pos += size;
+   return true;
+}
+
+void serialize(std::string &buffer, const TestRunner::TestResult &result)
+{
+   serialize(buffer, result.output_);
+   serialize(buffer, result.error_count_);
+   serialize(buffer, result.duration_);
+   serialize(buffer, result.n_cycles_);
+   serialize(buffer, result.n_failed_checks_);
+   for(int i = 0; i < NumReportTypeIds; ++i) {
+      serialize(buffer, result.n_reports_[i]);
+   }
+}
+
+bool deserialize(const std::string &buffer, std::size_t &pos, 
+                 TestRunner::TestResult &result)
+{
+   bool success 
+      =     deserialize(buffer, pos, result.output_)
+         && deserialize(buffer, pos, result.error_count_)
+         && deserialize(buffer, pos, result.duration_)
+         && deserialize(buffer, pos, result.n_cycles_)
+         && deserialize(buffer, pos, result.n_failed_checks_);
+         
+   for(int i = 0; i < NumReportTypeIds; ++i) {
+      success = success && deserialize(buffer, pos, result.n_reports_[i]);
+   }
+   return success;
+}
+
+// FNV-1a
+//
+class Hash
+{
+   public:
+      
+      void add(const char *data, std::size_t size) {
+         for(std::size_t i = 0; i < size; ++i) {
+            value_ = (value_ ^ uint8_t(data[i]))*1099511628211ull;
+         }
+      }
+      
+      void add(const std::string &text) {
+         // Include the terminating zero to separate strings.
+         //
+         this->add(text.c_str(), text.size() + 1);
+      }
+      
+      bool addFile(const std::string &filename) {
+         std::ifstream in(filename, std::ios::binary);
+         if(!in) { return false; }
+         char chunk[1 << 16];
+         while(in) {
+            in.read(chunk, sizeof(chunk));
+            this->add(chunk, std::size_t(in.gcount()));
+         }
+         return true;
+      }
+      
+      uint64_t get() const { return value_; }
+      
+   private:
+      
+      uint64_t value_ = 14695981039346656037ull;
+};
+
+const char cache_header[] = "papilio-test-cache 3";
+
+} // namespace
+   
+TestRunner::TestRunner(const CoreFactory &core_factory)
+   :  core_factory_(core_factory)
+{}
+
+TestRunner &TestRunner::add(const char *name, const TestFunction &test_function,
+                            const char *version)
+{
+   tests_.push_back(TestEntry{name, test_function, version, nullptr, 0});
+   return *this;
+}
+
+TestRunner &TestRunner::addChecks(const char *name, std::size_t n_checks,
+                                  const CheckingTestFunction &test_function,
+                                  const char *version)
+{
+   tests_.push_back(TestEntry{name, nullptr, version, test_function, n_checks});
+   return *this;
+}
+
+void TestRunner::setShard(int shard, int n_shards)
+{
+   if((n_shards < 1) || (shard < 1) || (shard > n_shards)) {
+      shard = 1;
+      n_shards = 1;
+   }
+   shard_ = shard;
+   n_shards_ = n_shards;
+}
+
+bool TestRunner::parseArguments(int argc, const char * const *argv)
+{
+   for(int i = 1; i < argc; ++i) {
+      
+      std::string argument = argv[i];
+      
+      if(argument == "--shard") {
+         if(i + 1 >= argc) { return false; }
+         int shard = 0, n_shards = 0;
+         if(   (std::sscanf(argv[++i], "%d/%d", &shard, &n_shards) != 2)
+            || (n_shards < 1) || (shard < 1) || (shard > n_shards)) {
+            return false;
+         }
+         this->setShard(shard, n_shards);
+      }
+      else if(argument == "--result-cache") {
+         if(i + 1 >= argc) { return false; }
+         this->setResultCache(argv[++i]);
+      }
+   }
+   return true;
+}
+
+bool TestRunner::computeFingerprints(Simulator &simulator)
+{
+   Hash common;
+   
+   if(!common.addFile("/proc/self/exe")) {
+      simulator.error() << "Unable to read the test executable. Result caching is disabled";
+      return false;
+   }
+   
+   common.add(core_version_);
+   
+   // Worker simulators are configured like the parent.
+   //
+   common.add(std::to_string(simulator.getCycleDuration()));
+   common.add(simulator.getDebug() ? "debug" : "");
+   
+   if(!core_binary_.empty() && !common.addFile(core_binary_)) {
+      simulator.error() << "Unable to read core binary " << core_binary_ 
+         << ". Result caching is disabled";
+      return false;
+   }
+   
+   fingerprints_.resize(tests_.size());
+   
+   for(std::size_t i = 0; i < tests_.size(); ++i) {
+      Hash hash = common;
+      hash.add(tests_[i].name_);
+      hash.add(tests_[i].version_);
+      fingerprints_[i] = hash.get();
+   }
+   
+   return true;
+}
+
+void TestRunner::readCache(Simulator &simulator)
+{
+   cache_.clear();
+   
+   std::ifstream in(cache_filename_);
+   if(!in) { return; }
+   
+   std::string header;
+   if(!std::getline(in, header) || (header != cache_header)) {
+      simulator.log() << "Ignoring incompatible result cache " << cache_filename_;
+      return;
+   }
+   
+   // One line per result: fingerprint, error count, duration, 
+   // number of cycles, number of failed checks, report counts and name.
+   //
+   std::string line;
+   while(std::getline(in, line)) {
+      
+      std::istringstream fields(line);
+      TestResult result;
+      uint64_t fingerprint = 0;
+      
+      fields >> std::hex >> fingerprint >> std::dec 
+         >> result.error_count_ >> result.duration_ >> result.n_cycles_
+         >> result.n_failed_checks_;
+      for(int type_id = 0; type_id < NumReportTypeIds; ++type_id) {
+         fields >> result.n_reports_[type_id];
+      }
+      fields >> std::ws;
+      std::getline(fields, result.name_);
+      
+      if(!fields.fail()) {
+         result.cached_ = true;
+         cache_[fingerprint] = result;
+      }
+   }
+}
+
+void TestRunner::writeCache(Simulator &simulator) const
+{
+   std::string temporary_filename = cache_filename_ + ".tmp";
+   
+   {
+      std::ofstream out(temporary_filename, std::ios::trunc);
+      
+      out << cache_header << "\n";
+      
+      // Only results of registered tests are kept, including 
+      // those of other shards.
+      //
+      for(std::size_t i = 0; i < tests_.size(); ++i) {
+         
+         auto it = cache_.find(fingerprints_[i]);
+         if(it == cache_.end()) { continue; }
+         
+         const TestResult &result = it->second;
+         
+         out << std::hex << fingerprints_[i] << std::dec 
+            << " " << result.error_count_ << " " << result.duration_ 
+            << " " << result.n_cycles_ << " " << result.n_failed_checks_;
+         for(int type_id = 0; type_id < NumReportTypeIds; ++type_id) {
+            out << " " << result.n_reports_[type_id];
+         }
+         out << " " << result.name_ << "\n";
+      }
+      
+      if(!out) {
+         simulator.error() << "Failed to write result cache " << cache_filename_;
+         return;
+      }
+   }
+   
+   std::rename(temporary_filename.c_str(), cache_filename_.c_str());
+}
+
+void TestRunner::runTests(const Simulator &parent, 
+                          std::size_t begin, std::size_t end,
+                          std::vector<std::string> &serialized_results)
+{
+   std::ostream null_stream(nullptr);
+   
+   // Every test runs with a new simulator and starts from the initial
+   // state of the core. If the core cannot save its state, 
+   // every test gets a new core.
+   //
+   std::shared_ptr<SimulatorCore_> core = core_factory_();
+   std::vector<uint8_t> initial_state;
+   bool restore_core = core->saveState(initial_state);
+   
+   for(std::size_t i = begin; i < end; ++i) {
+      
+      if(i > begin) {
+         if(!restore_core || !core->restoreState(initial_state)) {
+            core = core_factory_();
+         }
+      }
+      
+      std::ostringstream out;
+      
+      std::unique_ptr<Simulator> simulator_ptr 
+         = simulator_factory_ ? simulator_factory_(null_stream)
+                              : std::unique_ptr<Simulator>(new WorkerSimulator(null_stream, parent));
+      
+      // Simulators of the factory are configured like the parent
+      // as debug mode and cycle duration are part of the fingerprints.
+      //
+      Simulator &simulator = *simulator_ptr;
+      simulator.setDebug(parent.getDebug());
+      simulator.setCycleDuration(parent.getCycleDuration());
+      simulator.setLogLevel(parent.getLogLevel());
+      simulator.setQuiet(parent.getQuiet());
+      simulator.setTerminateOnFailure(false);
+      simulator.setCore(core);
+      simulator.setOStream(out);
+      
+      TestResult result;
+      const TestEntry &entry = tests_[test_ids_[pending_[i]]];
+      
+      {
+         auto test = simulator.newTest(entry.name_.c_str());
+         if(entry.checking_function_) {
+            result.n_failed_checks_ = entry.checking_function_(simulator);
+         }
+         else {
+            entry.function_(simulator);
+         }
+      }
+      
+      simulator.flush();
+      
+      result.output_ = out.str();
+      result.error_count_ = simulator.getErrorCount();
+      result.duration_ = simulator.getTime();
+      result.n_cycles_ = simulator.getCycleId();
+      
+      for(int type_id = 0; type_id < NumReportTypeIds; ++type_id) {
+         result.n_reports_[type_id] = simulator.getNumOverallReportsOfType(type_id);
+      }
+      
+      serialize(serialized_results[i - begin], result);
+      
+      simulator.setOStream(null_stream);
+   }
+}
+
+int TestRunner::run(Simulator &simulator)
+{
+   results_.clear();
+   test_ids_.clear();
+   pending_.clear();
+   
+   for(std::size_t i = 0; i < tests_.size(); ++i) {
+      if(int(i % n_shards_) + 1 == shard_) {
+         test_ids_.push_back(i);
+      }
+   }
+   
+   results_.resize(test_ids_.size());
+   
+   for(std::size_t i = 0; i < test_ids_.size(); ++i) {
+      results_[i].name_ = tests_[test_ids_[i]].name_;
+   }
+   
+   bool use_cache = !cache_filename_.empty() && this->computeFingerprints(simulator);
+   
+   if(use_cache) {
+      this->readCache(simulator);
+   }
+   
+   for(std::size_t i = 0; i < results_.size(); ++i) {
+      
+      if(use_cache) {
+         auto it = cache_.find(fingerprints_[test_ids_[i]]);
+         if(it != cache_.end()) {
+            results_[i] = it->second;
+            results_[i].name_ = tests_[test_ids_[i]].name_;
+            continue;
+         }
+      }
+      
+      pending_.push_back(i);
+   }
+   
+   int n_workers = WorkerPool::getNumWorkers(n_workers_, pending_.size());
+   
+   simulator.log() << "Running " << pending_.size() << " tests with "
+      << n_workers << " workers";
+   
+   if(!pending_.empty()) {
+      
+      // Make sure that buffered output is not duplicated by 
+      // worker processes.
+      //
+      simulator.flush();
+      
+      std::vector<std::string> serialized_results;
+      std::vector<bool> valid;
+      
+      WorkerPool::run((worker_type_ == ProcessWorkers) 
+                           ? WorkerPool::ProcessWorkers 
+                           : WorkerPool::ThreadWorkers,
+                      n_workers, pending_.size(),
+         [this, &simulator](std::size_t begin, std::size_t end, 
+                            std::vector<std::string> &share) {
+            this->runTests(simulator, begin, end, share);
+         },
+         serialized_results, valid);
+      
+      for(std::size_t i = 0; i < pending_.size(); ++i) {
+         
+         TestResult &result = results_[pending_[i]];
+         std::size_t pos = 0;
+         
+         if(!valid[i] || !deserialize(serialized_results[i], pos, result)) {
+            result.output_ = "Worker process terminated abnormally\n";
+            result.error_count_ = 1;
+            result.n_failed_checks_ = tests_[test_ids_[pending_[i]]].n_checks_;
+         }
+      }
+   }
+   
+   if(use_cache) {
+      for(auto i: pending_) {
+         TestResult &entry = cache_[fingerprints_[test_ids_[i]]];
+         entry = results_[i];
+         entry.output_.clear();
+         entry.cached_ = true;
+      }
+      this->writeCache(simulator);
+   }
+   
+   int n_failed = 0;
+   
+   for(const auto &result: results_) {
+      if(result.cached_) {
+         simulator.log() << "Test " << result.name_ << ": cached result (" 
+            << ((result.error_count_ == 0) ? "passed" : "failed") << ")";
+      }
+      else {
+         simulator.getOStream() << result.output_;
+      }
+      if(result.error_count_ != 0) {
+         ++n_failed;
+      }
+   }
+   
+   this->printSummary(simulator, n_workers, n_failed);
+   
+   if(n_failed != 0) {
+      simulator.error() << n_failed << " of " << results_.size() << " tests failed";
+   }
+   
+   return n_failed;
+}
+
+void TestRunner::printSummary(Simulator &simulator, int n_workers, int n_failed) const
+{
+   Simulator::TimeType duration = 0;
+   int n_cycles = 0;
+   int error_count = 0;
+   int n_reports[NumReportTypeIds] = {};
+   
+   for(const auto &result: results_) {
+      duration += result.duration_;
+      n_cycles += result.n_cycles_;
+      error_count += result.error_count_;
+      for(int type_id = 0; type_id < NumReportTypeIds; ++type_id) {
+         n_reports[type_id] += result.n_reports_[type_id];
+      }
+   }
+   
+   // Foreground color yellow
+   //
+   simulator.getOStream() << "\x1B[33;1m";
+   
+   simulator.log() << "";
+   simulator.log() << "################################################################################";
+   simulator.log() << "Parallel testing done";
+   simulator.log() << "";
+   int n_cached = 0;
+   for(const auto &result: results_) {
+      if(result.cached_) { ++n_cached; }
+   }
+   
+   if(n_cached > 0) {
+      simulator.log() << "tests: " << results_.size() << " (" << n_failed << " failed, "
+         << n_cached << " cached)";
+   }
+   else {
+      simulator.log() << "tests: " << results_.size() << " (" << n_failed << " failed)";
+   }
+   if(n_shards_ > 1) {
+      simulator.log() << "shard: " << shard_ << "/" << n_shards_ 
+         << " (" << tests_.size() << " tests overall)";
+   }
+   simulator.log() << "workers: " << n_workers;
+   simulator.log() << "duration: " << duration << " ms = " << n_cycles << " cycles";
+   simulator.log() << "error_count: " << error_count;
+   simulator.log() << "";
+   simulator.log() << "num. overall reports processed: " << n_reports[AnyTypeReportTypeId];
+   for(int type_id = 1; type_id < NumReportTypeIds; ++type_id) {
+      simulator.log() << "num. " << getReportTypeString(type_id) << " reports processed: " 
+         << n_reports[type_id];
+   }
+   
+   if(n_failed != 0) {
+      simulator.log() << "";
+      simulator.log() << "failed tests:";
+      for(const auto &result: results_) {
+         if(result.error_count_ != 0) {
+            simulator.log() << "   " << result.name_;
+         }
+      }
+   }
+   
+   simulator.log() << "################################################################################";
+   simulator.log() << "";
+   
+   // Restore color to neutral.
+   //
+   simulator.getOStream() << "\x1B[0m";
+}
+
+} // namespace papilio
@@ -0,0 +1,264 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/Simulator.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace papilio {
+   
+class SimulatorCore_;
+
+/// @brief A registry of independent tests that are run in parallel.
+/// @details Tests are distributed over a number of workers. Every worker
+///        runs a contiguous share of the tests in registration order.
+///        Every test runs with a new simulator and a core in its initial
+///        state. The worker restores the initial state of its core
+///        before every test if the core supports saving its state 
+///        (see SimulatorCore_::saveState(...)). Otherwise, every test
+///        gets a new core from a factory function.
+///
+///        The output of every test is collected separately 
+///        and written in registration order, followed by a summary. 
+///        Output is therefore independent of the order in which
+///        workers finish.
+///
+///        Optionally, results are cached in a file (see setResultCache(...)).
+///        A test is skipped if a result was cached for its fingerprint. 
+///        The fingerprint covers the test's name and version, the
+///        core version (see setCoreVersion(...) and setCoreBinary(...)),
+///        the cycle duration and debug mode of the parent simulator 
+///        and the content of the test executable.
+///
+///        Tests can be split into shards that are run separately, 
+///        e.g. on different machines (see setShard(...)).
+///
+class TestRunner
+{
+   public:
+      
+      typedef std::function<std::shared_ptr<SimulatorCore_>()> CoreFactory;
+      
+      /// @brief A function that creates a simulator writing to a given stream.
+      /// @details Cores pass their reports to simulators of a specific
+      ///        type, e.g. a simulator class of the firmware's integration.
+      ///
+      typedef std::function<std::unique_ptr<Simulator>(std::ostream &out)> SimulatorFactory;
+      
+      typedef std::function<void(Simulator &)> TestFunction;
+      
+      /// @brief A function that runs a test that consists of a number
+      ///        of independent checks.
+      /// @returns The number of checks that failed.
+      ///
+      typedef std::function<std::size_t(Simulator &)> CheckingTestFunction;
+      
+      /// @brief The types of workers.
+      ///
+      enum WorkerType {
+         
+         /// @brief Every worker is a thread.
+         /// @details Only use this if cores do not share any global state.
+         ///
+         ThreadWorkers,
+         
+         /// @brief Every worker is a forked process.
+         /// @details This is suitable for cores with global state.
+         ///
+         ProcessWorkers
+      };
+      
+      /// @brief The result of an individual test.
+      ///
+      struct TestResult {
+         std::string name_;
+         std::string output_;
+         int error_count_ = 0;
+         Simulator::TimeType duration_ = 0;
+         int n_cycles_ = 0;
+         int n_reports_[NumReportTypeIds] = {};
+         
+         /// @brief The number of checks that failed (see addChecks(...)).
+         /// @details If the worker that ran the test terminated abnormally, 
+         ///        all checks count as failed.
+         ///
+         std::size_t n_failed_checks_ = 0;
+         
+         /// @brief True if the result was taken from the result cache.
+         ///
+         bool cached_ = false;
+      };
+      
+      /// @brief Constructor.
+      /// @param core_factory A function that creates a new simulator core 
+      ///        in its initial state.
+      ///
+      TestRunner(const CoreFactory &core_factory);
+      
+      /// @brief Registers a test.
+      /// @param name The name of the test.
+      /// @param test_function A function that runs the test.
+      /// @param version An optional version string that becomes part 
+      ///        of the test's fingerprint.
+      ///
+      TestRunner &add(const char *name, const TestFunction &test_function,
+                      const char *version = "");
+      
+      /// @brief Registers a test that consists of a number of checks.
+      /// @details The number of failed checks that the test function returns
+      ///        is stored with the test's result. Failed checks should also be
+      ///        reported as errors, so that the test fails.
+      ///
+      /// @param name The name of the test.
+      /// @param n_checks The number of checks.
+      /// @param test_function A function that runs the test.
+      /// @param version An optional version string that becomes part 
+      ///        of the test's fingerprint.
+      ///
+      TestRunner &addChecks(const char *name, std::size_t n_checks,
+                            const CheckingTestFunction &test_function,
+                            const char *version = "");
+      
+      /// @brief Sets the function that creates the simulator of every test.
+      /// @details By default, plain simulators are created. Debug mode, 
+      ///        cycle duration, log level and quiet mode of every simulator 
+      ///        are configured like the parent simulator.
+      ///
+      ///        With process workers, the factory is called in forked
+      ///        worker processes. It must therefore be fork-safe, e.g. 
+      ///        it must not depend on threads or locks of the parent process.
+      ///
+      void setSimulatorFactory(const SimulatorFactory &simulator_factory) {
+         simulator_factory_ = simulator_factory;
+      }
+      
+      /// @brief Sets the number of workers.
+      /// @param n_workers The number of workers. If zero, one
+      ///        worker per hardware thread is used.
+      ///
+      void setNumWorkers(int n_workers) { n_workers_ = n_workers; }
+      
+      /// @brief Selects the type of workers.
+      ///
+      void setWorkerType(WorkerType worker_type) { worker_type_ = worker_type; }
+      
+      /// @brief Enables caching test results.
+      /// @details The cache file is read before and written after every run.
+      ///
+      /// @param filename The name of the cache file. Caching is disabled 
+      ///        if empty.
+      ///
+      void setResultCache(const std::string &filename) { cache_filename_ = filename; }
+      
+      /// @brief Sets a version of the simulator core that becomes part
+      ///        of all test fingerprints.
+      ///
+      void setCoreVersion(const std::string &version) { core_version_ = version; }
+      
+      /// @brief Sets a binary file, e.g. a core library, whose content
+      ///        becomes part of all test fingerprints.
+      ///
+      void setCoreBinary(const std::string &filename) { core_binary_ = filename; }
+      
+      /// @brief Selects a subset of the tests to run.
+      /// @details Test i (counting from zero in registration order) belongs 
+      ///        to shard i % n_shards + 1.
+      ///
+      /// @param shard The shard to run in the range [1, n_shards].
+      /// @param n_shards The number of shards.
+      ///
+      void setShard(int shard, int n_shards);
+      
+      /// @brief Configures the runner from command line arguments.
+      /// @details Supported are --shard i/n and --result-cache <filename>.
+      ///        Other arguments are ignored.
+      ///
+      /// @returns False if an argument is malformed.
+      ///
+      bool parseArguments(int argc, const char * const *argv);
+      
+      /// @brief Runs all registered tests.
+      /// @details Worker simulators are configured like the given simulator.
+      ///        Test output and summary are written to it. An error is 
+      ///        registered with the simulator if any test failed.
+      ///
+      /// @param simulator The parent simulator.
+      /// @returns The number of failed tests.
+      ///
+      int run(Simulator &simulator);
+      
+      /// @brief Retreives the results of the most recent run.
+      ///
+      const std::vector<TestResult> &getResults() const { return results_; }
+      
+   private:
+      
+      struct TestEntry {
+         std::string name_;
+         TestFunction function_;
+         std::string version_;
+         CheckingTestFunction checking_function_;
+         std::size_t n_checks_;
+      };
+      
+      void runTests(const Simulator &parent, 
+                    std::size_t begin, std::size_t end,
+                    std::vector<std::string> &serialized_results);
+      
+      void printSummary(Simulator &simulator, int n_workers, int n_failed) const;
+      
+      bool computeFingerprints(Simulator &simulator);
+      void readCache(Simulator &simulator);
+      void writeCache(Simulator &simulator) const;
+      
+   private:
+      
+      CoreFactory core_factory_;
+      SimulatorFactory simulator_factory_;
+      std::vector<TestEntry> tests_;
+      std::vector<TestResult> results_;
+      
+      // The test ids of all results of the current shard, and
+      // the ids of the results that are not cached.
+      //
+      std::vector<std::size_t> test_ids_;
+      std::vector<std::size_t> pending_;
+      
+      // The fingerprints of all registered tests and the cached results
+      // by fingerprint.
+      //
+      std::vector<uint64_t> fingerprints_;
+      std::unordered_map<uint64_t, TestResult> cache_;
+      
+      std::string cache_filename_;
+      std::string core_version_;
+      std::string core_binary_;
+      
+      int shard_ = 1;
+      int n_shards_ = 1;
+      
+      int n_workers_ = 0;
+      WorkerType worker_type_ = ProcessWorkers;
+};
+
+} // namespace papilio
@@ -0,0 +1,308 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/TypingLoadGenerator.h"
+#include "papilio/Simulator.h"
+#include "papilio/actions/generic_report/CustomReportAction.h"
+#include "papilio/reports/KeyboardReport_.h"
+#include "papilio/aux/WallTimer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace papilio {
+
+namespace {
+
+// The number of characters that are shown around the first difference
+// between typed and reconstructed text.
+//
+constexpr std::size_t context_length = 20;
+
+uint16_t characterKey(uint8_t keycode, uint8_t modifiers) {
+   return uint16_t((uint16_t(keycode) << 8) | modifiers);
+}
+
+std::string excerpt(const std::string &text, std::size_t pos) {
+   std::size_t begin = (pos > context_length) ? pos - context_length : 0;
+   if(begin >= text.size()) { return std::string(); }
+   return text.substr(begin, pos + context_length - begin);
+}
+
+} // namespace
+
+TypingLoadGenerator &TypingLoadGenerator::addModifier(uint8_t keycode, uint8_t row, uint8_t col)
+{
+   if(KeyboardReport_::isModifierKeycode(keycode)) {
+      ModifierKey &modifier_key = modifier_keys_[keycode - KeyboardReport_::first_modifier_keycode];
+      modifier_key.row_ = row;
+      modifier_key.col_ = col;
+      modifier_key.defined_ = true;
+   }
+   return *this;
+}
+
+TypingLoadGenerator &TypingLoadGenerator::addCharacter(char c, uint8_t row, uint8_t col,
+                                                       uint8_t keycode, uint8_t modifiers)
+{
+   Stroke &stroke = strokes_[uint8_t(c)];
+   stroke.row_ = row;
+   stroke.col_ = col;
+   stroke.keycode_ = keycode;
+   stroke.modifiers_ = modifiers;
+   stroke.defined_ = true;
+   
+   characters_[characterKey(keycode, modifiers)] = c;
+   
+   return *this;
+}
+
+int TypingLoadGenerator::reportedCharacter(uint8_t keycode, uint8_t modifiers) const
+{
+   auto it = characters_.find(characterKey(keycode, modifiers));
+   if(it == characters_.end()) { return -1; }
+   return uint8_t(it->second);
+}
+
+bool TypingLoadGenerator::run(Simulator &simulator, const std::string &text)
+{
+   typed_text_.clear();
+   reconstructed_text_.clear();
+   n_skipped_ = 0;
+   keystrokes_per_second_ = 0.0;
+   
+   const double cycle_duration = double(simulator.getCycleDuration());
+   
+   if((cycle_duration <= 0.0) || (wpm_ <= 0.0)) {
+      simulator.error() << "Typing requires a positive cycle duration and typing speed";
+      return false;
+   }
+   
+   // Five characters per word, intervals and hold durations in cycles.
+   //
+   const double mean_interval = 60000.0/(5.0*wpm_)/cycle_duration;
+   const double mean_hold = (1.0 + rollover_)*mean_interval;
+   
+   std::mt19937_64 random(seed_);
+   std::uniform_real_distribution<double> jitter_distribution(-jitter_, jitter_);
+   
+   // Reconstruct the text from keycodes that become active.
+   //
+   uint8_t active_keycodes[32] = {};
+   std::size_t n_unknown_keycodes = 0;
+   
+   auto recorder = actions::CustomReportAction<Report_>{[&](const Report_ &report) {
+      
+      ReportData data;
+      report.getData(data);
+      
+      if(   (data.type_id_ != KeyboardReportTypeId)
+         && (data.type_id_ != BootKeyboardReportTypeIdId)) {
+         return true;
+      }
+      
+      for(int byte = 0; byte < 32; ++byte) {
+         
+         uint8_t activated = uint8_t(data.bytes_[1 + byte] & ~active_keycodes[byte]);
+         
+         for(int bit = 0; activated != 0; ++bit, activated >>= 1) {
+            
+            if(!(activated & 1)) { continue; }
+            
+            int c = this->reportedCharacter(uint8_t(8*byte + bit), data.bytes_[0]);
+            if(c < 0) {
+               ++n_unknown_keycodes;
+               continue;
+            }
+            reconstructed_text_ += char(c);
+         }
+      }
+      
+      memcpy(active_keycodes, &data.bytes_[1], 32);
+      
+      return true;
+   }};
+   
+   simulator.permanentReportActions().add(recorder);
+   
+   const bool fast_forward = simulator.getFastForward();
+   simulator.setFastForward(true);
+   
+   auto scheduleModifiers = [&](uint8_t modifiers, int cycle_id, bool press) {
+      for(int i = 0; i < 8; ++i) {
+         if(!(modifiers & (1 << i)) || !modifier_keys_[i].defined_) { continue; }
+         if(press) {
+            simulator.schedulePressKey(ScheduleTime::atCycle(cycle_id),
+                                       modifier_keys_[i].row_, modifier_keys_[i].col_);
+         }
+         else {
+            simulator.scheduleReleaseKey(ScheduleTime::atCycle(cycle_id),
+                                         modifier_keys_[i].row_, modifier_keys_[i].col_);
+         }
+      }
+   };
+   
+   auto runUntil = [&](int cycle_id) {
+      int n_cycles = cycle_id - simulator.getCycleId();
+      if(n_cycles > 0) {
+         simulator.cycles(n_cycles);
+      }
+   };
+   
+   const int start_cycle_id = simulator.getCycleId() + 1;
+   
+   double next_press = start_cycle_id;
+   int last_press = start_cycle_id - 1;
+   int last_release = start_cycle_id - 1;
+   uint8_t held_modifiers = 0;
+   
+   // The first cycle in which a key may be pressed again.
+   //
+   std::unordered_map<uint16_t, int> key_free_cycle_ids;
+   
+   WallTimer timer;
+   timer.start();
+   
+   const std::size_t batch_size = std::max(batch_size_, std::size_t(1));
+   
+   for(std::size_t pos = 0; pos < text.size(); ) {
+      
+      const std::size_t batch_end = std::min(pos + batch_size, text.size());
+      
+      for(; pos < batch_end; ++pos) {
+         
+         const Stroke &stroke = strokes_[uint8_t(text[pos])];
+         
+         if(!stroke.defined_) {
+            ++n_skipped_;
+            continue;
+         }
+         
+         typed_text_ += text[pos];
+         
+         int press = std::max(int(std::lround(next_press)), last_press + 1);
+         
+         // Different modifiers are only pressed once all keys are released.
+         //
+         if(stroke.modifiers_ != held_modifiers) {
+            
+            int modifier_release = std::max(press, last_release + 1);
+            scheduleModifiers(held_modifiers, modifier_release, false);
+            
+            press = modifier_release + 1;
+            
+            if(stroke.modifiers_ != 0) {
+               scheduleModifiers(stroke.modifiers_, press, true);
+               ++press;
+            }
+            
+            held_modifiers = stroke.modifiers_;
+         }
+         
+         const uint16_t key = uint16_t((uint16_t(stroke.row_) << 8) | stroke.col_);
+         
+         auto it = key_free_cycle_ids.find(key);
+         if(it != key_free_cycle_ids.end()) {
+            press = std::max(press, it->second);
+         }
+         
+         const int hold = std::max(1, int(std::lround(
+                                 mean_hold*(1.0 + jitter_distribution(random)))));
+         const int release = press + hold;
+         
+         simulator.schedulePressKey(ScheduleTime::atCycle(press), stroke.row_, stroke.col_);
+         simulator.scheduleReleaseKey(ScheduleTime::atCycle(release), stroke.row_, stroke.col_);
+         
+         key_free_cycle_ids[key] = release + 1;
+         last_press = press;
+         last_release = std::max(last_release, release);
+         
+         next_press = press + mean_interval*(1.0 + jitter_distribution(random));
+      }
+      
+      // Releases that are due after the last press of the batch
+      // remain scheduled.
+      //
+      runUntil(last_press);
+   }
+   
+   const int end_cycle_id = last_release + 1;
+   scheduleModifiers(held_modifiers, end_cycle_id, false);
+   runUntil(end_cycle_id);
+   
+   const double elapsed_ms = timer.elapsed();
+   
+   simulator.permanentReportActions().remove(recorder);
+   simulator.setFastForward(fast_forward);
+   
+   const std::size_t n_keystrokes = typed_text_.size();
+   
+   keystrokes_per_second_ = (elapsed_ms > 0.0) ? 1000.0*n_keystrokes/elapsed_ms : 0.0;
+   
+   const double simulated_ms = (end_cycle_id - start_cycle_id + 1)*cycle_duration;
+   const double effective_wpm = (simulated_ms > 0.0) ? n_keystrokes/5.0*60000.0/simulated_ms : 0.0;
+   
+   simulator.log() << "Typed " << n_keystrokes << " characters (" << n_skipped_
+      << " skipped) in " << simulated_ms << " ms simulated time (" << effective_wpm
+      << " WPM) and " << elapsed_ms << " ms wall time (" << keystrokes_per_second_
+      << " keystrokes/s)";
+   
+   bool success = true;
+   
+   if(n_unknown_keycodes > 0) {
+      simulator.error() << n_unknown_keycodes
+         << " keycodes were reported that are not part of the reverse keymap";
+      success = false;
+   }
+   
+   if(reconstructed_text_ != typed_text_) {
+      
+      std::size_t pos = 0;
+      while(   (pos < typed_text_.size()) && (pos < reconstructed_text_.size())
+            && (typed_text_[pos] == reconstructed_text_[pos])) {
+         ++pos;
+      }
+      
+      simulator.error() << "Reconstructed text differs from typed text at character "
+         << pos << " (" << reconstructed_text_.size() << " of "
+         << typed_text_.size() << " characters reconstructed)";
+      simulator.log() << "   typed:         \"" << excerpt(typed_text_, pos) << "\"";
+      simulator.log() << "   reconstructed: \"" << excerpt(reconstructed_text_, pos) << "\"";
+      success = false;
+   }
+   
+   return success;
+}
+
+bool TypingLoadGenerator::runFile(Simulator &simulator, const std::string &filename)
+{
+   std::ifstream file(filename, std::ios::binary);
+   if(!file) {
+      simulator.error() << "Unable to read text corpus \"" << filename << "\"";
+      return false;
+   }
+   
+   std::string text{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+   
+   return this->run(simulator, text);
+}
+
+} // namespace papilio
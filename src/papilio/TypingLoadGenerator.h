@@ -0,0 +1,184 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+namespace papilio {
+
+class Simulator;
+
+/// @brief Types a text corpus at a given typing speed.
+/// @details A reverse keymap assigns matrix position, keycode and
+///        modifiers to every character. Characters are typed
+///        at a target speed in words per minute (five characters per word).
+///        Intervals between key presses and hold durations are randomly
+///        jittered. Keys are held beyond the press of the next key
+///        (rollover), so key presses overlap like those of a fast typist.
+///
+///        Modifiers are pressed one cycle before the first key that
+///        requires them and held as long as consecutive characters
+///        require the same modifiers. Whenever the required modifiers
+///        change, typing waits until all keys are released, so that
+///        reports remain unambiguous.
+///
+///        Key events are passed to the simulator as scheduled key
+///        events (see Simulator::schedulePressKey(...)) in batches of
+///        characters. Cycles run in fast forward mode.
+///
+///        While typing, the text is reconstructed from keyboard and
+///        boot keyboard reports. Every keycode that becomes active
+///        is translated to the character with the same keycode and
+///        active modifiers. The reconstructed text is compared
+///        with the text that was typed.
+///
+class TypingLoadGenerator
+{
+   public:
+      
+      /// @brief Registers the matrix position of a modifier key.
+      ///
+      /// @param keycode The modifier keycode, e.g. 0xE1 (left shift).
+      /// @param row The keyboard matrix row of the modifier key.
+      /// @param col The keyboard matrix column of the modifier key.
+      ///
+      TypingLoadGenerator &addModifier(uint8_t keycode, uint8_t row, uint8_t col);
+      
+      /// @brief Registers a character of the reverse keymap.
+      ///
+      /// @param c The character.
+      /// @param row The keyboard matrix row of the key that types the character.
+      /// @param col The keyboard matrix column of the key that types the character.
+      /// @param keycode The keycode that the key generates.
+      /// @param modifiers The modifiers that are required, as modifier bitmap
+      ///        (bit n: modifier keycode 0xE0 + n). All modifiers
+      ///        must be registered via addModifier(...).
+      ///
+      TypingLoadGenerator &addCharacter(char c, uint8_t row, uint8_t col,
+                                        uint8_t keycode, uint8_t modifiers = 0);
+      
+      /// @brief Sets the typing speed in words per minute.
+      /// @details Default: 120
+      ///
+      void setWordsPerMinute(double wpm) { wpm_ = wpm; }
+      
+      /// @brief Sets the jitter of key press intervals and hold durations.
+      /// @details Intervals and durations vary randomly by up to the
+      ///        given fraction of their mean value. Default: 0.3
+      ///
+      void setJitter(double jitter) { jitter_ = jitter; }
+      
+      /// @brief Sets how far keys are held beyond the press of the next key.
+      /// @details Keys are held for (1 + rollover) times the mean press
+      ///        interval. Default: 0.5
+      ///
+      void setRollover(double rollover) { rollover_ = rollover; }
+      
+      /// @brief Sets the number of characters that are scheduled per batch.
+      /// @details Default: 256
+      ///
+      void setBatchSize(std::size_t n_characters) { batch_size_ = n_characters; }
+      
+      /// @brief Sets the seed of the random jitter.
+      ///
+      void setSeed(uint64_t seed) { seed_ = seed; }
+      
+      /// @brief Types a text.
+      /// @details Characters that are not part of the reverse keymap
+      ///        are skipped. A difference between typed and
+      ///        reconstructed text is reported as an error.
+      ///
+      /// @param simulator The simulator to type with.
+      /// @param text The text to type.
+      ///
+      /// @returns True if the reconstructed text matches the typed text.
+      ///
+      bool run(Simulator &simulator, const std::string &text);
+      
+      /// @brief Types the content of a text file. See run(...).
+      ///
+      /// @param simulator The simulator to type with.
+      /// @param filename The name of the text file.
+      ///
+      /// @returns True if the file was read and the reconstructed text
+      ///        matches the typed text.
+      ///
+      bool runFile(Simulator &simulator, const std::string &filename);
+      
+      /// @brief Retreives the text that was typed by the most recent run,
+      ///        without skipped characters.
+      ///
+      const std::string &getTypedText() const { return typed_text_; }
+      
+      /// @brief Retreives the text that was reconstructed from the reports
+      ///        of the most recent run.
+      ///
+      const std::string &getReconstructedText() const { return reconstructed_text_; }
+      
+      /// @brief Retreives the number of characters of the most recent
+      ///        run that are not part of the reverse keymap.
+      ///
+      std::size_t getNumSkippedCharacters() const { return n_skipped_; }
+      
+      /// @brief Retreives the number of simulated keystrokes per second of
+      ///        wall time that were achieved by the most recent run.
+      ///
+      double getKeystrokesPerSecond() const { return keystrokes_per_second_; }
+   
+   private:
+      
+      struct Stroke {
+         uint8_t row_;
+         uint8_t col_;
+         uint8_t keycode_;
+         uint8_t modifiers_;
+         bool defined_ = false;
+      };
+      
+      struct ModifierKey {
+         uint8_t row_;
+         uint8_t col_;
+         bool defined_ = false;
+      };
+      
+      int reportedCharacter(uint8_t keycode, uint8_t modifiers) const;
+   
+   private:
+      
+      Stroke strokes_[256];
+      ModifierKey modifier_keys_[8];
+      
+      // Characters by keycode and modifier bitmap.
+      //
+      std::unordered_map<uint16_t, char> characters_;
+      
+      double wpm_ = 120.0;
+      double jitter_ = 0.3;
+      double rollover_ = 0.5;
+      std::size_t batch_size_ = 256;
+      uint64_t seed_ = 0;
+      
+      std::string typed_text_;
+      std::string reconstructed_text_;
+      std::size_t n_skipped_ = 0;
+      double keystrokes_per_second_ = 0.0;
+};
+
+} // namespace papilio
@@ -25,128 +25,322 @@
 #undef min
 #undef max
 
-#include <map>
-#include <sstream>
-#include <regex>
+#include <cstdlib>
+#include <memory>
 #include <iostream>
 
 namespace papilio {
    
-typedef std::map<uint8_t, std::string> KeyAddrToKeyString;
+namespace {
+   
+void appendDecimal(std::string &s, unsigned value) {
+   char digits[10];
+   int n = 0;
+   do {
+      digits[n++] = char('0' + value % 10);
+      value /= 10;
+   } while(value != 0);
+   while(n > 0) {
+      s += digits[--n];
+   }
+}
+
+// The position of the keyboard's key labels is computed
+// under the assumption that every key label consists of four characters.
+//
+constexpr unsigned key_label_width = 4;
+
+} // anonymous namespace
+
+KeyboardRenderer::KeyboardRenderer(const char *ascii_keyboard)
+   :  template_(ascii_keyboard)
+{
+   this->parseTemplate();
+}
 
-class KeyboardRenderer
+void KeyboardRenderer::parseTemplate()
 {
-   public:
+   lines_.clear();
+   
+   std::vector<Segment> line;
+   Segment segment{std::string(), -1, 0};
+   unsigned column = 0;
+   
+   const std::size_t size = template_.size();
+   std::size_t i = 0;
+   
+   while(i < size) {
+      
+      const char c = template_[i];
       
-      KeyboardRenderer(const SimulatorCore_ &simulator_core)
-         :  simulator_core_(simulator_core)
-      {}
+      if(c == '\n') {
+         segment.key_offset_ = -1;
+         segment.column_ = column;
+         line.push_back(std::move(segment));
+         lines_.push_back(std::move(line));
+         line.clear();
+         segment = Segment{std::string(), -1, 0};
+         column = 0;
+         ++i;
+         continue;
+      }
+      
+      if(c == '{') {
+         std::size_t end = i + 1;
+         while((end < size) && (template_[end] >= '0') && (template_[end] <= '9')) {
+            ++end;
+         }
+         if((end > i + 1) && (end < size) && (template_[end] == '}')) {
+            unsigned long key_offset 
+               = std::strtoul(template_.c_str() + i + 1, nullptr, 10);
+            segment.key_offset_ = int((key_offset < 0xFFFF) ? key_offset : 0xFFFF);
+            segment.column_ = column;
+            line.push_back(std::move(segment));
+            segment = Segment{std::string(), -1, 0};
+            column += key_label_width;
+            i = end + 1;
+            continue;
+         }
+      }
+      
+      segment.text_ += c;
+      
+      // Count UTF-8 code points, not bytes.
+      //
+      if((c & 0xC0) != 0x80) {
+         ++column;
+      }
+      ++i;
+   }
+   
+   if(!segment.text_.empty() || !line.empty()) {
+      segment.key_offset_ = -1;
+      segment.column_ = column;
+      line.push_back(std::move(segment));
+      lines_.push_back(std::move(line));
+   }
+}
 
-      std::string generateColorEscSeq(uint8_t row, uint8_t col) {
+void KeyboardRenderer::updateKeyStrings(const Simulator &simulator)
+{
+   using namespace terminal_escape_sequences;
+   
+   const SimulatorCore_ &simulator_core = simulator.getCore();
+   
+   uint8_t rows = 0, cols = 0;
+   simulator_core.getKeyMatrixDimensions(rows, cols);
+   
+   const std::size_t n_keys = std::size_t(rows)*cols;
+   
+   bool all_changed = false;
+   if(key_states_.size() != n_keys) {
+      key_states_.assign(n_keys, KeyState{0, 0, 0, false, std::string()});
+      key_strings_.assign(n_keys, std::string());
+      key_changed_.assign(n_keys, true);
+      all_changed = true;
+   }
+   
+   // Revisions are only meaningful with respect to the tracker
+   // they were retreived from.
+   //
+   const CoreChangeTracker &changes = simulator.getCoreChanges();
+   
+   if((&changes != changes_) || (changes.getRevision() < revision_)) {
+      changes_ = &changes;
+      all_changed = true;
+   }
+   
+   const CoreChangeTracker::Revision since = revision_;
+   revision_ = changes.getRevision();
+   
+   if(!all_changed && !changes.anyChanged(since)) {
+      key_changed_.assign(n_keys, false);
+      return;
+   }
+   
+   simulator_core.getKeyMatrixState(pressed_keys_);
+   
+   led_colors_.resize(3*n_keys);
+   if(n_keys > 0) {
+      simulator_core.getCurrentKeyLEDColors(&led_colors_[0], KeyOffset(n_keys));
+   }
+   
+   std::string label;
+   
+   for(uint8_t row = 0; row < rows; ++row) {
+      for(uint8_t col = 0; col < cols; ++col) {
          
-         using namespace terminal_escape_sequences;
+         const KeyOffset pos = keyOffset(row, col, cols);
          
-         uint8_t red = 0, green = 0, blue = 0;
+         KeyState &state = key_states_[pos];
          
-         uint8_t rows, cols;
-         simulator_core_.getKeyMatrixDimensions(rows, cols);
+         if(   !all_changed
+            && !changes.hasChanged(CoreChanges::KeyStateChange, pos, since)
+            && !changes.hasChanged(CoreChanges::KeyLEDChange, pos, since)
+            && !changes.hasChanged(CoreChanges::KeyLabelChange, pos, since)) {
+            key_changed_[pos] = false;
+            continue;
+         }
          
-         uint8_t key_offset = row*cols + col;
-            
-         simulator_core_.getCurrentKeyLEDColor(key_offset, red, green, blue);
+         // Querying labels is expensive.
+         //
+         if(all_changed || changes.hasChanged(CoreChanges::KeyLabelChange, pos, since)) {
+            label = "****";
+            simulator_core.getCurrentKeyLabel(row, col, label);
+         }
+         else {
+            label = state.label_;
+         }
          
-         int col_norm = red*red + green*green + blue*blue;
+         const uint8_t red = led_colors_[3*pos];
+         const uint8_t green = led_colors_[3*pos + 1];
+         const uint8_t blue = led_colors_[3*pos + 2];
          
-         int foreground_color = 30;
+         const bool pressed = pressed_keys_.test(pos);
          
-         // Have dark grey text on light background color and light grey
-         // on dark background.
-         //
-         if(col_norm <= 49152) {
-            foreground_color = 37;
-         }
+         const bool changed 
+            =     all_changed
+               || (state.red_ != red)
+               || (state.green_ != green)
+               || (state.blue_ != blue)
+               || (state.pressed_ != pressed)
+               || (state.label_ != label);
+               
+         key_changed_[pos] = changed;
          
-         static const char * const empty = "";
-         const char *activation_highlight = empty;
-         if(simulator_core_.isKeyPressed(row, col)) {
-            activation_highlight = underlined;
+         if(!changed) {
+            continue;
          }
-            
-         std::ostringstream o;
-         o << "\x1B[48;2;" << (int)red << ";" << (int)green << ";" << (int)blue << "m"
-               "\x1B[" << foreground_color << "m" 
-               << activation_highlight;
-         return o.str();
-      }
          
-      void generateLookup(KeyAddrToKeyString &lookup) {
+         state.red_ = red;
+         state.green_ = green;
+         state.blue_ = blue;
+         state.pressed_ = pressed;
+         state.label_ = label;
          
-         using namespace terminal_escape_sequences;
-         
-         uint8_t rows = 0, cols = 0;
+         int col_norm = red*red + green*green + blue*blue;
          
-         simulator_core_.getKeyMatrixDimensions(rows, cols);
+         // Have dark grey text on light background color and light grey
+         // on dark background.
+         //
+         const char *foreground_color = (col_norm <= 49152) ? "37" : "30";
          
-         for(uint8_t row = 0; row < rows; ++row) {
-            for(uint8_t col = 0; col < cols; ++col) {
-               
-               std::string key_string("****");
-               simulator_core_.getCurrentKeyLabel(row, col, key_string);
-               
-               std::string color_string = this->generateColorEscSeq(row, col);
-               
-               uint8_t pos = row*cols + col;
-               
-               //std::cout << (int)pos << ": color: \"" << color_string << "\", key_string: \"" << key_string << "\"\n";
-               
-               lookup[pos] = color_string + key_string + reset_formatting;
-            }
+         std::string &key_string = key_strings_[pos];
+         key_string.clear();
+         key_string += "\x1B[48;2;";
+         appendDecimal(key_string, red);
+         key_string += ';';
+         appendDecimal(key_string, green);
+         key_string += ';';
+         appendDecimal(key_string, blue);
+         key_string += "m\x1B[";
+         key_string += foreground_color;
+         key_string += 'm';
+         if(pressed) {
+            key_string += underlined;
          }
+         key_string += label;
+         key_string += reset_formatting;
       }
-      
-   private:
-      
-      const SimulatorCore_ &simulator_core_;
-};
+   }
+}
+
+std::string KeyboardRenderer::generateLine(const std::size_t line_id) const
+{
+   std::string output_text;
    
-void renderKeyboard(const Simulator &simulator, const char *ascii_keyboard) {
+   for(const auto &segment: lines_[line_id]) {
+      output_text += segment.text_;
+      if((segment.key_offset_ >= 0) 
+            && (std::size_t(segment.key_offset_) < key_strings_.size())) {
+         output_text += key_strings_[segment.key_offset_];
+      }
+   }
    
-   KeyAddrToKeyString lookup;
-   KeyboardRenderer kr{simulator.getCore()};
-   kr.generateLookup(lookup);
-
-   std::istringstream ss(ascii_keyboard);
-   std::string line;
+   return output_text;
+}
 
-   std::regex re("\\{\\d+\\}");
-   while(std::getline(ss,line,'\n')){
+void KeyboardRenderer::render(const Simulator &simulator)
+{
+   this->updateKeyStrings(simulator);
+   
+   for(std::size_t line_id = 0; line_id < lines_.size(); ++line_id) {
+      simulator.log() << this->generateLine(line_id);
+   }
+   
+   // The log output invalidates the terminal positions of
+   // an incrementally rendered frame.
+   //
+   frame_valid_ = false;
+}
 
-      std::string output_text;
-         
-      auto callback = [&](std::string const& m){
-         if(m[0] == '{')
-         {
-            std::istringstream iss(m);
-            int n;
-            iss.ignore(1);
-            iss >> n;
-            output_text += lookup[uint8_t(n)];
-         }
-         else
-         {
-            output_text += m;
-         }
-      };
+void KeyboardRenderer::update(const Simulator &simulator)
+{
+   this->updateKeyStrings(simulator);
+   
+   frame_buffer_.clear();
+   
+   if(!frame_valid_) {
+      for(std::size_t line_id = 0; line_id < lines_.size(); ++line_id) {
+         frame_buffer_ += this->generateLine(line_id);
+         frame_buffer_ += '\n';
+      }
+      frame_valid_ = true;
+   }
+   else {
       
-      //std::cout << "Line: " << line << std::endl;
+      // The cursor resides at the beginning of the line
+      // that follows the keyboard.
+      //
+      const std::size_t n_lines = lines_.size();
       
-      std::sregex_token_iterator
-         begin(line.begin(), line.end(), re, {-1, 0}),
-         end;
-      std::for_each(begin,end,callback);
-
-      simulator.log() << output_text;
-    }
+      for(std::size_t line_id = 0; line_id < n_lines; ++line_id) {
+         for(const auto &segment: lines_[line_id]) {
+            
+            if((segment.key_offset_ < 0) 
+                  || (std::size_t(segment.key_offset_) >= key_strings_.size())
+                  || !key_changed_[segment.key_offset_]) {
+               continue;
+            }
+            
+            const unsigned lines_up = unsigned(n_lines - line_id);
+            
+            frame_buffer_ += "\x1B[";
+            appendDecimal(frame_buffer_, lines_up);
+            frame_buffer_ += "A\r";
+            if(segment.column_ > 0) {
+               frame_buffer_ += "\x1B[";
+               appendDecimal(frame_buffer_, segment.column_);
+               frame_buffer_ += 'C';
+            }
+            frame_buffer_ += key_strings_[segment.key_offset_];
+            frame_buffer_ += "\r\x1B[";
+            appendDecimal(frame_buffer_, lines_up);
+            frame_buffer_ += 'B';
+         }
+      }
+   }
+   
+   if(frame_buffer_.empty()) {
+      return;
+   }
+   
+   simulator.getOStream().write(frame_buffer_.data(), frame_buffer_.size());
+   simulator.getOStream().flush();
+}
+   
+void renderKeyboard(const Simulator &simulator, const char *ascii_keyboard) {
+   
+   // Interactive sessions typically render the same template
+   // after every cycle.
+   //
+   static thread_local std::unique_ptr<KeyboardRenderer> renderer;
+   
+   if(!renderer || (renderer->getTemplate() != ascii_keyboard)) {
+      renderer.reset(new KeyboardRenderer{ascii_keyboard});
+   }
+   
+   renderer->render(simulator);
 }
 
 } // namespace papilio
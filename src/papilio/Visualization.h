@@ -17,11 +17,113 @@
 
 #pragma once
 
+#include "papilio/CoreChanges.h"
+#include "papilio/KeyMatrixState.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
 namespace papilio {
    
 class Simulator;
+
+/// @brief Renders a keyboard's ascii representation based on a
+///        template that is parsed only once.
+/// @details Any {n} token of the template is replaced by the
+///        label of the key with offset n, rendered in the key's
+///        current LED color. 
+///
+class KeyboardRenderer
+{
+   public:
+      
+      /// @brief Constructor.
+      ///
+      /// @param ascii_keyboard The ascii representation of the keyboards
+      ///        key layout.
+      ///
+      explicit KeyboardRenderer(const char *ascii_keyboard);
+      
+      /// @brief Renders the complete keyboard via the simulator's
+      ///        log stream.
+      ///
+      /// @param simulator The parent simulator object.
+      ///
+      void render(const Simulator &simulator);
+      
+      /// @brief Renders the keyboard incrementally.
+      /// @details The first call after construction or invalidate()
+      ///        draws the complete keyboard directly to the simulator's
+      ///        ostream, without log line prefixes. Every
+      ///        further call only redraws those keys whose LED color,
+      ///        pressed state or label changed, using terminal cursor
+      ///        addressing. This requires that no other output is
+      ///        written between calls. Call invalidate() if it was.
+      ///
+      ///        If the core tracks changes (see SimulatorCore_::takeChanges(...)),
+      ///        only the labels of keys that changed are queried. 
+      ///
+      /// @param simulator The parent simulator object.
+      ///
+      void update(const Simulator &simulator);
+      
+      /// @brief Forces the next call to update() to draw the 
+      ///        complete keyboard.
+      ///
+      void invalidate() { frame_valid_ = false; }
+      
+      /// @brief Retreives the template that the renderer was created from.
+      ///
+      const std::string &getTemplate() const { return template_; }
+      
+   private:
+      
+      void parseTemplate();
+      
+      void updateKeyStrings(const Simulator &simulator);
+      
+      std::string generateLine(const std::size_t line_id) const;
+      
+   private:
+      
+      // A literal text that is followed by a key slot. Key slot
+      // -1 means that the text is the end of the line.
+      //
+      struct Segment {
+         std::string text_;
+         int key_offset_;
+         unsigned column_;
+      };
+      
+      struct KeyState {
+         uint8_t red_, green_, blue_;
+         bool pressed_;
+         std::string label_;
+      };
+      
+      std::string template_;
+      
+      std::vector<std::vector<Segment>> lines_;
+      
+      std::vector<KeyState> key_states_;
+      std::vector<std::string> key_strings_;
+      std::vector<bool> key_changed_;
+      
+      KeyMatrixState pressed_keys_;
+      std::vector<uint8_t> led_colors_;
+      
+      bool frame_valid_ = false;
+      
+      const CoreChangeTracker *changes_ = nullptr;
+      CoreChangeTracker::Revision revision_ = 0;
+      
+      std::string frame_buffer_;
+};
    
 /// @brief Renders a keyboard's asscii representation.
+/// @details The most recently used template is parsed only once
+///        per thread.
 ///
 /// @param simulator The parent simulator object.
 /// @param ascii_keyboard The ascii representation of the keyboards
@@ -20,6 +20,8 @@
 #undef min
 #undef max
 
+#include "papilio/aux/PoolAllocator.h"
+
 #include <string>
 #include <ostream>
 #include <memory>
@@ -189,8 +191,9 @@ auto unwrapAction(const _T &action) -> decltype(action.ptr()) {
       struct DelegateConstruction {};                                          \
                                                                                \
       template<typename..._Args>                                               \
-      WRAPPER(DelegateConstruction, _Args...args)                              \
-         : action_{new WRAPPER::Action{std::forward<_Args>(args)...}}          \
+      WRAPPER(DelegateConstruction, _Args&&...args)                            \
+         : action_{papilio::allocatePooled<WRAPPER::Action>(                   \
+                                          std::forward<_Args>(args)...)}       \
       {}                                                                       \
                                                                                \
       /*operator std::shared_ptr<TYPENAME_KEYWORD WRAPPER::Action::ActionBaseType> () { return action_; }                                                           \
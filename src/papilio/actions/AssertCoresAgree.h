@@ -0,0 +1,84 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/actions/Action_.h"
+#include "papilio/DifferentialCore.h"
+#include "papilio/Simulator.h"
+
+#include <memory>
+
+namespace papilio {
+namespace actions {
+
+/// @brief Asserts that the reference and the candidate of a
+///        differential core agree.
+/// @details Register this action as permanent cycle action. It fails
+///        once, in the cycle of the first mismatch, and reports the 
+///        mismatch together with the reports that preceded it.
+///
+class AssertCoresAgree {
+   
+   public:
+   
+      /// @brief Constructor.
+      /// @param core The differential core to check.
+      ///
+      AssertCoresAgree(const std::shared_ptr<DifferentialCore> &core) 
+         :  AssertCoresAgree(DelegateConstruction{}, core)
+      {}
+      
+   private:
+      
+      class Action : public Action_ {
+      
+         public:
+
+            Action(const std::shared_ptr<DifferentialCore> &core) 
+               :  core_(core)
+            {}
+            
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Reference and candidate core agree";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               core_->describeMismatch(*this->getSimulator(), add_indent);
+            }
+
+            virtual bool evalInternal() override {
+               
+               // The mismatch is only reported once.
+               //
+               if(reported_ || !core_->hasMismatch()) { return true; }
+               
+               reported_ = true;
+               return false;
+            }
+         
+         private:
+            
+            std::shared_ptr<DifferentialCore> core_;
+            bool reported_ = false;
+      };
+      
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(AssertCoresAgree)
+};
+
+} // namespace actions
+} // namespace papilio
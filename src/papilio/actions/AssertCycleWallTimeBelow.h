@@ -0,0 +1,104 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/actions/Action_.h"
+#include "papilio/Profiler.h"
+#include "papilio/Simulator.h"
+
+namespace papilio {
+namespace actions {
+
+/// @brief Asserts that a percentile of the wall time of 
+///        SimulatorCore_::loop() is below a given duration.
+/// @details The durations are taken from the simulator's profiler
+///        that must be enabled. Report processing that happens during
+///        the core loop is not accounted for. The assertion fails if no core
+///        loop was profiled at all. Typically evaluated once at the end of a test,
+///        e.g. by means of Simulator::evaluateActions(...).
+///
+class AssertCycleWallTimeBelow {
+   
+   public:
+   
+      /// @brief Constructor.
+      /// @param microseconds The duration that the wall time must be below.
+      /// @param percentile The percentile in the range [0, 100] 
+      ///        that is checked, e.g. 99.
+      ///
+      AssertCycleWallTimeBelow(double microseconds, double percentile = 100) 
+         :  AssertCycleWallTimeBelow(DelegateConstruction{}, microseconds, percentile)
+      {}
+      
+   private:
+      
+      class Action : public Action_ {
+      
+         public:
+
+            Action(double microseconds, double percentile) 
+               :  microseconds_(microseconds),
+                  percentile_(percentile)
+            {}
+            
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Core loop wall time percentile " 
+                  << percentile_ << " below " << microseconds_ << " us";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               const auto &histogram = this->getHistogram();
+               if(histogram.getCount() == 0) {
+                  this->getSimulator()->log() << add_indent << "No core loops profiled";
+                  return;
+               }
+               this->getSimulator()->log() << add_indent << "Actual core loop wall time percentile " 
+                  << percentile_ << ": " << histogram.getPercentile(percentile_)/ns_per_us
+                  << " us (" << histogram.getCount() << " samples)";
+               
+               const auto &worst_cycle = this->getSimulator()->getProfiler().getWorstCoreLoop();
+               this->getSimulator()->log() << add_indent << "Slowest core loop: " 
+                  << worst_cycle.duration_/ns_per_us << " us in cycle " << worst_cycle.cycle_id_;
+            }
+
+            virtual bool evalInternal() override {
+               const auto &histogram = this->getHistogram();
+               return    (histogram.getCount() > 0)
+                      && (histogram.getPercentile(percentile_) < microseconds_*ns_per_us);
+            }
+         
+         private:
+            
+            static constexpr double ns_per_us = 1e3;
+            
+            const Histogram &getHistogram() const {
+               return this->getSimulator()->getProfiler()
+                           .getPhaseHistogram(Profiler::CoreLoopPhase);
+            }
+            
+         private:
+            
+            double microseconds_ = 0;
+            double percentile_ = 100;
+      };
+      
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(AssertCycleWallTimeBelow)
+};
+
+} // namespace actions
+} // namespace papilio
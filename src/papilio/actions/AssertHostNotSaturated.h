@@ -0,0 +1,104 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/actions/Action_.h"
+#include "papilio/HostPollingModel.h"
+#include "papilio/Simulator.h"
+
+namespace papilio {
+namespace actions {
+
+/// @brief Asserts that the host polled all reports of an endpoint
+///        without dropping or merging any of them.
+/// @details The statistics are taken from the simulator's host polling
+///        model that must be enabled. Optionally, the queue depth that
+///        arriving reports found must stay below a limit.
+///        Typically evaluated once at the end of a test,
+///        e.g. by means of Simulator::evaluateActions(...).
+///
+class AssertHostNotSaturated {
+   
+   public:
+      
+      /// @brief Constructor.
+      /// @param type_id The report type id of the endpoint, e.g. KeyboardReportTypeId.
+      /// @param max_queue_depth The queue depth that must not be reached.
+      ///        Zero means no limit.
+      ///
+      AssertHostNotSaturated(int type_id, uint64_t max_queue_depth = 0)
+         :  AssertHostNotSaturated(DelegateConstruction{}, type_id, max_queue_depth)
+      {}
+   
+   private:
+      
+      class Action : public Action_ {
+         
+         public:
+            
+            Action(int type_id, uint64_t max_queue_depth)
+               :  type_id_(type_id),
+                  max_queue_depth_(max_queue_depth)
+            {}
+            
+            virtual void describe(const char *add_indent = "") const override {
+               if(max_queue_depth_ > 0) {
+                  this->getSimulator()->log() << add_indent << "Host polled all " 
+                     << getReportTypeString(type_id_) << " reports with queue depth below " 
+                     << max_queue_depth_;
+               }
+               else {
+                  this->getSimulator()->log() << add_indent << "Host polled all " 
+                     << getReportTypeString(type_id_) << " reports";
+               }
+            }
+            
+            virtual void describeState(const char *add_indent = "") const {
+               const auto &endpoint = this->getEndpoint();
+               this->getSimulator()->log() << add_indent << "Actually "
+                  << endpoint.getNumDropped() << " dropped, "
+                  << endpoint.getNumMerged() << " merged, max. queue depth "
+                  << endpoint.getQueueDepthHistogram().getMax()
+                  << " (" << endpoint.getNumArrived() << " reports)";
+            }
+            
+            virtual bool evalInternal() override {
+               const auto &endpoint = this->getEndpoint();
+               return    (endpoint.getNumDropped() == 0)
+                      && (endpoint.getNumMerged() == 0)
+                      && (   (max_queue_depth_ == 0)
+                          || (endpoint.getQueueDepthHistogram().getMax() < max_queue_depth_));
+            }
+         
+         private:
+            
+            const HostPollingModel::Endpoint &getEndpoint() const {
+               return this->getSimulator()->getHostPolling().getEndpoint(type_id_);
+            }
+         
+         private:
+            
+            int type_id_ = KeyboardReportTypeId;
+            uint64_t max_queue_depth_ = 0;
+      };
+   
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(AssertHostNotSaturated)
+};
+
+} // namespace actions
+} // namespace papilio
@@ -0,0 +1,180 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/actions/Action_.h"
+#include "papilio/LEDRecording.h"
+#include "papilio/LED_Checks.h"
+#include "papilio/Simulator.h"
+#include "papilio/SimulatorCore_.h"
+
+#include <vector>
+
+namespace papilio {
+namespace actions {
+
+/// @brief Compares the key LED colors of every cycle against an LED recording.
+/// @details Register this action as permanent cycle action. 
+///        The LED state of every cycle must match the last frame
+///        that was recorded at or before the same cycle id, e.g. 
+///        by RecordLEDAnimation. Comparison stops at the first divergence, 
+///        which is reported as a failure. Cycles before the first
+///        recorded frame are not compared.
+///
+///        Use atEnd() after the test to check that no recorded
+///        frames are missing.
+///
+class AssertLEDsMatchRecording {
+   
+   public:
+      
+      /// @brief Constructor.
+      ///
+      /// @param filename The name of the recording file to compare with.
+      /// @param tolerance The maximum difference per color channel that is 
+      ///        considered a match.
+      ///
+      AssertLEDsMatchRecording(const std::string &filename, uint8_t tolerance = 0)
+         : AssertLEDsMatchRecording(DelegateConstruction{}, filename, tolerance)
+      {}
+      
+      /// @brief Checks if all frames of the recording have been compared.
+      ///
+      bool atEnd() const { return action_->atEnd(); }
+      
+      /// @brief Checks if a divergence was detected.
+      ///
+      bool hasDiverged() const { return action_->hasDiverged(); }
+   
+   private:
+      
+      class Action : public Action_ {
+   
+         public:
+            
+            Action(const std::string &filename, uint8_t tolerance)
+               :  filename_(filename),
+                  tolerance_(tolerance)
+            {
+               reader_.open(filename_);
+            }
+
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "LEDs match recording \'"
+                  << filename_ << "\'";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               
+               switch(state_) {
+                  case OpenFailed:
+                     this->getSimulator()->log() << add_indent << "Unable to read LED recording file";
+                     break;
+                  case SizeMismatch:
+                     this->getSimulator()->log() << add_indent << "The recording stores " 
+                        << reader_.getNumKeys() << " key LEDs, the keyboard has " 
+                        << n_keys_;
+                     break;
+                  case Diverged:
+                     this->getSimulator()->log() << add_indent << "LED colors diverge from the frame of cycle " 
+                        << reader_.getCycleId() << " at " << diff_.getNumMismatches() 
+                        << " of " << diff_.getNumKeys() << " key LEDs";
+                     for(const auto &mismatch: diff_.getMismatches()) {
+                        this->getSimulator()->log() << add_indent << "   key LED " 
+                           << (int)mismatch.key_offset_ 
+                           << ": expected (" << (int)mismatch.expected_[0] << ", " 
+                                             << (int)mismatch.expected_[1] << ", " 
+                                             << (int)mismatch.expected_[2] << ")"
+                           << ", actual (" << (int)mismatch.actual_[0] << ", " 
+                                           << (int)mismatch.actual_[1] << ", " 
+                                           << (int)mismatch.actual_[2] << ")";
+                     }
+                     break;
+                  default:
+                     this->getSimulator()->log() << add_indent << n_compared_ 
+                        << " cycles compared";
+                     break;
+               }
+            }
+
+            virtual bool evalInternal() override {
+               
+               // Comparison stops at the first divergence.
+               //
+               if(state_ != Matching) { return true; }
+               
+               if(!reader_.isOpen()) {
+                  state_ = OpenFailed;
+                  return false;
+               }
+               
+               const SimulatorCore_ &core = this->getSimulator()->getCore();
+               
+               uint8_t rows = 0, cols = 0;
+               core.getKeyMatrixDimensions(rows, cols);
+               n_keys_ = KeyOffset(rows*cols);
+               
+               if(n_keys_ != reader_.getNumKeys()) {
+                  state_ = SizeMismatch;
+                  return false;
+               }
+               
+               const uint32_t cycle_id = uint32_t(this->getSimulator()->getCycleId());
+               
+               while(!reader_.atEnd() && (reader_.getNextCycleId() <= cycle_id)) {
+                  reader_.next();
+               }
+               
+               if(!reader_.hasFrame() || (n_keys_ == 0)) { return true; }
+               
+               colors_.resize(3*std::size_t(n_keys_));
+               core.getCurrentKeyLEDColors(&colors_[0], n_keys_);
+               
+               ++n_compared_;
+               
+               if(!compareLEDFrames(reader_.getColors(), &colors_[0], n_keys_, diff_, tolerance_)) {
+                  state_ = Diverged;
+                  return false;
+               }
+               
+               return true;
+            }
+            
+            bool atEnd() const { return reader_.atEnd(); }
+            
+            bool hasDiverged() const { return state_ != Matching; }
+            
+         private:
+            
+            enum State { Matching, OpenFailed, SizeMismatch, Diverged };
+            
+            std::string filename_;
+            uint8_t tolerance_;
+            LEDRecordingReader reader_;
+            LEDFrameDiff diff_;
+            std::vector<uint8_t> colors_;
+            KeyOffset n_keys_ = 0;
+            std::size_t n_compared_ = 0;
+            State state_ = Matching;
+      };
+   
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(AssertLEDsMatchRecording)
+};
+
+} // namespace actions
+} // namespace papilio
@@ -0,0 +1,96 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/actions/Action_.h"
+#include "papilio/LatencyTracker.h"
+#include "papilio/Simulator.h"
+
+namespace papilio {
+namespace actions {
+
+/// @brief Asserts that a percentile of the key to report latency 
+///        is below a given number of cycles.
+/// @details The latency is taken from the simulator's latency tracker
+///        that must be enabled. The assertion fails if no latency was 
+///        recorded at all. Typically evaluated once at the end of a test,
+///        e.g. by means of Simulator::evaluateActions(...).
+///
+class AssertLatencyBelow {
+   
+   public:
+   
+      /// @brief Constructor.
+      /// @param cycles The number of cycles that the latency must be below.
+      /// @param percentile The percentile in the range [0, 100] 
+      ///        that is checked, e.g. 99.
+      ///
+      AssertLatencyBelow(uint64_t cycles, double percentile = 100) 
+         :  AssertLatencyBelow(DelegateConstruction{}, cycles, percentile)
+      {}
+      
+   private:
+      
+      class Action : public Action_ {
+      
+         public:
+
+            Action(uint64_t cycles, double percentile) 
+               :  cycles_(cycles),
+                  percentile_(percentile)
+            {}
+            
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Latency percentile " 
+                  << percentile_ << " below " << cycles_ << " cycles";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               const auto &histogram = this->getHistogram();
+               if(histogram.getCount() == 0) {
+                  this->getSimulator()->log() << add_indent << "No latencies recorded";
+                  return;
+               }
+               this->getSimulator()->log() << add_indent << "Actual latency percentile " 
+                  << percentile_ << ": " << histogram.getPercentile(percentile_) 
+                  << " cycles (" << histogram.getCount() << " samples)";
+            }
+
+            virtual bool evalInternal() override {
+               const auto &histogram = this->getHistogram();
+               return    (histogram.getCount() > 0)
+                      && (histogram.getPercentile(percentile_) < cycles_);
+            }
+         
+         private:
+            
+            const Histogram &getHistogram() const {
+               return this->getSimulator()->getLatencyTracker().getStatistics().cycles_;
+            }
+            
+         private:
+            
+            uint64_t cycles_ = 0;
+            double percentile_ = 100;
+      };
+      
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(AssertLatencyBelow)
+};
+
+} // namespace actions
+} // namespace papilio
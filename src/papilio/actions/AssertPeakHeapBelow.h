@@ -0,0 +1,89 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/actions/Action_.h"
+#include "papilio/MemoryTracker.h"
+#include "papilio/Simulator.h"
+
+namespace papilio {
+namespace actions {
+
+/// @brief Asserts that the peak heap footprint of the firmware 
+///        is below a given number of bytes.
+/// @details The peak is taken from the simulator's memory tracker
+///        that must be enabled. It covers the time since the start 
+///        of the current test. The assertion fails if the library
+///        was built without heap tracking (see PAPILIO_TRACK_HEAP).
+///
+class AssertPeakHeapBelow {
+   
+   public:
+   
+      /// @brief Constructor.
+      /// @param bytes The number of bytes that the peak must be below.
+      ///
+      AssertPeakHeapBelow(int64_t bytes) 
+         :  AssertPeakHeapBelow(DelegateConstruction{}, bytes)
+      {}
+      
+   private:
+      
+      class Action : public Action_ {
+      
+         public:
+
+            Action(int64_t bytes) 
+               :  bytes_(bytes)
+            {}
+            
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Peak heap below " 
+                  << bytes_ << " bytes";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               if(!this->isTracked()) {
+                  this->getSimulator()->log() << add_indent << "Heap not tracked";
+                  return;
+               }
+               this->getSimulator()->log() << add_indent << "Actual peak heap: " 
+                  << MemoryTracker::getPeakHeap() << " bytes";
+            }
+
+            virtual bool evalInternal() override {
+               return this->isTracked() && (MemoryTracker::getPeakHeap() < bytes_);
+            }
+         
+         private:
+            
+            bool isTracked() const {
+               return    MemoryTracker::isHeapTrackingAvailable()
+                      && this->getSimulator()->getMemoryTracker().isEnabled();
+            }
+            
+         private:
+            
+            int64_t bytes_ = 0;
+      };
+      
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(AssertPeakHeapBelow)
+};
+
+} // namespace actions
+} // namespace papilio
@@ -42,8 +42,8 @@ class GroupedAction_ : public _ActionType {
          :  actions_{std::forward<_Actions>(actions)...}
       {}
 
-      GroupedAction_(const std::vector<std::shared_ptr<_ActionType>> &actions)
-         :  actions_{actions}
+      GroupedAction_(std::vector<std::shared_ptr<_ActionType>> actions)
+         :  actions_{std::move(actions)}
       {}
 
       virtual void report(const char *add_indent = "") const override {
@@ -0,0 +1,178 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/actions/Action_.h"
+#include "papilio/LEDRecording.h"
+#include "papilio/Simulator.h"
+#include "papilio/SimulatorCore_.h"
+
+#include <vector>
+
+namespace papilio {
+namespace actions {
+
+/// @brief Records the key LED colors of every cycle to an LED recording file.
+/// @details Register this action as permanent cycle action 
+///        to record a golden LED animation that can later be compared 
+///        against via AssertLEDsMatchRecording. Frames are only written
+///        when the LED colors changed. The action always passes,
+///        unless the recording file cannot be written.
+///
+class RecordLEDAnimation {
+   
+   public:
+      
+      /// @brief Constructor.
+      ///
+      /// @param filename The name of the recording file to write.
+      /// @param keyframe_interval Every nth frame written stores the 
+      ///        colors of all keys, the others only store changes.
+      ///
+      RecordLEDAnimation(const std::string &filename, 
+                         unsigned keyframe_interval = 64)
+         : RecordLEDAnimation(DelegateConstruction{}, filename, keyframe_interval)
+      {}
+      
+      /// @brief Flushes and closes the recording file.
+      /// @details Otherwise this happens when the action is destroyed.
+      ///        Once closed, no further frames are recorded.
+      ///
+      void close() { action_->close(); }
+      
+      /// @brief Retreives the number of frames recorded.
+      ///
+      std::size_t getNumFrames() const { return action_->getNumFrames(); }
+   
+   private:
+      
+      class Action : public Action_ {
+   
+         public:
+            
+            Action(const std::string &filename, unsigned keyframe_interval)
+               :  filename_(filename),
+                  keyframe_interval_(keyframe_interval)
+            {}
+
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Recording LED animation \'"
+                  << filename_ << "\'";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               if(n_keys_changed_) {
+                  this->getSimulator()->log() << add_indent 
+                     << "Number of keys changed from " << n_recorded_keys_ 
+                     << " to " << n_changed_keys_ << " while recording";
+               }
+               else if(failed_) {
+                  this->getSimulator()->log() << add_indent 
+                     << "Unable to write LED recording file \'" << filename_ << "\'";
+               }
+               else {
+                  this->getSimulator()->log() << add_indent << writer_.getNumFrames()
+                     << " frames recorded";
+               }
+            }
+
+            virtual bool evalInternal() override {
+               
+               // Report a failure only once.
+               //
+               if(failed_ || closed_) { return true; }
+               
+               const SimulatorCore_ &core = this->getSimulator()->getCore();
+               
+               uint8_t rows = 0, cols = 0;
+               core.getKeyMatrixDimensions(rows, cols);
+               const KeyOffset n_keys = KeyOffset(rows*cols);
+               
+               // The number of keys is only known once the action
+               // is evaluated.
+               //
+               if(!writer_.isOpen()) {
+                  if(!writer_.open(filename_, n_keys, keyframe_interval_)) {
+                     failed_ = true;
+                     return false;
+                  }
+                  colors_.assign(3*std::size_t(n_keys) + 1, 0);
+                  n_recorded_keys_ = n_keys;
+               }
+               
+               // The recording's frame size is fixed, e.g. a core that was
+               // replaced by one with different dimensions cannot be recorded.
+               //
+               if(n_keys != n_recorded_keys_) {
+                  n_changed_keys_ = n_keys;
+                  n_keys_changed_ = true;
+                  failed_ = true;
+                  return false;
+               }
+               
+               // Colors are only copied if any changed.
+               //
+               const CoreChangeTracker &changes = this->getSimulator()->getCoreChanges();
+               
+               if(   (n_keys > 0) 
+                  && (   (&changes != changes_)
+                      || changes.anyChanged(CoreChanges::KeyLEDChange, revision_))) {
+                  core.getCurrentKeyLEDColors(&colors_[0], n_keys);
+               }
+               
+               changes_ = &changes;
+               revision_ = changes.getRevision();
+               
+               if(!writer_.write(uint32_t(this->getSimulator()->getCycleId()),
+                                 this->getSimulator()->getTime(),
+                                 &colors_[0])) {
+                  failed_ = true;
+                  return false;
+               }
+               
+               return true;
+            }
+            
+            void close() { 
+               writer_.close(); 
+               closed_ = true;
+            }
+            
+            std::size_t getNumFrames() const { return writer_.getNumFrames(); }
+            
+         private:
+            
+            std::string filename_;
+            unsigned keyframe_interval_;
+            LEDRecordingWriter writer_;
+            std::vector<uint8_t> colors_;
+            KeyOffset n_recorded_keys_ = 0;
+            KeyOffset n_changed_keys_ = 0;
+            bool n_keys_changed_ = false;
+            bool failed_ = false;
+            bool closed_ = false;
+            
+            const CoreChangeTracker *changes_ = nullptr;
+            CoreChangeTracker::Revision revision_ = 0;
+      };
+   
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(RecordLEDAnimation)
+};
+
+} // namespace actions
+} // namespace papilio
@@ -0,0 +1,290 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/Simulator.h"
+#include "papilio/actions/Action_.h"
+#include "papilio/actions/generic_report/ReportAction.h"
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/// @file
+/// @brief This files contains classes and functions to 
+///        group actions whose types are known at compile time.
+
+namespace papilio {
+namespace actions {
+   
+/// @private
+/// @brief Determines the action type that a wrapper (or a pointer) refers to.
+///
+template<typename _Wrapper>
+struct StaticGroupMemberType {
+   typedef typename std::decay<
+         decltype(*unwrapAction(std::declval<const _Wrapper&>()))
+      >::type type;
+};
+
+/// @private
+/// @brief Determines the report type of a group of two report types.
+/// @details Generic report actions (Report_) are compatible with any 
+///        report type.
+///
+template<typename _ReportType1, typename _ReportType2>
+struct StaticGroupReportType {
+   static constexpr bool compatible 
+      =     std::is_same<_ReportType1, _ReportType2>::value
+         || std::is_same<_ReportType1, Report_>::value
+         || std::is_same<_ReportType2, Report_>::value;
+         
+   typedef typename std::conditional<
+         std::is_same<_ReportType1, Report_>::value, 
+         _ReportType2, 
+         _ReportType1
+      >::type type;
+};
+
+/// @private
+/// @brief Checks compatibility and determines base and report type 
+///        of a group of actions.
+///
+template<typename..._ActionTypes>
+struct StaticGroupTraits;
+
+template<typename _ActionType>
+struct StaticGroupTraits<_ActionType>
+{
+   static constexpr bool same_base_type = true;
+   static constexpr bool compatible = true;
+   
+   typedef typename _ActionType::ActionBaseType ActionBaseType;
+   typedef typename _ActionType::ReportType ReportType;
+};
+
+template<typename _ActionType, typename..._MoreActionTypes>
+struct StaticGroupTraits<_ActionType, _MoreActionTypes...>
+{
+   private:
+      
+      typedef StaticGroupTraits<_MoreActionTypes...> Rest;
+      typedef StaticGroupReportType<typename _ActionType::ReportType, 
+                                    typename Rest::ReportType> Combined;
+      
+   public:
+      
+      static constexpr bool same_base_type 
+         = std::is_same<typename _ActionType::ActionBaseType, 
+                        typename Rest::ActionBaseType>::value;
+         
+      static constexpr bool compatible 
+         = Rest::compatible && same_base_type && Combined::compatible;
+   
+      typedef typename _ActionType::ActionBaseType ActionBaseType;
+      typedef typename Combined::type ReportType;
+};
+
+/// @private
+/// @brief Selects the class that a group of actions derives from.
+///
+template<typename _ActionBaseType, typename _ReportType>
+struct StaticGroupBase {
+   typedef Action_ type;
+};
+
+template<>
+struct StaticGroupBase<ReportAction_, Report_> {
+   typedef ReportAction_ type;
+};
+
+template<typename _ReportType>
+struct StaticGroupBase<ReportAction_, _ReportType> {
+   typedef ReportAction<_ReportType> type;
+};
+
+/// @brief Groups multiple actions whose types are known at compile time.
+/// @details Like Grouped, the group only passes if all of its members 
+///        pass. Unlike Grouped, member types are part of the group's type.
+///        Cycle and report actions as well as report actions of different 
+///        report types cannot be mixed, which is checked at compile time.
+///        The group's report type is that of its non-generic
+///        members.
+///
+///        The members are copied into the group and stored inline.
+///        As their exact types are known, evaluating the group requires 
+///        neither type erasure nor additional allocations, and the compiler 
+///        can resolve member calls statically.
+///
+///        Use the function staticGroup(...) to create groups
+///        without naming their type.
+///
+template<typename..._Wrappers>
+class StaticGrouped
+{
+   private:
+      
+      typedef StaticGroupTraits<typename StaticGroupMemberType<_Wrappers>::type...> Traits;
+      
+      static_assert(sizeof...(_Wrappers) > 0, 
+         "An action group requires at least one action");
+      static_assert(Traits::same_base_type,
+         "Cycle actions and report actions cannot be grouped");
+      static_assert(Traits::compatible, 
+         "Report actions of different report types cannot be grouped");
+      
+   public:
+      
+      /// @brief Constructor.
+      /// @param actions The actions to group.
+      ///
+      StaticGrouped(const _Wrappers &...actions)
+         :  StaticGrouped(DelegateConstruction{}, *unwrapAction(actions)...)
+      {}
+      
+   private:
+      
+      class Action : public StaticGroupBase<typename Traits::ActionBaseType,
+                                            typename Traits::ReportType>::type
+      {
+         public:
+            
+            typedef std::tuple<typename StaticGroupMemberType<_Wrappers>::type...> Members;
+            
+            Action(const typename StaticGroupMemberType<_Wrappers>::type &...actions)
+               :  members_(actions...)
+            {}
+            
+            virtual void report(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Action group:";
+               std::string indent = std::string(add_indent) + "   ";
+               ReportMember f{indent.c_str()};
+               this->forEachMember(f);
+            }
+            
+            virtual void setSimulator(const Simulator *simulator) override {
+               this->Action_::setSimulator(simulator);
+               SetSimulator f{simulator};
+               this->forEachMember(f);
+            }
+            
+            virtual void describe(const char * /*add_indent*/ = "") const override {
+               this->getSimulator()->log() << "A group of actions";
+            }
+            
+            virtual void describeState(const char *add_indent = "") const override {
+               if(this->isValid()) {
+                  this->getSimulator()->log() << add_indent << "Action group valid";
+                  return;
+               }
+               this->getSimulator()->log() << add_indent << "Action group failed";
+               std::string indent = std::string(add_indent) + "   ";
+               DescribeInvalidMember f{indent.c_str()};
+               this->forEachMember(f);
+            }
+            
+            virtual void setReport(const Report_ *report) override {
+               this->Base::setReport(report);
+               SetReport f{report};
+               this->forEachMember(f);
+            }
+            
+         protected:
+            
+            virtual bool evalInternal() override {
+               EvalMember f{true};
+               this->forEachMember(f);
+               return f.valid_;
+            }
+            
+         private:
+            
+            typedef typename StaticGroupBase<typename Traits::ActionBaseType,
+                                             typename Traits::ReportType>::type Base;
+            
+            struct EvalMember {
+               bool valid_;
+               template<typename _T> void operator()(_T &action) { valid_ &= action.eval(); }
+            };
+            
+            struct SetSimulator {
+               const Simulator *simulator_;
+               void operator()(Action_ &action) { action.setSimulator(simulator_); }
+            };
+            
+            struct SetReport {
+               const Report_ *report_;
+               void operator()(Action_ &action) { action.setReport(report_); }
+            };
+            
+            struct ReportMember {
+               const char *indent_;
+               void operator()(const Action_ &action) { action.report(indent_); }
+            };
+            
+            struct DescribeInvalidMember {
+               const char *indent_;
+               void operator()(const Action_ &action) { 
+                  if(!action.isValid()) { action.describeState(indent_); }
+               }
+            };
+            
+            template<std::size_t _I = 0, typename _Function>
+            typename std::enable_if<(_I < sizeof...(_Wrappers))>::type
+               forEachMember(_Function &f) {
+                  f(std::get<_I>(members_));
+                  this->forEachMember<_I + 1>(f);
+               }
+            
+            template<std::size_t _I = 0, typename _Function>
+            typename std::enable_if<(_I == sizeof...(_Wrappers))>::type
+               forEachMember(_Function &) {}
+            
+            template<std::size_t _I = 0, typename _Function>
+            typename std::enable_if<(_I < sizeof...(_Wrappers))>::type
+               forEachMember(_Function &f) const {
+                  f(std::get<_I>(members_));
+                  this->forEachMember<_I + 1>(f);
+               }
+            
+            template<std::size_t _I = 0, typename _Function>
+            typename std::enable_if<(_I == sizeof...(_Wrappers))>::type
+               forEachMember(_Function &) const {}
+            
+         private:
+            
+            Members members_;
+      };
+      
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY_TMPL(StaticGrouped<_Wrappers...>)
+};
+
+/// @brief Groups multiple actions whose types are known at compile time.
+/// @details See StaticGrouped for details.
+///
+/// @param actions The actions to group.
+///
+template<typename..._Wrappers>
+StaticGrouped<_Wrappers...> staticGroup(const _Wrappers &...actions)
+{
+   return StaticGrouped<_Wrappers...>{actions...};
+}
+
+} // namespace actions
+} // namespace papilio
@@ -24,6 +24,8 @@ namespace papilio {
 namespace actions {
 
 /// @brief Asserts that the current report equals another report.
+/// @details The expected report is stored as ReportData. Neither
+///        storing nor comparing it allocates.
 ///
 template<typename _ReportType>
 class AssertReportEquals {
@@ -34,17 +36,34 @@ class AssertReportEquals {
       ///
       /// @param report The report to compare with.
       ///
-      AssertReportEquals(const std::shared_ptr<_ReportType> &report)
+      AssertReportEquals(const _ReportType &report)
          : AssertReportEquals(DelegateConstruction{}, report)
       {}
       
+      /// @brief Constructor.
+      ///
+      /// @param report The report to compare with.
+      ///
+      AssertReportEquals(const std::shared_ptr<_ReportType> &report)
+         : AssertReportEquals(DelegateConstruction{}, *report)
+      {}
+      
       /// @brief Constructor.
       ///
       /// @param data The data of the report to compare with.
       ///
-      AssertReportEquals(const void *data)
+      AssertReportEquals(const ReportData &data)
          : AssertReportEquals(DelegateConstruction{}, data)
       {}
+      
+      /// @brief Constructor.
+      ///
+      /// @param data The raw data of the report to compare with. 
+      ///        Interpreted by _ReportType::create(...).
+      ///
+      AssertReportEquals(const void *data)
+         : AssertReportEquals(DelegateConstruction{}, *_ReportType::create(data))
+      {}
    
    private:
       
@@ -53,35 +72,43 @@ class AssertReportEquals {
          public:
             
             Action(const _ReportType &report)
-               :  report_(report)
-            {}
+            {
+               report.getData(expected_);
+            }
       
-            Action(const void *data)
-               :  report_(_ReportType::create(data))
+            Action(const ReportData &data)
+               :  expected_(data)
             {}
 
             virtual void describe(const char *add_indent = "") const override {
-               this->getSimulator()->log() << add_indent << "Report equals: ";
-               report_->dump(*this->getSimulator(), add_indent);
+               this->getSimulator()->log() << add_indent << "Report equals: "
+                  << expected_.toHexString();
             }
 
             virtual void describeState(const char *add_indent = "") const {
                
+               ReportData actual;
+               this->getReport().getData(actual);
+               
                this->getSimulator()->log() << add_indent << "Reports differ: ";
-               this->getSimulator()->log() << add_indent << "expected: ";
-               report_->dump(*this->getSimulator(), add_indent);
-               this->getSimulator()->log() << add_indent << "actual: ";
+               this->getSimulator()->log() << add_indent << "expected: "
+                  << expected_.toHexString();
+               this->getSimulator()->log() << add_indent << "actual:   "
+                  << actual.toHexString();
                this->getReport().dump(*this->getSimulator(), add_indent);
             }
 
             virtual bool evalInternal() override {
                
-               return this->getReport().equals(*report_);
+               ReportData actual;
+               this->getReport().getData(actual);
+               
+               return actual == expected_;
             }
             
          private:
             
-            std::shared_ptr<_ReportType> report_;
+            ReportData expected_;
       };
    
    PAPILIO_AUTO_DEFINE_ACTION_INVENTORY_TMPL(AssertReportEquals<_ReportType>)
@@ -0,0 +1,164 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/actions/generic_report/ReportAction.h"
+#include "papilio/ReportTrace.h"
+#include "papilio/Simulator.h"
+
+namespace papilio {
+namespace actions {
+
+/// @brief Compares every report against a recorded report trace.
+/// @details Register this action as permanent report action. 
+///        The trace file, e.g. recorded via RecordReportTrace, is streamed 
+///        in as reports arrive. Report data, time and cycle id of 
+///        every report must match the next record of the trace. 
+///        Comparison stops at the first divergence, which is reported 
+///        as a failure.
+///
+///        Use atEnd() after the test to check that no recorded
+///        reports are missing.
+///
+class AssertReportsMatchTrace {
+   
+   public:
+      
+      /// @brief Constructor.
+      ///
+      /// @param filename The name of the trace file to compare with.
+      ///
+      AssertReportsMatchTrace(const std::string &filename)
+         : AssertReportsMatchTrace(DelegateConstruction{}, filename)
+      {}
+      
+      /// @brief Only compare report data, ignoring time and cycle id.
+      ///
+      AssertReportsMatchTrace &ignoreTiming() { action_->setIgnoreTiming(true); return *this; }
+      
+      /// @brief Checks if all records of the trace have been compared.
+      ///
+      bool atEnd() const { return action_->atEnd(); }
+      
+      /// @brief Checks if a divergence was detected.
+      ///
+      bool hasDiverged() const { return action_->hasDiverged(); }
+   
+   private:
+      
+      class Action : public ReportAction_ {
+   
+         public:
+            
+            Action(const std::string &filename)
+               :  filename_(filename)
+            {
+               reader_.open(filename_);
+            }
+
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Reports match trace \'"
+                  << filename_ << "\'";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               
+               switch(state_) {
+                  case OpenFailed:
+                     this->getSimulator()->log() << add_indent << "Unable to read report trace file";
+                     break;
+                  case Corrupt:
+                     this->getSimulator()->log() << add_indent << "Record " << (reader_.getNumRecordsRead() + 1) 
+                        << " of the trace is corrupt";
+                     break;
+                  case TraceExhausted:
+                     this->getSimulator()->log() << add_indent << "Report encountered after all " 
+                        << reader_.getNumRecordsRead() << " records of the trace";
+                     break;
+                  case Diverged:
+                     this->getSimulator()->log() << add_indent << "Report diverges from record " 
+                        << reader_.getNumRecordsRead() << " of the trace";
+                     this->getSimulator()->log() << add_indent << "expected: t=" << expected_.time_ 
+                        << ", c=" << expected_.cycle_id_ << ", type " << int(expected_.data_.type_id_)
+                        << ": " << expected_.data_.toHexString();
+                     this->getSimulator()->log() << add_indent << "actual:   t=" << actual_.time_ 
+                        << ", c=" << actual_.cycle_id_ << ", type " << int(actual_.data_.type_id_)
+                        << ": " << actual_.data_.toHexString();
+                     break;
+                  default:
+                     this->getSimulator()->log() << add_indent << reader_.getNumRecordsRead() 
+                        << " records compared";
+                     break;
+               }
+            }
+
+            virtual bool evalInternal() override {
+               
+               // Comparison stops at the first divergence.
+               //
+               if(state_ != Matching) { return true; }
+               
+               if(!reader_.isOpen()) {
+                  state_ = OpenFailed;
+                  return false;
+               }
+               
+               if(!reader_.next(expected_)) {
+                  state_ = reader_.isCorrupt() ? Corrupt : TraceExhausted;
+                  return false;
+               }
+               
+               actual_.time_ = this->getSimulator()->getTime();
+               actual_.cycle_id_ = this->getSimulator()->getCycleId();
+               this->getReport().getData(actual_.data_);
+               
+               bool match = (actual_.data_ == expected_.data_)
+                         && (   ignore_timing_
+                             || (   (actual_.time_ == expected_.time_)
+                                 && (actual_.cycle_id_ == expected_.cycle_id_)));
+               
+               if(!match) {
+                  state_ = Diverged;
+               }
+               
+               return match;
+            }
+            
+            void setIgnoreTiming(bool state) { ignore_timing_ = state; }
+            
+            bool atEnd() const { return reader_.atEnd(); }
+            
+            bool hasDiverged() const { return state_ != Matching; }
+            
+         private:
+            
+            enum State { Matching, OpenFailed, Corrupt, TraceExhausted, Diverged };
+            
+            std::string filename_;
+            ReportTraceReader reader_;
+            ReportTraceRecord expected_;
+            ReportTraceRecord actual_;
+            State state_ = Matching;
+            bool ignore_timing_ = false;
+      };
+   
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(AssertReportsMatchTrace)
+};
+
+} // namespace actions
+} // namespace papilio
@@ -0,0 +1,116 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/actions/generic_report/ReportAction.h"
+#include "papilio/ReportTrace.h"
+#include "papilio/Simulator.h"
+
+namespace papilio {
+namespace actions {
+
+/// @brief Records every report to a report trace file.
+/// @details Register this action as permanent report action 
+///        to record a golden trace that can later be compared against
+///        via AssertReportsMatchTrace. The action always passes,
+///        unless the trace file cannot be written.
+///
+class RecordReportTrace {
+   
+   public:
+      
+      /// @brief Constructor.
+      ///
+      /// @param filename The name of the trace file to write.
+      ///
+      RecordReportTrace(const std::string &filename)
+         : RecordReportTrace(DelegateConstruction{}, filename)
+      {}
+      
+      /// @brief Flushes and closes the trace file.
+      /// @details Otherwise this happens when the action is destroyed.
+      ///
+      void close() { action_->close(); }
+      
+      /// @brief Retreives the number of reports recorded.
+      ///
+      std::size_t getNumRecords() const { return action_->getNumRecords(); }
+   
+   private:
+      
+      class Action : public ReportAction_ {
+   
+         public:
+            
+            Action(const std::string &filename)
+               :  filename_(filename)
+            {
+               writer_.open(filename_);
+            }
+
+            virtual void describe(const char *add_indent = "") const override {
+               this->getSimulator()->log() << add_indent << "Recording report trace \'"
+                  << filename_ << "\'";
+            }
+
+            virtual void describeState(const char *add_indent = "") const {
+               if(failed_) {
+                  this->getSimulator()->log() << add_indent 
+                     << "Unable to write report trace file \'" << filename_ << "\'";
+               }
+               else {
+                  this->getSimulator()->log() << add_indent << writer_.getNumRecords()
+                     << " reports recorded";
+               }
+            }
+
+            virtual bool evalInternal() override {
+               
+               // Report a failure only once.
+               //
+               if(failed_) { return true; }
+               
+               ReportTraceRecord record;
+               record.time_ = this->getSimulator()->getTime();
+               record.cycle_id_ = this->getSimulator()->getCycleId();
+               this->getReport().getData(record.data_);
+               
+               if(!writer_.write(record)) {
+                  failed_ = true;
+                  return false;
+               }
+               
+               return true;
+            }
+            
+            void close() { writer_.close(); }
+            
+            std::size_t getNumRecords() const { return writer_.getNumRecords(); }
+            
+         private:
+            
+            std::string filename_;
+            ReportTraceWriter writer_;
+            bool failed_ = false;
+      };
+   
+   PAPILIO_AUTO_DEFINE_ACTION_INVENTORY(RecordReportTrace)
+};
+
+} // namespace actions
+} // namespace papilio
@@ -71,12 +71,14 @@ class AssertKeycodesActive {
             Action(const std::vector<uint8_t> &keycodes, 
                       bool exclusively = false) 
                :  keycodes_(keycodes),
+                  expected_(keycodes_),
                   exclusively_(exclusively) 
             {}
 
             template<typename..._KeyInfo>
             Action(_KeyInfo...key_info) 
                :  keycodes_{toKeycode(std::forward<_KeyInfo>(key_info))...},
+                  expected_(keycodes_),
                   exclusively_(false) 
             {}
 
@@ -112,25 +114,13 @@ class AssertKeycodesActive {
 
             virtual bool evalInternal() override {
                
-               for(auto keycode: keycodes_) {
-                  if(!this->getReport().isKeycodeActive(keycode)) {
-                     return false;
-                  }
-               }
-                  
-               if(exclusively_) {
-                  
-                  auto active_keycodes = this->getReport().getActiveKeycodes();
+               auto active = this->getReport().getKeycodeBitmap();
                
-                  for(auto keycode: active_keycodes) {
-                     
-                     if(std::find(keycodes_.begin(), keycodes_.end(), keycode) == keycodes_.end()) {
-                        return false;
-                     }
-                  }
+               if(exclusively_) {
+                  return active == expected_;
                }
                
-               return true;
+               return expected_.isSubsetOf(active);
             }
             
             /// @brief Set exclusivity of the keycodes allowed in the keyboard
@@ -148,6 +138,7 @@ class AssertKeycodesActive {
          private:
             
             std::vector<uint8_t> keycodes_;
+            KeycodeBitmap expected_;
             bool exclusively_ = false;
       };
    
@@ -73,13 +73,17 @@ class AssertModifiersActive {
                       bool exclusively = false) 
                :  modifiers_(modifiers),
                   exclusively_(exclusively) 
-            {}
+            {
+               this->initExpected();
+            }
 
             template<typename..._KeyInfo>
             Action(_KeyInfo...key_info) 
                :  modifiers_{toModifier(std::forward<_KeyInfo>(key_info))...},
                   exclusively_(false) 
-            {}
+            {
+               this->initExpected();
+            }
 
             virtual void describe(const char *add_indent = "") const override {
                this->getSimulator()->log() << add_indent << "Modifiers active: ";
@@ -113,6 +117,20 @@ class AssertModifiersActive {
 
             virtual bool evalInternal() override {
                
+               if(bitmap_compatible_) {
+                  
+                  uint8_t active = this->getReport().getModifierBitmap();
+                  
+                  if(exclusively_) {
+                     return active == expected_;
+                  }
+                  
+                  return (expected_ & ~active) == 0;
+               }
+               
+               // Modifiers that are not representable in the modifier
+               // bitmap are left to the report.
+               //
                for(auto modifier: modifiers_) {
                   if(!this->getReport().isModifierKeycodeActive(modifier)) {
                      return false;
@@ -146,9 +164,23 @@ class AssertModifiersActive {
             ///
             bool getExclusively() const { return exclusively_; }
             
+         private:
+            
+            void initExpected() {
+               for(auto modifier: modifiers_) {
+                  if(!KeyboardReport_::isModifierKeycode(modifier)) {
+                     bitmap_compatible_ = false;
+                     return;
+                  }
+                  expected_ |= uint8_t(1 << (modifier - KeyboardReport_::first_modifier_keycode));
+               }
+            }
+            
          private:
             
             std::vector<uint8_t> modifiers_;
+            uint8_t expected_ = 0;
+            bool bitmap_compatible_ = true;
             bool exclusively_ = false;
       };
    
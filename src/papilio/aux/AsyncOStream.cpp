@@ -0,0 +1,315 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/aux/AsyncOStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace papilio {
+   
+/// @private
+/// @brief The background thread that drains all asynchronous streams.
+/// @details The thread runs while any asynchronous stream exists.
+///
+class AsyncOutputWriter
+{
+   public:
+      
+      static AsyncOutputWriter &get() {
+         static AsyncOutputWriter writer;
+         return writer;
+      }
+      
+      ~AsyncOutputWriter() { this->stop(); }
+      
+      void add(AsyncOStream::Buffer *buffer) {
+         std::lock_guard<std::mutex> lifecycle_lock(lifecycle_mutex_);
+         {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers_.push_back(buffer);
+         }
+         if(!thread_.joinable()) {
+            running_ = true;
+            thread_ = std::thread(&AsyncOutputWriter::run, this);
+         }
+      }
+      
+      void remove(AsyncOStream::Buffer *buffer) {
+         std::lock_guard<std::mutex> lifecycle_lock(lifecycle_mutex_);
+         {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers_.erase(std::remove(buffers_.begin(), buffers_.end(), buffer), 
+                           buffers_.end());
+            if(!buffers_.empty()) { return; }
+         }
+         this->stop();
+      }
+      
+      /// @brief Wakes the thread if it waits for output.
+      ///
+      void wake() { condition_.notify_one(); }
+      
+      /// @brief Protects the list of buffers and their target streams.
+      ///
+      std::mutex &getMutex() { return mutex_; }
+      
+   private:
+      
+      AsyncOutputWriter() = default;
+      
+      void stop() {
+         if(!thread_.joinable()) { return; }
+         {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+         }
+         condition_.notify_one();
+         thread_.join();
+      }
+      
+      void run() {
+         std::unique_lock<std::mutex> lock(mutex_);
+         while(running_) {
+            bool work_done = false;
+            for(auto *buffer: buffers_) {
+               work_done |= buffer->drain();
+            }
+            
+            // Producers only wake the thread if their buffer fills up or 
+            // output is flushed. Small amounts of output wait for the 
+            // next poll.
+            //
+            if(!work_done) {
+               condition_.wait_for(lock, std::chrono::milliseconds(2));
+            }
+         }
+         for(auto *buffer: buffers_) {
+            buffer->drain();
+         }
+      }
+      
+   private:
+      
+      std::mutex lifecycle_mutex_;
+      std::mutex mutex_;
+      std::condition_variable condition_;
+      std::vector<AsyncOStream::Buffer*> buffers_;
+      std::thread thread_;
+      bool running_ = false;
+};
+
+namespace {
+   
+constexpr std::size_t staging_size = 4096;
+
+std::size_t roundUpToPowerOfTwo(std::size_t n)
+{
+   std::size_t result = 1;
+   while(result < n) { result <<= 1; }
+   return result;
+}
+
+} // namespace
+
+AsyncOStream::Buffer::Buffer(std::ostream &target, std::size_t buffer_size, OverflowPolicy policy)
+   :  target_(&target),
+      policy_(policy),
+      staging_(staging_size),
+      ring_(roundUpToPowerOfTwo((buffer_size > staging_size) ? buffer_size : staging_size)),
+      mask_(ring_.size() - 1)
+{
+   this->setp(staging_.data(), staging_.data() + staging_.size());
+}
+
+void AsyncOStream::Buffer::beginMessage(bool droppable)
+{
+   if(message_depth_++ > 0) { return; }
+   
+   this->commit();
+   droppable_ = droppable;
+   dropping_ = false;
+}
+
+void AsyncOStream::Buffer::endMessage()
+{
+   if(--message_depth_ > 0) { return; }
+   
+   this->commit();
+   droppable_ = false;
+   dropping_ = false;
+}
+
+void AsyncOStream::Buffer::commit()
+{
+   std::size_t n_bytes = std::size_t(this->pptr() - this->pbase());
+   this->setp(staging_.data(), staging_.data() + staging_.size());
+   
+   if(n_bytes > 0) {
+      this->push(staging_.data(), n_bytes);
+   }
+}
+
+void AsyncOStream::Buffer::push(const char *data, std::size_t n_bytes)
+{
+   // The remainder of a dropped message is dropped as well.
+   //
+   if(dropping_) { return; }
+   
+   if(droppable_ && (policy_ == DropOnOverflow)) {
+      std::size_t n_free = ring_.size() 
+            - (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+      if(n_free < n_bytes) {
+         dropping_ = true;
+         ++n_dropped_;
+         return;
+      }
+   }
+   
+   auto &writer = AsyncOutputWriter::get();
+   
+   while(n_bytes > 0) {
+      
+      std::size_t head = head_.load(std::memory_order_relaxed);
+      std::size_t n_free = ring_.size() - (head - tail_.load(std::memory_order_acquire));
+      
+      if(n_free == 0) {
+         writer.wake();
+         std::this_thread::yield();
+         continue;
+      }
+      
+      std::size_t offset = head & mask_;
+      std::size_t n = std::min(std::min(n_bytes, n_free), ring_.size() - offset);
+      
+      std::memcpy(&ring_[offset], data, n);
+      head_.store(head + n, std::memory_order_release);
+      
+      data += n;
+      n_bytes -= n;
+      
+      if(n_free - n < ring_.size()/2) {
+         writer.wake();
+      }
+   }
+}
+
+bool AsyncOStream::Buffer::drain()
+{
+   // The flush request must be read before the data. Otherwise, 
+   // output that was committed before the request could be missed.
+   //
+   uint64_t flush_requested = flush_requested_.load(std::memory_order_acquire);
+   
+   std::size_t head = head_.load(std::memory_order_acquire);
+   std::size_t tail = tail_.load(std::memory_order_relaxed);
+   
+   bool work_done = (head != tail);
+   
+   while(tail != head) {
+      std::size_t offset = tail & mask_;
+      std::size_t n = std::min(head - tail, ring_.size() - offset);
+      target_->write(&ring_[offset], std::streamsize(n));
+      tail += n;
+      tail_.store(tail, std::memory_order_release);
+   }
+   
+   if(flush_requested != flush_done_.load(std::memory_order_relaxed)) {
+      target_->flush();
+      flush_done_.store(flush_requested, std::memory_order_release);
+      work_done = true;
+   }
+   
+   return work_done;
+}
+
+AsyncOStream::Buffer::int_type 
+   AsyncOStream::Buffer::overflow(int_type c)
+{
+   this->commit();
+   
+   if(!traits_type::eq_int_type(c, traits_type::eof())) {
+      *this->pptr() = traits_type::to_char_type(c);
+      this->pbump(1);
+   }
+   
+   return traits_type::not_eof(c);
+}
+
+std::streamsize AsyncOStream::Buffer::xsputn(const char *s, std::streamsize n)
+{
+   if(n > this->epptr() - this->pptr()) {
+      
+      this->commit();
+      
+      // Large chunks bypass the staging area.
+      //
+      if(n >= std::streamsize(staging_.size())) {
+         this->push(s, std::size_t(n));
+         return n;
+      }
+   }
+   
+   std::memcpy(this->pptr(), s, std::size_t(n));
+   this->pbump(int(n));
+   return n;
+}
+
+int AsyncOStream::Buffer::sync()
+{
+   this->commit();
+   
+   uint64_t request = flush_requested_.fetch_add(1, std::memory_order_acq_rel) + 1;
+   
+   auto &writer = AsyncOutputWriter::get();
+   writer.wake();
+   
+   while(flush_done_.load(std::memory_order_acquire) < request) {
+      std::this_thread::yield();
+   }
+   
+   return 0;
+}
+
+AsyncOStream::AsyncOStream(std::ostream &target, std::size_t buffer_size, 
+                           OverflowPolicy policy)
+   :  std::ostream(nullptr),
+      buffer_(target, buffer_size, policy)
+{
+   this->rdbuf(&buffer_);
+   AsyncOutputWriter::get().add(&buffer_);
+}
+
+AsyncOStream::~AsyncOStream()
+{
+   buffer_.pubsync();
+   AsyncOutputWriter::get().remove(&buffer_);
+}
+
+void AsyncOStream::setTarget(std::ostream &target)
+{
+   buffer_.pubsync();
+   
+   std::lock_guard<std::mutex> lock(AsyncOutputWriter::get().getMutex());
+   buffer_.target_ = &target;
+}
+  
+} // namespace papilio
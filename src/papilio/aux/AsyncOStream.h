@@ -0,0 +1,167 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <ostream>
+#include <streambuf>
+#include <stdint.h>
+#include <vector>
+
+namespace papilio {
+   
+class AsyncOutputWriter;
+
+/// @brief An output stream that is written to its target by a background thread.
+/// @details Output is collected in a bounded, lock-free single producer 
+///        single consumer ring buffer. A background thread that is shared
+///        by all asynchronous streams drains the buffers to their target 
+///        streams. Each producing thread must thus use its own stream 
+///        object, e.g. one per simulator.
+///
+///        Output can be grouped into messages, see beginMessage(...). If the 
+///        buffer is full, output either blocks until the background
+///        thread made room, or messages that were marked as droppable 
+///        are discarded, depending on the overflow policy.
+///
+///        Flushing the stream blocks until all output was written 
+///        and the target stream was flushed.
+///
+class AsyncOStream : public std::ostream
+{
+   public:
+      
+      /// @brief Determines what happens if output does not fit into the buffer.
+      ///
+      enum OverflowPolicy {
+         
+         /// @brief Wait until the background thread made room.
+         ///
+         BlockOnOverflow,
+         
+         /// @brief Discard droppable messages, wait for all other output.
+         ///
+         DropOnOverflow
+      };
+      
+      /// @brief Constructor.
+      /// @param target The stream that receives the output.
+      /// @param buffer_size The size of the buffer in bytes (rounded up to
+      ///        a power of two).
+      /// @param policy The overflow policy.
+      ///
+      AsyncOStream(std::ostream &target, 
+                   std::size_t buffer_size = 1 << 20, 
+                   OverflowPolicy policy = BlockOnOverflow);
+      
+      virtual ~AsyncOStream() override;
+      
+      /// @brief Flushes the stream and replaces the target stream.
+      /// @param target The new target stream.
+      ///
+      void setTarget(std::ostream &target);
+      
+      /// @brief Retreives the target stream.
+      ///
+      std::ostream &getTarget() const { return *buffer_.target_; }
+      
+      void setOverflowPolicy(OverflowPolicy policy) { buffer_.policy_ = policy; }
+      
+      OverflowPolicy getOverflowPolicy() const { return buffer_.policy_; }
+      
+      /// @brief Marks the beginning of a message.
+      /// @details All output until the matching endMessage() is 
+      ///        passed to the background thread as a whole. Messages 
+      ///        may be nested, in which case only the outermost
+      ///        message counts.
+      ///
+      /// @param droppable If true, the message may be dropped
+      ///        if the buffer is full and the overflow policy is 
+      ///        DropOnOverflow.
+      ///
+      void beginMessage(bool droppable) { buffer_.beginMessage(droppable); }
+      
+      /// @brief Marks the end of a message.
+      ///
+      void endMessage() { buffer_.endMessage(); }
+      
+      /// @brief Retreives the number of messages that were dropped
+      ///        because the buffer was full.
+      ///
+      uint64_t getNumDroppedMessages() const { return buffer_.n_dropped_; }
+      
+   private:
+      
+      class Buffer : public std::streambuf
+      {
+         public:
+            
+            Buffer(std::ostream &target, std::size_t buffer_size, OverflowPolicy policy);
+            
+            void beginMessage(bool droppable);
+            void endMessage();
+            
+         protected:
+            
+            virtual int_type overflow(int_type c) override;
+            virtual std::streamsize xsputn(const char *s, std::streamsize n) override;
+            virtual int sync() override;
+            
+         private:
+            
+            // Moves staged output to the ring buffer.
+            //
+            void commit();
+            
+            void push(const char *data, std::size_t n_bytes);
+            
+            // Called by the background thread. Returns true if 
+            // any work was done.
+            //
+            bool drain();
+            
+         private:
+            
+            std::ostream *target_;
+            OverflowPolicy policy_;
+            
+            std::vector<char> staging_;
+            
+            std::vector<char> ring_;
+            std::size_t mask_;
+            std::atomic<std::size_t> head_{0};
+            std::atomic<std::size_t> tail_{0};
+            
+            std::atomic<uint64_t> flush_requested_{0};
+            std::atomic<uint64_t> flush_done_{0};
+            
+            int message_depth_ = 0;
+            bool droppable_ = false;
+            bool dropping_ = false;
+            uint64_t n_dropped_ = 0;
+            
+            friend class AsyncOStream;
+            friend class AsyncOutputWriter;
+      };
+      
+      Buffer buffer_;
+      
+      friend class AsyncOutputWriter;
+};
+
+} // namespace papilio
@@ -0,0 +1,97 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/aux/BufferedOStream.h"
+
+#include <cstring>
+
+namespace papilio {
+   
+BufferedOStream::Buffer::Buffer(std::ostream &target, std::size_t buffer_size)
+   :  target_(&target),
+      data_(buffer_size > 0 ? buffer_size : 1)
+{
+   this->setp(data_.data(), data_.data() + data_.size());
+}
+
+void BufferedOStream::Buffer::writeOut()
+{
+   std::streamsize n = this->pptr() - this->pbase();
+   if(n > 0) {
+      target_->write(this->pbase(), n);
+   }
+   this->setp(data_.data(), data_.data() + data_.size());
+}
+
+BufferedOStream::Buffer::int_type 
+   BufferedOStream::Buffer::overflow(int_type c)
+{
+   this->writeOut();
+   
+   if(!traits_type::eq_int_type(c, traits_type::eof())) {
+      *this->pptr() = traits_type::to_char_type(c);
+      this->pbump(1);
+   }
+   
+   return traits_type::not_eof(c);
+}
+
+std::streamsize BufferedOStream::Buffer::xsputn(const char *s, std::streamsize n)
+{
+   if(n > this->epptr() - this->pptr()) {
+      
+      this->writeOut();
+      
+      // Large chunks bypass the buffer.
+      //
+      if(n >= std::streamsize(data_.size())) {
+         target_->write(s, n);
+         return n;
+      }
+   }
+   
+   std::memcpy(this->pptr(), s, n);
+   this->pbump(int(n));
+   return n;
+}
+
+int BufferedOStream::Buffer::sync()
+{
+   this->writeOut();
+   target_->flush();
+   return 0;
+}
+
+BufferedOStream::BufferedOStream(std::ostream &target, std::size_t buffer_size)
+   :  std::ostream(nullptr),
+      buffer_(target, buffer_size)
+{
+   this->rdbuf(&buffer_);
+}
+
+BufferedOStream::~BufferedOStream()
+{
+   buffer_.sync();
+}
+
+void BufferedOStream::setTarget(std::ostream &target)
+{
+   buffer_.sync();
+   buffer_.target_ = &target;
+}
+  
+} // namespace papilio
@@ -0,0 +1,78 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+namespace papilio {
+   
+/// @brief An output stream that collects output in a buffer.
+/// @details The buffer is written to the target stream when it is
+///        full or when the stream is flushed explicitly. 
+///
+class BufferedOStream : public std::ostream
+{
+   public:
+      
+      /// @brief Constructor.
+      /// @param target The stream that receives the buffered output.
+      /// @param buffer_size The size of the buffer in bytes.
+      ///
+      BufferedOStream(std::ostream &target, std::size_t buffer_size = 1 << 16);
+      
+      virtual ~BufferedOStream() override;
+      
+      /// @brief Flushes the buffer and replaces the target stream.
+      /// @param target The new target stream.
+      ///
+      void setTarget(std::ostream &target);
+      
+      /// @brief Retreives the target stream.
+      ///
+      std::ostream &getTarget() const { return *buffer_.target_; }
+      
+   private:
+      
+      class Buffer : public std::streambuf
+      {
+         public:
+            
+            Buffer(std::ostream &target, std::size_t buffer_size);
+            
+            void writeOut();
+            
+         protected:
+            
+            virtual int_type overflow(int_type c) override;
+            virtual std::streamsize xsputn(const char *s, std::streamsize n) override;
+            virtual int sync() override;
+            
+         private:
+            
+            std::ostream *target_;
+            std::vector<char> data_;
+            
+            friend class BufferedOStream;
+      };
+      
+      Buffer buffer_;
+};
+
+} // namespace papilio
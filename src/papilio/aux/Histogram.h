@@ -0,0 +1,128 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace papilio {
+   
+/// @brief A histogram of non-negative integer values with log-linear bins.
+/// @details Values below 16 are counted exactly. Larger values are sorted
+///        into 16 bins per power of two, i.e. with a relative 
+///        resolution of 1/16. Adding a value takes constant time and 
+///        never allocates, which makes the histogram suitable for 
+///        hot paths. The unit of values is up to the user (e.g. nanoseconds
+///        or cycles).
+///
+class Histogram
+{
+   public:
+      
+      /// @brief Adds a value.
+      ///
+      void add(uint64_t value) {
+         ++counts_[binIndex(value)];
+         if(count_ == 0 || value < min_) { min_ = value; }
+         if(value > max_) { max_ = value; }
+         ++count_;
+         sum_ += value;
+      }
+      
+      /// @brief Adds all values of another histogram.
+      ///
+      void merge(const Histogram &other) {
+         if(other.count_ == 0) { return; }
+         for(int i = 0; i < n_bins; ++i) {
+            counts_[i] += other.counts_[i];
+         }
+         if(count_ == 0 || other.min_ < min_) { min_ = other.min_; }
+         if(other.max_ > max_) { max_ = other.max_; }
+         count_ += other.count_;
+         sum_ += other.sum_;
+      }
+      
+      /// @brief Removes all values.
+      ///
+      void clear() { *this = Histogram{}; }
+      
+      uint64_t getCount() const { return count_; }
+      uint64_t getMin() const { return min_; }
+      uint64_t getMax() const { return max_; }
+      double getMean() const { return (count_ > 0) ? double(sum_)/count_ : 0.0; }
+      
+      /// @brief Retreives an estimate of a percentile.
+      ///
+      /// @param percentile The percentile in the range [0, 100], e.g. 99.
+      ///
+      /// @returns The upper bound of the bin that contains the requested
+      ///        percentile, limited to the maximum value added. 
+      ///        Zero if the histogram is empty.
+      ///
+      uint64_t getPercentile(double percentile) const {
+         
+         if(count_ == 0) { return 0; }
+         
+         uint64_t rank = uint64_t(percentile/100.0*count_ + 0.5);
+         if(rank < 1) { rank = 1; }
+         if(rank > count_) { rank = count_; }
+         
+         uint64_t n = 0;
+         for(int i = 0; i < n_bins; ++i) {
+            n += counts_[i];
+            if(n >= rank) {
+               uint64_t upper = binUpperBound(i);
+               return (upper < max_) ? upper : max_;
+            }
+         }
+         return max_;
+      }
+      
+   private:
+      
+      static constexpr int sub_bin_bits = 4;
+      static constexpr int n_sub_bins = 1 << sub_bin_bits;
+      static constexpr int n_bins = (64 - sub_bin_bits + 1)*n_sub_bins;
+      
+      static int highestBit(uint64_t value) {
+         return 63 - __builtin_clzll(value);
+      }
+      
+      static int binIndex(uint64_t value) {
+         if(value < n_sub_bins) { return int(value); }
+         int shift = highestBit(value) - sub_bin_bits;
+         return (shift + 1)*n_sub_bins + int((value >> shift) & (n_sub_bins - 1));
+      }
+      
+      static uint64_t binUpperBound(int index) {
+         if(index < n_sub_bins) { return uint64_t(index); }
+         int shift = index/n_sub_bins - 1;
+         uint64_t lower = (uint64_t(n_sub_bins + index%n_sub_bins)) << shift;
+         return lower + ((uint64_t(1) << shift) - 1);
+      }
+      
+   private:
+      
+      uint64_t counts_[n_bins] = {};
+      uint64_t count_ = 0;
+      uint64_t sum_ = 0;
+      uint64_t min_ = 0;
+      uint64_t max_ = 0;
+};
+
+} // namespace papilio
@@ -0,0 +1,233 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace papilio {
+   
+/// @private
+/// @brief A pool of memory blocks of fixed size.
+/// @details Freed blocks are kept in a per-thread free list for reuse.
+///        Blocks that are freed by another thread than the one that 
+///        allocated them migrate to the free list of the freeing thread.
+///        When a thread exits, its free blocks are passed on to a shared 
+///        list that other threads refill from before allocating new memory.
+///        Blocks that are allocated or freed on a thread after its free list 
+///        was destroyed, e.g. by destructors of other thread local objects, 
+///        are taken from or returned to the shared list directly.
+///        Memory is thus bounded by the peak number of blocks in use 
+///        but never returned to the heap, as blocks of a chunk may 
+///        be in use by any thread.
+///
+template<std::size_t _BlockSize>
+class BlockPool
+{
+   public:
+      
+      static void *allocate() {
+         if(freeListDestroyed()) {
+            return allocateShared();
+         }
+         FreeList &free_list = freeList();
+         if(!free_list.head_) {
+            refill(free_list);
+         }
+         Block *block = free_list.head_;
+         free_list.head_ = block->next_;
+         return block;
+      }
+      
+      static void deallocate(void *ptr) {
+         Block *block = static_cast<Block*>(ptr);
+         if(freeListDestroyed()) {
+            deallocateShared(block);
+            return;
+         }
+         FreeList &free_list = freeList();
+         block->next_ = free_list.head_;
+         free_list.head_ = block;
+      }
+      
+   private:
+      
+      union Block {
+         Block *next_;
+         typename std::aligned_storage<_BlockSize, alignof(std::max_align_t)>::type storage_;
+      };
+      
+      static constexpr std::size_t min_chunk_size = 32;
+      static constexpr std::size_t max_chunk_size = 4096;
+      
+      // The free blocks of threads that exited.
+      //
+      struct SharedFreeList {
+         std::mutex mutex_;
+         Block *head_ = nullptr;
+      };
+      
+      static SharedFreeList &sharedFreeList() {
+         
+         // Never destroyed, as threads may exit during static destruction.
+         //
+         static SharedFreeList *shared_free_list = new SharedFreeList;
+         return *shared_free_list;
+      }
+      
+      struct FreeList {
+         
+         Block *head_ = nullptr;
+         std::size_t chunk_size_ = min_chunk_size;
+         
+         ~FreeList() {
+            
+            freeListDestroyed() = true;
+            
+            if(!head_) { return; }
+            
+            Block *tail = head_;
+            while(tail->next_) {
+               tail = tail->next_;
+            }
+            
+            SharedFreeList &shared_free_list = sharedFreeList();
+            std::lock_guard<std::mutex> lock(shared_free_list.mutex_);
+            tail->next_ = shared_free_list.head_;
+            shared_free_list.head_ = head_;
+            head_ = nullptr;
+         }
+      };
+      
+      static FreeList &freeList() {
+         static thread_local FreeList free_list;
+         return free_list;
+      }
+      
+      // Trivially destructible, thus valid until the thread exits.
+      //
+      static bool &freeListDestroyed() {
+         static thread_local bool destroyed = false;
+         return destroyed;
+      }
+      
+      static void *allocateShared() {
+         SharedFreeList &shared_free_list = sharedFreeList();
+         std::lock_guard<std::mutex> lock(shared_free_list.mutex_);
+         Block *block = shared_free_list.head_;
+         if(block) {
+            shared_free_list.head_ = block->next_;
+            return block;
+         }
+         return ::operator new(sizeof(Block));
+      }
+      
+      static void deallocateShared(Block *block) {
+         SharedFreeList &shared_free_list = sharedFreeList();
+         std::lock_guard<std::mutex> lock(shared_free_list.mutex_);
+         block->next_ = shared_free_list.head_;
+         shared_free_list.head_ = block;
+      }
+      
+      static void refill(FreeList &free_list) {
+         
+         {
+            SharedFreeList &shared_free_list = sharedFreeList();
+            std::lock_guard<std::mutex> lock(shared_free_list.mutex_);
+            if(shared_free_list.head_) {
+               free_list.head_ = shared_free_list.head_;
+               shared_free_list.head_ = nullptr;
+               return;
+            }
+         }
+         
+         std::size_t n_blocks = free_list.chunk_size_;
+         
+         Block *chunk = static_cast<Block*>(::operator new(n_blocks*sizeof(Block)));
+         
+         for(std::size_t i = 0; i < n_blocks - 1; ++i) {
+            chunk[i].next_ = &chunk[i + 1];
+         }
+         chunk[n_blocks - 1].next_ = free_list.head_;
+         free_list.head_ = chunk;
+         
+         if(free_list.chunk_size_ < max_chunk_size) {
+            free_list.chunk_size_ *= 2;
+         }
+      }
+};
+
+/// @private
+/// @brief An allocator that serves single objects from block pools.
+///
+template<typename _T>
+class PoolAllocator
+{
+   public:
+      
+      typedef _T value_type;
+      
+      PoolAllocator() {}
+      
+      template<typename _U>
+      PoolAllocator(const PoolAllocator<_U> &) {}
+      
+      _T *allocate(std::size_t n) {
+         if(n != 1 || !is_pooled) {
+            return static_cast<_T*>(::operator new(n*sizeof(_T)));
+         }
+         return static_cast<_T*>(Pool::allocate());
+      }
+      
+      void deallocate(_T *ptr, std::size_t n) {
+         if(n != 1 || !is_pooled) {
+            ::operator delete(ptr);
+            return;
+         }
+         Pool::deallocate(ptr);
+      }
+      
+   private:
+      
+      // Block sizes are rounded to reduce the number of distinct pools.
+      //
+      typedef BlockPool<(sizeof(_T) + 15) & ~std::size_t(15)> Pool;
+      
+      static constexpr bool is_pooled = alignof(_T) <= alignof(std::max_align_t);
+};
+
+template<typename _T, typename _U>
+bool operator==(const PoolAllocator<_T> &, const PoolAllocator<_U> &) { return true; }
+
+template<typename _T, typename _U>
+bool operator!=(const PoolAllocator<_T> &, const PoolAllocator<_U> &) { return false; }
+
+/// @brief Creates a reference counted object whose memory, including
+///        the reference counter, is served from a block pool.
+///
+template<typename _T, typename..._Args>
+std::shared_ptr<_T> allocatePooled(_Args&&...args) {
+   return std::allocate_shared<_T>(PoolAllocator<_T>{}, std::forward<_Args>(args)...);
+}
+
+} // namespace papilio
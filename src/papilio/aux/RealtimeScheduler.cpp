@@ -0,0 +1,71 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/aux/RealtimeScheduler.h"
+
+#include <thread>
+
+namespace papilio {
+   
+namespace {
+   
+RealtimeScheduler::Clock::duration fromMilliseconds(double ms)
+{
+   return std::chrono::duration_cast<RealtimeScheduler::Clock::duration>(
+            std::chrono::duration<double, std::milli>(ms));
+}
+
+} // namespace
+   
+RealtimeScheduler::RealtimeScheduler(double period_ms, double spin_ms, 
+                                     Histogram *lateness)
+   :  period_(fromMilliseconds(period_ms)),
+      spin_(fromMilliseconds(spin_ms)),
+      lateness_(lateness)
+{}
+
+void RealtimeScheduler::start()
+{
+   next_deadline_ = Clock::now() + period_;
+}
+
+void RealtimeScheduler::wait()
+{
+   auto now = Clock::now();
+   
+   if(now < next_deadline_) {
+      
+      auto wake_up = next_deadline_ - spin_;
+      
+      if(now < wake_up) {
+         std::this_thread::sleep_until(wake_up);
+      }
+      
+      do {
+         now = Clock::now();
+      } while(now < next_deadline_);
+   }
+   
+   if(lateness_) {
+      lateness_->add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        now - next_deadline_).count());
+   }
+   
+   next_deadline_ += period_;
+}
+
+} // namespace papilio
@@ -0,0 +1,71 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/aux/Histogram.h"
+
+#include <chrono>
+
+namespace papilio {
+   
+/// @brief Paces a loop to a fixed period in wall clock time.
+/// @details Deadlines are absolute multiples of the period, counted 
+///        from start(). Thus, the time spent between calls to wait() 
+///        does not accumulate as drift. If a cycle overruns, the 
+///        following cycles are started without waiting until the 
+///        schedule is met again.
+///
+///        Waiting sleeps until shortly before the deadline and spins 
+///        for the rest of the time, if a spin duration is configured.
+///
+class RealtimeScheduler
+{
+   public:
+      
+      typedef std::chrono::steady_clock Clock;
+      
+      /// @brief Constructor.
+      ///
+      /// @param period_ms The loop period in milliseconds.
+      /// @param spin_ms The duration in milliseconds to busy-wait 
+      ///        before each deadline instead of sleeping. Improves 
+      ///        precision at the cost of CPU time. 
+      /// @param lateness An optional histogram that collects the 
+      ///        lateness of every deadline in nanoseconds.
+      ///
+      RealtimeScheduler(double period_ms, double spin_ms = 0.0, 
+                        Histogram *lateness = nullptr);
+      
+      /// @brief Starts the schedule. The first deadline is one
+      ///        period from now.
+      ///
+      void start();
+      
+      /// @brief Waits for the next deadline.
+      ///
+      void wait();
+      
+   private:
+      
+      Clock::duration period_;
+      Clock::duration spin_;
+      Clock::time_point next_deadline_;
+      Histogram *lateness_;
+};
+
+} // namespace papilio
@@ -0,0 +1,191 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace papilio {
+   
+/// @brief A growable circular buffer with contiguous storage.
+/// @details The buffer offers the subset of the std::deque interface
+///        that is used by ActionContainer. Elements live in 
+///        a single power-of-two sized array. Popped slots are reset
+///        but not freed, so once the buffer has reached its working size,
+///        pushing and popping does not allocate.
+///
+/// @tparam _T The element type. Must be default constructible and
+///        movable.
+///
+template<typename _T>
+class RingBuffer
+{
+   private:
+      
+      template<typename _Buffer, typename _Value>
+      class Iterator_
+      {
+         public:
+            
+            typedef std::forward_iterator_tag iterator_category;
+            typedef _Value value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef _Value *pointer;
+            typedef _Value &reference;
+            
+            Iterator_(_Buffer *buffer, std::size_t pos)
+               :  buffer_(buffer), pos_(pos)
+            {}
+            
+            reference operator*() const { return (*buffer_)[pos_]; }
+            pointer operator->() const { return &(*buffer_)[pos_]; }
+            
+            Iterator_ &operator++() { ++pos_; return *this; }
+            Iterator_ operator++(int) { Iterator_ tmp = *this; ++pos_; return tmp; }
+            
+            bool operator==(const Iterator_ &other) const { return pos_ == other.pos_; }
+            bool operator!=(const Iterator_ &other) const { return pos_ != other.pos_; }
+            
+         private:
+            
+            friend class RingBuffer;
+            
+            _Buffer *buffer_;
+            std::size_t pos_;
+      };
+      
+   public:
+      
+      typedef _T value_type;
+      typedef std::size_t size_type;
+      typedef Iterator_<RingBuffer, _T> iterator;
+      typedef Iterator_<const RingBuffer, const _T> const_iterator;
+      
+      /// @brief Constructor.
+      /// @param capacity The initial capacity. Rounded up to a power of two.
+      ///
+      explicit RingBuffer(std::size_t capacity = 16) {
+         std::size_t n = 1;
+         while(n < capacity) { n <<= 1; }
+         slots_.resize(n);
+         mask_ = n - 1;
+      }
+      
+      std::size_t size() const { return size_; }
+      bool empty() const { return size_ == 0; }
+      std::size_t capacity() const { return slots_.size(); }
+      
+      _T &operator[](std::size_t pos) { return slots_[(head_ + pos) & mask_]; }
+      const _T &operator[](std::size_t pos) const { return slots_[(head_ + pos) & mask_]; }
+      
+      _T &front() { return slots_[head_]; }
+      const _T &front() const { return slots_[head_]; }
+      
+      _T &back() { return (*this)[size_ - 1]; }
+      const _T &back() const { return (*this)[size_ - 1]; }
+      
+      iterator begin() { return iterator{this, 0}; }
+      iterator end() { return iterator{this, size_}; }
+      const_iterator begin() const { return const_iterator{this, 0}; }
+      const_iterator end() const { return const_iterator{this, size_}; }
+      
+      void push_back(const _T &value) {
+         this->reserveOne();
+         (*this)[size_] = value;
+         ++size_;
+      }
+      
+      void push_back(_T &&value) {
+         this->reserveOne();
+         (*this)[size_] = std::move(value);
+         ++size_;
+      }
+      
+      /// @brief Removes the front element.
+      /// @details The slot is reset to release any resources held
+      ///        by the element. Move the front element out before
+      ///        popping to avoid a copy.
+      ///
+      void pop_front() {
+         slots_[head_] = _T{};
+         head_ = (head_ + 1) & mask_;
+         --size_;
+      }
+      
+      void pop_back() {
+         this->back() = _T{};
+         --size_;
+      }
+      
+      /// @brief Removes an element.
+      /// @details Elements behind the erased one are moved forward by 
+      ///        one slot. Erasing the front or back element is O(1).
+      ///
+      /// @param iter An iterator to the element to be erased.
+      ///
+      /// @returns An iterator to the element that followed the 
+      ///        erased one.
+      ///
+      iterator erase(iterator iter) {
+         if(iter.pos_ == 0) {
+            this->pop_front();
+            return this->begin();
+         }
+         for(std::size_t pos = iter.pos_; pos + 1 < size_; ++pos) {
+            (*this)[pos] = std::move((*this)[pos + 1]);
+         }
+         this->pop_back();
+         return iter;
+      }
+      
+      /// @brief Removes all elements while keeping the allocated storage.
+      ///
+      void clear() {
+         for(std::size_t pos = 0; pos < size_; ++pos) {
+            (*this)[pos] = _T{};
+         }
+         head_ = 0;
+         size_ = 0;
+      }
+      
+   private:
+      
+      void reserveOne() {
+         
+         if(size_ < slots_.size()) { return; }
+         
+         std::vector<_T> new_slots(2*slots_.size());
+         for(std::size_t pos = 0; pos < size_; ++pos) {
+            new_slots[pos] = std::move((*this)[pos]);
+         }
+         slots_.swap(new_slots);
+         mask_ = slots_.size() - 1;
+         head_ = 0;
+      }
+      
+   private:
+      
+      std::vector<_T> slots_;
+      std::size_t mask_ = 0;
+      std::size_t head_ = 0;
+      std::size_t size_ = 0;
+};
+
+} // namespace papilio
@@ -0,0 +1,89 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace papilio {
+   
+/// @brief A reusable barrier for a fixed number of threads.
+/// @details Threads that wait spin for a short while, then yield and
+///        eventually sleep in short intervals. Threads that pass
+///        the barrier in quick succession, e.g. once per simulator
+///        cycle, thus never enter the kernel, while idle threads 
+///        consume little CPU time.
+///
+class SpinBarrier
+{
+   public:
+      
+      /// @brief Constructor.
+      /// @param n_threads The number of threads that must arrive
+      ///        before any of them passes.
+      ///
+      explicit SpinBarrier(unsigned n_threads) 
+         :  n_threads_(n_threads),
+            n_remaining_(n_threads)
+      {}
+      
+      SpinBarrier(const SpinBarrier &) = delete;
+      SpinBarrier &operator=(const SpinBarrier &) = delete;
+      
+      /// @brief Blocks until all threads arrived.
+      ///
+      void wait() {
+         
+         unsigned generation = generation_.load(std::memory_order_acquire);
+         
+         if(n_remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            
+            // The last thread to arrive releases the others.
+            //
+            n_remaining_.store(n_threads_, std::memory_order_relaxed);
+            generation_.fetch_add(1, std::memory_order_release);
+            return;
+         }
+         
+         for(unsigned n_polls = 0; 
+             generation_.load(std::memory_order_acquire) == generation; 
+             ++n_polls) {
+            if(n_polls < max_spins) {
+               continue;
+            }
+            else if(n_polls < max_yields) {
+               std::this_thread::yield();
+            }
+            else {
+               std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+         }
+      }
+      
+   private:
+      
+      static constexpr unsigned max_spins = 1000;
+      static constexpr unsigned max_yields = 100000;
+      
+      const unsigned n_threads_;
+      std::atomic<unsigned> n_remaining_;
+      std::atomic<unsigned> generation_{0};
+};
+
+} // namespace papilio
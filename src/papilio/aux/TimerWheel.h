@@ -0,0 +1,274 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace papilio {
+   
+/// @brief A hierarchical timer wheel.
+/// @details Entries are scheduled for integer ticks. Every level of the 
+///        wheel has 64 slots, and a slot of level l covers 64^l ticks.
+///        An entry is stored on the lowest level where its tick falls
+///        within the current block of the next level. When the current
+///        tick enters a new block, the entries of that block's slot are
+///        redistributed to lower levels. Inserting an entry 
+///        and expiring the entries of a tick thus take constant time.
+///
+///        Entries that are due at the same tick expire in insertion order.
+///        Entries are stored in a node pool with a free list. Once the
+///        wheel has reached its working size, inserting and expiring 
+///        entries does not allocate.
+///
+/// @tparam _T The entry type. Must be copyable.
+///
+template<typename _T>
+class TimerWheel
+{
+   public:
+      
+      typedef uint64_t Tick;
+      
+      static constexpr int slot_bits = 6;
+      static constexpr int n_slots = 1 << slot_bits;
+      static constexpr int n_levels = 6;
+      
+      /// @brief Sets the current tick. The wheel must be empty.
+      ///
+      void reset(Tick now) {
+         now_ = now;
+         next_due_valid_ = false;
+      }
+      
+      /// @brief Retreives the current tick.
+      ///
+      Tick getNow() const { return now_; }
+      
+      /// @brief Checks if any entries are scheduled.
+      ///
+      bool empty() const { return size_ == 0; }
+      
+      /// @brief Retreives the number of scheduled entries.
+      ///
+      std::size_t size() const { return size_; }
+      
+      /// @brief Schedules an entry.
+      /// @param tick The tick at which the entry is due. Ticks that
+      ///        are not in the future are replaced by the next tick.
+      /// @param value The entry.
+      ///
+      void insert(Tick tick, const _T &value) {
+         
+         if(tick <= now_) { tick = now_ + 1; }
+         
+         int32_t node_id;
+         if(free_ >= 0) {
+            node_id = free_;
+            free_ = nodes_[node_id].next_;
+            nodes_[node_id].tick_ = tick;
+            nodes_[node_id].value_ = value;
+         }
+         else {
+            node_id = int32_t(nodes_.size());
+            nodes_.push_back(Node{tick, value, -1});
+         }
+         
+         this->link(node_id);
+         ++size_;
+         
+         if(next_due_valid_ && (tick < next_due_)) {
+            next_due_ = tick;
+         }
+      }
+      
+      /// @brief Retreives the tick of the entries that are due next.
+      /// @details The wheel must not be empty.
+      ///
+      Tick getNextDue() const {
+         if(!next_due_valid_) {
+            next_due_ = this->findNextDue();
+            next_due_valid_ = true;
+         }
+         return next_due_;
+      }
+      
+      /// @brief Advances the current tick without expiring entries.
+      /// @details No entries must be due before or at the new tick.
+      ///
+      /// @param n_ticks The number of ticks to advance.
+      ///
+      void skip(Tick n_ticks) {
+         Tick old = now_;
+         now_ += n_ticks;
+         this->cascade(old);
+      }
+      
+      /// @brief Advances the current tick by one and passes all entries 
+      ///        that are due at the new tick to a function.
+      /// @details The function may schedule new entries. Entries that it
+      ///        schedules for the current tick are due at the next tick.
+      ///
+      /// @param f A function that is called with every due entry.
+      ///
+      template<typename _F>
+      void step(_F &&f) {
+         
+         this->skip(1);
+         
+         Slot &slot = levels_[0][now_ & slot_mask];
+         int32_t node_id = slot.head_;
+         slot.head_ = slot.tail_ = -1;
+         
+         if(node_id < 0) { return; }
+         
+         next_due_valid_ = false;
+         
+         while(node_id >= 0) {
+            
+            // f may insert entries which may reallocate the node pool.
+            //
+            int32_t next = nodes_[node_id].next_;
+            _T value = std::move(nodes_[node_id].value_);
+            nodes_[node_id].value_ = _T();
+            nodes_[node_id].next_ = free_;
+            free_ = node_id;
+            --size_;
+            
+            f(value);
+            
+            node_id = next;
+         }
+      }
+      
+   private:
+      
+      static constexpr Tick slot_mask = n_slots - 1;
+      
+      struct Node {
+         Tick tick_;
+         _T value_;
+         int32_t next_;
+      };
+      
+      struct Slot {
+         int32_t head_ = -1;
+         int32_t tail_ = -1;
+      };
+      
+      static Tick block(Tick tick, int level) {
+         return (level*slot_bits >= 64) ? 0 : (tick >> (level*slot_bits));
+      }
+      
+      void link(int32_t node_id) {
+         
+         Node &node = nodes_[node_id];
+         node.next_ = -1;
+         
+         int level = 0;
+         while(   (level < n_levels - 1) 
+               && (block(node.tick_, level + 1) != block(now_, level + 1))) {
+            ++level;
+         }
+         
+         Slot &slot = levels_[level][block(node.tick_, level) & slot_mask];
+         
+         if(slot.tail_ >= 0) {
+            nodes_[slot.tail_].next_ = node_id;
+         }
+         else {
+            slot.head_ = node_id;
+         }
+         slot.tail_ = node_id;
+      }
+      
+      // Redistributes the entries of the slots of all blocks that 
+      // were entered since tick old, starting from the top level.
+      //
+      void cascade(Tick old) {
+         for(int level = n_levels - 1; level > 0; --level) {
+            
+            if(block(old, level) == block(now_, level)) { continue; }
+            
+            Slot &slot = levels_[level][block(now_, level) & slot_mask];
+            int32_t node_id = slot.head_;
+            slot.head_ = slot.tail_ = -1;
+            
+            while(node_id >= 0) {
+               int32_t next = nodes_[node_id].next_;
+               this->link(node_id);
+               node_id = next;
+            }
+         }
+      }
+      
+      // Entries of lower levels are due before those of higher levels.
+      // On every level below the top level, the slots after the current 
+      // one are ordered in time.
+      //
+      Tick findNextDue() const {
+         
+         for(int level = 0; level < n_levels; ++level) {
+            
+            Tick start = (level == n_levels - 1) ? 0 : (block(now_, level) & slot_mask) + 1;
+            Tick result = ~Tick(0);
+            
+            for(Tick s = start; s < Tick(n_slots); ++s) {
+               for(int32_t node_id = levels_[level][s].head_; node_id >= 0; 
+                   node_id = nodes_[node_id].next_) {
+                  if(nodes_[node_id].tick_ < result) {
+                     result = nodes_[node_id].tick_;
+                  }
+               }
+               if((result != ~Tick(0)) && (level < n_levels - 1)) {
+                  return result;
+               }
+            }
+            
+            if(result != ~Tick(0)) {
+               return result;
+            }
+         }
+         
+         return ~Tick(0);
+      }
+      
+   private:
+      
+      Slot levels_[n_levels][n_slots];
+      std::vector<Node> nodes_;
+      int32_t free_ = -1;
+      std::size_t size_ = 0;
+      Tick now_ = 0;
+      
+      mutable Tick next_due_ = 0;
+      mutable bool next_due_valid_ = false;
+};
+
+template<typename _T>
+constexpr int TimerWheel<_T>::slot_bits;
+template<typename _T>
+constexpr int TimerWheel<_T>::n_slots;
+template<typename _T>
+constexpr int TimerWheel<_T>::n_levels;
+template<typename _T>
+constexpr typename TimerWheel<_T>::Tick TimerWheel<_T>::slot_mask;
+
+} // namespace papilio
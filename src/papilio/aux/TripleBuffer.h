@@ -0,0 +1,82 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+namespace papilio {
+   
+/// @brief A lock-free single producer, single consumer handoff
+///        of the latest value.
+/// @details The producer fills back() and publishes it. The consumer 
+///        calls update() and, if that returns true, reads the most 
+///        recently published value via front(). Values published in 
+///        between are skipped. Neither side ever blocks.
+///
+template<typename _T>
+class TripleBuffer
+{
+   public:
+      
+      /// @brief Retreives the buffer to be filled by the producer.
+      ///
+      _T &back() { return buffers_[back_]; }
+      
+      /// @brief Publishes the content of back() to the consumer.
+      ///
+      void publish() {
+         uint8_t previous = state_.exchange(back_ | new_data_flag, std::memory_order_acq_rel);
+         back_ = previous & index_mask;
+      }
+      
+      /// @brief Fetches the most recently published value, if any.
+      ///
+      /// @returns True if a new value is available via front().
+      ///
+      bool update() {
+         if(!(state_.load(std::memory_order_relaxed) & new_data_flag)) {
+            return false;
+         }
+         uint8_t previous = state_.exchange(front_, std::memory_order_acq_rel);
+         front_ = previous & index_mask;
+         return true;
+      }
+      
+      /// @brief Retreives the value that was fetched by the last update().
+      ///
+      const _T &front() const { return buffers_[front_]; }
+      
+   private:
+      
+      static constexpr uint8_t index_mask = 0x3;
+      static constexpr uint8_t new_data_flag = 0x4;
+      
+      _T buffers_[3] = {};
+      
+      // The index of the buffer that is currently exchanged between
+      // producer and consumer, together with a flag that signals
+      // unread data.
+      //
+      std::atomic<uint8_t> state_{1};
+      
+      uint8_t back_ = 0;
+      uint8_t front_ = 2;
+};
+
+} // namespace papilio
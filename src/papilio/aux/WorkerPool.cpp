@@ -0,0 +1,277 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/aux/WorkerPool.h"
+
+#include <thread>
+#include <cerrno>
+#include <cstring>
+#include <stdint.h>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+namespace papilio {
+   
+namespace {
+   
+bool writeAll(int fd, const char *data, std::size_t size)
+{
+   while(size > 0) {
+      auto n = ::write(fd, data, size);
+      if(n < 0) { 
+         if(errno == EINTR) { continue; }
+         return false; 
+      }
+      data += n;
+      size -= n;
+   }
+   return true;
+}
+
+void runThreadWorkers(int n_workers, std::size_t n_items,
+                      const WorkerPool::WorkerFunction &worker_function,
+                      std::vector<std::string> &results)
+{
+   std::vector<std::thread> threads;
+   std::vector<std::vector<std::string>> shares(n_workers);
+   
+   for(int w = 0; w < n_workers; ++w) {
+      std::size_t begin = w*n_items/n_workers;
+      std::size_t end = (w + 1)*n_items/n_workers;
+      shares[w].resize(end - begin);
+      threads.emplace_back([&worker_function, &shares, w, begin, end]() {
+         worker_function(begin, end, shares[w]);
+      });
+   }
+   
+   for(auto &thread: threads) {
+      thread.join();
+   }
+   
+   std::size_t i = 0;
+   for(auto &share: shares) {
+      for(auto &result: share) {
+         results[i++].swap(result);
+      }
+   }
+}
+
+void runProcessWorkers(int n_workers, std::size_t n_items,
+                       const WorkerPool::WorkerFunction &worker_function,
+                       std::vector<std::string> &results,
+                       std::vector<bool> &valid)
+{
+   struct Worker {
+      pid_t pid_ = -1;
+      int fd_ = -1;
+      std::size_t begin_ = 0, end_ = 0;
+      std::string data_;
+      
+      // True if the results could not be read completely.
+      //
+      bool failed_ = false;
+   };
+   
+   std::vector<Worker> workers(n_workers);
+   
+   for(int w = 0; w < n_workers; ++w) {
+      
+      Worker &worker = workers[w];
+      worker.begin_ = w*n_items/n_workers;
+      worker.end_ = (w + 1)*n_items/n_workers;
+      
+      int fds[2];
+      if(::pipe(fds) != 0) {
+         continue;
+      }
+      
+      pid_t pid = ::fork();
+      
+      if(pid == 0) {
+         
+         ::close(fds[0]);
+         
+         std::vector<std::string> share(worker.end_ - worker.begin_);
+         worker_function(worker.begin_, worker.end_, share);
+         
+         std::string buffer;
+         for(const auto &result: share) {
+            uint32_t size = uint32_t(result.size());
+            buffer.append(reinterpret_cast<const char*>(&size), sizeof(size));
+            buffer.append(result);
+         }
+         
+         bool success = writeAll(fds[1], buffer.data(), buffer.size());
+         ::close(fds[1]);
+         
+         // Do not run any destructors or exit handlers of 
+         // the parent's objects.
+         //
+         ::_exit(success ? 0 : 1);
+      }
+      
+      ::close(fds[1]);
+      
+      if(pid < 0) {
+         ::close(fds[0]);
+         continue;
+      }
+      
+      worker.pid_ = pid;
+      worker.fd_ = fds[0];
+   }
+   
+   // Drain all pipes concurrently to prevent children from blocking.
+   //
+   std::vector<pollfd> poll_fds;
+   for(auto &worker: workers) {
+      if(worker.fd_ >= 0) {
+         poll_fds.push_back(pollfd{worker.fd_, POLLIN, 0});
+      }
+   }
+   
+   char chunk[1 << 16];
+   
+   auto findWorker = [&workers](int fd) -> Worker& {
+      for(auto &worker: workers) {
+         if(worker.fd_ == fd) { return worker; }
+      }
+      return workers.front();
+   };
+   
+   auto closePipe = [&findWorker](pollfd &poll_fd, bool failed) {
+      findWorker(poll_fd.fd).failed_ |= failed;
+      ::close(poll_fd.fd);
+      poll_fd.fd = -1;
+   };
+   
+   std::size_t n_open = poll_fds.size();
+   while(n_open > 0) {
+      
+      if(::poll(poll_fds.data(), poll_fds.size(), -1) < 0) {
+         
+         if(errno == EINTR) { continue; }
+         
+         // The results of all workers that are still running are lost.
+         // Closing the pipes lets them terminate.
+         //
+         for(auto &poll_fd: poll_fds) {
+            if(poll_fd.fd >= 0) {
+               closePipe(poll_fd, true);
+            }
+         }
+         break;
+      }
+      
+      for(auto &poll_fd: poll_fds) {
+         
+         if(poll_fd.fd < 0 || poll_fd.revents == 0) { continue; }
+         
+         auto n = ::read(poll_fd.fd, chunk, sizeof(chunk));
+         
+         if(n > 0) {
+            findWorker(poll_fd.fd).data_.append(chunk, n);
+         }
+         else if(n < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+         }
+         else {
+            
+            // End of file, or a broken pipe that fails the worker.
+            //
+            closePipe(poll_fd, n < 0);
+            --n_open;
+         }
+      }
+   }
+   
+   for(auto &worker: workers) {
+      
+      int status = 0;
+      bool success = false;
+      
+      if(worker.pid_ > 0) {
+         while(   (::waitpid(worker.pid_, &status, 0) < 0) 
+               && (errno == EINTR)) {}
+         success =    !worker.failed_
+                   && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+      }
+      
+      std::size_t pos = 0;
+      for(std::size_t i = worker.begin_; i < worker.end_; ++i) {
+         
+         uint32_t size = 0;
+         
+         if(   success 
+            && (pos + sizeof(size) <= worker.data_.size())) {
+            std::memcpy(&size, worker.data_.data() + pos, sizeof(size));
+            pos += sizeof(size);
+            success = (pos + size <= worker.data_.size());
+         }
+         else {
+            success = false;
+         }
+         
+         if(success) {
+            results[i].assign(worker.data_, pos, size);
+            pos += size;
+         }
+         else {
+            valid[i] = false;
+         }
+      }
+   }
+}
+
+} // namespace
+
+int WorkerPool::getNumWorkers(int n_requested, std::size_t n_items)
+{
+   int n_workers = n_requested;
+   if(n_workers <= 0) {
+      n_workers = std::thread::hardware_concurrency();
+   }
+   if(n_workers > int(n_items)) {
+      n_workers = n_items;
+   }
+   if(n_workers < 1) {
+      n_workers = 1;
+   }
+   return n_workers;
+}
+
+void WorkerPool::run(WorkerType worker_type, int n_workers, std::size_t n_items,
+                     const WorkerFunction &worker_function,
+                     std::vector<std::string> &results,
+                     std::vector<bool> &valid)
+{
+   results.assign(n_items, std::string());
+   valid.assign(n_items, true);
+   
+   if(n_items == 0) { return; }
+   
+   if(worker_type == ProcessWorkers) {
+      runProcessWorkers(n_workers, n_items, worker_function, results, valid);
+   }
+   else {
+      runThreadWorkers(n_workers, n_items, worker_function, results);
+   }
+}
+
+} // namespace papilio
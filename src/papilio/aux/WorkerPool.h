@@ -0,0 +1,82 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace papilio {
+   
+/// @brief Distributes work items over a number of workers.
+/// @details The items [0, n_items) are split into contiguous shares, 
+///        one per worker. A worker function processes a share
+///        and generates one result string per item. Workers are
+///        either threads or forked processes. The results of 
+///        process workers are transferred to the parent via pipes. 
+///
+class WorkerPool
+{
+   public:
+      
+      /// @brief The types of workers.
+      ///
+      enum WorkerType {
+         
+         /// @brief Every worker is a thread.
+         ///
+         ThreadWorkers,
+         
+         /// @brief Every worker is a forked process.
+         ///
+         ProcessWorkers
+      };
+      
+      /// @brief A function that processes the items [begin, end).
+      /// @details results has end - begin entries. Entry i - begin
+      ///        receives the result of item i.
+      ///
+      typedef std::function<void(std::size_t begin, std::size_t end, 
+                                 std::vector<std::string> &results)> WorkerFunction;
+      
+      /// @brief Computes the number of workers to use.
+      /// @param n_requested The requested number of workers. If zero, 
+      ///        one worker per hardware thread is used.
+      /// @param n_items The number of work items.
+      /// @returns A number of workers in the range [1, max(1, n_items)].
+      ///
+      static int getNumWorkers(int n_requested, std::size_t n_items);
+      
+      /// @brief Processes all items.
+      ///
+      /// @param worker_type The type of workers.
+      /// @param n_workers The number of workers.
+      /// @param n_items The number of work items.
+      /// @param worker_function The function that processes a share of items.
+      /// @param results Receives the results of all items.
+      /// @param valid Receives false for every item whose worker 
+      ///        terminated abnormally.
+      ///
+      static void run(WorkerType worker_type, int n_workers, std::size_t n_items,
+                      const WorkerFunction &worker_function,
+                      std::vector<std::string> &results,
+                      std::vector<bool> &valid);
+};
+
+} // namespace papilio
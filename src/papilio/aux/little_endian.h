@@ -0,0 +1,51 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace papilio {
+   
+/// @brief Stores the lower bytes of an integer in little endian order.
+///
+/// @param buffer The buffer to write to.
+/// @param value The value to store.
+/// @param n_bytes The number of bytes to store.
+///
+inline void encodeLittleEndian(uint8_t *buffer, uint64_t value, int n_bytes)
+{
+   for(int i = 0; i < n_bytes; ++i) {
+      buffer[i] = uint8_t(value >> (8*i));
+   }
+}
+
+/// @brief Reads an integer that is stored in little endian order.
+///
+/// @param buffer The buffer to read from.
+/// @param n_bytes The number of bytes to read.
+///
+inline uint64_t decodeLittleEndian(const uint8_t *buffer, int n_bytes)
+{
+   uint64_t value = 0;
+   for(int i = n_bytes - 1; i >= 0; --i) {
+      value = (value << 8) | buffer[i];
+   }
+   return value;
+}
+
+} // namespace papilio
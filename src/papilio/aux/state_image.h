@@ -0,0 +1,78 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/aux/little_endian.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace papilio {
+   
+// State images of cores that consist of several parts (see
+// SimulatorCore_::saveState(...)) store every part preceded by 
+// its size (4 bytes little endian).
+   
+/// @brief Appends a size prefixed part to a state image.
+///
+/// @param image The image.
+/// @param data The data of the part.
+/// @param size The number of bytes of the part.
+///
+inline void appendImagePart(std::vector<uint8_t> &image, const void *data, size_t size)
+{
+   size_t pos = image.size();
+   image.resize(pos + 4 + size);
+   encodeLittleEndian(&image[pos], size, 4);
+   if(size > 0) {
+      memcpy(&image[pos + 4], data, size);
+   }
+}
+
+inline void appendImagePart(std::vector<uint8_t> &image, const std::vector<uint8_t> &part)
+{
+   appendImagePart(image, part.data(), part.size());
+}
+
+/// @brief Reads a size prefixed part of a state image.
+///
+/// @param image The image.
+/// @param pos The position of the part. Advanced to the next part.
+/// @param part The part that is read.
+///
+/// @returns False if the image is truncated.
+///
+inline bool readImagePart(const std::vector<uint8_t> &image, size_t &pos, 
+                          std::vector<uint8_t> &part)
+{
+   if(pos + 4 > image.size()) {
+      return false;
+   }
+   size_t size = size_t(decodeLittleEndian(&image[pos], 4));
+   pos += 4;
+   if(pos + size > image.size()) {
+      return false;
+   }
+   part.assign(image.begin() + pos, image.begin() + pos + size);
+   pos += size;
+   return true;
+}
+
+} // namespace papilio
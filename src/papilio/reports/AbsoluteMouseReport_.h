@@ -81,6 +81,24 @@ class AbsoluteMouseReport_ : public Report_ {
       /// @returns The horizontal wheel movement.
       ///
       virtual int8_t getHorizontalWheel() const = 0;
+      
+      /// @brief Retreives a fixed size representation of the report.
+      /// @param data The data object to fill.
+      ///
+      virtual void getData(ReportData &data) const override {
+         data.reset(type_, 7);
+         data.bytes_[0] = uint8_t(  (this->isLeftButtonPressed() ? 1 : 0)
+                                  | (this->isRightButtonPressed() ? 2 : 0)
+                                  | (this->isMiddleButtonPressed() ? 4 : 0));
+         uint16_t x = this->getXPosition();
+         uint16_t y = this->getYPosition();
+         data.bytes_[1] = uint8_t(x);
+         data.bytes_[2] = uint8_t(x >> 8);
+         data.bytes_[3] = uint8_t(y);
+         data.bytes_[4] = uint8_t(y >> 8);
+         data.bytes_[5] = uint8_t(this->getVerticalWheel());
+         data.bytes_[6] = uint8_t(this->getHorizontalWheel());
+      }
  
       static const char *typeString() { return "absolute mouse"; }
       virtual const char *getTypeString() const override { return typeString(); }
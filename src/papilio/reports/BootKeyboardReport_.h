@@ -18,6 +18,7 @@
 #pragma once
 
 #include "papilio/reports/Report_.h"
+#include "papilio/reports/KeyboardReport_.h"
 
 // Undefine some macros defined by Arduino
 //
@@ -74,6 +75,22 @@ class BootKeyboardReport_ : public Report_ {
       /// @returns A list of active modifier keycodes.
       ///
       virtual std::vector<uint8_t> getActiveModifiers() const = 0;
+      
+      /// @brief Retreives a fixed size representation of the report.
+      /// @details The layout is the same as that of keyboard reports.
+      /// @param data The data object to fill.
+      ///
+      virtual void getData(ReportData &data) const override {
+         data.reset(type_, 33);
+         for(auto modifier: this->getActiveModifiers()) {
+            if(KeyboardReport_::isModifierKeycode(modifier)) {
+               data.bytes_[0] |= uint8_t(1 << (modifier - KeyboardReport_::first_modifier_keycode));
+            }
+         }
+         for(auto keycode: this->getActiveKeycodes()) {
+            data.bytes_[1 + keycode/8] |= uint8_t(1 << (keycode % 8));
+         }
+      }
             
       static const char *typeString() { return "boot keyboard"; }
       virtual const char *getTypeString() const override { return typeString(); }
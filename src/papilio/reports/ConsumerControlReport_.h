@@ -0,0 +1,85 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/reports/Report_.h"
+
+// Undefine some macros defined by Arduino
+//
+#undef min
+#undef max
+
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+#include <ostream>
+
+namespace papilio {
+   
+class Simulator;
+  
+/// @brief An interface hat facilitates analyzing consumer control reports.
+/// @details Consumer control reports transport usages of the HID consumer
+///        page, e.g. volume or media keys.
+///
+class ConsumerControlReport_ : public Report_ {
+   
+   public:
+      
+      static constexpr uint8_t type_ = ConsumerControlReportTypeId;
+      
+      typedef ConsumerControlReport_ BaseReportType;
+      
+      /// @brief The maximum number of usages that are represented
+      ///        by the report data.
+      ///
+      static constexpr int max_usages = 4;
+      
+      /// @brief Checks if a consumer usage is active in the report.
+      /// @param usage The usage to check for.
+      /// @returns [bool] True if the given usage is active.
+      ///
+      virtual bool isUsageActive(uint16_t usage) const = 0;
+      
+      /// @brief Retreives a list of all usages that are active in the report.
+      /// @returns A vector of usages.
+      ///
+      virtual std::vector<uint16_t> getActiveUsages() const = 0;
+      
+      /// @brief Retreives a fixed size representation of the report.
+      /// @details The active usages are stored in ascending order.
+      /// @param data The data object to fill.
+      ///
+      virtual void getData(ReportData &data) const override {
+         data.reset(type_, 2*max_usages);
+         auto usages = this->getActiveUsages();
+         std::sort(usages.begin(), usages.end());
+         int n_usages = 0;
+         for(auto usage: usages) {
+            if((usage == 0) || (n_usages == max_usages)) { continue; }
+            data.bytes_[2*n_usages] = uint8_t(usage);
+            data.bytes_[2*n_usages + 1] = uint8_t(usage >> 8);
+            ++n_usages;
+         }
+      }
+      
+      static const char *typeString() { return "consumer control"; }
+      virtual const char *getTypeString() const override { return typeString(); }
+};
+
+} // namespace papilio
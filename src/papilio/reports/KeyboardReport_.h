@@ -18,6 +18,7 @@
 #pragma once
 
 #include "papilio/reports/Report_.h"
+#include "papilio/reports/KeycodeBitmap.h"
 
 // Undefine some macros defined by Arduino
 //
@@ -42,6 +43,12 @@ class KeyboardReport_ : public Report_ {
       
       typedef KeyboardReport_ BaseReportType;
       
+      /// @brief The keycode of the first modifier (left control). 
+      /// @details Bit n of the modifier bitmap represents modifier 
+      ///        keycode first_modifier_keycode + n.
+      ///
+      static constexpr uint8_t first_modifier_keycode = 0xE0;
+      
       /// @brief Checks if a keycode is active in the keyboard report.
       /// @param keycode The keycode to check for.
       /// @returns [bool] True if the given keycode is active.
@@ -75,6 +82,59 @@ class KeyboardReport_ : public Report_ {
       ///
       virtual std::vector<uint8_t> getActiveModifiers() const = 0;
       
+      /// @brief Retreives the bitmap of all active keycodes.
+      /// @details The default implementation is based on getActiveKeycodes().
+      ///        Cores should override this method to expose the
+      ///        bitmap of the underlying HID report directly, e.g. by
+      ///        means of KeycodeBitmap::assignBytes(...).
+      /// @returns The keycode bitmap.
+      ///
+      virtual KeycodeBitmap getKeycodeBitmap() const {
+         return KeycodeBitmap{this->getActiveKeycodes()};
+      }
+      
+      /// @brief Retreives the bitmap of active modifiers.
+      /// @details The default implementation is based on getActiveModifiers().
+      ///        Cores should override this method to expose the
+      ///        modifier byte of the underlying HID report directly.
+      /// @returns The modifier bitmap. Bit n represents modifier keycode
+      ///        first_modifier_keycode + n.
+      ///
+      virtual uint8_t getModifierBitmap() const {
+         uint8_t bitmap = 0;
+         for(auto modifier: this->getActiveModifiers()) {
+            if(isModifierKeycode(modifier)) {
+               bitmap |= uint8_t(1 << (modifier - first_modifier_keycode));
+            }
+         }
+         return bitmap;
+      }
+      
+      /// @brief Checks if a keycode is representable in the modifier bitmap.
+      /// @param keycode The keycode to check.
+      ///
+      static bool isModifierKeycode(uint8_t keycode) {
+         return (keycode >= first_modifier_keycode) 
+             && (keycode < first_modifier_keycode + 8);
+      }
+      
+      /// @brief Retreives a fixed size representation of the report.
+      /// @details The default implementation is based on the modifier
+      ///        and keycode bitmaps.
+      /// @param data The data object to fill.
+      ///
+      virtual void getData(ReportData &data) const override {
+         data.reset(type_, 33);
+         data.bytes_[0] = this->getModifierBitmap();
+         auto keycodes = this->getKeycodeBitmap();
+         for(int w = 0; w < KeycodeBitmap::num_words; ++w) {
+            uint64_t word = keycodes.getWord(w);
+            for(int b = 0; b < 8; ++b) {
+               data.bytes_[1 + 8*w + b] = uint8_t(word >> (8*b));
+            }
+         }
+      }
+      
       static const char *typeString() { return "keyboard"; }
       virtual const char *getTypeString() const override { return typeString(); }
 };
@@ -0,0 +1,131 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+namespace papilio {
+   
+/// @brief A set of keycodes, stored as a 256 bit bitmap.
+/// @details Bit n represents keycode n. Set operations work 
+///        on entire 64 bit words and do not allocate.
+///
+class KeycodeBitmap {
+   
+   public:
+      
+      static constexpr int num_words = 4;
+      
+      /// @brief Constructs an empty bitmap.
+      ///
+      KeycodeBitmap() = default;
+      
+      /// @brief Constructs a bitmap from a list of keycodes.
+      /// @param keycodes The keycodes whose bits are to be set.
+      ///
+      explicit KeycodeBitmap(const std::vector<uint8_t> &keycodes) {
+         for(auto keycode: keycodes) {
+            this->set(keycode);
+         }
+      }
+      
+      /// @brief Copies a raw bitmap, e.g. the key bitmap of a HID report.
+      /// @details Bit n % 8 of byte n / 8 represents keycode n.
+      ///
+      /// @param bytes The raw bitmap.
+      /// @param n_bytes The number of bytes to copy (at most 32). 
+      ///        Keycodes beyond the copied range are considered inactive.
+      ///
+      void assignBytes(const uint8_t *bytes, size_t n_bytes) {
+         uint8_t buffer[sizeof(words_)] = {};
+         memcpy(buffer, bytes, (n_bytes < sizeof(buffer)) ? n_bytes : sizeof(buffer));
+         for(int w = 0; w < num_words; ++w) {
+            uint64_t word = 0;
+            for(int b = 7; b >= 0; --b) {
+               word = (word << 8) | buffer[8*w + b];
+            }
+            words_[w] = word;
+         }
+      }
+      
+      void set(uint8_t keycode) {
+         words_[keycode >> 6] |= uint64_t(1) << (keycode & 63);
+      }
+      
+      void reset(uint8_t keycode) {
+         words_[keycode >> 6] &= ~(uint64_t(1) << (keycode & 63));
+      }
+      
+      bool test(uint8_t keycode) const {
+         return (words_[keycode >> 6] >> (keycode & 63)) & 1;
+      }
+      
+      /// @brief Checks if no keycode is set.
+      ///
+      bool none() const {
+         return (words_[0] | words_[1] | words_[2] | words_[3]) == 0;
+      }
+      
+      /// @brief Checks if all keycodes of this bitmap are also set in another one.
+      /// @param other The bitmap to compare with.
+      ///
+      bool isSubsetOf(const KeycodeBitmap &other) const {
+         return (  (words_[0] & ~other.words_[0])
+                 | (words_[1] & ~other.words_[1])
+                 | (words_[2] & ~other.words_[2])
+                 | (words_[3] & ~other.words_[3])) == 0;
+      }
+      
+      bool operator==(const KeycodeBitmap &other) const {
+         return (  (words_[0] ^ other.words_[0])
+                 | (words_[1] ^ other.words_[1])
+                 | (words_[2] ^ other.words_[2])
+                 | (words_[3] ^ other.words_[3])) == 0;
+      }
+      
+      bool operator!=(const KeycodeBitmap &other) const {
+         return !(*this == other);
+      }
+      
+      /// @brief Retreives one 64 bit word of the bitmap.
+      /// @param w The word index in the range [0, 3]. Word w
+      ///        represents keycodes 64*w to 64*w + 63.
+      ///
+      uint64_t getWord(int w) const { return words_[w]; }
+      
+      /// @brief Retreives the list of keycodes set, in ascending order.
+      ///
+      std::vector<uint8_t> toKeycodes() const {
+         std::vector<uint8_t> keycodes;
+         for(int keycode = 0; keycode < 256; ++keycode) {
+            if(this->test(uint8_t(keycode))) {
+               keycodes.push_back(uint8_t(keycode));
+            }
+         }
+         return keycodes;
+      }
+      
+   private:
+      
+      uint64_t words_[num_words] = {};
+};
+
+} // namespace papilio
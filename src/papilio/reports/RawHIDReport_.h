@@ -0,0 +1,73 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/reports/Report_.h"
+
+// Undefine some macros defined by Arduino
+//
+#undef min
+#undef max
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <ostream>
+
+namespace papilio {
+   
+class Simulator;
+  
+/// @brief An interface hat facilitates analyzing raw HID reports.
+///
+class RawHIDReport_ : public Report_ {
+   
+   public:
+      
+      static constexpr uint8_t type_ = RawHIDReportTypeId;
+      
+      typedef RawHIDReport_ BaseReportType;
+      
+      /// @brief The maximum size of a raw HID report.
+      ///
+      static constexpr size_t max_size = 64;
+      
+      /// @brief Retreives the number of bytes of the report.
+      ///
+      virtual size_t getSize() const = 0;
+      
+      /// @brief Retreives the bytes of the report.
+      ///
+      virtual const uint8_t *getBytes() const = 0;
+      
+      /// @brief Retreives a fixed size representation of the report.
+      /// @details Bytes beyond max_size are not represented.
+      /// @param data The data object to fill.
+      ///
+      virtual void getData(ReportData &data) const override {
+         size_t size = this->getSize();
+         if(size > max_size) { size = max_size; }
+         data.reset(type_, uint8_t(size));
+         memcpy(data.bytes_, this->getBytes(), size);
+      }
+      
+      static const char *typeString() { return "raw HID"; }
+      virtual const char *getTypeString() const override { return typeString(); }
+};
+
+} // namespace papilio
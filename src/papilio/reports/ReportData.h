@@ -0,0 +1,125 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+namespace papilio {
+   
+/// @brief A fixed size, trivially copyable representation of a report.
+/// @details Report data can be stored inline in containers, copied 
+///        with memcpy and compared and hashed without virtual dispatch 
+///        or heap allocation. It is retreived via Report_::getData(...).
+///
+///        The byte layout depends on the report type.
+///
+///        boot keyboard, keyboard (33 bytes):
+///           [0]       modifier bitmap (bit n: modifier keycode 0xE0 + n)
+///           [1..32]   keycode bitmap (bit k % 8 of byte 1 + k / 8: keycode k)
+///
+///        mouse (5 bytes):
+///           [0]       buttons (bit 0: left, bit 1: right, bit 2: middle)
+///           [1], [2]  x- and y-movement
+///           [3], [4]  vertical and horizontal wheel
+///
+///        absolute mouse (7 bytes):
+///           [0]       buttons (bit 0: left, bit 1: right, bit 2: middle)
+///           [1..2]    x-position (little endian)
+///           [3..4]    y-position (little endian)
+///           [5], [6]  vertical and horizontal wheel
+///
+///        consumer control (8 bytes):
+///           [0..7]    up to four usages (little endian), ascending
+///
+///        system control (1 byte):
+///           [0]       usage
+///
+///        raw HID (up to 64 bytes):
+///           [0..63]   the report bytes
+///
+///        Unused bytes are always zero.
+///
+///        Report data crosses the boundary of core libraries 
+///        (see CoreLibrary). Changing its layout requires increasing
+///        PAPILIO_CORE_INTERFACE_VERSION.
+///
+struct ReportData {
+   
+   static constexpr size_t max_size = 64;
+   
+   uint8_t type_id_;
+   uint8_t size_;
+   uint8_t bytes_[max_size];
+   
+   /// @brief Resets the data to an empty report of a given type.
+   /// @param type_id The report type id.
+   /// @param size The number of data bytes used by the report type.
+   ///
+   void reset(uint8_t type_id, uint8_t size) {
+      memset(this, 0, sizeof(ReportData));
+      type_id_ = type_id;
+      size_ = size;
+   }
+   
+   /// @brief Computes a hash value of the report data (FNV-1a).
+   ///
+   size_t hash() const {
+      uint32_t h = 2166136261u;
+      const uint8_t *bytes = reinterpret_cast<const uint8_t*>(this);
+      for(size_t i = 0; i < 2 + size_t(size_); ++i) {
+         h = (h ^ bytes[i])*16777619u;
+      }
+      return h;
+   }
+   
+   /// @brief Generates a hexadecimal representation of the data bytes.
+   ///
+   std::string toHexString() const {
+      static const char digits[] = "0123456789abcdef";
+      std::string result;
+      result.reserve(3*size_);
+      for(size_t i = 0; i < size_; ++i) {
+         if(i > 0) { result += ' '; }
+         result += digits[bytes_[i] >> 4];
+         result += digits[bytes_[i] & 0xF];
+      }
+      return result;
+   }
+};
+
+inline
+bool operator==(const ReportData &a, const ReportData &b) {
+   return memcmp(&a, &b, sizeof(ReportData)) == 0;
+}
+
+inline
+bool operator!=(const ReportData &a, const ReportData &b) {
+   return !(a == b);
+}
+
+/// @brief A hash functor that enables using report data as key of 
+///        unordered containers.
+///
+struct ReportDataHash {
+   size_t operator()(const ReportData &data) const { return data.hash(); }
+};
+
+} // namespace papilio
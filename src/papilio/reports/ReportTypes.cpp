@@ -0,0 +1,41 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "papilio/reports/ReportTypes.h"
+#include "papilio/Simulator.h"
+#include "papilio/Simulator_Impl.h"
+#include "papilio/ActionContainer_Impl.h"
+
+namespace papilio {
+
+// Explicit template instantiations of the permanent action containers
+// of all entries of ReportTypes.
+//
+#define PAPILIO_INSTANTIATE_REPORT_ACTION_CONTAINER_(REPORT_TYPE, TYPE_ID)     \
+   template class ActionContainer<ReportAction<REPORT_TYPE>>;
+
+PAPILIO_FOR_EACH_REPORT_TYPE(PAPILIO_INSTANTIATE_REPORT_ACTION_CONTAINER_)
+
+// Explicit template instantiations of the report processing 
+// of all entries of ReportTypes.
+//
+#define PAPILIO_INSTANTIATE_REPORT_PROCESSING_(REPORT_TYPE, TYPE_ID)           \
+   template void Simulator::processReportProfiled(const REPORT_TYPE &);
+
+PAPILIO_FOR_EACH_REPORT_TYPE(PAPILIO_INSTANTIATE_REPORT_PROCESSING_)
+
+} // namespace papilio
@@ -0,0 +1,195 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/reports/Report_.h"
+#include "papilio/reports/BootKeyboardReport_.h"
+#include "papilio/reports/KeyboardReport_.h"
+#include "papilio/reports/MouseReport_.h"
+#include "papilio/reports/AbsoluteMouseReport_.h"
+#include "papilio/reports/ConsumerControlReport_.h"
+#include "papilio/reports/SystemControlReport_.h"
+#include "papilio/reports/RawHIDReport_.h"
+
+#include <stddef.h>
+#include <tuple>
+
+namespace papilio {
+   
+/// @brief A compile time list of report types.
+///
+template<typename... _ReportTypes>
+struct ReportTypeList {
+   static constexpr size_t size = sizeof...(_ReportTypes);
+};
+
+/// @private
+///
+template<typename _Void, typename... _ReportTypes>
+struct ReportTypeListOf {
+   typedef ReportTypeList<_ReportTypes...> Type;
+};
+
+/// @private
+///
+#define PAPILIO_LIST_REPORT_TYPE_(REPORT_TYPE, TYPE_ID) , REPORT_TYPE
+
+/// @brief The report types that are known to the simulator.
+/// @details The simulator generates its permanent report action containers
+///        and report counters from this list. It is generated from 
+///        PAPILIO_FOR_EACH_REPORT_TYPE (see papilio/reports/Report_.h).
+///
+typedef ReportTypeListOf<void PAPILIO_FOR_EACH_REPORT_TYPE(PAPILIO_LIST_REPORT_TYPE_)>::Type 
+   ReportTypes;
+
+#undef PAPILIO_LIST_REPORT_TYPE_
+
+/// @private
+///
+template<size_t _I, typename _List>
+struct ReportTypeAt {};
+
+/// @private
+///
+template<typename _Head, typename... _Tail>
+struct ReportTypeAt<0, ReportTypeList<_Head, _Tail...>> {
+   typedef _Head Type;
+};
+
+/// @private
+///
+template<size_t _I, typename _Head, typename... _Tail>
+struct ReportTypeAt<_I, ReportTypeList<_Head, _Tail...>> {
+   typedef typename ReportTypeAt<_I - 1, ReportTypeList<_Tail...>>::Type Type;
+};
+
+/// @private
+///
+template<typename _ReportType, typename _List>
+struct ReportTypeIndex {};
+
+/// @private
+///
+template<typename _ReportType, typename... _Tail>
+struct ReportTypeIndex<_ReportType, ReportTypeList<_ReportType, _Tail...>> {
+   static constexpr size_t value = 0;
+};
+
+/// @private
+///
+template<typename _ReportType, typename _Head, typename... _Tail>
+struct ReportTypeIndex<_ReportType, ReportTypeList<_Head, _Tail...>> {
+   static constexpr size_t value 
+      = 1 + ReportTypeIndex<_ReportType, ReportTypeList<_Tail...>>::value;
+};
+
+/// @private
+///
+template<typename _ReportType>
+struct ReportTraits
+{
+   typedef typename _ReportType::BaseReportType BaseReportType;
+   
+   static constexpr int type_id = BaseReportType::type_;
+   
+   /// @brief The position of the report type in ReportTypes.
+   ///
+   static constexpr size_t index = ReportTypeIndex<BaseReportType, ReportTypes>::value;
+   
+   static_assert(type_id == int(index) + 1, 
+                 "The report type id must equal the position in ReportTypes plus one");
+};
+
+/// @brief Calls f.template apply<I>() for every index I of ReportTypes.
+/// @details As of C++11 there are no generic lambdas. The functor is
+///        thus a class with a member function template apply<I>().
+///
+template<size_t _I = 0, size_t _N = ReportTypes::size>
+struct ForEachReportType {
+   template<typename _F>
+   static void apply(_F &f) {
+      f.template apply<_I>();
+      ForEachReportType<_I + 1, _N>::apply(f);
+   }
+};
+
+/// @private
+///
+template<size_t _N>
+struct ForEachReportType<_N, _N> {
+   template<typename _F>
+   static void apply(_F &) {}
+};
+
+/// @private
+///
+template<template<typename> class _Mapping, typename _List>
+struct ReportTypeTuple {};
+
+/// @brief A tuple with one element _Mapping<_ReportType>::Type per report type.
+///
+template<template<typename> class _Mapping, typename... _ReportTypes>
+struct ReportTypeTuple<_Mapping, ReportTypeList<_ReportTypes...>> {
+   
+   typedef std::tuple<typename _Mapping<_ReportTypes>::Type...> Type;
+   
+   /// @brief Creates a tuple whose elements are all constructed from
+   ///        the same argument.
+   ///
+   template<typename _Arg>
+   static Type create(_Arg &arg) {
+      return Type(repeatForReportType<_ReportTypes>(arg)...);
+   }
+   
+   private:
+      
+      template<typename _ReportType, typename _Arg>
+      static _Arg &repeatForReportType(_Arg &arg) { return arg; }
+};
+
+/// @private
+///
+template<typename _List>
+struct ReportTypeStrings {};
+
+/// @private
+///
+template<typename... _ReportTypes>
+struct ReportTypeStrings<ReportTypeList<_ReportTypes...>> {
+   static const char *get(int type_id) {
+      static const char *const type_strings[] = {
+         Report_::typeString(), _ReportTypes::typeString()...
+      };
+      if((type_id < 0) || (type_id > int(sizeof...(_ReportTypes)))) {
+         return Report_::typeString();
+      }
+      return type_strings[type_id];
+   }
+};
+
+/// @brief Retreives the type string of a report type.
+/// @param type_id The report type id.
+/// @returns The type string or the generic type string for AnyTypeReportTypeId
+///        and unknown ids.
+///
+inline
+const char *getReportTypeString(int type_id) {
+   return ReportTypeStrings<ReportTypes>::get(type_id);
+}
+
+} // namespace papilio
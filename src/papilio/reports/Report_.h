@@ -25,19 +25,48 @@
 #undef max
 #endif
 
+#include "papilio/reports/ReportData.h"
+
 #include <memory>
 
 namespace papilio {
    
 class Simulator;
 
+/// @brief Invokes a macro for every report type that is known 
+///        to the simulator with the interface class and the name of 
+///        its type id.
+/// @details This is the only list of report types. The type id enum
+///        below, the ReportTypes list (see papilio/reports/ReportTypes.h), 
+///        and the explicit template instantiations and their extern 
+///        template declarations are generated from it. To add a report type,
+///        define its interface class (with type_, BaseReportType and
+///        typeString()) and append it to this list.
+///
+#define PAPILIO_FOR_EACH_REPORT_TYPE(MACRO)                                    \
+   MACRO(BootKeyboardReport_,    BootKeyboardReportTypeIdId)                   \
+   MACRO(KeyboardReport_,        KeyboardReportTypeId)                         \
+   MACRO(MouseReport_,           MouseReportTypeId)                            \
+   MACRO(AbsoluteMouseReport_,   AbsoluteMouseReportTypeId)                    \
+   MACRO(ConsumerControlReport_, ConsumerControlReportTypeId)                  \
+   MACRO(SystemControlReport_,   SystemControlReportTypeId)                    \
+   MACRO(RawHIDReport_,          RawHIDReportTypeId)
+
+/// @private
+///
+#define PAPILIO_REPORT_TYPE_ID_(REPORT_TYPE, TYPE_ID) TYPE_ID,
+
+/// @brief The report type ids.
+/// @details The id of a report type is its position in 
+///        PAPILIO_FOR_EACH_REPORT_TYPE plus one.
+///
 enum {
    AnyTypeReportTypeId = 0,
-   BootKeyboardReportTypeIdId = 1,
-   KeyboardReportTypeId = 2,
-   MouseReportTypeId = 3,
-   AbsoluteMouseReportTypeId = 4
+   PAPILIO_FOR_EACH_REPORT_TYPE(PAPILIO_REPORT_TYPE_ID_)
+   NumReportTypeIds
 };
+
+#undef PAPILIO_REPORT_TYPE_ID_
   
 /// @brief A common base class for HID reports.
 ///
@@ -60,6 +89,13 @@ class Report_ {
       ///
       virtual bool equals(const Report_ &other) const = 0;
       
+      /// @brief Retreives a fixed size representation of the report.
+      /// @details Report data of two reports with identical content 
+      ///        compares equal.
+      /// @param data The data object to fill.
+      ///
+      virtual void getData(ReportData &data) const = 0;
+      
       /// @brief Checks if the report is empty.
       /// @details Empty means neither key nor modifier keycodes are active.
       ///
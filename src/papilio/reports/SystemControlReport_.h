@@ -0,0 +1,63 @@
+/* -*- mode: c++ -*-
+ * Papilio - A keyboard simulation framework 
+ * Copyright (C) 2019  noseglasses (shinynoseglasses@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "papilio/reports/Report_.h"
+
+// Undefine some macros defined by Arduino
+//
+#undef min
+#undef max
+
+#include <stdint.h>
+#include <ostream>
+
+namespace papilio {
+   
+class Simulator;
+  
+/// @brief An interface hat facilitates analyzing system control reports.
+/// @details System control reports transport usages of the HID generic
+///        desktop page, e.g. power down, sleep or wake up.
+///
+class SystemControlReport_ : public Report_ {
+   
+   public:
+      
+      static constexpr uint8_t type_ = SystemControlReportTypeId;
+      
+      typedef SystemControlReport_ BaseReportType;
+      
+      /// @brief Queries the active system control usage.
+      /// @returns The active usage or zero if none is active.
+      ///
+      virtual uint8_t getUsage() const = 0;
+      
+      /// @brief Retreives a fixed size representation of the report.
+      /// @param data The data object to fill.
+      ///
+      virtual void getData(ReportData &data) const override {
+         data.reset(type_, 1);
+         data.bytes_[0] = this->getUsage();
+      }
+      
+      static const char *typeString() { return "system control"; }
+      virtual const char *getTypeString() const override { return typeString(); }
+};
+
+} // namespace papilio
@@ -17,10 +17,37 @@
 
 #pragma once
 
+#include "papilio/KeyMatrixState.h"
+
+#include <stdint.h>
+
 namespace papilio {
 namespace keyboardio {
 namespace model01 {
    
+/// @brief The LED index of every key, indexed by row*16 + col.
+///
+constexpr uint8_t key_led_map[64] = {
+   3, 4, 11, 12, 19, 20, 26, 27,     36, 37, 43, 44, 51, 52, 59, 60,
+   2, 5, 10, 13, 18, 21, 25, 28,     35, 38, 42, 45, 50, 53, 58, 61,
+   1, 6,  9, 14, 17, 22, 24, 29,     34, 39, 41, 46, 49, 54, 57, 62,
+   0, 7,  8, 15, 16, 23, 31, 30,     33, 32, 40, 47, 48, 55, 56, 63
+};
+
+/// @brief Compile time properties of the Model01 key matrix.
+/// @details Use these with StaticSimulatorCore.
+///
+struct MatrixTraits {
+   
+   static constexpr uint8_t rows = 4;
+   static constexpr uint8_t cols = 16;
+   static constexpr KeyOffset n_leds = 64;
+   
+   static constexpr KeyOffset keyToLED(KeyOffset key_offset) {
+      return key_led_map[key_offset];
+   }
+};
+   
 /// @brief A formatted string that represents the keyboard layout of 
 ///        the Keyboardio Model01.
 /// @details Use this string with the renderKeyboard(...) function.